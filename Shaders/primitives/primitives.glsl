@@ -0,0 +1,84 @@
+// Shared by the primitive kernels. A workgroup processes a tile of TILE_SIZE elements, each invocation
+// ITEMS_PER_THREAD consecutive ones; must match GpuPrimitives on the host.
+// USE_SUBGROUPS needs the Vulkan 1.1 target and a compute subgroup of 16 invocations or more, dividing
+// GROUP_SIZE (checked on the host, CanUseSubgroups). The subgroup scan also assumes invocations are laid out
+// linearly across subgroups, gl_LocalInvocationIndex = gl_SubgroupID * gl_SubgroupSize + gl_SubgroupInvocationID,
+// which implementations do in practice for a one-dimensional workgroup of full subgroups.
+#ifdef USE_SUBGROUPS
+#extension GL_KHR_shader_subgroup_basic : require
+#extension GL_KHR_shader_subgroup_arithmetic : require
+#endif
+
+#define GROUP_SIZE 256
+#define ITEMS_PER_THREAD 4
+#define TILE_SIZE (GROUP_SIZE * ITEMS_PER_THREAD)
+#define RADIX_BITS 8
+#define RADIX_SIZE 256
+
+layout( local_size_x = GROUP_SIZE ) in;
+
+shared uint s_scan[GROUP_SIZE];
+shared uint s_groupTotal;
+
+// Tiles past the 65535 groups of a dispatch dimension go to Y
+uint GetTileIndex()
+{
+	return gl_WorkGroupID.x + gl_WorkGroupID.y * gl_NumWorkGroups.x;
+}
+
+uint WorkgroupInclusiveAddShared( uint value )
+{
+	// Hillis-Steele in shared memory, log2(GROUP_SIZE) steps
+	const uint i = gl_LocalInvocationID.x;
+	s_scan[i] = value;
+	barrier();
+	for ( uint offset = 1; offset < GROUP_SIZE; offset <<= 1 )
+	{
+		const uint other = i >= offset ? s_scan[i - offset] : 0;
+		barrier();
+		s_scan[i] += other;
+		barrier();
+	}
+	const uint result = s_scan[i];
+	if ( i == GROUP_SIZE - 1 )
+		s_groupTotal = result;
+	barrier();
+	return result;
+}
+
+#ifdef USE_SUBGROUPS
+uint WorkgroupInclusiveAddSubgroups( uint value )
+{
+	// Subgroups scan their own values, then the first subgroup scans the subgroup totals
+	const uint scan = subgroupInclusiveAdd( value );
+	if ( gl_SubgroupInvocationID == gl_SubgroupSize - 1 )
+		s_scan[gl_SubgroupID] = scan;
+	barrier();
+	if ( gl_SubgroupID == 0 )
+	{
+		const uint total = gl_SubgroupInvocationID < gl_NumSubgroups ? s_scan[gl_SubgroupInvocationID] : 0;
+		const uint prefix = subgroupExclusiveAdd( total );
+		if ( gl_SubgroupInvocationID < gl_NumSubgroups )
+			s_scan[gl_SubgroupInvocationID] = prefix;
+		if ( gl_SubgroupInvocationID == gl_NumSubgroups - 1 )
+			s_groupTotal = prefix + total;
+	}
+	barrier();
+	const uint result = scan + s_scan[gl_SubgroupID];
+	barrier();
+	return result;
+}
+#endif
+
+// Inclusive sum of one value per invocation, in invocation order, with the workgroup total left in
+// s_groupTotal until the next call. Every invocation of the workgroup must make the call.
+uint WorkgroupInclusiveAdd( uint value )
+{
+#ifdef USE_SUBGROUPS
+	// Same for the whole workgroup, so the branch is uniform. The shared-memory scan only runs if the subgroup
+	// size the shader actually gets differs from the one the host checked, a driver free to vary it for instance.
+	if ( gl_NumSubgroups <= gl_SubgroupSize && gl_NumSubgroups * gl_SubgroupSize == GROUP_SIZE )
+		return WorkgroupInclusiveAddSubgroups( value );
+#endif
+	return WorkgroupInclusiveAddShared( value );
+}
@@ -0,0 +1,23 @@
+// Keys of the radix sort passes: uint, or uint64 as uvec2 (low word first) with KEY_64
+#ifdef KEY_64
+#define KEY_TYPE uvec2
+#else
+#define KEY_TYPE uint
+#endif
+
+layout( push_constant ) uniform Constants
+{
+	uint count;
+	uint shift;		// of the digit sorted by this pass
+	uint tileCount;	// histograms are digit-major: histogram[digit * tileCount + tile]
+} constants;
+
+uint GetDigit( KEY_TYPE key )
+{
+#ifdef KEY_64
+	const uint word = constants.shift < 32 ? key.x : key.y;
+	return (word >> (constants.shift & 31)) & (RADIX_SIZE - 1);
+#else
+	return (key >> constants.shift) & (RADIX_SIZE - 1);
+#endif
+}
@@ -1,10 +1,17 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+// Resolved at pipeline creation, the untaken branch is compiled out
+layout(constant_id = 0) const bool GRAYSCALE = false;
+
 layout(location = 0) out vec4 outColor;
 
 layout(location = 0) in vec3 inputColor;
 
 void main() {
-	outColor = vec4(inputColor, 1.0);
-}
\ No newline at end of file
+	vec3 color = inputColor;
+	if (GRAYSCALE) {
+		color = vec3(dot(color, vec3(0.299, 0.587, 0.114)));
+	}
+	outColor = vec4(color, 1.0);
+}
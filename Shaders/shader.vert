@@ -5,6 +5,20 @@ out gl_PerVertex {
 	vec4  gl_Position;
 };
 
+// Mirrors DrawParamsVulkan
+layout(push_constant) uniform DrawParams {
+	uint objectIndex;
+	uint materialIndex;
+	uint transformOffset;
+} draw;
+
+// Mirrors FrameConstantsVulkan, in the shared set of PerDrawStreamVulkan (PipelineLayoutVulkan::MAX_SETS - 1)
+layout(set = 3, binding = 0) uniform FrameConstants {
+	float aspectScale;
+	float time;
+	uint frameNumber;
+} frame;
+
 vec2 inputVertex[3] = {
 	vec2(0.0, -0.5),
 	vec2(0.5, 0.5),
@@ -20,6 +34,6 @@ vec3 inputColor[3] = vec3[](
 layout(location = 0) out vec3 fragColor;
 
 void main() {
-	gl_Position = vec4(inputVertex[gl_VertexIndex], 0.0, 1.0);
-	fragColor = inputColor[gl_VertexIndex];
-}
\ No newline at end of file
+	gl_Position = vec4(inputVertex[gl_VertexIndex] * vec2(frame.aspectScale, 1.0), 0.0, 1.0);
+	fragColor = inputColor[(gl_VertexIndex + draw.materialIndex) % 3];
+}
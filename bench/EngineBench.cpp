@@ -0,0 +1,931 @@
+#include <stdafx.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+#include "core/CommandList.h"
+#include "core/compute/ComputeBatch.h"
+#include "core/compute/GpuPrimitives.h"
+#include "core/memory/AllocationCounter.h"
+#include "core/null/Device3D_null.h"
+#include "core/render/BatchRenderer.h"
+#include "core/render/FrameCapture.h"
+#include "core/render/FrameExport.h"
+#include "core/render/RenderQueue.h"
+#include "core/render/SceneRenderer.h"
+#include "core/thread/JobSystem.h"
+
+// Fixed-iteration CPU benchmarks of the engine against the null backend, headless on any machine.
+// Usage: engine_bench [--iterations N] [--warmup N] [--filter text] [--out results.json]
+//                     [--compare baseline.json] [--threshold 0.10]
+// Every iteration is timed; min/percentiles/max and the raw samples go to the JSON file.
+// --compare exits with failure when a scenario's p50 is slower than the baseline by more than the threshold;
+// tail percentiles are reported but not judged, they are too noisy on a shared machine.
+// Steady-state scenarios also fail when an iteration allocates, if built with ALLOCATION_COUNTER.
+// They always warm up for at least MIN_STEADY_STATE_WARMUP iterations, whatever --warmup says: every frame
+// slot has to be reused once before the arenas reach their steady-state size.
+
+namespace
+{
+	const uint32_t DEFAULT_ITERATIONS = 200;
+	const uint32_t DEFAULT_WARMUP = 10;
+	// Two full rotations of the frame slots: the first one records the high-water mark, the second grows every slot to it
+	const uint32_t MIN_STEADY_STATE_WARMUP = 2 * SceneRenderer::MAX_FRAMES_IN_FLIGHT;
+	const double DEFAULT_THRESHOLD = 0.10;
+	// Below this a difference is timer noise, whatever the relative change
+	const double NOISE_FLOOR_MS = 0.005;
+
+	struct BenchContext
+	{
+		JobSystem * jobs = nullptr;
+		Device3DNull * device = nullptr;
+	};
+
+	class Scenario
+	{
+	public:
+		explicit Scenario( const char * name, bool steadyState ) : m_name( name ), m_steadyState( steadyState ) {}
+		virtual ~Scenario() {}
+
+		virtual void Setup( BenchContext & ) {}
+		virtual void Iterate( BenchContext & context ) = 0;
+		virtual void Teardown( BenchContext & ) {}
+		// Units of work per iteration, reported as time per item when not zero
+		virtual uint32_t GetItemCount() const { return 0; }
+
+		const std::string & GetName() const { return m_name; }
+		// Steady-state iterations are held to a zero allocation budget
+		bool IsSteadyState() const { return m_steadyState; }
+
+	private:
+		std::string m_name;
+		bool m_steadyState;
+	};
+
+	// Device bring-up and the renderer's own allocations
+	class StartupScenario : public Scenario
+	{
+	public:
+		StartupScenario() : Scenario( "startup", false ) {}
+
+		virtual void Iterate( BenchContext & context ) override
+		{
+			Device3DNull device;
+			device.Init();
+			{
+				SceneRenderer renderer( device, *context.jobs );
+			}
+			device.Destroy();
+		}
+	};
+
+	class PipelineCreationScenario : public Scenario
+	{
+	public:
+		static const uint32_t PIPELINE_COUNT = 256;
+
+		PipelineCreationScenario() : Scenario( "pipeline_creation", false ) {}
+
+		virtual void Iterate( BenchContext & context ) override
+		{
+			PipelineHandle pipelines[PIPELINE_COUNT];
+			for ( PipelineHandle & pipeline : pipelines )
+			{
+				pipeline = context.device->AddPipeline();
+			}
+			for ( PipelineHandle pipeline : pipelines )
+			{
+				context.device->DestroyPipeline( pipeline );
+			}
+		}
+		virtual uint32_t GetItemCount() const override { return PIPELINE_COUNT; }
+	};
+
+	// The null device has no swapchain: the back buffers a swapchain creation allocates stand in for it
+	class SwapChainCreationScenario : public Scenario
+	{
+	public:
+		static const uint32_t BACK_BUFFER_COUNT = 3;
+
+		SwapChainCreationScenario() : Scenario( "swapchain_creation", false ) {}
+
+		virtual void Iterate( BenchContext & context ) override
+		{
+			ImageDesc desc;
+			desc.width = 1920;
+			desc.height = 1080;
+			desc.format = ImageFormat::BGRA8;
+			desc.usage = ImageUsageColorTarget | ImageUsageTransferSrc;
+
+			ImageHandle images[BACK_BUFFER_COUNT];
+			for ( ImageHandle & image : images )
+			{
+				image = context.device->CreateImage( desc );
+			}
+			for ( ImageHandle image : images )
+			{
+				context.device->DestroyImage( image );
+			}
+		}
+	};
+
+	// Full scene frame with drawCount objects, all of them inside the frustum
+	class DrawsScenario : public Scenario
+	{
+	public:
+		static const uint32_t PIPELINE_COUNT = 16;
+		static const uint32_t VERTEX_BUFFER_COUNT = 64;
+		static const uint32_t TRANSLUCENT_STRIDE = 8;	// one object in 8 is translucent
+
+		DrawsScenario( const char * name, uint32_t drawCount ) : Scenario( name, true ), m_drawCount( drawCount ) {}
+
+		virtual void Setup( BenchContext & context ) override
+		{
+			const float fovY = 1.0f;
+			const float aspect = 16.0f / 9.0f;
+			m_frustum = Frustum::FromPerspective( fovY, aspect, 0.1f, 1000.0f );
+
+			for ( PipelineHandle & pipeline : m_pipelines )
+			{
+				pipeline = context.device->AddPipeline();
+			}
+			for ( BufferHandle & buffer : m_vertexBuffers )
+			{
+				BufferDesc desc;
+				desc.size = 64 * 1024;
+				desc.usage = BufferUsageVertex;
+				buffer = context.device->CreateBuffer( desc );
+			}
+
+			// Fixed seed, every run renders the same scene in the same order
+			std::mt19937 rng( 1234 );
+			std::uniform_real_distribution<float> unit( -0.8f, 0.8f );
+			std::uniform_real_distribution<float> depth( 10.0f, 900.0f );
+			const float tanY = std::tan( fovY * 0.5f );
+			m_objects.resize( m_drawCount );
+			for ( uint32_t i = 0; i < m_drawCount; ++i )
+			{
+				RenderObject & object = m_objects[i];
+				const float z = depth( rng );
+				object.center[0] = unit( rng ) * z * tanY * aspect;
+				object.center[1] = unit( rng ) * z * tanY;
+				object.center[2] = -z;
+				object.radius = 0.5f;
+				object.pipeline = m_pipelines[rng() % PIPELINE_COUNT];
+				object.vertexBuffer = m_vertexBuffers[rng() % VERTEX_BUFFER_COUNT];
+				object.vertexCount = 36;
+				object.materialIndex = rng() % 256;
+				object.translucent = i % TRANSLUCENT_STRIDE == 0;
+			}
+
+			m_renderer.reset( new SceneRenderer( *context.device, *context.jobs ) );
+		}
+
+		virtual void Iterate( BenchContext & ) override
+		{
+			m_renderer->RenderFrame( m_frameNumber++, m_objects.data(), m_drawCount, m_frustum );
+		}
+
+		virtual void Teardown( BenchContext & context ) override
+		{
+			m_renderer->WaitIdle();
+			m_renderer.reset();
+			for ( BufferHandle buffer : m_vertexBuffers )
+			{
+				context.device->DestroyBuffer( buffer );
+			}
+			for ( PipelineHandle pipeline : m_pipelines )
+			{
+				context.device->DestroyPipeline( pipeline );
+			}
+			m_objects.clear();
+		}
+
+		virtual uint32_t GetItemCount() const override { return m_drawCount; }
+
+	private:
+		uint32_t m_drawCount;
+		uint64_t m_frameNumber = 0;
+		Frustum m_frustum;
+		PipelineHandle m_pipelines[PIPELINE_COUNT];
+		BufferHandle m_vertexBuffers[VERTEX_BUFFER_COUNT];
+		std::vector<RenderObject> m_objects;
+		std::unique_ptr<SceneRenderer> m_renderer;
+	};
+
+	// The render queue on its own: draw keys of a scene with a few pipelines and many materials, restored
+	// to their unsorted order before every sort, as the cull hands them over
+	class RenderQueueSortScenario : public Scenario
+	{
+	public:
+		static const uint32_t DRAW_COUNT = 50000;
+
+		RenderQueueSortScenario() : Scenario( "render_queue_sort_50k", true ) {}
+
+		virtual void Setup( BenchContext & ) override
+		{
+			std::mt19937 rng( 1234 );
+			std::uniform_real_distribution<float> depth( 10.0f, 900.0f );
+			m_unsorted.resize( DRAW_COUNT );
+			for ( uint32_t i = 0; i < DRAW_COUNT; ++i )
+			{
+				DrawKeyFields fields;
+				fields.pipeline = rng() % 16;
+				fields.resources = rng() % 64;
+				fields.material = rng() % 256;
+				fields.depth = depth( rng );
+				fields.translucent = i % 8 == 0;
+				m_unsorted[i] = { PackDrawKey( fields ), i };
+			}
+			m_items.resize( DRAW_COUNT );
+			m_scratch.resize( DRAW_COUNT );
+		}
+
+		virtual void Iterate( BenchContext & ) override
+		{
+			std::copy( m_unsorted.begin(), m_unsorted.end(), m_items.begin() );
+			SortRenderQueue( m_items.data(), m_scratch.data(), DRAW_COUNT );
+		}
+
+		virtual uint32_t GetItemCount() const override { return DRAW_COUNT; }
+
+	private:
+		std::vector<RenderQueueItem> m_unsorted;
+		std::vector<RenderQueueItem> m_items;
+		std::vector<RenderQueueItem> m_scratch;
+	};
+
+	// Staging write then copy to a GPU-only buffer on the copy queue, double buffered
+	class UploadScenario : public Scenario
+	{
+	public:
+		static const uint32_t UPLOAD_SIZE = 4 * 1024 * 1024;
+		static const uint32_t SLOT_COUNT = 2;
+
+		UploadScenario() : Scenario( "uploads", true ), m_arena( 64 * 1024 ), m_source( UPLOAD_SIZE, 0x5A ) {}
+
+		virtual void Setup( BenchContext & context ) override
+		{
+			BufferDesc staging;
+			staging.size = (uint64_t)UPLOAD_SIZE * SLOT_COUNT;
+			staging.usage = BufferUsageTransferSrc;
+			staging.memory = MemoryUsage::Upload;
+			m_staging = context.device->CreateBuffer( staging );
+
+			BufferDesc target;
+			target.size = UPLOAD_SIZE;
+			target.usage = BufferUsageTransferDst | BufferUsageVertex;
+			m_target = context.device->CreateBuffer( target );
+		}
+
+		virtual void Iterate( BenchContext & context ) override
+		{
+			const uint32_t slot = m_iteration++ % SLOT_COUNT;
+			if ( m_serials[slot] )
+				context.device->WaitComplete( IDevice3D::CopyQueue, m_serials[slot] );
+
+			char * mapped = static_cast<char *>( context.device->GetMappedBuffer( m_staging ) );
+			memcpy( mapped + (size_t)slot * UPLOAD_SIZE, m_source.data(), UPLOAD_SIZE );
+
+			m_arena.Reset();
+			CommandList list( m_arena );
+			list.Barrier( m_target, ResourceState::VertexBuffer, ResourceState::TransferDst );
+			list.CopyBuffer( m_staging, (uint64_t)slot * UPLOAD_SIZE, m_target, 0, UPLOAD_SIZE );
+			list.Barrier( m_target, ResourceState::TransferDst, ResourceState::VertexBuffer );
+			const CommandList * lists[] = { &list };
+			m_serials[slot] = context.device->Submit( IDevice3D::CopyQueue, lists, 1 );
+		}
+
+		virtual void Teardown( BenchContext & context ) override
+		{
+			for ( uint64_t & serial : m_serials )
+			{
+				if ( serial )
+					context.device->WaitComplete( IDevice3D::CopyQueue, serial );
+				serial = 0;
+			}
+			context.device->DestroyBuffer( m_staging );
+			context.device->DestroyBuffer( m_target );
+		}
+
+	private:
+		LinearArena m_arena;
+		std::vector<char> m_source;
+		BufferHandle m_staging;
+		BufferHandle m_target;
+		uint64_t m_serials[SLOT_COUNT] = {};
+		uint32_t m_iteration = 0;
+	};
+
+	// One 1080p BGRA frame through the capture ring: copy submission, band conversion to RGB, delivery
+	class CaptureScenario : public Scenario
+	{
+	public:
+		static const uint32_t WIDTH = 1920;
+		static const uint32_t HEIGHT = 1080;
+
+		CaptureScenario() : Scenario( "capture_1080p", true ) {}
+
+		virtual void Setup( BenchContext & context ) override
+		{
+			ImageDesc desc;
+			desc.width = WIDTH;
+			desc.height = HEIGHT;
+			desc.format = ImageFormat::BGRA8;
+			desc.usage = ImageUsageColorTarget | ImageUsageTransferSrc;
+			m_image = context.device->CreateImage( desc );
+
+			m_capture.reset( new FrameCapture( *context.device, *context.jobs ) );
+			m_capture->Init( WIDTH, HEIGHT, ImageFormat::BGRA8, [this]( const CapturedFrame & frame ) { m_checksum += frame.rgb[0]; } );
+		}
+
+		virtual void Iterate( BenchContext & ) override
+		{
+			m_capture->Capture( m_image, 0, m_frameId++ );
+			m_capture->Flush();
+		}
+
+		virtual void Teardown( BenchContext & context ) override
+		{
+			m_capture->PrintReport( std::cout );
+			m_capture.reset();
+			context.device->DestroyImage( m_image );
+		}
+
+		virtual uint32_t GetItemCount() const override { return WIDTH * HEIGHT; }
+
+	private:
+		std::unique_ptr<FrameCapture> m_capture;
+		ImageHandle m_image;
+		uint64_t m_frameId = 0;
+		uint64_t m_checksum = 0;
+	};
+
+	// One 1080p RGB frame published into a shared-memory frame ring, drained by a reader in the same
+	// process standing in for the encoder
+	class FrameExportScenario : public Scenario
+	{
+	public:
+		static const uint32_t WIDTH = 1920;
+		static const uint32_t HEIGHT = 1080;
+
+		FrameExportScenario( const char * name, FrameExportFormat format ) : Scenario( name, true ), m_format( format ), m_rgb( WIDTH * HEIGHT * 3 ) {}
+
+		virtual void Setup( BenchContext & ) override
+		{
+			for ( size_t i = 0; i < m_rgb.size(); ++i )
+			{
+				m_rgb[i] = (uint8_t)(i * 31);
+			}
+
+			FrameExportDesc desc;
+			desc.name = "engine_bench_" + GetName();
+			desc.format = m_format;
+			desc.width = WIDTH;
+			desc.height = HEIGHT;
+			m_export.Open( desc );
+			if ( !m_reader.Open( desc.target, desc.name ) )
+			{
+				throw std::runtime_error( "Cannot open frame ring " + desc.name );
+			}
+		}
+
+		virtual void Iterate( BenchContext & ) override
+		{
+			const CapturedFrame frame = { m_frameId++, WIDTH, HEIGHT, m_rgb.data() };
+			m_export.Write( frame );
+
+			const uint8_t * payload = nullptr;
+			while ( m_reader.Acquire( &payload ) )
+			{
+				m_reader.Release();
+			}
+		}
+
+		virtual void Teardown( BenchContext & ) override
+		{
+			m_export.PrintReport( std::cout );
+			m_reader.Close();
+			m_export.Close();
+		}
+
+		virtual uint32_t GetItemCount() const override { return WIDTH * HEIGHT; }
+
+	private:
+		FrameExportFormat m_format;
+		std::vector<uint8_t> m_rgb;
+		FrameExport m_export;
+		FrameRingReader m_reader;
+		uint64_t m_frameId = 0;
+	};
+
+	// Offline image farm: JOB_COUNT independent 256x256 images, one in four a compute dispatch, the
+	// others OBJECT_COUNT draws each, rendered and read back through the batch renderer
+	class BatchRenderScenario : public Scenario
+	{
+	public:
+		static const uint32_t JOB_COUNT = 256;
+		static const uint32_t OBJECT_COUNT = 200;
+		static const uint32_t PIPELINE_COUNT = 4;
+
+		BatchRenderScenario() : Scenario( "batch_render_256", true ) {}
+
+		virtual void Setup( BenchContext & context ) override
+		{
+			for ( PipelineHandle & pipeline : m_pipelines )
+			{
+				pipeline = context.device->AddPipeline();
+			}
+			m_computePipeline = context.device->AddPipeline( true );
+
+			BufferDesc vertexDesc;
+			vertexDesc.size = 64 * 1024;
+			vertexDesc.usage = BufferUsageVertex;
+			m_vertexBuffer = context.device->CreateBuffer( vertexDesc );
+
+			m_objects.resize( OBJECT_COUNT );
+			for ( uint32_t i = 0; i < OBJECT_COUNT; ++i )
+			{
+				m_objects[i] = { { 0.0f, 0.0f, -10.0f }, 1.0f, m_pipelines[i * PIPELINE_COUNT / OBJECT_COUNT], m_vertexBuffer, 36, i, false };
+			}
+
+			m_jobs.resize( JOB_COUNT );
+			for ( uint32_t i = 0; i < JOB_COUNT; ++i )
+			{
+				m_jobs[i].id = i;
+				m_jobs[i].variant = i;
+				if ( i % 4 == 3 )
+				{
+					m_jobs[i].computePipeline = m_computePipeline;
+				}
+				else
+				{
+					m_jobs[i].objects = m_objects.data();
+					m_jobs[i].objectCount = OBJECT_COUNT;
+				}
+			}
+
+			m_renderer.reset( new BatchRenderer( *context.device, *context.jobs ) );
+			m_renderer->Init( BatchRendererDesc() );
+		}
+
+		virtual void Iterate( BenchContext & ) override
+		{
+			m_stats = m_renderer->Render( m_jobs.data(), JOB_COUNT, [this]( const OfflineImage & image ) { m_checksum += image.rgba[0]; } );
+		}
+
+		virtual void Teardown( BenchContext & context ) override
+		{
+			BatchRenderer::PrintReport( std::cout, m_stats );
+			m_renderer.reset();
+			context.device->DestroyBuffer( m_vertexBuffer );
+			for ( PipelineHandle pipeline : m_pipelines )
+			{
+				context.device->DestroyPipeline( pipeline );
+			}
+			context.device->DestroyPipeline( m_computePipeline );
+		}
+
+		virtual uint32_t GetItemCount() const override { return JOB_COUNT; }
+
+	private:
+		PipelineHandle m_pipelines[PIPELINE_COUNT];
+		PipelineHandle m_computePipeline;
+		BufferHandle m_vertexBuffer;
+		std::vector<RenderObject> m_objects;
+		std::vector<OfflineRenderJob> m_jobs;
+		std::unique_ptr<BatchRenderer> m_renderer;
+		BatchRenderStats m_stats;
+		std::atomic<uint64_t> m_checksum{ 0 };
+	};
+
+	// GPGPU pipeline: KERNEL_COUNT chained kernels over three storage buffers, a barrier between stages
+	// of STAGE_SIZE independent dispatches, the result downloaded, all of it in one compute submission
+	class ComputeBatchScenario : public Scenario
+	{
+	public:
+		static const uint32_t KERNEL_COUNT = 4096;
+		static const uint32_t STAGE_SIZE = 8;
+		static const uint32_t BUFFER_SIZE = 1024 * 1024;
+
+		struct Constants
+		{
+			uint32_t elementCount;
+			uint32_t kernel;
+		};
+
+		ComputeBatchScenario() : Scenario( "compute_batch_4k", true ) {}
+
+		virtual void Setup( BenchContext & context ) override
+		{
+			m_pipeline = context.device->AddPipeline( true );
+
+			BufferDesc storageDesc;
+			storageDesc.size = BUFFER_SIZE;
+			storageDesc.usage = BufferUsageStorage | BufferUsageTransferSrc;
+			for ( BufferHandle & buffer : m_buffers )
+			{
+				buffer = context.device->CreateBuffer( storageDesc );
+			}
+
+			BufferDesc readbackDesc;
+			readbackDesc.size = BUFFER_SIZE;
+			readbackDesc.usage = BufferUsageTransferDst;
+			readbackDesc.memory = MemoryUsage::Readback;
+			m_readback = context.device->CreateBuffer( readbackDesc );
+
+			m_batch.reset( new ComputeBatch( *context.device, 256 * 1024 ) );
+		}
+
+		virtual void Iterate( BenchContext & ) override
+		{
+			for ( uint32_t i = 0; i < KERNEL_COUNT; ++i )
+			{
+				// Ping-pong: even stages read 0 and write 1, odd stages the other way round
+				const uint32_t stage = i / STAGE_SIZE;
+				const BufferHandle buffers[] = { m_buffers[stage & 1], m_buffers[(stage + 1) & 1], m_buffers[2] };
+				const Constants constants = { BUFFER_SIZE / 4, i };
+				m_batch->Dispatch( m_pipeline, buffers, 3, constants, BUFFER_SIZE / 4 / 256 );
+				if ( i % STAGE_SIZE == STAGE_SIZE - 1 )
+					m_batch->Barrier( buffers[1] );
+			}
+			m_batch->Download( m_buffers[(KERNEL_COUNT / STAGE_SIZE) & 1], 0, m_readback, 0, BUFFER_SIZE );
+			m_batch->Wait( m_batch->Submit() );
+		}
+
+		virtual void Teardown( BenchContext & context ) override
+		{
+			m_batch.reset();
+			context.device->DestroyBuffer( m_readback );
+			for ( BufferHandle buffer : m_buffers )
+			{
+				context.device->DestroyBuffer( buffer );
+			}
+			context.device->DestroyPipeline( m_pipeline );
+		}
+
+		virtual uint32_t GetItemCount() const override { return KERNEL_COUNT; }
+
+	private:
+		PipelineHandle m_pipeline;
+		BufferHandle m_buffers[3];
+		BufferHandle m_readback;
+		std::unique_ptr<ComputeBatch> m_batch;
+	};
+
+	// Recording cost of the GPU primitives on COUNT elements: a scan, a reduction, a compaction and a 64-bit
+	// key sort, every level and radix pass of them, in one compute submission
+	class GpuPrimitivesScenario : public Scenario
+	{
+	public:
+		static const uint32_t COUNT = 1000 * 1000;
+
+		GpuPrimitivesScenario() : Scenario( "gpu_primitives_1m", true ) {}
+
+		virtual void Setup( BenchContext & context ) override
+		{
+			GpuPrimitivePipelines pipelines;
+			for ( PipelineHandle * pipeline : { &pipelines.scanTiles, &pipelines.scanAdd, &pipelines.reduce, &pipelines.compactScatter,
+				&pipelines.radixHistogram[0], &pipelines.radixHistogram[1], &pipelines.radixScatter[0], &pipelines.radixScatter[1] } )
+			{
+				*pipeline = context.device->AddPipeline( true );
+			}
+			m_pipelines = pipelines;
+
+			BufferDesc storageDesc;
+			storageDesc.size = COUNT * sizeof( uint64_t );
+			storageDesc.usage = BufferUsageStorage;
+			for ( BufferHandle & buffer : m_buffers )
+			{
+				buffer = context.device->CreateBuffer( storageDesc );
+			}
+
+			m_primitives.reset( new GpuPrimitives( *context.device, m_pipelines ) );
+			m_primitives->Init( COUNT );
+			m_batch.reset( new ComputeBatch( *context.device ) );
+		}
+
+		virtual void Iterate( BenchContext & ) override
+		{
+			m_primitives->ExclusiveScan( *m_batch, m_buffers[0], m_buffers[1], COUNT );
+			m_primitives->Reduce( *m_batch, m_buffers[0], m_buffers[1], COUNT );
+			m_primitives->Compact( *m_batch, m_buffers[0], m_buffers[1], m_buffers[2], m_buffers[3], COUNT );
+			m_primitives->SortKeyValue( *m_batch, m_buffers[0], m_buffers[1], COUNT, SortKeyWidth::Bits64 );
+			m_batch->Wait( m_batch->Submit() );
+		}
+
+		virtual void Teardown( BenchContext & context ) override
+		{
+			m_batch.reset();
+			m_primitives.reset();
+			for ( BufferHandle buffer : m_buffers )
+			{
+				context.device->DestroyBuffer( buffer );
+			}
+			for ( PipelineHandle pipeline : { m_pipelines.scanTiles, m_pipelines.scanAdd, m_pipelines.reduce, m_pipelines.compactScatter,
+				m_pipelines.radixHistogram[0], m_pipelines.radixHistogram[1], m_pipelines.radixScatter[0], m_pipelines.radixScatter[1] } )
+			{
+				context.device->DestroyPipeline( pipeline );
+			}
+		}
+
+	private:
+		GpuPrimitivePipelines m_pipelines;
+		BufferHandle m_buffers[4];
+		std::unique_ptr<GpuPrimitives> m_primitives;
+		std::unique_ptr<ComputeBatch> m_batch;
+	};
+
+	struct ScenarioResult
+	{
+		std::string name;
+		uint32_t itemCount = 0;
+		std::vector<double> samples;	// ms, in run order
+		double minMs = 0.0;
+		double p50Ms = 0.0;
+		double p90Ms = 0.0;
+		double p99Ms = 0.0;
+		double maxMs = 0.0;
+		double meanMs = 0.0;
+	};
+
+	// Nearest-rank percentile of sorted samples
+	double Percentile( const std::vector<double> & sorted, double p )
+	{
+		const size_t rank = (size_t)std::ceil( p * sorted.size() );
+		return sorted[std::min( sorted.size(), std::max<size_t>( rank, 1 ) ) - 1];
+	}
+
+	ScenarioResult RunScenario( Scenario & scenario, BenchContext & context, uint32_t warmup, uint32_t iterations, FrameAllocationBudget & budget )
+	{
+		ScenarioResult result;
+		result.name = scenario.GetName();
+		result.itemCount = scenario.GetItemCount();
+		result.samples.reserve( iterations );
+
+		scenario.Setup( context );
+		if ( scenario.IsSteadyState() )
+			warmup = std::max( warmup, MIN_STEADY_STATE_WARMUP );
+		for ( uint32_t it = 0; it < warmup; ++it )
+		{
+			scenario.Iterate( context );
+		}
+
+		for ( uint32_t it = 0; it < iterations; ++it )
+		{
+			if ( scenario.IsSteadyState() )
+				budget.BeginFrame();
+			const auto start = std::chrono::steady_clock::now();
+			{
+				AllocationScopeGuard scope( scenario.IsSteadyState() ? AllocationScope::Frame : AllocationScope::Init );
+				scenario.Iterate( context );
+			}
+			const auto end = std::chrono::steady_clock::now();
+			if ( scenario.IsSteadyState() )
+				budget.EndFrame();
+			result.samples.push_back( std::chrono::duration<double, std::milli>( end - start ).count() );
+		}
+		scenario.Teardown( context );
+
+		std::vector<double> sorted = result.samples;
+		std::sort( sorted.begin(), sorted.end() );
+		result.minMs = sorted.front();
+		result.p50Ms = Percentile( sorted, 0.50 );
+		result.p90Ms = Percentile( sorted, 0.90 );
+		result.p99Ms = Percentile( sorted, 0.99 );
+		result.maxMs = sorted.back();
+		double sum = 0.0;
+		for ( double ms : sorted )
+		{
+			sum += ms;
+		}
+		result.meanMs = sum / sorted.size();
+		return result;
+	}
+
+	bool WriteJson( const char * path, const std::vector<ScenarioResult> & results, uint32_t iterations )
+	{
+		FILE * file = fopen( path, "w" );
+		if ( !file )
+			return false;
+
+		fprintf( file, "{\n  \"version\": 1,\n  \"iterations\": %u,\n  \"scenarios\": [\n", iterations );
+		for ( size_t i = 0; i < results.size(); ++i )
+		{
+			const ScenarioResult & r = results[i];
+			fprintf( file, "    {\n      \"name\": \"%s\",\n", r.name.c_str() );
+			fprintf( file, "      \"items\": %u,\n", r.itemCount );
+			fprintf( file, "      \"min_ms\": %.6f,\n      \"p50_ms\": %.6f,\n      \"p90_ms\": %.6f,\n      \"p99_ms\": %.6f,\n      \"max_ms\": %.6f,\n      \"mean_ms\": %.6f,\n",
+				r.minMs, r.p50Ms, r.p90Ms, r.p99Ms, r.maxMs, r.meanMs );
+			fprintf( file, "      \"samples_ms\": [" );
+			for ( size_t s = 0; s < r.samples.size(); ++s )
+			{
+				fprintf( file, "%s%.6f", s ? ", " : "", r.samples[s] );
+			}
+			fprintf( file, "]\n    }%s\n", i + 1 < results.size() ? "," : "" );
+		}
+		fprintf( file, "  ]\n}\n" );
+		fclose( file );
+		return true;
+	}
+
+	struct BaselineEntry
+	{
+		std::string name;
+		double p50Ms;
+		double p90Ms;
+	};
+
+	double ReadNumberAfter( const std::string & text, size_t from, const char * key )
+	{
+		const size_t pos = text.find( key, from );
+		return pos == std::string::npos ? -1.0 : std::strtod( text.c_str() + pos + strlen( key ), nullptr );
+	}
+
+	// Reads back what WriteJson() produced, not a general JSON parser
+	bool ReadBaseline( const char * path, std::vector<BaselineEntry> & entries )
+	{
+		std::ifstream file( path );
+		if ( !file )
+			return false;
+		std::stringstream buffer;
+		buffer << file.rdbuf();
+		const std::string text = buffer.str();
+
+		const char * nameKey = "\"name\": \"";
+		for ( size_t pos = text.find( nameKey ); pos != std::string::npos; pos = text.find( nameKey, pos ) )
+		{
+			pos += strlen( nameKey );
+			const size_t nameEnd = text.find( '"', pos );
+			if ( nameEnd == std::string::npos )
+				return false;
+
+			BaselineEntry entry;
+			entry.name = text.substr( pos, nameEnd - pos );
+			entry.p50Ms = ReadNumberAfter( text, nameEnd, "\"p50_ms\":" );
+			entry.p90Ms = ReadNumberAfter( text, nameEnd, "\"p90_ms\":" );
+			entries.push_back( entry );
+		}
+		return true;
+	}
+
+	bool IsRegression( double baselineMs, double currentMs, double threshold )
+	{
+		return baselineMs >= 0.0 && currentMs > baselineMs * (1.0 + threshold) && currentMs - baselineMs > NOISE_FLOOR_MS;
+	}
+
+	// Returns the number of regressed scenarios
+	uint32_t Compare( const std::vector<BaselineEntry> & baseline, const std::vector<ScenarioResult> & results, double threshold )
+	{
+		uint32_t regressions = 0;
+		printf( "\n%-20s %12s %12s %8s %12s %12s  %s\n", "scenario", "base_p50_ms", "p50_ms", "delta", "base_p90_ms", "p90_ms", "status" );
+		for ( const ScenarioResult & result : results )
+		{
+			auto it = std::find_if( baseline.begin(), baseline.end(), [&]( const BaselineEntry & entry ) { return entry.name == result.name; } );
+			if ( it == baseline.end() )
+			{
+				printf( "%-20s %12s %12.4f %8s %12s %12.4f  new\n", result.name.c_str(), "-", result.p50Ms, "-", "-", result.p90Ms );
+				continue;
+			}
+
+			const bool regressed = IsRegression( it->p50Ms, result.p50Ms, threshold );
+			const bool improved = result.p50Ms < it->p50Ms * (1.0 - threshold) && it->p50Ms - result.p50Ms > NOISE_FLOOR_MS;
+			const double delta = it->p50Ms > 0.0 ? 100.0 * (result.p50Ms - it->p50Ms) / it->p50Ms : 0.0;
+			printf( "%-20s %12.4f %12.4f %+7.1f%% %12.4f %12.4f  %s\n", result.name.c_str(), it->p50Ms, result.p50Ms, delta, it->p90Ms, result.p90Ms, regressed ? "REGRESSION" : (improved ? "improved" : "ok") );
+			regressions += regressed ? 1 : 0;
+		}
+		return regressions;
+	}
+
+	const char * const ARGUMENT_NAMES[] = { "--iterations", "--warmup", "--threshold", "--filter", "--out", "--compare" };
+
+	// Every argument has to be a known flag followed by its value, a typo would silently bench the defaults
+	bool CheckArguments( int argc, char ** argv )
+	{
+		for ( int i = 1; i < argc; i += 2 )
+		{
+			const bool known = std::any_of( std::begin( ARGUMENT_NAMES ), std::end( ARGUMENT_NAMES ), [&]( const char * name ) { return strcmp( argv[i], name ) == 0; } );
+			if ( !known || i + 1 >= argc )
+			{
+				fprintf( stderr, "%s argument: %s\n", known ? "missing value for" : "unknown", argv[i] );
+				fprintf( stderr, "usage: engine_bench [--iterations N] [--warmup N] [--filter text] [--out results.json]\n" );
+				fprintf( stderr, "                    [--compare baseline.json] [--threshold 0.10]\n" );
+				return false;
+			}
+		}
+		return true;
+	}
+
+	const char * GetArgument( int argc, char ** argv, const char * name )
+	{
+		for ( int i = 1; i + 1 < argc; ++i )
+		{
+			if ( strcmp( argv[i], name ) == 0 )
+				return argv[i + 1];
+		}
+		return nullptr;
+	}
+}
+
+int main( int argc, char ** argv )
+{
+	if ( !CheckArguments( argc, argv ) )
+		return 2;
+
+	const char * iterationsArg = GetArgument( argc, argv, "--iterations" );
+	const char * warmupArg = GetArgument( argc, argv, "--warmup" );
+	const char * thresholdArg = GetArgument( argc, argv, "--threshold" );
+	const char * filter = GetArgument( argc, argv, "--filter" );
+	const char * outPath = GetArgument( argc, argv, "--out" );
+	const char * baselinePath = GetArgument( argc, argv, "--compare" );
+
+	const uint32_t iterations = std::max( 1, iterationsArg ? std::atoi( iterationsArg ) : (int)DEFAULT_ITERATIONS );
+	const uint32_t warmup = warmupArg ? (uint32_t)std::atoi( warmupArg ) : DEFAULT_WARMUP;
+	if ( warmup < MIN_STEADY_STATE_WARMUP )
+		printf( "warm-up raised to %u iterations for steady-state scenarios\n", MIN_STEADY_STATE_WARMUP );
+	const double threshold = thresholdArg ? std::atof( thresholdArg ) : DEFAULT_THRESHOLD;
+
+	JobSystem jobs;
+	jobs.Init();
+	Device3DNull device;
+	device.Init();
+
+	BenchContext context;
+	context.jobs = &jobs;
+	context.device = &device;
+
+	std::vector<std::unique_ptr<Scenario>> scenarios;
+	scenarios.emplace_back( new StartupScenario() );
+	scenarios.emplace_back( new PipelineCreationScenario() );
+	scenarios.emplace_back( new SwapChainCreationScenario() );
+	scenarios.emplace_back( new DrawsScenario( "draws_1k", 1000 ) );
+	scenarios.emplace_back( new DrawsScenario( "draws_10k", 10000 ) );
+	scenarios.emplace_back( new DrawsScenario( "draws_50k", 50000 ) );
+	scenarios.emplace_back( new DrawsScenario( "draws_100k", 100000 ) );
+	scenarios.emplace_back( new RenderQueueSortScenario() );
+	scenarios.emplace_back( new UploadScenario() );
+	scenarios.emplace_back( new CaptureScenario() );
+	scenarios.emplace_back( new BatchRenderScenario() );
+	scenarios.emplace_back( new ComputeBatchScenario() );
+	scenarios.emplace_back( new GpuPrimitivesScenario() );
+	scenarios.emplace_back( new FrameExportScenario( "export_raw_1080p", FrameExportFormat::Raw ) );
+	scenarios.emplace_back( new FrameExportScenario( "export_y4m_1080p", FrameExportFormat::Y4M ) );
+
+	// Warm-up iterations (at least MIN_STEADY_STATE_WARMUP) cover first-touch allocations and arena growth,
+	// every measured steady-state iteration counts
+	FrameAllocationBudget budget( 0, 0, 0 );
+
+	printf( "%-20s %10s %10s %10s %10s %10s %12s\n", "scenario", "min_ms", "p50_ms", "p90_ms", "p99_ms", "max_ms", "ns_per_item" );
+	std::vector<ScenarioResult> results;
+	for ( auto & scenario : scenarios )
+	{
+		if ( filter && scenario->GetName().find( filter ) == std::string::npos )
+			continue;
+
+		results.push_back( RunScenario( *scenario, context, warmup, iterations, budget ) );
+		const ScenarioResult & r = results.back();
+		char perItem[32] = "-";
+		if ( r.itemCount )
+			snprintf( perItem, sizeof( perItem ), "%.1f", r.p50Ms * 1e6 / r.itemCount );
+		printf( "%-20s %10.4f %10.4f %10.4f %10.4f %10.4f %12s\n", r.name.c_str(), r.minMs, r.p50Ms, r.p90Ms, r.p99Ms, r.maxMs, perItem );
+	}
+
+	std::cout << std::endl;
+	device.PrintReport( std::cout );
+	budget.PrintReport( std::cout );
+
+	device.Destroy();
+	jobs.Shutdown();
+
+	int exitCode = budget.IsExceeded() ? EXIT_FAILURE : EXIT_SUCCESS;
+
+	if ( outPath && !WriteJson( outPath, results, iterations ) )
+	{
+		fprintf( stderr, "cannot write %s\n", outPath );
+		exitCode = EXIT_FAILURE;
+	}
+
+	if ( baselinePath )
+	{
+		std::vector<BaselineEntry> baseline;
+		if ( !ReadBaseline( baselinePath, baseline ) )
+		{
+			fprintf( stderr, "cannot read baseline %s\n", baselinePath );
+			return EXIT_FAILURE;
+		}
+		const uint32_t regressions = Compare( baseline, results, threshold );
+		if ( regressions )
+		{
+			printf( "%u scenario(s) regressed by more than %.0f%%\n", regressions, threshold * 100.0 );
+			exitCode = EXIT_FAILURE;
+		}
+	}
+
+	return exitCode;
+}
@@ -0,0 +1,91 @@
+#include <stdafx.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "core/memory/AllocationCounter.h"
+#include "core/thread/JobSystem.h"
+
+// Scaling benchmark for the job system: the same ParallelFor workload on 1 to N workers.
+// Usage: job_scaling [maxWorkers] [iterations]
+// Fails when a measured iteration allocates, if built with ALLOCATION_COUNTER.
+
+namespace
+{
+	const uint32_t ELEMENT_COUNT = 1 << 20;
+	const uint32_t BATCH_SIZE = 1024;
+
+	// Enough ALU per element that the run measures scheduling and not memory bandwidth
+	void Workload( float * values, uint32_t begin, uint32_t end )
+	{
+		for ( uint32_t i = begin; i < end; ++i )
+		{
+			float v = values[i];
+			for ( int k = 0; k < 64; ++k )
+			{
+				v = std::sqrt( v * 1.0001f + 0.5f );
+			}
+			values[i] = v;
+		}
+	}
+
+	double RunScenario( uint32_t workerCount, uint32_t iterations, std::vector<float> & values, FrameAllocationBudget & budget )
+	{
+		JobSystem jobs;
+		jobs.Init( workerCount );
+
+		// Warm-up so thread start and first touch are not measured
+		jobs.ParallelFor( ELEMENT_COUNT, BATCH_SIZE, [&]( uint32_t begin, uint32_t end ) { Workload( values.data(), begin, end ); } );
+
+		std::vector<double> times;
+		times.reserve( iterations );
+		for ( uint32_t it = 0; it < iterations; ++it )
+		{
+			budget.BeginFrame();
+			const auto start = std::chrono::high_resolution_clock::now();
+			{
+				AllocationScopeGuard scope( AllocationScope::Frame );
+				jobs.ParallelFor( ELEMENT_COUNT, BATCH_SIZE, [&]( uint32_t begin, uint32_t end ) { Workload( values.data(), begin, end ); } );
+			}
+			const auto end = std::chrono::high_resolution_clock::now();
+			budget.EndFrame();
+			times.push_back( std::chrono::duration<double, std::milli>( end - start ).count() );
+		}
+
+		jobs.Shutdown();
+
+		std::sort( times.begin(), times.end() );
+		return times[times.size() / 2];
+	}
+}
+
+int main( int argc, char ** argv )
+{
+	const uint32_t hardwareThreads = std::max( 1U, std::thread::hardware_concurrency() );
+	const uint32_t maxWorkers = argc > 1 ? (uint32_t)std::atoi( argv[1] ) : hardwareThreads;
+	const uint32_t iterations = argc > 2 ? (uint32_t)std::atoi( argv[2] ) : 10;
+
+	std::vector<float> values( ELEMENT_COUNT, 1.0f );
+
+	// Workers do not tag their allocations, only what the submitting thread does is measured
+	FrameAllocationBudget budget( 0, 0, 0 );
+
+	printf( "workers  median_ms  speedup  efficiency\n" );
+	double baseline = 0.0;
+	for ( uint32_t workers = 1; workers <= std::max( 1U, maxWorkers ); ++workers )
+	{
+		const double ms = RunScenario( workers, std::max( 1U, iterations ), values, budget );
+		if ( workers == 1 )
+			baseline = ms;
+
+		const double speedup = baseline / ms;
+		printf( "%7u  %9.3f  %7.2f  %9.1f%%\n", workers, ms, speedup, 100.0 * speedup / workers );
+	}
+
+	std::cout << std::endl;
+	budget.PrintReport( std::cout );
+	AllocationCounter::PrintReport( std::cout );
+
+	return budget.IsExceeded() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
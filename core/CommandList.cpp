@@ -0,0 +1,230 @@
+#include <stdafx.h>
+#include "CommandList.h"
+
+#include <algorithm>
+
+namespace
+{
+	// Headers and payloads are 4-byte granular, every field in the stream is 32 or 64 bits
+	const uint32_t STREAM_GRANULARITY = 4;
+
+	uint32_t AlignStream( uint32_t size )
+	{
+		return (size + STREAM_GRANULARITY - 1) & ~(STREAM_GRANULARITY - 1);
+	}
+
+	std::atomic<uint64_t> s_nextArenasId{ 1 };
+
+	// Arenas the calling thread already registered, keyed by CommandArenas id.
+	// Ids are never reused, an entry left by a destroyed CommandArenas is just never matched again.
+	struct ThreadArenasEntry
+	{
+		uint64_t id;
+		FrameArenas * arenas;
+	};
+	thread_local std::vector<ThreadArenasEntry> s_threadArenas;
+}
+
+//
+//
+//	CommandList ===================================================================================
+//
+//
+bool CommandList::Reader::Next( Header & header )
+{
+	while ( m_chunk && m_offset >= m_chunk->used )
+	{
+		m_chunk = m_chunk->next;
+		m_offset = 0;
+	}
+	if ( !m_chunk )
+		return false;
+
+	const char * data = GetChunkData( m_chunk ) + m_offset;
+	memcpy( &header, data, sizeof( Header ) );
+	m_payload = data + sizeof( Header );
+	m_offset += AlignStream( sizeof( Header ) + header.size );
+	return true;
+}
+
+void CommandList::BindPipeline( PipelineHandle pipeline )
+{
+	Write( CommandType::BindPipeline, CmdBindPipeline{ pipeline } );
+}
+
+void CommandList::BindVertexBuffer( uint32_t binding, BufferHandle buffer, uint64_t offset )
+{
+	Write( CommandType::BindVertexBuffer, CmdBindVertexBuffer{ binding, buffer, offset } );
+}
+
+void CommandList::BindStorageBuffer( uint32_t binding, BufferHandle buffer, uint64_t offset, uint64_t range )
+{
+	Write( CommandType::BindStorageBuffer, CmdBindStorageBuffer{ binding, buffer, offset, range } );
+}
+
+void CommandList::BindStorageImage( uint32_t binding, ImageHandle image )
+{
+	Write( CommandType::BindStorageImage, CmdBindStorageImage{ binding, image } );
+}
+
+void CommandList::BindIndexBuffer( BufferHandle buffer, IndexType indexType, uint64_t offset )
+{
+	Write( CommandType::BindIndexBuffer, CmdBindIndexBuffer{ buffer, indexType, offset } );
+}
+
+void CommandList::PushConstants( uint32_t offset, uint32_t size, const void * data )
+{
+	const CmdPushConstants payload = { offset, size };
+	Write( CommandType::PushConstants, &payload, sizeof( payload ), data, size );
+}
+
+void CommandList::BeginRenderPass( ImageHandle colorTarget, const float clearColor[4] )
+{
+	CmdBeginRenderPass payload = { colorTarget };
+	memcpy( payload.clearColor, clearColor, sizeof( payload.clearColor ) );
+	Write( CommandType::BeginRenderPass, payload );
+}
+
+void CommandList::EndRenderPass()
+{
+	Write( CommandType::EndRenderPass, nullptr, 0 );
+}
+
+void CommandList::Draw( uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance )
+{
+	Write( CommandType::Draw, CmdDraw{ vertexCount, instanceCount, firstVertex, firstInstance } );
+}
+
+void CommandList::DrawIndexed( uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance )
+{
+	Write( CommandType::DrawIndexed, CmdDrawIndexed{ indexCount, instanceCount, firstIndex, vertexOffset, firstInstance } );
+}
+
+void CommandList::Dispatch( uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ )
+{
+	Write( CommandType::Dispatch, CmdDispatch{ groupCountX, groupCountY, groupCountZ } );
+}
+
+void CommandList::CopyBuffer( BufferHandle src, uint64_t srcOffset, BufferHandle dst, uint64_t dstOffset, uint64_t size )
+{
+	Write( CommandType::CopyBuffer, CmdCopyBuffer{ src, dst, srcOffset, dstOffset, size } );
+}
+
+void CommandList::CopyBufferToImage( BufferHandle src, uint64_t srcOffset, ImageHandle dst )
+{
+	Write( CommandType::CopyBufferToImage, CmdCopyBufferToImage{ src, dst, srcOffset } );
+}
+
+void CommandList::CopyImageToBuffer( ImageHandle src, BufferHandle dst, uint64_t dstOffset )
+{
+	Write( CommandType::CopyImageToBuffer, CmdCopyImageToBuffer{ src, dst, dstOffset } );
+}
+
+void CommandList::Barrier( BufferHandle buffer, ResourceState before, ResourceState after )
+{
+	Write( CommandType::BufferBarrier, CmdBufferBarrier{ buffer, before, after } );
+}
+
+void CommandList::Barrier( ImageHandle image, ResourceState before, ResourceState after )
+{
+	Write( CommandType::ImageBarrier, CmdImageBarrier{ image, before, after } );
+}
+
+void CommandList::WriteTimestamp( QueryPoolHandle pool, uint32_t query )
+{
+	Write( CommandType::WriteTimestamp, CmdWriteTimestamp{ pool, query } );
+}
+
+void CommandList::Reset()
+{
+	m_first = nullptr;
+	m_current = nullptr;
+	m_commandCount = 0;
+	m_byteSize = 0;
+}
+
+void CommandList::Write( CommandType type, const void * payload, uint32_t size, const void * extra, uint32_t extraSize )
+{
+	const uint32_t payloadSize = size + extraSize;
+	assert( payloadSize <= 0xFFFF );
+	const uint32_t total = AlignStream( sizeof( Header ) + payloadSize );
+
+	if ( !m_current || m_current->used + total > m_current->capacity )
+	{
+		const uint32_t capacity = std::max<uint32_t>( CHUNK_SIZE - sizeof( Chunk ), total );
+		Chunk * chunk = static_cast<Chunk *>( m_arena->Allocate( sizeof( Chunk ) + capacity, alignof( Chunk ) ) );
+		chunk->next = nullptr;
+		chunk->used = 0;
+		chunk->capacity = capacity;
+
+		if ( m_current )
+			m_current->next = chunk;
+		else
+			m_first = chunk;
+		m_current = chunk;
+	}
+
+	char * data = GetChunkData( m_current ) + m_current->used;
+	const Header header = { type, (uint16_t)payloadSize };
+	memcpy( data, &header, sizeof( Header ) );
+	if ( size )
+		memcpy( data + sizeof( Header ), payload, size );
+	if ( extraSize )
+		memcpy( data + sizeof( Header ) + size, extra, extraSize );
+
+	m_current->used += total;
+	m_byteSize += total;
+	++m_commandCount;
+}
+
+//
+//
+//	CommandArenas =================================================================================
+//
+//
+CommandArenas::CommandArenas( uint32_t frameCount, size_t capacity )
+	: m_id( s_nextArenasId.fetch_add( 1, std::memory_order_relaxed ) )
+	, m_frameCount( frameCount )
+	, m_capacity( capacity )
+{
+}
+
+void CommandArenas::BeginFrame( uint64_t frameNumber )
+{
+	m_frameNumber.store( frameNumber, std::memory_order_relaxed );
+
+	// Work moves between threads from frame to frame, every thread's arenas are sized for the largest one seen
+	std::lock_guard<std::mutex> lock( m_mutex );
+	for ( const auto & arenas : m_threadArenas )
+	{
+		m_peak = std::max( m_peak, arenas->GetPeak() );
+	}
+	for ( auto & arenas : m_threadArenas )
+	{
+		arenas->BeginFrame( frameNumber, m_peak );
+	}
+}
+
+LinearArena & CommandArenas::GetArena()
+{
+	return GetThreadArenas().GetArena( m_frameNumber.load( std::memory_order_relaxed ) );
+}
+
+FrameArenas & CommandArenas::GetThreadArenas()
+{
+	for ( const ThreadArenasEntry & entry : s_threadArenas )
+	{
+		if ( entry.id == m_id )
+			return *entry.arenas;
+	}
+
+	// First recording from this thread
+	FrameArenas * arenas = nullptr;
+	{
+		std::lock_guard<std::mutex> lock( m_mutex );
+		arenas = new FrameArenas( m_frameCount, std::max( m_capacity, m_peak + m_peak / 2 ) );
+		m_threadArenas.emplace_back( arenas );
+	}
+	s_threadArenas.push_back( { m_id, arenas } );
+	return *arenas;
+}
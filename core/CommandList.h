@@ -0,0 +1,300 @@
+#pragma once
+#include "device.h"
+#include "memory/LinearArena.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+enum class CommandType : uint16_t
+{
+	BindPipeline = 0,
+	BindVertexBuffer,
+	BindIndexBuffer,
+	BindStorageBuffer,
+	BindStorageImage,
+	PushConstants,
+	Draw,
+	DrawIndexed,
+	Dispatch,
+	CopyBuffer,
+	CopyBufferToImage,
+	CopyImageToBuffer,
+	BufferBarrier,
+	ImageBarrier,
+	BeginRenderPass,
+	EndRenderPass,
+	WriteTimestamp,
+
+	Count,
+};
+
+enum class IndexType : uint32_t
+{
+	Uint16 = 0,
+	Uint32,
+};
+
+// What a resource is used for, barriers transition between two of these
+enum class ResourceState : uint32_t
+{
+	Undefined = 0,
+	TransferSrc,
+	TransferDst,
+	VertexBuffer,
+	IndexBuffer,
+	UniformBuffer,
+	ShaderRead,
+	ShaderWrite,
+	ColorTarget,
+	DepthTarget,
+	Present,
+	HostRead,	// readback buffers, once the GPU is done writing them
+};
+
+// Command payloads, stored in the stream right after their header
+struct CmdBindPipeline
+{
+	PipelineHandle pipeline;
+};
+
+struct CmdBindVertexBuffer
+{
+	uint32_t binding;
+	BufferHandle buffer;
+	uint64_t offset;
+};
+
+// Binding index in the pipeline's single descriptor set of storage buffers
+struct CmdBindStorageBuffer
+{
+	uint32_t binding;
+	BufferHandle buffer;
+	uint64_t offset;
+	uint64_t range;		// 0 up to the end of the buffer
+};
+
+// Shares the storage buffers' descriptor set; the image must be in the ShaderWrite state
+struct CmdBindStorageImage
+{
+	uint32_t binding;
+	ImageHandle image;
+};
+
+struct CmdBindIndexBuffer
+{
+	BufferHandle buffer;
+	IndexType indexType;
+	uint64_t offset;
+};
+
+// Followed by size bytes of data
+struct CmdPushConstants
+{
+	uint32_t offset;
+	uint32_t size;
+};
+
+struct CmdDraw
+{
+	uint32_t vertexCount;
+	uint32_t instanceCount;
+	uint32_t firstVertex;
+	uint32_t firstInstance;
+};
+
+struct CmdDrawIndexed
+{
+	uint32_t indexCount;
+	uint32_t instanceCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+	uint32_t firstInstance;
+};
+
+struct CmdDispatch
+{
+	uint32_t groupCountX;
+	uint32_t groupCountY;
+	uint32_t groupCountZ;
+};
+
+struct CmdCopyBuffer
+{
+	BufferHandle src;
+	BufferHandle dst;
+	uint64_t srcOffset;
+	uint64_t dstOffset;
+	uint64_t size;
+};
+
+// Tightly packed texels covering the whole image
+struct CmdCopyBufferToImage
+{
+	BufferHandle src;
+	ImageHandle dst;
+	uint64_t srcOffset;
+};
+
+// Whole image, texels tightly packed in the buffer
+struct CmdCopyImageToBuffer
+{
+	ImageHandle src;
+	BufferHandle dst;
+	uint64_t dstOffset;
+};
+
+struct CmdBufferBarrier
+{
+	BufferHandle buffer;
+	ResourceState before;
+	ResourceState after;
+};
+
+struct CmdImageBarrier
+{
+	ImageHandle image;
+	ResourceState before;
+	ResourceState after;
+};
+
+// Clears the target, then draws render into it until EndRenderPass (no payload).
+// The target must be in the ColorTarget state; viewport and scissor are set to its whole extent.
+struct CmdBeginRenderPass
+{
+	ImageHandle colorTarget;
+	float clearColor[4];
+};
+
+// Once every command recorded before it completed
+struct CmdWriteTimestamp
+{
+	QueryPoolHandle pool;
+	uint32_t query;
+};
+
+// Backend-agnostic list of GPU commands. Recording only appends bytes to a stream allocated from an arena,
+// so any thread can record without touching the graphics API; the device translates the stream at submit.
+// Each command is a 4-byte header followed by its payload, unaligned: payloads are read back with memcpy.
+// The arena must outlive the list, lists recorded for a frame use that frame's CommandArenas arena.
+class CommandList
+{
+	struct Chunk
+	{
+		Chunk * next;
+		uint32_t used;
+		uint32_t capacity;
+	};
+
+public:
+	struct Header
+	{
+		CommandType type;
+		uint16_t size;	// payload bytes
+	};
+
+	// Walks the stream in recording order
+	class Reader
+	{
+	public:
+		explicit Reader( const CommandList & list ) : m_chunk( list.m_first ), m_offset( 0 ) {}
+
+		bool Next( Header & header );
+		// Payload of the command returned by the last Next()
+		template<typename T>
+		T Read() const
+		{
+			T payload;
+			memcpy( &payload, m_payload, sizeof( T ) );
+			return payload;
+		}
+		const void * GetPayload() const { return m_payload; }
+
+	private:
+		const Chunk * m_chunk;
+		uint32_t m_offset;
+		const char * m_payload = nullptr;
+	};
+
+public:
+	explicit CommandList( LinearArena & arena ) : m_arena( &arena ) {}
+
+	CommandList( const CommandList & ) = delete;
+	CommandList & operator=( const CommandList & ) = delete;
+
+	void BindPipeline( PipelineHandle pipeline );
+	void BindVertexBuffer( uint32_t binding, BufferHandle buffer, uint64_t offset = 0 );
+	void BindIndexBuffer( BufferHandle buffer, IndexType indexType, uint64_t offset = 0 );
+	void BindStorageBuffer( uint32_t binding, BufferHandle buffer, uint64_t offset = 0, uint64_t range = 0 );
+	void BindStorageImage( uint32_t binding, ImageHandle image );
+	void PushConstants( uint32_t offset, uint32_t size, const void * data );
+	template<typename T>
+	void PushConstants( const T & data, uint32_t offset = 0 ) { PushConstants( offset, sizeof( T ), &data ); }
+
+	// Draws must be recorded between these two, barriers outside of them
+	void BeginRenderPass( ImageHandle colorTarget, const float clearColor[4] );
+	void EndRenderPass();
+	void Draw( uint32_t vertexCount, uint32_t instanceCount = 1, uint32_t firstVertex = 0, uint32_t firstInstance = 0 );
+	void DrawIndexed( uint32_t indexCount, uint32_t instanceCount = 1, uint32_t firstIndex = 0, int32_t vertexOffset = 0, uint32_t firstInstance = 0 );
+	void Dispatch( uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1 );
+
+	void CopyBuffer( BufferHandle src, uint64_t srcOffset, BufferHandle dst, uint64_t dstOffset, uint64_t size );
+	void CopyBufferToImage( BufferHandle src, uint64_t srcOffset, ImageHandle dst );
+	void CopyImageToBuffer( ImageHandle src, BufferHandle dst, uint64_t dstOffset );
+	void Barrier( BufferHandle buffer, ResourceState before, ResourceState after );
+	void Barrier( ImageHandle image, ResourceState before, ResourceState after );
+	void WriteTimestamp( QueryPoolHandle pool, uint32_t query );
+
+	// Forgets the recorded commands, their bytes stay in the arena until it is reset
+	void Reset();
+
+	uint32_t GetCommandCount() const { return m_commandCount; }
+	size_t GetByteSize() const { return m_byteSize; }
+	bool IsEmpty() const { return m_commandCount == 0; }
+
+private:
+	static constexpr uint32_t CHUNK_SIZE = 4096;
+
+	void Write( CommandType type, const void * payload, uint32_t size, const void * extra = nullptr, uint32_t extraSize = 0 );
+	template<typename T>
+	void Write( CommandType type, const T & payload ) { Write( type, &payload, sizeof( T ) ); }
+
+	static char * GetChunkData( Chunk * chunk ) { return reinterpret_cast<char *>( chunk + 1 ); }
+	static const char * GetChunkData( const Chunk * chunk ) { return reinterpret_cast<const char *>( chunk + 1 ); }
+
+private:
+	LinearArena * m_arena;
+	Chunk * m_first = nullptr;
+	Chunk * m_current = nullptr;
+	uint32_t m_commandCount = 0;
+	size_t m_byteSize = 0;
+};
+
+// Recording arenas, one set per thread and per frame slot. A thread gets its own arena the first time it
+// asks, so concurrent recorders never share an allocator. BeginFrame() resets the slot's arenas of every
+// thread and must not run while anyone records: it belongs to the thread that owns the frame loop.
+class CommandArenas
+{
+public:
+	CommandArenas( uint32_t frameCount, size_t capacity );
+
+	void BeginFrame( uint64_t frameNumber );
+	// Arena of the calling thread for the current frame
+	LinearArena & GetArena();
+
+private:
+	FrameArenas & GetThreadArenas();
+
+private:
+	const uint64_t m_id;
+	const uint32_t m_frameCount;
+	const size_t m_capacity;
+	std::atomic<uint64_t> m_frameNumber{ 0 };
+
+	std::mutex m_mutex;
+	std::vector<std::unique_ptr<FrameArenas>> m_threadArenas;
+	size_t m_peak = 0;
+};
@@ -0,0 +1,178 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// 32-bit resource handle: slot index in the low bits, slot generation in the high bits.
+// The generation changes every time a slot is reused, so a handle to a destroyed resource
+// never resolves to whatever took its place. The value 0 is never handed out.
+template<typename Tag>
+class Handle
+{
+public:
+	static constexpr uint32_t INDEX_BITS = 20;
+	static constexpr uint32_t INDEX_MASK = (1U << INDEX_BITS) - 1;
+	static constexpr uint32_t GENERATION_MASK = (1U << (32 - INDEX_BITS)) - 1;
+
+public:
+	Handle() = default;
+	Handle( uint32_t index, uint32_t generation ) : m_value( (generation << INDEX_BITS) | index ) {}
+
+	bool IsValid() const { return m_value != 0; }
+	uint32_t GetIndex() const { return m_value & INDEX_MASK; }
+	uint32_t GetGeneration() const { return m_value >> INDEX_BITS; }
+	uint32_t GetValue() const { return m_value; }
+	static Handle FromValue( uint32_t value ) { Handle handle; handle.m_value = value; return handle; }
+
+	bool operator==( const Handle & other ) const { return m_value == other.m_value; }
+	bool operator!=( const Handle & other ) const { return m_value != other.m_value; }
+
+private:
+	uint32_t m_value = 0;
+};
+
+// Resources of one type, stored as one dense array per component (SoA) so systems iterate
+// only the fields they touch. Handles go through a sparse slot table: lookup is O(1), removal
+// swaps the last element into the hole to keep the arrays dense.
+// Not synchronized: create and destroy from the owning thread; lookups may run concurrently with each other.
+template<typename Tag, typename... Components>
+class HandlePool
+{
+public:
+	typedef Handle<Tag> HandleType;
+	template<size_t I>
+	using Component = typename std::tuple_element<I, std::tuple<Components...>>::type;
+
+public:
+	HandleType Create( Components... components )
+	{
+		uint32_t slotIdx;
+		if ( m_freeHead != INVALID_INDEX )
+		{
+			slotIdx = m_freeHead;
+			m_freeHead = m_slots[slotIdx].denseIdx;
+		}
+		else
+		{
+			assert( m_slots.size() < HandleType::INDEX_MASK );
+			slotIdx = (uint32_t)m_slots.size();
+			m_slots.push_back( { INVALID_INDEX, 0 } );
+		}
+
+		Slot & slot = m_slots[slotIdx];
+		slot.generation = (slot.generation + 1) & HandleType::GENERATION_MASK;
+		if ( slot.generation == 0 )
+			slot.generation = 1;
+		slot.denseIdx = (uint32_t)m_denseToSlot.size();
+
+		m_denseToSlot.push_back( slotIdx );
+		PushBack( std::index_sequence_for<Components...>(), std::move( components )... );
+		return HandleType( slotIdx, slot.generation );
+	}
+
+	bool Destroy( HandleType handle )
+	{
+		if ( !IsValid( handle ) )
+			return false;
+
+		Slot & slot = m_slots[handle.GetIndex()];
+		const uint32_t denseIdx = slot.denseIdx;
+		const uint32_t lastIdx = (uint32_t)m_denseToSlot.size() - 1;
+		if ( denseIdx != lastIdx )
+		{
+			MoveDense( std::index_sequence_for<Components...>(), lastIdx, denseIdx );
+			m_denseToSlot[denseIdx] = m_denseToSlot[lastIdx];
+			m_slots[m_denseToSlot[denseIdx]].denseIdx = denseIdx;
+		}
+		PopBack( std::index_sequence_for<Components...>() );
+		m_denseToSlot.pop_back();
+
+		// Free slots are chained through denseIdx, the generation stays to invalidate old handles
+		slot.denseIdx = m_freeHead;
+		m_freeHead = handle.GetIndex();
+		return true;
+	}
+
+	bool IsValid( HandleType handle ) const
+	{
+		const uint32_t slotIdx = handle.GetIndex();
+		return handle.IsValid() && slotIdx < m_slots.size()
+			&& m_slots[slotIdx].generation == handle.GetGeneration()
+			&& m_slots[slotIdx].denseIdx < m_denseToSlot.size()
+			&& m_denseToSlot[m_slots[slotIdx].denseIdx] == slotIdx;
+	}
+
+	template<size_t I>
+	Component<I> & Get( HandleType handle )
+	{
+		assert( IsValid( handle ) );
+		return std::get<I>( m_dense )[m_slots[handle.GetIndex()].denseIdx];
+	}
+
+	template<size_t I>
+	const Component<I> & Get( HandleType handle ) const
+	{
+		assert( IsValid( handle ) );
+		return std::get<I>( m_dense )[m_slots[handle.GetIndex()].denseIdx];
+	}
+
+	// nullptr for a stale or null handle
+	template<size_t I>
+	Component<I> * TryGet( HandleType handle )
+	{
+		return IsValid( handle ) ? &std::get<I>( m_dense )[m_slots[handle.GetIndex()].denseIdx] : nullptr;
+	}
+
+	// Dense iteration: elements [0, GetCount()) of every component line up
+	template<size_t I>
+	Component<I> * GetDense() { return std::get<I>( m_dense ).data(); }
+	template<size_t I>
+	const Component<I> * GetDense() const { return std::get<I>( m_dense ).data(); }
+	HandleType GetHandle( uint32_t denseIdx ) const
+	{
+		const uint32_t slotIdx = m_denseToSlot[denseIdx];
+		return HandleType( slotIdx, m_slots[slotIdx].generation );
+	}
+
+	uint32_t GetCount() const { return (uint32_t)m_denseToSlot.size(); }
+	bool IsEmpty() const { return m_denseToSlot.empty(); }
+
+private:
+	static constexpr uint32_t INVALID_INDEX = 0xFFFFFFFFU;
+
+	struct Slot
+	{
+		uint32_t denseIdx;
+		uint32_t generation;
+	};
+
+	template<size_t... I>
+	void PushBack( std::index_sequence<I...>, Components &&... components )
+	{
+		int expand[] = { 0, (std::get<I>( m_dense ).push_back( std::move( components ) ), 0)... };
+		(void)expand;
+	}
+
+	template<size_t... I>
+	void MoveDense( std::index_sequence<I...>, uint32_t from, uint32_t to )
+	{
+		int expand[] = { 0, (std::get<I>( m_dense )[to] = std::move( std::get<I>( m_dense )[from] ), 0)... };
+		(void)expand;
+	}
+
+	template<size_t... I>
+	void PopBack( std::index_sequence<I...> )
+	{
+		int expand[] = { 0, (std::get<I>( m_dense ).pop_back(), 0)... };
+		(void)expand;
+	}
+
+private:
+	std::vector<Slot> m_slots;
+	uint32_t m_freeHead = INVALID_INDEX;
+	std::vector<uint32_t> m_denseToSlot;
+	std::tuple<std::vector<Components>...> m_dense;
+};
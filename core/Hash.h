@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// 64-bit FNV-1a. Used to key caches on content, not meant to be cryptographic.
+const uint64_t HASH_SEED = 14695981039346656037ULL;
+
+inline uint64_t HashBytes( const void * data, size_t size, uint64_t seed = HASH_SEED )
+{
+	const uint8_t * bytes = static_cast<const uint8_t *>( data );
+	uint64_t hash = seed;
+	for ( size_t i = 0; i < size; ++i )
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+template<typename T>
+inline uint64_t HashValue( const T & value, uint64_t seed = HASH_SEED )
+{
+	return HashBytes( &value, sizeof( T ), seed );
+}
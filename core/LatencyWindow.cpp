@@ -0,0 +1,61 @@
+#include <stdafx.h>
+#include "LatencyWindow.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <ostream>
+
+namespace
+{
+	double GetSortedPercentile( const double * sorted, uint32_t count, double p )
+	{
+		if ( count == 0 )
+			return 0.0;
+		const uint32_t idx = (uint32_t)std::ceil( p * count );
+		return sorted[std::min( count, std::max( idx, 1U ) ) - 1];
+	}
+}
+
+constexpr uint32_t LatencyWindow::CAPACITY;
+
+void LatencyWindow::Add( double ms )
+{
+	m_samples[m_next] = ms;
+	m_next = (m_next + 1) % CAPACITY;
+	m_count = std::min( m_count + 1, CAPACITY );
+}
+
+void LatencyWindow::Reset()
+{
+	m_next = 0;
+	m_count = 0;
+}
+
+double LatencyWindow::GetPercentile( double p ) const
+{
+	double sorted[CAPACITY];
+	return GetSortedPercentile( sorted, Sort( sorted ), p );
+}
+
+void LatencyWindow::PrintReport( std::ostream & out, const char * name ) const
+{
+	double sorted[CAPACITY];
+	const uint32_t count = Sort( sorted );
+
+	out << std::fixed << std::setprecision( 3 )
+		<< name << ": " << count << " samples"
+		<< ", p50 " << GetSortedPercentile( sorted, count, 0.50 )
+		<< ", p90 " << GetSortedPercentile( sorted, count, 0.90 )
+		<< ", p99 " << GetSortedPercentile( sorted, count, 0.99 )
+		<< ", max " << GetSortedPercentile( sorted, count, 1.0 ) << " ms\n"
+		<< std::defaultfloat;
+}
+
+uint32_t LatencyWindow::Sort( double * sorted ) const
+{
+	// Once the window wrapped, every slot holds a sample and order does not matter
+	std::copy( m_samples, m_samples + m_count, sorted );
+	std::sort( sorted, sorted + m_count );
+	return m_count;
+}
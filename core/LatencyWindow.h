@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <iosfwd>
+
+// Latency samples in ms over a sliding window of the last CAPACITY ones.
+// Adding a sample never allocates, so it can be done every frame; percentiles are for reports.
+class LatencyWindow
+{
+public:
+	static constexpr uint32_t CAPACITY = 1024;
+
+public:
+	void Add( double ms );
+	void Reset();
+
+	uint32_t GetCount() const { return m_count; }
+	// p in [0, 1], 0 without samples
+	double GetPercentile( double p ) const;
+
+	// One line: name, sample count, p50 p90 p99 and max
+	void PrintReport( std::ostream & out, const char * name ) const;
+
+private:
+	uint32_t Sort( double * sorted ) const;
+
+private:
+	double m_samples[CAPACITY];
+	uint32_t m_next = 0;
+	uint32_t m_count = 0;
+};
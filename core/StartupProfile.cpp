@@ -0,0 +1,129 @@
+#include <stdafx.h>
+#include "StartupProfile.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+
+namespace
+{
+	// Taken during static initialization, as close to process start as portable code gets
+	const StartupProfile::Clock::time_point s_processStart = StartupProfile::Clock::now();
+
+	thread_local uint32_t s_phaseDepth = 0;
+
+	double ToMs( StartupProfile::Clock::duration duration )
+	{
+		return std::chrono::duration<double, std::milli>( duration ).count();
+	}
+}
+
+StartupProfile & StartupProfile::Get()
+{
+	static StartupProfile profile;
+	return profile;
+}
+
+StartupProfile::StartupProfile()
+	: m_start( s_processStart )
+{
+}
+
+uint32_t StartupProfile::BeginPhase( const char * name )
+{
+	const double now = GetElapsedMs();
+
+	std::lock_guard<std::mutex> lock( m_mutex );
+	m_phases.push_back( { name, GetThreadIdx(), s_phaseDepth++, now, -1.0 } );
+	return (uint32_t)m_phases.size() - 1;
+}
+
+void StartupProfile::EndPhase( uint32_t phaseIdx )
+{
+	const double now = GetElapsedMs();
+
+	std::lock_guard<std::mutex> lock( m_mutex );
+	m_phases[phaseIdx].endMs = now;
+	--s_phaseDepth;
+}
+
+void StartupProfile::MarkFirstSubmit()
+{
+	const double now = GetElapsedMs();
+
+	std::lock_guard<std::mutex> lock( m_mutex );
+	if ( m_firstSubmitMs < 0.0 )
+		m_firstSubmitMs = now;
+}
+
+double StartupProfile::GetTimeToFirstSubmitMs() const
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	return m_firstSubmitMs;
+}
+
+void StartupProfile::MarkFirstFrame()
+{
+	const double now = GetElapsedMs();
+
+	std::lock_guard<std::mutex> lock( m_mutex );
+	if ( m_firstFrameMs < 0.0 )
+		m_firstFrameMs = now;
+}
+
+double StartupProfile::GetTimeToFirstFrameMs() const
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	return m_firstFrameMs;
+}
+
+double StartupProfile::GetElapsedMs() const
+{
+	return ToMs( Clock::now() - m_start );
+}
+
+void StartupProfile::PrintReport( std::ostream & out ) const
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+
+	std::vector<const Phase *> phases;
+	for ( const Phase & phase : m_phases )
+	{
+		phases.push_back( &phase );
+	}
+	std::stable_sort( phases.begin(), phases.end(), []( const Phase * a, const Phase * b ) { return a->beginMs < b->beginMs; } );
+
+	out << "startup phases, ms since process start\n";
+	out << "thread     begin       end  duration  phase\n";
+	out << std::fixed << std::setprecision( 2 );
+	for ( const Phase * phase : phases )
+	{
+		out << std::setw( 6 ) << phase->threadIdx
+			<< std::setw( 10 ) << phase->beginMs;
+		if ( phase->endMs >= 0.0 )
+			out << std::setw( 10 ) << phase->endMs << std::setw( 10 ) << phase->endMs - phase->beginMs;
+		else
+			out << std::setw( 10 ) << "-" << std::setw( 10 ) << "running";
+		out << "  " << std::string( phase->depth * 2, ' ' ) << phase->name << "\n";
+	}
+
+	if ( m_firstSubmitMs >= 0.0 )
+		out << "time to first submit: " << m_firstSubmitMs << " ms\n";
+	if ( m_firstFrameMs >= 0.0 )
+		out << "time to first frame: " << m_firstFrameMs << " ms\n";
+	else
+		out << "no frame presented yet, " << GetElapsedMs() << " ms since process start\n";
+	out << std::defaultfloat;
+}
+
+uint32_t StartupProfile::GetThreadIdx()
+{
+	const std::thread::id id = std::this_thread::get_id();
+	for ( uint32_t i = 0; i < m_threads.size(); ++i )
+	{
+		if ( m_threads[i] == id )
+			return i;
+	}
+	m_threads.push_back( id );
+	return (uint32_t)m_threads.size() - 1;
+}
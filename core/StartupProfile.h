@@ -0,0 +1,71 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Timeline of the process start-up: named phases with the thread that ran them, relative to process start,
+// the time to the first graphics submission the GPU completed, and the time to the first presented frame.
+// Phases may nest and overlap across threads; the report shows both, so the critical path of an overlapped
+// init can be read straight off it.
+class StartupProfile
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Phase
+	{
+		std::string name;
+		uint32_t threadIdx;	// order in which threads first recorded a phase, 0 is the first one
+		uint32_t depth;		// nesting level on its thread
+		double beginMs;
+		double endMs;
+	};
+
+public:
+	static StartupProfile & Get();
+
+	// Returns the phase index for EndPhase()
+	uint32_t BeginPhase( const char * name );
+	void EndPhase( uint32_t phaseIdx );
+
+	// Only the first call counts. A submission is not a frame: nothing reached the screen until a present
+	void MarkFirstSubmit();
+	double GetTimeToFirstSubmitMs() const;
+	void MarkFirstFrame();
+	bool HasFirstFrame() const { return GetTimeToFirstFrameMs() >= 0.0; }
+	// Negative until MarkFirstFrame()
+	double GetTimeToFirstFrameMs() const;
+	double GetElapsedMs() const;
+
+	void PrintReport( std::ostream & out ) const;
+
+private:
+	StartupProfile();
+
+	uint32_t GetThreadIdx();
+
+private:
+	const Clock::time_point m_start;
+	mutable std::mutex m_mutex;
+	std::vector<Phase> m_phases;
+	std::vector<std::thread::id> m_threads;
+	double m_firstSubmitMs = -1.0;
+	double m_firstFrameMs = -1.0;
+};
+
+class StartupPhase
+{
+public:
+	explicit StartupPhase( const char * name ) : m_phaseIdx( StartupProfile::Get().BeginPhase( name ) ) {}
+	~StartupPhase() { StartupProfile::Get().EndPhase( m_phaseIdx ); }
+
+	StartupPhase( const StartupPhase & ) = delete;
+	StartupPhase & operator=( const StartupPhase & ) = delete;
+
+private:
+	uint32_t m_phaseIdx;
+};
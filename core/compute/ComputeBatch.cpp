@@ -0,0 +1,66 @@
+#include <stdafx.h>
+#include "ComputeBatch.h"
+
+constexpr uint32_t ComputeBatch::MAX_BUFFERS;
+
+ComputeBatch::ComputeBatch( IDevice3D & device, size_t arenaCapacity )
+	: m_device( device )
+	, m_arena( arenaCapacity )
+{
+}
+
+void ComputeBatch::Dispatch( PipelineHandle pipeline, const BufferHandle * buffers, uint32_t bufferCount,
+	const void * constants, uint32_t constantSize, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ )
+{
+	assert( bufferCount <= MAX_BUFFERS );
+
+	// Rebinding what is already bound costs a few bytes here, the translator drops it
+	m_list.BindPipeline( pipeline );
+	for ( uint32_t i = 0; i < bufferCount; ++i )
+	{
+		m_list.BindStorageBuffer( i, buffers[i] );
+	}
+	if ( constantSize )
+		m_list.PushConstants( 0, constantSize, constants );
+	m_list.Dispatch( groupCountX, groupCountY, groupCountZ );
+	++m_stats.dispatchCount;
+}
+
+void ComputeBatch::Barrier( const BufferHandle * buffers, uint32_t count )
+{
+	// Consecutive barriers reach the driver as one
+	for ( uint32_t i = 0; i < count; ++i )
+	{
+		m_list.Barrier( buffers[i], ResourceState::ShaderWrite, ResourceState::ShaderWrite );
+	}
+	++m_stats.barrierCount;
+}
+
+void ComputeBatch::Upload( BufferHandle src, uint64_t srcOffset, BufferHandle dst, uint64_t dstOffset, uint64_t size )
+{
+	m_list.Barrier( dst, ResourceState::ShaderWrite, ResourceState::TransferDst );
+	m_list.CopyBuffer( src, srcOffset, dst, dstOffset, size );
+	m_list.Barrier( dst, ResourceState::TransferDst, ResourceState::ShaderWrite );
+}
+
+void ComputeBatch::Download( BufferHandle src, uint64_t srcOffset, BufferHandle dst, uint64_t dstOffset, uint64_t size )
+{
+	m_list.Barrier( src, ResourceState::ShaderWrite, ResourceState::TransferSrc );
+	m_list.CopyBuffer( src, srcOffset, dst, dstOffset, size );
+	m_list.Barrier( src, ResourceState::TransferSrc, ResourceState::ShaderWrite );
+	m_list.Barrier( dst, ResourceState::TransferDst, ResourceState::HostRead );
+}
+
+uint64_t ComputeBatch::Submit()
+{
+	if ( m_list.IsEmpty() )
+		return 0;
+
+	// Translated before Submit() returns, the recorded bytes can go right away
+	const CommandList * lists[] = { &m_list };
+	const uint64_t serial = m_device.Submit( IDevice3D::ComputeQueue, lists, 1 );
+	m_list.Reset();
+	m_arena.Reset();
+	++m_stats.submitCount;
+	return serial;
+}
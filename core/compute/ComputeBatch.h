@@ -0,0 +1,62 @@
+#pragma once
+#include "../CommandList.h"
+#include "../device.h"
+#include "../memory/LinearArena.h"
+
+#include <cstdint>
+
+// Compute work recorded as one command list and sent in a single submission on the compute queue:
+// a chain of kernels costs one vkQueueSubmit, not one per dispatch. Dispatches are only ordered where
+// Barrier() asks for it, independent ones overlap on the GPU.
+// Buffers are bound as storage buffers 0..n-1 of the pipeline, in the order given.
+// Runs on any device, the null device included; on Vulkan the pipelines come from CreateComputePipeline().
+class ComputeBatch
+{
+public:
+	static constexpr uint32_t MAX_BUFFERS = 8;
+
+	struct Stats
+	{
+		uint64_t dispatchCount = 0;
+		uint64_t barrierCount = 0;
+		uint64_t submitCount = 0;
+	};
+
+public:
+	explicit ComputeBatch( IDevice3D & device, size_t arenaCapacity = 64 * 1024 );
+
+	ComputeBatch( const ComputeBatch & ) = delete;
+	ComputeBatch & operator=( const ComputeBatch & ) = delete;
+
+	void Dispatch( PipelineHandle pipeline, const BufferHandle * buffers, uint32_t bufferCount,
+		const void * constants, uint32_t constantSize, uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1 );
+	template<typename T>
+	void Dispatch( PipelineHandle pipeline, const BufferHandle * buffers, uint32_t bufferCount,
+		const T & constants, uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1 )
+	{
+		Dispatch( pipeline, buffers, bufferCount, &constants, sizeof( T ), groupCountX, groupCountY, groupCountZ );
+	}
+
+	// Shader writes to the buffers are visible to the dispatches recorded after
+	void Barrier( const BufferHandle * buffers, uint32_t count );
+	void Barrier( BufferHandle buffer ) { Barrier( &buffer, 1 ); }
+	// Copies from a host-written Upload buffer, for the dispatches recorded after
+	void Upload( BufferHandle src, uint64_t srcOffset, BufferHandle dst, uint64_t dstOffset, uint64_t size );
+	// Copies what the dispatches wrote to a Readback buffer, readable by the host once the batch completes
+	void Download( BufferHandle src, uint64_t srcOffset, BufferHandle dst, uint64_t dstOffset, uint64_t size );
+	// Pool from CreateTimestampQueries( IDevice3D::ComputeQueue, ... )
+	void WriteTimestamp( QueryPoolHandle pool, uint32_t query ) { m_list.WriteTimestamp( pool, query ); }
+
+	// Returns the compute queue serial, 0 when nothing was recorded. The batch is empty again afterwards.
+	uint64_t Submit();
+	void Wait( uint64_t serial ) { m_device.WaitComplete( IDevice3D::ComputeQueue, serial ); }
+
+	bool IsEmpty() const { return m_list.IsEmpty(); }
+	const Stats & GetStats() const { return m_stats; }
+
+private:
+	IDevice3D & m_device;
+	LinearArena m_arena;
+	CommandList m_list{ m_arena };
+	Stats m_stats;
+};
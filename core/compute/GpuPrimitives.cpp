@@ -0,0 +1,176 @@
+#include <stdafx.h>
+#include "GpuPrimitives.h"
+
+constexpr uint32_t GpuPrimitives::GROUP_SIZE;
+constexpr uint32_t GpuPrimitives::ITEMS_PER_THREAD;
+constexpr uint32_t GpuPrimitives::TILE_SIZE;
+constexpr uint32_t GpuPrimitives::RADIX_BITS;
+constexpr uint32_t GpuPrimitives::RADIX_SIZE;
+constexpr uint32_t GpuPrimitives::MAX_GROUPS_X;
+
+GpuPrimitives::GpuPrimitives( IDevice3D & device, const GpuPrimitivePipelines & pipelines )
+	: m_device( device )
+	, m_pipelines( pipelines )
+{
+}
+
+GpuPrimitives::~GpuPrimitives()
+{
+	Destroy();
+}
+
+void GpuPrimitives::Init( uint32_t maxCount )
+{
+	Destroy();
+	m_maxCount = maxCount;
+
+	// The histograms are scanned too, they hold fewer counters than there are elements
+	const uint32_t maxTiles = GetTileCount( maxCount );
+	for ( uint32_t count = std::max( maxCount, maxTiles * RADIX_SIZE ); count > TILE_SIZE; )
+	{
+		count = GetTileCount( count );
+		m_tileSums.push_back( CreateScratch( (uint64_t)count * sizeof( uint32_t ) ) );
+	}
+	// Every scan writes its tile totals, even a single tile's
+	m_tileSums.push_back( CreateScratch( sizeof( uint32_t ) ) );
+
+	m_offsets = CreateScratch( (uint64_t)maxCount * sizeof( uint32_t ) );
+	m_histogram = CreateScratch( (uint64_t)maxTiles * RADIX_SIZE * sizeof( uint32_t ) );
+	m_sortKeys = CreateScratch( (uint64_t)maxCount * sizeof( uint64_t ) );
+	m_sortValues = CreateScratch( (uint64_t)maxCount * sizeof( uint32_t ) );
+}
+
+void GpuPrimitives::Destroy()
+{
+	for ( BufferHandle buffer : m_tileSums )
+	{
+		m_device.DestroyBuffer( buffer );
+	}
+	m_tileSums.clear();
+	m_device.DestroyBuffer( m_offsets );
+	m_device.DestroyBuffer( m_histogram );
+	m_device.DestroyBuffer( m_sortKeys );
+	m_device.DestroyBuffer( m_sortValues );
+	m_offsets = m_histogram = m_sortKeys = m_sortValues = BufferHandle();
+	m_maxCount = 0;
+}
+
+void GpuPrimitives::ExclusiveScan( ComputeBatch & batch, BufferHandle in, BufferHandle out, uint32_t count )
+{
+	assert( count <= m_maxCount );
+	Scan( batch, in, out, count, ScanExclusive, 0 );
+}
+
+void GpuPrimitives::InclusiveScan( ComputeBatch & batch, BufferHandle in, BufferHandle out, uint32_t count )
+{
+	assert( count <= m_maxCount );
+	Scan( batch, in, out, count, 0, 0 );
+}
+
+void GpuPrimitives::Reduce( ComputeBatch & batch, BufferHandle in, BufferHandle out, uint32_t count )
+{
+	assert( count <= m_maxCount );
+
+	// Each level sums the tiles of the one before, the last one writes a single value
+	BufferHandle source = in;
+	for ( uint32_t level = 0; ; ++level )
+	{
+		const uint32_t tileCount = GetTileCount( count );
+		const BufferHandle target = tileCount == 1 ? out : m_tileSums[level];
+		const BufferHandle buffers[] = { source, target };
+		Dispatch( batch, m_pipelines.reduce, buffers, 2, &count, sizeof( count ), count );
+		batch.Barrier( target );
+		if ( tileCount == 1 )
+			break;
+
+		source = target;
+		count = tileCount;
+	}
+}
+
+void GpuPrimitives::Compact( ComputeBatch & batch, BufferHandle values, BufferHandle flags, BufferHandle out, BufferHandle outCount, uint32_t count )
+{
+	assert( count <= m_maxCount );
+	if ( count == 0 )
+		return;
+
+	Scan( batch, flags, m_offsets, count, ScanExclusive | ScanPredicate, 0 );
+
+	const BufferHandle buffers[] = { values, flags, m_offsets, out, outCount };
+	Dispatch( batch, m_pipelines.compactScatter, buffers, 5, &count, sizeof( count ), count );
+	const BufferHandle written[] = { out, outCount };
+	batch.Barrier( written, 2 );
+}
+
+void GpuPrimitives::SortKeyValue( ComputeBatch & batch, BufferHandle keys, BufferHandle values, uint32_t count, SortKeyWidth width )
+{
+	assert( count <= m_maxCount );
+	if ( count <= 1 )
+		return;
+
+	// An even pass count: the last pass writes back to keys and values
+	const uint32_t keyBits = width == SortKeyWidth::Bits64 ? 64 : 32;
+	const uint32_t tileCount = GetTileCount( count );
+	BufferHandle source[] = { keys, values };
+	BufferHandle target[] = { m_sortKeys, m_sortValues };
+	for ( uint32_t shift = 0; shift < keyBits; shift += RADIX_BITS )
+	{
+		const RadixConstants constants = { count, shift, tileCount };
+
+		// Digit-major counters: their exclusive scan is where each tile's run of each digit starts
+		const BufferHandle histogramBuffers[] = { source[0], m_histogram };
+		Dispatch( batch, m_pipelines.radixHistogram[(int)width], histogramBuffers, 2, &constants, sizeof( constants ), count );
+		batch.Barrier( m_histogram );
+		Scan( batch, m_histogram, m_histogram, tileCount * RADIX_SIZE, ScanExclusive, 0 );
+
+		const BufferHandle scatterBuffers[] = { source[0], source[1], target[0], target[1], m_histogram };
+		Dispatch( batch, m_pipelines.radixScatter[(int)width], scatterBuffers, 5, &constants, sizeof( constants ), count );
+		batch.Barrier( target, 2 );
+
+		std::swap( source[0], target[0] );
+		std::swap( source[1], target[1] );
+	}
+}
+
+BufferHandle GpuPrimitives::CreateScratch( uint64_t size )
+{
+	BufferDesc desc;
+	desc.size = std::max<uint64_t>( size, sizeof( uint32_t ) );
+	desc.usage = BufferUsageStorage;
+	return m_device.CreateBuffer( desc );
+}
+
+void GpuPrimitives::Scan( ComputeBatch & batch, BufferHandle in, BufferHandle out, uint32_t count, uint32_t flags, uint32_t level )
+{
+	if ( count == 0 )
+		return;
+
+	assert( level < m_tileSums.size() );
+	const BufferHandle tileSums = m_tileSums[level];
+	const ScanConstants constants = { count, flags };
+	const BufferHandle buffers[] = { in, out, tileSums };
+	Dispatch( batch, m_pipelines.scanTiles, buffers, 3, &constants, sizeof( constants ), count );
+
+	const uint32_t tileCount = GetTileCount( count );
+	if ( tileCount > 1 )
+	{
+		// The tile totals become the offset of every tile, added back to its elements
+		batch.Barrier( tileSums );
+		Scan( batch, tileSums, tileSums, tileCount, ScanExclusive, level + 1 );
+
+		const BufferHandle addBuffers[] = { out, tileSums };
+		Dispatch( batch, m_pipelines.scanAdd, addBuffers, 2, &count, sizeof( count ), count );
+	}
+	const BufferHandle written[] = { out, tileSums };
+	batch.Barrier( written, 2 );
+}
+
+void GpuPrimitives::Dispatch( ComputeBatch & batch, PipelineHandle pipeline, const BufferHandle * buffers, uint32_t bufferCount,
+	const void * constants, uint32_t constantSize, uint32_t count )
+{
+	// One workgroup per tile, past MAX_GROUPS_X the tiles wrap to Y and the extra groups exit
+	const uint32_t tileCount = GetTileCount( count );
+	const uint32_t groupsX = std::min( tileCount, MAX_GROUPS_X );
+	const uint32_t groupsY = (tileCount + groupsX - 1) / groupsX;
+	batch.Dispatch( pipeline, buffers, bufferCount, constants, constantSize, groupsX, groupsY );
+}
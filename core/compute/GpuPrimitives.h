@@ -0,0 +1,101 @@
+#pragma once
+#include "ComputeBatch.h"
+
+#include <cstdint>
+#include <vector>
+
+// Kernels of Shaders/primitives, created by the backend (CreateGpuPrimitivePipelinesVulkan())
+struct GpuPrimitivePipelines
+{
+	PipelineHandle scanTiles;
+	PipelineHandle scanAdd;
+	PipelineHandle reduce;
+	PipelineHandle compactScatter;
+	PipelineHandle radixHistogram[2];	// indexed by SortKeyWidth
+	PipelineHandle radixScatter[2];
+};
+
+enum class SortKeyWidth
+{
+	Bits32 = 0,
+	Bits64,
+};
+
+// Data-parallel building blocks on uint32 elements, recorded into a ComputeBatch: prefix sums,
+// reduction, stream compaction and a stable LSD radix sort of key-value pairs. Inputs are split in
+// tiles of TILE_SIZE elements, one per workgroup; the per-tile results are scanned or reduced again,
+// level after level, until one tile is left.
+// Calls recorded into the same batch run in order: each one ends with a barrier on what it wrote,
+// scratch included. Buffers must be created with BufferUsageStorage, and no larger than the device's
+// maxStorageBufferRange.
+class GpuPrimitives
+{
+public:
+	static constexpr uint32_t GROUP_SIZE = 256;
+	static constexpr uint32_t ITEMS_PER_THREAD = 4;
+	static constexpr uint32_t TILE_SIZE = GROUP_SIZE * ITEMS_PER_THREAD;
+	static constexpr uint32_t RADIX_BITS = 8;
+	static constexpr uint32_t RADIX_SIZE = 1 << RADIX_BITS;
+	static constexpr uint32_t MAX_GROUPS_X = 65535;	// guaranteed maxComputeWorkGroupCount[0]
+
+public:
+	GpuPrimitives( IDevice3D & device, const GpuPrimitivePipelines & pipelines );
+	~GpuPrimitives();
+
+	GpuPrimitives( const GpuPrimitives & ) = delete;
+	GpuPrimitives & operator=( const GpuPrimitives & ) = delete;
+
+	// Allocates the scratch of every call on up to maxCount elements
+	void Init( uint32_t maxCount );
+	void Destroy();
+
+	// in and out may be the same buffer
+	void ExclusiveScan( ComputeBatch & batch, BufferHandle in, BufferHandle out, uint32_t count );
+	void InclusiveScan( ComputeBatch & batch, BufferHandle in, BufferHandle out, uint32_t count );
+	// Sum of the elements, wrapping, written to the first element of out
+	void Reduce( ComputeBatch & batch, BufferHandle in, BufferHandle out, uint32_t count );
+	// Keeps values[i] where flags[i] != 0, in order; their count is written to the first element of outCount
+	void Compact( ComputeBatch & batch, BufferHandle values, BufferHandle flags, BufferHandle out, BufferHandle outCount, uint32_t count );
+	// Ascending and stable, in place: uint32 or uint64 keys, uint32 values. RADIX_BITS per pass.
+	void SortKeyValue( ComputeBatch & batch, BufferHandle keys, BufferHandle values, uint32_t count, SortKeyWidth width );
+
+	uint32_t GetMaxCount() const { return m_maxCount; }
+
+	static uint32_t GetTileCount( uint32_t count ) { return (count + TILE_SIZE - 1) / TILE_SIZE; }
+
+private:
+	enum ScanFlags : uint32_t
+	{
+		ScanExclusive = 1 << 0,
+		ScanPredicate = 1 << 1,	// scans (value != 0), see compaction
+	};
+
+	struct ScanConstants
+	{
+		uint32_t count;
+		uint32_t flags;
+	};
+
+	struct RadixConstants
+	{
+		uint32_t count;
+		uint32_t shift;
+		uint32_t tileCount;
+	};
+
+	BufferHandle CreateScratch( uint64_t size );
+	void Scan( ComputeBatch & batch, BufferHandle in, BufferHandle out, uint32_t count, uint32_t flags, uint32_t level );
+	void Dispatch( ComputeBatch & batch, PipelineHandle pipeline, const BufferHandle * buffers, uint32_t bufferCount,
+		const void * constants, uint32_t constantSize, uint32_t count );
+
+private:
+	IDevice3D & m_device;
+	GpuPrimitivePipelines m_pipelines;
+	uint32_t m_maxCount = 0;
+
+	std::vector<BufferHandle> m_tileSums;	// one per level, the tile totals of the level below
+	BufferHandle m_offsets;		// compaction
+	BufferHandle m_histogram;	// radix sort, RADIX_SIZE counters per tile
+	BufferHandle m_sortKeys;	// radix sort ping-pong
+	BufferHandle m_sortValues;
+};
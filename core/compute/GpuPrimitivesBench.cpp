@@ -0,0 +1,277 @@
+#include <stdafx.h>
+#include "GpuPrimitivesBench.h"
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <numeric>
+#include <ostream>
+#include <random>
+
+namespace
+{
+	enum Primitive
+	{
+		PrimitiveExclusiveScan = 0,
+		PrimitiveInclusiveScan,
+		PrimitiveReduce,
+		PrimitiveCompact,
+		PrimitiveSort32,
+		PrimitiveSort64,
+
+		PrimitiveCount,
+	};
+
+	const char * PRIMITIVE_NAMES[] = { "exclusive_scan", "inclusive_scan", "reduce", "compact", "sort_kv32", "sort_kv64" };
+	static_assert( sizeof( PRIMITIVE_NAMES ) / sizeof( PRIMITIVE_NAMES[0] ) == PrimitiveCount, "PRIMITIVE_NAMES must match Primitive" );
+
+	// Bytes every primitive reads and writes per element, at the least: what GB/s is reported against
+	const uint32_t PRIMITIVE_BYTES[] = { 8, 8, 4, 16, 16, 24 };
+	static_assert( sizeof( PRIMITIVE_BYTES ) / sizeof( PRIMITIVE_BYTES[0] ) == PrimitiveCount, "PRIMITIVE_BYTES must match Primitive" );
+
+	// Every buffer of one element count, host copies included
+	class BenchData
+	{
+	public:
+		BenchData( IDevice3D & device, uint32_t count )
+			: m_device( device )
+			, m_count( count )
+		{
+			// Keys are up to 64-bit, everything else is uint32
+			const uint64_t sizes[] = { (uint64_t)count * sizeof( uint64_t ), (uint64_t)count * sizeof( uint32_t ), sizeof( uint32_t ), (uint64_t)count * sizeof( uint32_t ) };
+			static_assert( sizeof( sizes ) / sizeof( sizes[0] ) == sizeof( m_buffers ) / sizeof( m_buffers[0] ), "one size per buffer" );
+			BufferDesc storageDesc;
+			storageDesc.usage = BufferUsageStorage | BufferUsageTransferSrc | BufferUsageTransferDst;
+			for ( uint32_t i = 0; i < sizeof( sizes ) / sizeof( sizes[0] ); ++i )
+			{
+				storageDesc.size = sizes[i];
+				m_buffers[i] = device.CreateBuffer( storageDesc );
+			}
+
+			BufferDesc stagingDesc;
+			stagingDesc.size = sizes[0];
+			stagingDesc.usage = BufferUsageTransferSrc;
+			stagingDesc.memory = MemoryUsage::Upload;
+			m_upload = device.CreateBuffer( stagingDesc );
+
+			stagingDesc.usage = BufferUsageTransferDst;
+			stagingDesc.memory = MemoryUsage::Readback;
+			m_readback = device.CreateBuffer( stagingDesc );
+
+			std::mt19937_64 random( count );
+			m_keys.resize( count );
+			m_values.resize( count );
+			m_flags.resize( count );
+			for ( uint32_t i = 0; i < count; ++i )
+			{
+				m_keys[i] = random();
+				m_values[i] = (uint32_t)m_keys[i] & 0xFFFF;
+				m_flags[i] = (uint32_t)(m_keys[i] >> 16) & 1;
+			}
+		}
+
+		~BenchData()
+		{
+			for ( BufferHandle buffer : m_buffers )
+			{
+				m_device.DestroyBuffer( buffer );
+			}
+			m_device.DestroyBuffer( m_upload );
+			m_device.DestroyBuffer( m_readback );
+		}
+
+		BufferHandle Get( uint32_t index ) const { return m_buffers[index]; }
+
+		// Inputs: values, compaction flags, key-value pairs with the element index as value
+		void Upload( ComputeBatch & batch, Primitive primitive )
+		{
+			uint8_t * mapped = static_cast<uint8_t *>( m_device.GetMappedBuffer( m_upload ) );
+			if ( primitive == PrimitiveSort32 || primitive == PrimitiveSort64 )
+			{
+				const uint32_t keySize = primitive == PrimitiveSort64 ? 8 : 4;
+				for ( uint32_t i = 0; i < m_count; ++i )
+				{
+					memcpy( mapped + (uint64_t)i * keySize, &m_keys[i], keySize );
+				}
+				batch.Upload( m_upload, 0, m_buffers[0], 0, (uint64_t)m_count * keySize );
+				batch.Wait( batch.Submit() );
+
+				uint32_t * indices = reinterpret_cast<uint32_t *>( mapped );
+				std::iota( indices, indices + m_count, 0u );
+				batch.Upload( m_upload, 0, m_buffers[1], 0, (uint64_t)m_count * sizeof( uint32_t ) );
+			}
+			else
+			{
+				memcpy( mapped, m_values.data(), (uint64_t)m_count * sizeof( uint32_t ) );
+				batch.Upload( m_upload, 0, m_buffers[0], 0, (uint64_t)m_count * sizeof( uint32_t ) );
+				if ( primitive == PrimitiveCompact )
+				{
+					batch.Wait( batch.Submit() );
+					memcpy( mapped, m_flags.data(), (uint64_t)m_count * sizeof( uint32_t ) );
+					batch.Upload( m_upload, 0, m_buffers[3], 0, (uint64_t)m_count * sizeof( uint32_t ) );
+				}
+			}
+			batch.Wait( batch.Submit() );
+		}
+
+		void Record( GpuPrimitives & primitives, ComputeBatch & batch, Primitive primitive )
+		{
+			switch ( primitive )
+			{
+			case PrimitiveExclusiveScan:
+				primitives.ExclusiveScan( batch, m_buffers[0], m_buffers[1], m_count );
+				break;
+			case PrimitiveInclusiveScan:
+				primitives.InclusiveScan( batch, m_buffers[0], m_buffers[1], m_count );
+				break;
+			case PrimitiveReduce:
+				primitives.Reduce( batch, m_buffers[0], m_buffers[1], m_count );
+				break;
+			case PrimitiveCompact:
+				primitives.Compact( batch, m_buffers[0], m_buffers[3], m_buffers[1], m_buffers[2], m_count );
+				break;
+			case PrimitiveSort32:
+				primitives.SortKeyValue( batch, m_buffers[0], m_buffers[1], m_count, SortKeyWidth::Bits32 );
+				break;
+			case PrimitiveSort64:
+				primitives.SortKeyValue( batch, m_buffers[0], m_buffers[1], m_count, SortKeyWidth::Bits64 );
+				break;
+			default:
+				break;
+			}
+		}
+
+		bool Validate( ComputeBatch & batch, Primitive primitive )
+		{
+			std::vector<uint32_t> expected;
+			switch ( primitive )
+			{
+			case PrimitiveExclusiveScan:
+				expected.resize( m_count );
+				std::partial_sum( m_values.begin(), m_values.end() - 1, expected.begin() + 1 );
+				expected[0] = 0;
+				return Compare( batch, m_buffers[1], expected );
+			case PrimitiveInclusiveScan:
+				expected.resize( m_count );
+				std::partial_sum( m_values.begin(), m_values.end(), expected.begin() );
+				return Compare( batch, m_buffers[1], expected );
+			case PrimitiveReduce:
+				expected.push_back( std::accumulate( m_values.begin(), m_values.end(), 0u ) );
+				return Compare( batch, m_buffers[1], expected );
+			case PrimitiveCompact:
+				for ( uint32_t i = 0; i < m_count; ++i )
+				{
+					if ( m_flags[i] )
+						expected.push_back( m_values[i] );
+				}
+				return Compare( batch, m_buffers[2], std::vector<uint32_t>( 1, (uint32_t)expected.size() ) )
+					&& Compare( batch, m_buffers[1], expected );
+			case PrimitiveSort32:
+			case PrimitiveSort64:
+			{
+				// Stable: equal keys keep the order of their indices
+				const uint64_t keyMask = primitive == PrimitiveSort64 ? ~0ull : 0xFFFFFFFFull;
+				expected.resize( m_count );
+				std::iota( expected.begin(), expected.end(), 0u );
+				std::stable_sort( expected.begin(), expected.end(), [&]( uint32_t a, uint32_t b ) {
+					return (m_keys[a] & keyMask) < (m_keys[b] & keyMask);
+				} );
+				return Compare( batch, m_buffers[1], expected );
+			}
+			default:
+				return false;
+			}
+		}
+
+	private:
+		bool Compare( ComputeBatch & batch, BufferHandle buffer, const std::vector<uint32_t> & expected )
+		{
+			const uint64_t size = expected.size() * sizeof( uint32_t );
+			if ( size == 0 )
+				return true;
+
+			batch.Download( buffer, 0, m_readback, 0, size );
+			batch.Wait( batch.Submit() );
+			m_device.InvalidateMappedBuffer( m_readback );
+			return memcmp( m_device.GetMappedBuffer( m_readback ), expected.data(), size ) == 0;
+		}
+
+	private:
+		IDevice3D & m_device;
+		uint32_t m_count;
+		BufferHandle m_buffers[4];	// inputs, outputs, output count, compaction flags
+		BufferHandle m_upload;
+		BufferHandle m_readback;
+		std::vector<uint64_t> m_keys;
+		std::vector<uint32_t> m_values;
+		std::vector<uint32_t> m_flags;
+	};
+}
+
+bool RunGpuPrimitivesBench( IDevice3D & device, const GpuPrimitivePipelines & pipelines, const GpuPrimitivesBenchDesc & desc, std::ostream & out )
+{
+	bool passed = true;
+	ComputeBatch batch( device );
+	GpuPrimitives primitives( device, pipelines );
+	// Begin and end of the recorded primitive, invalid when the compute queue has no timestamps
+	const QueryPoolHandle timestamps = device.CreateTimestampQueries( IDevice3D::ComputeQueue, 2 );
+
+	out << std::fixed << std::setprecision( 3 );
+	if ( !timestamps.IsValid() )
+		out << "no GPU timestamps on the compute queue, throughput is computed from the wall time\n";
+	out << std::left << std::setw( 16 ) << "primitive" << std::right << std::setw( 12 ) << "count"
+		<< std::setw( 12 ) << "gpu_ms" << std::setw( 12 ) << "wall_ms" << std::setw( 12 ) << "Melem/s" << std::setw( 10 ) << "GB/s" << "  result\n";
+	for ( uint64_t count = desc.minCount; count <= desc.maxCount; count *= 10 )
+	{
+		// The sort scratch holds 64-bit keys, the largest buffer of all
+		if ( count * sizeof( uint64_t ) > desc.maxBufferSize )
+		{
+			out << "skipped " << count << " elements and up: buffers over the " << desc.maxBufferSize << " bytes limit\n";
+			break;
+		}
+
+		primitives.Init( (uint32_t)count );
+		BenchData data( device, (uint32_t)count );
+		for ( uint32_t primitive = 0; primitive < PrimitiveCount; ++primitive )
+		{
+			// Wall time adds recording, submission and the wait to the GPU time, on small counts it is mostly that
+			double bestWallMs = 0.0;
+			double bestGpuMs = -1.0;
+			for ( uint32_t run = 0; run < desc.runCount; ++run )
+			{
+				// Inputs are uploaded outside of the timing, the sort overwrites its own
+				data.Upload( batch, (Primitive)primitive );
+
+				const auto start = std::chrono::steady_clock::now();
+				if ( timestamps.IsValid() )
+					batch.WriteTimestamp( timestamps, 0 );
+				data.Record( primitives, batch, (Primitive)primitive );
+				if ( timestamps.IsValid() )
+					batch.WriteTimestamp( timestamps, 1 );
+				batch.Wait( batch.Submit() );
+				const double wallMs = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+				bestWallMs = run == 0 ? wallMs : std::min( bestWallMs, wallMs );
+
+				const double gpuMs = timestamps.IsValid() ? device.GetTimestampDeltaMs( timestamps, 0, 1 ) : -1.0;
+				if ( gpuMs >= 0.0 )
+					bestGpuMs = bestGpuMs < 0.0 ? gpuMs : std::min( bestGpuMs, gpuMs );
+			}
+
+			const bool valid = data.Validate( batch, (Primitive)primitive );
+			passed = passed && valid;
+
+			const double seconds = (bestGpuMs >= 0.0 ? bestGpuMs : bestWallMs) / 1000.0;
+			out << std::left << std::setw( 16 ) << PRIMITIVE_NAMES[primitive] << std::right << std::setw( 12 ) << count;
+			if ( bestGpuMs >= 0.0 )
+				out << std::setw( 12 ) << bestGpuMs;
+			else
+				out << std::setw( 12 ) << "-";
+			out << std::setw( 12 ) << bestWallMs << std::setw( 12 ) << count / seconds / 1e6
+				<< std::setw( 10 ) << count * PRIMITIVE_BYTES[primitive] / seconds / 1e9 << "  " << (valid ? "ok" : "MISMATCH") << "\n";
+		}
+	}
+	device.DestroyQueries( timestamps );
+	primitives.Destroy();
+	out << std::defaultfloat;
+	return passed;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include "GpuPrimitives.h"
+
+#include <iosfwd>
+
+struct GpuPrimitivesBenchDesc
+{
+	uint32_t minCount = 1000;
+	uint32_t maxCount = 100 * 1000 * 1000;	// element counts go up tenfold from minCount
+	uint32_t runCount = 5;					// the fastest run is reported
+	uint64_t maxBufferSize = ~0ull;			// larger sizes are skipped, see maxStorageBufferRange
+};
+
+// Times every primitive on growing element counts, one submission per run, and checks the last
+// run against a CPU reference. GPU time comes from timestamps around the dispatches and is what
+// throughput is computed from; the wall time of the submission is reported beside it. Needs a device that executes compute work: on the null device
+// everything is recorded and submitted but nothing validates.
+// Returns false when a result does not match its reference.
+bool RunGpuPrimitivesBench( IDevice3D & device, const GpuPrimitivePipelines & pipelines, const GpuPrimitivesBenchDesc & desc, std::ostream & out );
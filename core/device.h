@@ -1,4 +1,66 @@
 #pragma once
+#include "HandlePool.h"
+
+#include <cstdint>
+
+class CommandList;
+
+// Backend-agnostic resource handles, resolved by the device that created them
+typedef Handle<struct BufferTag> BufferHandle;
+typedef Handle<struct ImageTag> ImageHandle;
+typedef Handle<struct PipelineTag> PipelineHandle;
+typedef Handle<struct QueueTag> QueueHandle;
+typedef Handle<struct QueryPoolTag> QueryPoolHandle;
+
+enum BufferUsageFlags
+{
+	BufferUsageVertex = 1 << 0,
+	BufferUsageIndex = 1 << 1,
+	BufferUsageUniform = 1 << 2,
+	BufferUsageStorage = 1 << 3,
+	BufferUsageTransferSrc = 1 << 4,
+	BufferUsageTransferDst = 1 << 5,
+};
+
+enum class MemoryUsage
+{
+	GpuOnly = 0,	// device local
+	Upload,			// host visible, written by the CPU every frame
+	Readback,		// host visible and cached, read back by the CPU
+};
+
+struct BufferDesc
+{
+	uint64_t size = 0;
+	uint32_t usage = 0;	// BufferUsageFlags
+	MemoryUsage memory = MemoryUsage::GpuOnly;
+};
+
+enum class ImageFormat
+{
+	RGBA8 = 0,
+	BGRA8,
+	RGBA16F,
+	D32F,
+};
+
+enum ImageUsageFlags
+{
+	ImageUsageSampled = 1 << 0,
+	ImageUsageStorage = 1 << 1,
+	ImageUsageColorTarget = 1 << 2,
+	ImageUsageDepthTarget = 1 << 3,
+	ImageUsageTransferSrc = 1 << 4,
+	ImageUsageTransferDst = 1 << 5,
+};
+
+struct ImageDesc
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	ImageFormat format = ImageFormat::RGBA8;
+	uint32_t usage = 0;	// ImageUsageFlags
+};
 
 class IDevice3D
 {
@@ -14,7 +76,35 @@ public:
 	};
 
 public:
+	virtual ~IDevice3D() {}
+
 	virtual void Init() = 0;
 	virtual void Destroy() = 0;
 
-};
\ No newline at end of file
+	// Several queue types can resolve to the same handle when they share a queue
+	virtual QueueHandle GetQueue( QueueType type ) const = 0;
+
+	virtual BufferHandle CreateBuffer( const BufferDesc & desc ) = 0;
+	virtual void DestroyBuffer( BufferHandle buffer ) = 0;
+	// Persistent CPU mapping of Upload and Readback buffers, nullptr for GpuOnly ones
+	virtual void * GetMappedBuffer( BufferHandle buffer ) const = 0;
+	// Makes GPU writes to a Readback buffer visible to the mapping, once the writing submission is complete
+	virtual void InvalidateMappedBuffer( BufferHandle buffer ) = 0;
+	virtual ImageHandle CreateImage( const ImageDesc & desc ) = 0;
+	virtual void DestroyImage( ImageHandle image ) = 0;
+	virtual void DestroyPipeline( PipelineHandle pipeline ) = 0;
+
+	// Translates the lists in order into one submission on the queue, returns its serial.
+	// Lists can be recorded on any thread; Submit itself is serialized by the device.
+	virtual uint64_t Submit( QueueType type, const CommandList * const * lists, uint32_t count ) = 0;
+	virtual bool IsComplete( QueueType type, uint64_t serial ) const = 0;
+	virtual void WaitComplete( QueueType type, uint64_t serial ) = 0;
+
+	// GPU timestamps written by CommandList::WriteTimestamp() in submissions on the queue.
+	// Invalid handle when the queue cannot time its work.
+	virtual QueryPoolHandle CreateTimestampQueries( QueueType type, uint32_t count ) = 0;
+	virtual void DestroyQueries( QueryPoolHandle pool ) = 0;
+	// Milliseconds from timestamp begin to end, once their submission completed; negative when unavailable
+	virtual double GetTimestampDeltaMs( QueryPoolHandle pool, uint32_t begin, uint32_t end ) = 0;
+
+};
@@ -0,0 +1,248 @@
+#include <stdafx.h>
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::OpenRead( const std::string & path )
+{
+	return Map( path, 0, false );
+}
+
+bool MappedFile::OpenWrite( const std::string & path, size_t size )
+{
+	assert( size > 0 );
+	return Map( path, size, true );
+}
+
+bool MappedFile::OpenReadWrite( const std::string & path )
+{
+	return Map( path, 0, true );
+}
+
+#ifdef _WIN32
+bool MappedFile::Map( const std::string & path, size_t size, bool writable )
+{
+	Close();
+
+	const DWORD access = writable ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ;
+	const DWORD disposition = size ? OPEN_ALWAYS : OPEN_EXISTING;
+	HANDLE file = CreateFileA( path.c_str(), access, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, disposition, FILE_ATTRIBUTE_NORMAL, nullptr );
+	if ( file == INVALID_HANDLE_VALUE )
+		return false;
+
+	if ( size == 0 )
+	{
+		LARGE_INTEGER fileSize = {};
+		GetFileSizeEx( file, &fileSize );
+		size = (size_t)fileSize.QuadPart;
+	}
+
+	if ( size == 0 )
+	{
+		CloseHandle( file );
+		return false;
+	}
+
+	const DWORD sizeHigh = (DWORD)( (uint64_t)size >> 32 );
+	const DWORD sizeLow = (DWORD)( (uint64_t)size & 0xFFFFFFFF );
+	HANDLE mapping = CreateFileMappingA( file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, sizeHigh, sizeLow, nullptr );
+	if ( mapping == nullptr )
+	{
+		CloseHandle( file );
+		return false;
+	}
+
+	void * data = MapViewOfFile( mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size );
+	if ( data == nullptr )
+	{
+		CloseHandle( mapping );
+		CloseHandle( file );
+		return false;
+	}
+
+	m_file = file;
+	m_mapping = mapping;
+	m_data = data;
+	m_size = size;
+	return true;
+}
+
+bool MappedFile::CreateShared( const std::string & name, size_t size )
+{
+	assert( size > 0 );
+	Close();
+
+	const DWORD sizeHigh = (DWORD)( (uint64_t)size >> 32 );
+	const DWORD sizeLow = (DWORD)( (uint64_t)size & 0xFFFFFFFF );
+	const std::string mappingName = "Local\\" + name;
+	HANDLE mapping = CreateFileMappingA( INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, sizeHigh, sizeLow, mappingName.c_str() );
+	if ( mapping == nullptr )
+		return false;
+	if ( GetLastError() == ERROR_ALREADY_EXISTS )
+	{
+		CloseHandle( mapping );
+		return false;
+	}
+
+	void * data = MapViewOfFile( mapping, FILE_MAP_WRITE, 0, 0, size );
+	if ( data == nullptr )
+	{
+		CloseHandle( mapping );
+		return false;
+	}
+
+	// The mapping goes away with its last handle, there is no name to remove
+	m_mapping = mapping;
+	m_data = data;
+	m_size = size;
+	return true;
+}
+
+bool MappedFile::OpenShared( const std::string & name )
+{
+	Close();
+
+	const std::string mappingName = "Local\\" + name;
+	HANDLE mapping = OpenFileMappingA( FILE_MAP_WRITE, FALSE, mappingName.c_str() );
+	if ( mapping == nullptr )
+		return false;
+
+	void * data = MapViewOfFile( mapping, FILE_MAP_WRITE, 0, 0, 0 );
+	if ( data == nullptr )
+	{
+		CloseHandle( mapping );
+		return false;
+	}
+
+	MEMORY_BASIC_INFORMATION info = {};
+	VirtualQuery( data, &info, sizeof( info ) );
+
+	m_mapping = mapping;
+	m_data = data;
+	m_size = info.RegionSize;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if ( m_data )
+		UnmapViewOfFile( m_data );
+	if ( m_mapping )
+		CloseHandle( m_mapping );
+	if ( m_file )
+		CloseHandle( m_file );
+
+	m_data = nullptr;
+	m_mapping = nullptr;
+	m_file = nullptr;
+	m_size = 0;
+}
+#else
+bool MappedFile::Map( const std::string & path, size_t size, bool writable )
+{
+	Close();
+
+	int fd = open( path.c_str(), writable ? (size ? (O_RDWR | O_CREAT) : O_RDWR) : O_RDONLY, 0644 );
+	if ( fd < 0 )
+		return false;
+
+	return MapDescriptor( fd, size, writable );
+}
+
+bool MappedFile::CreateShared( const std::string & name, size_t size )
+{
+	assert( size > 0 );
+	Close();
+
+	const std::string shmName = "/" + name;
+	int fd = shm_open( shmName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600 );
+	if ( fd < 0 )
+		return false;
+
+	if ( !MapDescriptor( fd, size, true ) )
+	{
+		shm_unlink( shmName.c_str() );
+		return false;
+	}
+	m_sharedName = shmName;
+	return true;
+}
+
+bool MappedFile::OpenShared( const std::string & name )
+{
+	Close();
+
+	const std::string shmName = "/" + name;
+	int fd = shm_open( shmName.c_str(), O_RDWR, 0600 );
+	if ( fd < 0 )
+		return false;
+
+	return MapDescriptor( fd, 0, true );
+}
+
+// Takes ownership of fd. A size of 0 maps the object at its current size.
+bool MappedFile::MapDescriptor( int fd, size_t size, bool writable )
+{
+	if ( size > 0 )
+	{
+		if ( ftruncate( fd, (off_t)size ) != 0 )
+		{
+			close( fd );
+			return false;
+		}
+	}
+	else
+	{
+		struct stat st = {};
+		fstat( fd, &st );
+		size = (size_t)st.st_size;
+	}
+
+	if ( size == 0 )
+	{
+		close( fd );
+		return false;
+	}
+
+	void * data = mmap( nullptr, size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0 );
+	if ( data == MAP_FAILED )
+	{
+		close( fd );
+		return false;
+	}
+
+	m_fd = fd;
+	m_data = data;
+	m_size = size;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if ( m_data )
+		munmap( m_data, m_size );
+	if ( m_fd >= 0 )
+		close( m_fd );
+	if ( !m_sharedName.empty() )
+		shm_unlink( m_sharedName.c_str() );
+
+	m_data = nullptr;
+	m_fd = -1;
+	m_size = 0;
+	m_sharedName.clear();
+}
+#endif
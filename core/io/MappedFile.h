@@ -0,0 +1,46 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+// Read-only or read-write view of a whole file mapped in the address space, or of a named
+// shared-memory segment (POSIX shm, a pagefile-backed mapping on Windows).
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile( const MappedFile & ) = delete;
+	MappedFile & operator=( const MappedFile & ) = delete;
+	~MappedFile();
+
+	bool OpenRead( const std::string & path );
+	bool OpenWrite( const std::string & path, size_t size );
+	// Existing file, at its current size
+	bool OpenReadWrite( const std::string & path );
+	// Creates the segment, fails when the name already exists rather than taking over another
+	// process's segment. Close() removes the name; processes that mapped it keep their view.
+	bool CreateShared( const std::string & name, size_t size );
+	// Read-write view of a segment another process created
+	bool OpenShared( const std::string & name );
+	void Close();
+
+	void * Data() const { return m_data; }
+	size_t Size() const { return m_size; }
+	bool IsOpen() const { return m_data != nullptr; }
+
+private:
+	bool Map( const std::string & path, size_t size, bool writable );
+#ifndef _WIN32
+	bool MapDescriptor( int fd, size_t size, bool writable );
+#endif
+
+private:
+	void * m_data = nullptr;
+	size_t m_size = 0;
+	std::string m_sharedName;	// set while a segment created here is open
+#ifdef _WIN32
+	void * m_file = nullptr;
+	void * m_mapping = nullptr;
+#else
+	int m_fd = -1;
+#endif
+};
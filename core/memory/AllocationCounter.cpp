@@ -0,0 +1,312 @@
+#include <stdafx.h>
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <ostream>
+
+#if defined( ALLOCATION_COUNTER ) && defined( _WIN32 ) && defined( _DEBUG )
+#include <crtdbg.h>
+#endif
+
+namespace
+{
+	struct ScopeCounters
+	{
+		std::atomic<uint64_t> count;
+		std::atomic<uint64_t> bytes;
+	};
+
+	// Plain types only: all of this is touched from malloc and operator new, possibly before any static constructor ran
+	ScopeCounters s_scopes[(int)AllocationScope::Count];
+	std::atomic<uint64_t> s_totalCount;
+	thread_local uint64_t s_threadCount = 0;
+	thread_local AllocationScope s_currentScope = AllocationScope::Untagged;
+
+	const char * s_scopeNames[] = {
+		"untagged",
+		"init",
+		"swapchain",
+		"frame",
+		"upload",
+	};
+	static_assert( sizeof( s_scopeNames ) / sizeof( *s_scopeNames ) == (size_t)AllocationScope::Count, "missing scope name" );
+
+#ifdef ALLOCATION_COUNTER
+	void RecordAllocation( size_t size )
+	{
+		++s_threadCount;
+		s_totalCount.fetch_add( 1, std::memory_order_relaxed );
+		ScopeCounters & scope = s_scopes[(int)s_currentScope];
+		scope.count.fetch_add( 1, std::memory_order_relaxed );
+		scope.bytes.fetch_add( size, std::memory_order_relaxed );
+	}
+#endif
+}
+
+bool AllocationCounter::IsEnabled()
+{
+#ifdef ALLOCATION_COUNTER
+	return true;
+#else
+	return false;
+#endif
+}
+
+uint64_t AllocationCounter::GetThreadCount()
+{
+	return s_threadCount;
+}
+
+uint64_t AllocationCounter::GetTotalCount()
+{
+	return s_totalCount.load( std::memory_order_relaxed );
+}
+
+AllocationStats AllocationCounter::GetScopeStats( AllocationScope scope )
+{
+	AllocationStats stats;
+	stats.count = s_scopes[(int)scope].count.load( std::memory_order_relaxed );
+	stats.bytes = s_scopes[(int)scope].bytes.load( std::memory_order_relaxed );
+	return stats;
+}
+
+AllocationScope AllocationCounter::GetCurrentScope()
+{
+	return s_currentScope;
+}
+
+AllocationScope AllocationCounter::SetCurrentScope( AllocationScope scope )
+{
+	const AllocationScope previous = s_currentScope;
+	s_currentScope = scope;
+	return previous;
+}
+
+const char * AllocationCounter::GetScopeName( AllocationScope scope )
+{
+	return s_scopeNames[(int)scope];
+}
+
+void AllocationCounter::PrintReport( std::ostream & out )
+{
+	if ( !IsEnabled() )
+	{
+		out << "allocation tracking disabled (build with ALLOCATION_COUNTER)" << std::endl;
+		return;
+	}
+
+	for ( int i = 0; i < (int)AllocationScope::Count; ++i )
+	{
+		const AllocationStats stats = GetScopeStats( (AllocationScope)i );
+		out << "  " << s_scopeNames[i] << ": " << stats.count << " allocations, " << stats.bytes << " bytes" << std::endl;
+	}
+}
+
+//
+//
+//	FrameAllocationBudget =========================================================================
+//
+//
+FrameAllocationBudget::FrameAllocationBudget( uint64_t maxCount, uint64_t maxBytes, uint32_t warmupFrames )
+	: m_maxCount( maxCount )
+	, m_maxBytes( maxBytes )
+	, m_warmupFrames( warmupFrames )
+{
+}
+
+void FrameAllocationBudget::BeginFrame()
+{
+	m_frameStart = AllocationCounter::GetScopeStats( AllocationScope::Frame );
+}
+
+AllocationStats FrameAllocationBudget::EndFrame()
+{
+	const AllocationStats end = AllocationCounter::GetScopeStats( AllocationScope::Frame );
+	AllocationStats frame;
+	frame.count = end.count - m_frameStart.count;
+	frame.bytes = end.bytes - m_frameStart.bytes;
+
+	const uint32_t frameIdx = m_frameCount++;
+	if ( frameIdx < m_warmupFrames )
+		return frame;
+
+	m_total.count += frame.count;
+	m_total.bytes += frame.bytes;
+	m_worst.count = std::max( m_worst.count, frame.count );
+	m_worst.bytes = std::max( m_worst.bytes, frame.bytes );
+
+	if ( frame.count > m_maxCount || frame.bytes > m_maxBytes )
+	{
+		if ( m_framesOverBudget++ == 0 )
+			m_firstFrameOverBudget = frameIdx;
+	}
+	return frame;
+}
+
+void FrameAllocationBudget::PrintReport( std::ostream & out ) const
+{
+	const uint32_t measured = m_frameCount > m_warmupFrames ? m_frameCount - m_warmupFrames : 0;
+	out << "frame allocations over " << measured << " steady-state frames: "
+		<< m_total.count << " allocations, " << m_total.bytes << " bytes, worst frame "
+		<< m_worst.count << " allocations / " << m_worst.bytes << " bytes"
+		<< " (budget " << m_maxCount << " / " << m_maxBytes << ")" << std::endl;
+
+	if ( IsExceeded() )
+	{
+		out << "  budget exceeded in " << m_framesOverBudget << " frames, first at frame " << m_firstFrameOverBudget << std::endl;
+	}
+}
+
+//
+//
+//	Allocation hooks ==============================================================================
+//
+//
+#ifdef ALLOCATION_COUNTER
+
+#if defined( __GLIBC__ )
+
+// Interposes the C allocator: the executable's definitions take precedence over libc's,
+// and forward to the real implementation through glibc's __libc_* entry points.
+extern "C"
+{
+	void * __libc_malloc( size_t size );
+	void * __libc_calloc( size_t count, size_t size );
+	void * __libc_realloc( void * ptr, size_t size );
+	void __libc_free( void * ptr );
+
+	void * malloc( size_t size ) noexcept
+	{
+		RecordAllocation( size );
+		return __libc_malloc( size );
+	}
+
+	void * calloc( size_t count, size_t size ) noexcept
+	{
+		RecordAllocation( count * size );
+		return __libc_calloc( count, size );
+	}
+
+	void * realloc( void * ptr, size_t size ) noexcept
+	{
+		RecordAllocation( size );
+		return __libc_realloc( ptr, size );
+	}
+
+	void free( void * ptr ) noexcept
+	{
+		__libc_free( ptr );
+	}
+}
+
+namespace
+{
+	// operator new counts once and bypasses the interposed malloc
+	void * RawAlloc( size_t size ) { return __libc_malloc( size ); }
+	void RawFree( void * ptr ) { __libc_free( ptr ); }
+}
+
+#else
+
+namespace
+{
+#if defined( _WIN32 ) && defined( _DEBUG )
+	// Set while operator new is in the CRT, so the hook does not count its allocation a second time
+	thread_local bool s_inOperatorNew = false;
+
+	int __cdecl CrtAllocHook( int allocType, void *, size_t size, int blockType, long, const unsigned char *, int )
+	{
+		if ( blockType != _CRT_BLOCK && !s_inOperatorNew && (allocType == _HOOK_ALLOC || allocType == _HOOK_REALLOC) )
+		{
+			RecordAllocation( size );
+		}
+		return TRUE;
+	}
+
+	struct CrtHookInstaller
+	{
+		CrtHookInstaller() { _CrtSetAllocHook( CrtAllocHook ); }
+	} s_crtHookInstaller;
+
+	void * RawAlloc( size_t size )
+	{
+		s_inOperatorNew = true;
+		void * ptr = std::malloc( size );
+		s_inOperatorNew = false;
+		return ptr;
+	}
+#else
+	void * RawAlloc( size_t size ) { return std::malloc( size ); }
+#endif
+
+	void RawFree( void * ptr ) { std::free( ptr ); }
+}
+
+#endif
+
+namespace
+{
+	void * CountedAlloc( size_t size )
+	{
+		RecordAllocation( size );
+		return RawAlloc( size ? size : 1 );
+	}
+}
+
+void * operator new( size_t size )
+{
+	if ( void * ptr = CountedAlloc( size ) )
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void * operator new[]( size_t size )
+{
+	if ( void * ptr = CountedAlloc( size ) )
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void * operator new( size_t size, const std::nothrow_t & ) noexcept
+{
+	return CountedAlloc( size );
+}
+
+void * operator new[]( size_t size, const std::nothrow_t & ) noexcept
+{
+	return CountedAlloc( size );
+}
+
+void operator delete( void * ptr ) noexcept
+{
+	RawFree( ptr );
+}
+
+void operator delete[]( void * ptr ) noexcept
+{
+	RawFree( ptr );
+}
+
+void operator delete( void * ptr, size_t ) noexcept
+{
+	RawFree( ptr );
+}
+
+void operator delete[]( void * ptr, size_t ) noexcept
+{
+	RawFree( ptr );
+}
+
+void operator delete( void * ptr, const std::nothrow_t & ) noexcept
+{
+	RawFree( ptr );
+}
+
+void operator delete[]( void * ptr, const std::nothrow_t & ) noexcept
+{
+	RawFree( ptr );
+}
+
+#endif
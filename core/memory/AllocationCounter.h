@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <iosfwd>
+
+// Engine phase an allocation is attributed to. The scope is per thread, set with AllocationScopeGuard.
+enum class AllocationScope
+{
+	Untagged = 0,
+	Init,
+	SwapChain,
+	Frame,
+	Upload,
+	Count,
+};
+
+struct AllocationStats
+{
+	uint64_t count = 0;
+	uint64_t bytes = 0;
+};
+
+// Counts heap allocations: global operator new, plus malloc/calloc/realloc through an interposer
+// (glibc symbol interposition, the CRT allocation hook in Windows debug builds).
+// Built in when ALLOCATION_COUNTER is defined, otherwise every count stays at zero and IsEnabled() says so.
+namespace AllocationCounter
+{
+	bool IsEnabled();
+
+	// Allocations made by the calling thread since it started
+	uint64_t GetThreadCount();
+	// Allocations made by every thread
+	uint64_t GetTotalCount();
+	AllocationStats GetScopeStats( AllocationScope scope );
+
+	AllocationScope GetCurrentScope();
+	// Returns the scope it replaces
+	AllocationScope SetCurrentScope( AllocationScope scope );
+	const char * GetScopeName( AllocationScope scope );
+
+	void PrintReport( std::ostream & out );
+}
+
+class AllocationScopeGuard
+{
+public:
+	explicit AllocationScopeGuard( AllocationScope scope ) : m_previous( AllocationCounter::SetCurrentScope( scope ) ) {}
+	~AllocationScopeGuard() { AllocationCounter::SetCurrentScope( m_previous ); }
+
+	AllocationScopeGuard( const AllocationScopeGuard & ) = delete;
+	AllocationScopeGuard & operator=( const AllocationScopeGuard & ) = delete;
+
+private:
+	AllocationScope m_previous;
+};
+
+// Per-frame allocation budget for the steady-state loop. Measures what every thread allocated in the
+// Frame scope between BeginFrame() and EndFrame(); the first warmupFrames are not checked.
+// A benchmark run fails when IsExceeded() is true at the end.
+class FrameAllocationBudget
+{
+public:
+	FrameAllocationBudget( uint64_t maxCount, uint64_t maxBytes, uint32_t warmupFrames );
+
+	void BeginFrame();
+	AllocationStats EndFrame();
+
+	bool IsExceeded() const { return m_framesOverBudget > 0; }
+	void PrintReport( std::ostream & out ) const;
+
+private:
+	uint64_t m_maxCount;
+	uint64_t m_maxBytes;
+	uint32_t m_warmupFrames;
+	uint32_t m_frameCount = 0;
+	uint32_t m_framesOverBudget = 0;
+	uint32_t m_firstFrameOverBudget = 0;
+	AllocationStats m_frameStart;
+	AllocationStats m_total;
+	AllocationStats m_worst;
+};
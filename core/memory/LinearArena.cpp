@@ -0,0 +1,150 @@
+#include <stdafx.h>
+#include "LinearArena.h"
+
+#include <cstdlib>
+
+namespace
+{
+	const size_t THREAD_LOCAL_CAPACITY = 64 * 1024;
+
+	size_t AlignUp( size_t value, size_t alignment )
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+//
+//
+//	LinearArena ===================================================================================
+//
+//
+LinearArena::LinearArena( size_t capacity )
+	: m_capacity( capacity )
+{
+	if ( capacity > 0 )
+	{
+		m_base = static_cast<char *>( std::malloc( capacity ) );
+		if ( !m_base )
+		{
+			throw std::bad_alloc();
+		}
+	}
+}
+
+LinearArena::~LinearArena()
+{
+	ReleaseOverflow( 0 );
+	std::free( m_base );
+}
+
+void * LinearArena::Allocate( size_t size, size_t alignment )
+{
+	assert( alignment > 0 && (alignment & (alignment - 1)) == 0 );
+
+	// malloc only guarantees max_align_t, align the address rather than the offset
+	const size_t offset = m_base ? AlignUp( reinterpret_cast<size_t>( m_base + m_offset ), alignment ) - reinterpret_cast<size_t>( m_base ) : 0;
+	if ( m_base && offset + size <= m_capacity )
+	{
+		m_offset = offset + size;
+		m_peak = std::max( m_peak, GetUsed() );
+		return m_base + offset;
+	}
+
+	// Out of room: dedicated heap block, kept until the next Reset().
+	// Over-allocated by the alignment, the header stays at the start of the block for free()
+	OverflowBlock * block = static_cast<OverflowBlock *>( std::malloc( sizeof( OverflowBlock ) + alignment - 1 + size ) );
+	if ( !block )
+	{
+		throw std::bad_alloc();
+	}
+	block->next = m_overflow;
+	block->size = size;
+	m_overflow = block;
+	m_overflowBytes += size;
+	++m_overflowCount;
+	m_peak = std::max( m_peak, GetUsed() );
+	return reinterpret_cast<void *>( AlignUp( reinterpret_cast<size_t>( block + 1 ), alignment ) );
+}
+
+void LinearArena::Reset( size_t minCapacity )
+{
+	ReleaseOverflow( 0 );
+	m_offset = 0;
+
+	// Grow to what the last frames needed, with some headroom, so they fit in the main block from now on
+	const size_t needed = std::max( m_peak, minCapacity );
+	if ( needed > m_capacity )
+	{
+		const size_t capacity = AlignUp( needed + needed / 2, 4096 );
+		char * base = static_cast<char *>( std::malloc( capacity ) );
+		if ( base )
+		{
+			std::free( m_base );
+			m_base = base;
+			m_capacity = capacity;
+		}
+	}
+}
+
+void LinearArena::Rewind( const Marker & marker )
+{
+	assert( marker.offset <= m_offset && marker.overflowCount <= m_overflowCount );
+
+	// Back to empty is a reset, which is also where the arena gets a chance to grow
+	if ( marker.offset == 0 && marker.overflowCount == 0 )
+	{
+		Reset();
+		return;
+	}
+	ReleaseOverflow( marker.overflowCount );
+	m_offset = marker.offset;
+}
+
+LinearArena & LinearArena::ThreadLocal()
+{
+	thread_local LinearArena arena( THREAD_LOCAL_CAPACITY );
+	return arena;
+}
+
+// Blocks are chained newest first, so the ones allocated after a marker are at the head
+void LinearArena::ReleaseOverflow( uint32_t keepCount )
+{
+	while ( m_overflowCount > keepCount )
+	{
+		OverflowBlock * next = m_overflow->next;
+		m_overflowBytes -= m_overflow->size;
+		std::free( m_overflow );
+		m_overflow = next;
+		--m_overflowCount;
+	}
+}
+
+//
+//
+//	FrameArenas ===================================================================================
+//
+//
+FrameArenas::FrameArenas( uint32_t count, size_t capacity )
+{
+	for ( uint32_t i = 0; i < count; ++i )
+	{
+		m_arenas.emplace_back( new LinearArena( capacity ) );
+	}
+}
+
+LinearArena & FrameArenas::BeginFrame( uint64_t frameNumber, size_t minCapacity )
+{
+	LinearArena & arena = GetArena( frameNumber );
+	arena.Reset( std::max( GetPeak(), minCapacity ) );
+	return arena;
+}
+
+size_t FrameArenas::GetPeak() const
+{
+	size_t peak = 0;
+	for ( const auto & arena : m_arenas )
+	{
+		peak = std::max( peak, arena->GetPeak() );
+	}
+	return peak;
+}
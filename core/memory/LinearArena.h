@@ -0,0 +1,138 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <vector>
+
+// Bump allocator for short-lived CPU data. Allocations are never freed one by one,
+// the whole arena is reset at a frame boundary (or rewound to a marker by an ArenaScope).
+// Running out of capacity falls back to heap blocks; the next Reset() grows the main block
+// to the high-water mark, so a steady-state frame ends up making no heap allocation at all.
+class LinearArena
+{
+public:
+	struct Marker
+	{
+		size_t offset;
+		uint32_t overflowCount;
+	};
+
+public:
+	explicit LinearArena( size_t capacity = 0 );
+	~LinearArena();
+
+	LinearArena( const LinearArena & ) = delete;
+	LinearArena & operator=( const LinearArena & ) = delete;
+
+	void * Allocate( size_t size, size_t alignment = alignof( std::max_align_t ) );
+	template<typename T>
+	T * AllocateArray( size_t count ) { return static_cast<T *>( Allocate( sizeof( T ) * count, alignof( T ) ) ); }
+
+	// minCapacity pre-sizes the main block for data this arena has not seen yet, e.g. another frame slot's peak
+	void Reset( size_t minCapacity = 0 );
+	Marker GetMarker() const { return { m_offset, m_overflowCount }; }
+	void Rewind( const Marker & marker );
+
+	size_t GetUsed() const { return m_offset + m_overflowBytes; }
+	size_t GetCapacity() const { return m_capacity; }
+	size_t GetPeak() const { return m_peak; }
+	uint32_t GetOverflowCount() const { return m_overflowCount; }
+
+	// Scratch arena of the calling thread, for data that does not outlive the current call chain
+	static LinearArena & ThreadLocal();
+
+private:
+	struct OverflowBlock
+	{
+		OverflowBlock * next;
+		size_t size;
+	};
+
+	void ReleaseOverflow( uint32_t keepCount );
+
+private:
+	char * m_base = nullptr;
+	size_t m_capacity = 0;
+	size_t m_offset = 0;
+	size_t m_peak = 0;
+	OverflowBlock * m_overflow = nullptr;
+	size_t m_overflowBytes = 0;
+	uint32_t m_overflowCount = 0;
+};
+
+// Rewinds an arena to where it was when the scope was opened
+class ArenaScope
+{
+public:
+	explicit ArenaScope( LinearArena & arena ) : m_arena( arena ), m_marker( arena.GetMarker() ) {}
+	~ArenaScope() { m_arena.Rewind( m_marker ); }
+
+	ArenaScope( const ArenaScope & ) = delete;
+	ArenaScope & operator=( const ArenaScope & ) = delete;
+
+	LinearArena & GetArena() const { return m_arena; }
+
+private:
+	LinearArena & m_arena;
+	LinearArena::Marker m_marker;
+};
+
+// One arena per frame slot, so data built for frame N survives while frame N+1 is being built.
+// count must cover every frame that can still read the data: the frames queued between threads plus the current one.
+class FrameArenas
+{
+public:
+	FrameArenas( uint32_t count, size_t capacity );
+
+	// The slot's arena is grown to the high-water mark of all slots (and at least minCapacity), so a frame
+	// bigger than usual makes every slot grow at its next reuse instead of each one overflowing in turn
+	LinearArena & BeginFrame( uint64_t frameNumber, size_t minCapacity = 0 );
+	LinearArena & GetArena( uint64_t frameNumber ) { return *m_arenas[frameNumber % m_arenas.size()]; }
+	size_t GetPeak() const;
+
+private:
+	std::vector<std::unique_ptr<LinearArena>> m_arenas;
+};
+
+// Standard allocator over an arena: deallocate() is a no-op, memory comes back on reset.
+// Moving a container moves its arena along, which keeps moves allocation free.
+// Without an arena it falls back to the heap, debug STL containers allocate even when default constructed.
+template<typename T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+
+	ArenaAllocator() = default;
+	ArenaAllocator( LinearArena & arena ) : m_arena( &arena ) {}
+	template<typename U>
+	ArenaAllocator( const ArenaAllocator<U> & other ) : m_arena( other.GetArena() ) {}
+
+	T * allocate( size_t count )
+	{
+		return m_arena ? m_arena->AllocateArray<T>( count ) : static_cast<T *>( ::operator new( sizeof( T ) * count ) );
+	}
+	void deallocate( T * ptr, size_t )
+	{
+		if ( !m_arena )
+			::operator delete( ptr );
+	}
+
+	LinearArena * GetArena() const { return m_arena; }
+
+private:
+	LinearArena * m_arena = nullptr;
+};
+
+template<typename T, typename U>
+bool operator==( const ArenaAllocator<T> & a, const ArenaAllocator<U> & b ) { return a.GetArena() == b.GetArena(); }
+template<typename T, typename U>
+bool operator!=( const ArenaAllocator<T> & a, const ArenaAllocator<U> & b ) { return a.GetArena() != b.GetArena(); }
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+template<typename T, typename Compare = std::less<T>>
+using ArenaSet = std::set<T, Compare, ArenaAllocator<T>>;
@@ -0,0 +1,299 @@
+#include <stdafx.h>
+#include "Device3D_null.h"
+
+#include <iomanip>
+#include <ostream>
+
+namespace
+{
+	const char * ENTRY_POINT_NAMES[] = {
+		"Init",
+		"Destroy",
+		"GetQueue",
+		"CreateBuffer",
+		"DestroyBuffer",
+		"GetMappedBuffer",
+		"InvalidateMappedBuffer",
+		"CreateImage",
+		"DestroyImage",
+		"AddPipeline",
+		"DestroyPipeline",
+		"Submit",
+		"IsComplete",
+		"WaitComplete",
+		"CreateTimestampQueries",
+		"DestroyQueries",
+		"GetTimestampDeltaMs",
+	};
+	static_assert( sizeof( ENTRY_POINT_NAMES ) / sizeof( ENTRY_POINT_NAMES[0] ) == Device3DNull::EntryPointCount, "ENTRY_POINT_NAMES must match EntryPoint" );
+}
+
+Device3DNull::Device3DNull()
+{
+	for ( auto & serial : m_submitSerials )
+	{
+		serial.store( 0, std::memory_order_relaxed );
+	}
+}
+
+Device3DNull::~Device3DNull()
+{
+}
+
+void Device3DNull::Init()
+{
+	EntryPointTimer timer( *this, EntryInit );
+
+	for ( int type = 0; type < QueueCount; ++type )
+	{
+		m_queues[type] = QueueHandle( type, 1 );
+	}
+}
+
+void Device3DNull::Destroy()
+{
+	EntryPointTimer timer( *this, EntryDestroy );
+
+	while ( !m_bufferPool.IsEmpty() )
+	{
+		m_bufferPool.Destroy( m_bufferPool.GetHandle( 0 ) );
+	}
+	while ( !m_imagePool.IsEmpty() )
+	{
+		m_imagePool.Destroy( m_imagePool.GetHandle( 0 ) );
+	}
+	while ( !m_pipelinePool.IsEmpty() )
+	{
+		m_pipelinePool.Destroy( m_pipelinePool.GetHandle( 0 ) );
+	}
+	while ( !m_queryPool.IsEmpty() )
+	{
+		m_queryPool.Destroy( m_queryPool.GetHandle( 0 ) );
+	}
+	for ( QueueHandle & queue : m_queues )
+	{
+		queue = QueueHandle();
+	}
+}
+
+QueueHandle Device3DNull::GetQueue( QueueType type ) const
+{
+	EntryPointTimer timer( *this, EntryGetQueue );
+	return m_queues[type];
+}
+
+BufferHandle Device3DNull::CreateBuffer( const BufferDesc & desc )
+{
+	EntryPointTimer timer( *this, EntryCreateBuffer );
+
+	// Only memory the CPU can map needs backing
+	std::unique_ptr<char[]> shadow;
+	if ( desc.memory != MemoryUsage::GpuOnly )
+		shadow.reset( new char[desc.size] );
+	return m_bufferPool.Create( desc, std::move( shadow ) );
+}
+
+void Device3DNull::DestroyBuffer( BufferHandle buffer )
+{
+	EntryPointTimer timer( *this, EntryDestroyBuffer );
+	m_bufferPool.Destroy( buffer );
+}
+
+void * Device3DNull::GetMappedBuffer( BufferHandle buffer ) const
+{
+	EntryPointTimer timer( *this, EntryGetMappedBuffer );
+	return m_bufferPool.Get<BufferShadow>( buffer ).get();
+}
+
+void Device3DNull::InvalidateMappedBuffer( BufferHandle buffer )
+{
+	EntryPointTimer timer( *this, EntryInvalidateMappedBuffer );
+	(void)buffer;
+}
+
+ImageHandle Device3DNull::CreateImage( const ImageDesc & desc )
+{
+	EntryPointTimer timer( *this, EntryCreateImage );
+	return m_imagePool.Create( desc );
+}
+
+void Device3DNull::DestroyImage( ImageHandle image )
+{
+	EntryPointTimer timer( *this, EntryDestroyImage );
+	m_imagePool.Destroy( image );
+}
+
+PipelineHandle Device3DNull::AddPipeline( bool isCompute )
+{
+	EntryPointTimer timer( *this, EntryAddPipeline );
+	return m_pipelinePool.Create( isCompute );
+}
+
+void Device3DNull::DestroyPipeline( PipelineHandle pipeline )
+{
+	EntryPointTimer timer( *this, EntryDestroyPipeline );
+	m_pipelinePool.Destroy( pipeline );
+}
+
+uint64_t Device3DNull::Submit( QueueType type, const CommandList * const * lists, uint32_t count )
+{
+	EntryPointTimer timer( *this, EntrySubmit );
+	std::lock_guard<std::mutex> lock( m_submitMutex );
+
+	// Decode everything and resolve every handle, the part of a backend translation that is not driver work
+	uint64_t invalidCount = 0;
+	for ( uint32_t i = 0; i < count; ++i )
+	{
+		CommandList::Reader reader( *lists[i] );
+		CommandList::Header header;
+		while ( reader.Next( header ) )
+		{
+			++m_commandCounts[(int)header.type];
+
+			bool valid = true;
+			switch ( header.type )
+			{
+			case CommandType::BindPipeline:
+				valid = m_pipelinePool.IsValid( reader.Read<CmdBindPipeline>().pipeline );
+				break;
+			case CommandType::BindVertexBuffer:
+				valid = m_bufferPool.IsValid( reader.Read<CmdBindVertexBuffer>().buffer );
+				break;
+			case CommandType::BindIndexBuffer:
+				valid = m_bufferPool.IsValid( reader.Read<CmdBindIndexBuffer>().buffer );
+				break;
+			case CommandType::BindStorageBuffer:
+				valid = m_bufferPool.IsValid( reader.Read<CmdBindStorageBuffer>().buffer );
+				break;
+			case CommandType::BindStorageImage:
+				valid = m_imagePool.IsValid( reader.Read<CmdBindStorageImage>().image );
+				break;
+			case CommandType::CopyBuffer:
+			{
+				const CmdCopyBuffer copy = reader.Read<CmdCopyBuffer>();
+				valid = m_bufferPool.IsValid( copy.src ) && m_bufferPool.IsValid( copy.dst );
+				break;
+			}
+			case CommandType::CopyBufferToImage:
+			{
+				const CmdCopyBufferToImage copy = reader.Read<CmdCopyBufferToImage>();
+				valid = m_bufferPool.IsValid( copy.src ) && m_imagePool.IsValid( copy.dst );
+				break;
+			}
+			case CommandType::CopyImageToBuffer:
+			{
+				const CmdCopyImageToBuffer copy = reader.Read<CmdCopyImageToBuffer>();
+				valid = m_imagePool.IsValid( copy.src ) && m_bufferPool.IsValid( copy.dst );
+				break;
+			}
+			case CommandType::BufferBarrier:
+				valid = m_bufferPool.IsValid( reader.Read<CmdBufferBarrier>().buffer );
+				break;
+			case CommandType::ImageBarrier:
+				valid = m_imagePool.IsValid( reader.Read<CmdImageBarrier>().image );
+				break;
+			case CommandType::BeginRenderPass:
+				valid = m_imagePool.IsValid( reader.Read<CmdBeginRenderPass>().colorTarget );
+				break;
+			case CommandType::WriteTimestamp:
+			{
+				const CmdWriteTimestamp write = reader.Read<CmdWriteTimestamp>();
+				valid = m_queryPool.IsValid( write.pool ) && write.query < m_queryPool.Get<QueryPoolCount>( write.pool );
+				break;
+			}
+			default:
+				break;
+			}
+			invalidCount += valid ? 0 : 1;
+		}
+		m_submittedBytes += lists[i]->GetByteSize();
+	}
+	m_invalidHandleCount += invalidCount;
+
+	return m_submitSerials[type].fetch_add( 1, std::memory_order_release ) + 1;
+}
+
+bool Device3DNull::IsComplete( QueueType type, uint64_t serial ) const
+{
+	EntryPointTimer timer( *this, EntryIsComplete );
+	return serial <= m_submitSerials[type].load( std::memory_order_acquire );
+}
+
+void Device3DNull::WaitComplete( QueueType type, uint64_t serial )
+{
+	EntryPointTimer timer( *this, EntryWaitComplete );
+	assert( serial <= m_submitSerials[type].load( std::memory_order_acquire ) );
+	(void)type;
+	(void)serial;
+}
+
+QueryPoolHandle Device3DNull::CreateTimestampQueries( QueueType type, uint32_t count )
+{
+	EntryPointTimer timer( *this, EntryCreateTimestampQueries );
+	(void)type;
+	return m_queryPool.Create( count );
+}
+
+void Device3DNull::DestroyQueries( QueryPoolHandle pool )
+{
+	EntryPointTimer timer( *this, EntryDestroyQueries );
+	m_queryPool.Destroy( pool );
+}
+
+double Device3DNull::GetTimestampDeltaMs( QueryPoolHandle pool, uint32_t begin, uint32_t end )
+{
+	EntryPointTimer timer( *this, EntryGetTimestampDeltaMs );
+	(void)pool;
+	(void)begin;
+	(void)end;
+	return -1.0;
+}
+
+Device3DNull::EntryPointStats Device3DNull::GetEntryPointStats( EntryPoint entry ) const
+{
+	EntryPointStats stats;
+	stats.callCount = m_entryPoints[entry].callCount.load( std::memory_order_relaxed );
+	stats.totalNs = m_entryPoints[entry].totalNs.load( std::memory_order_relaxed );
+	return stats;
+}
+
+const char * Device3DNull::GetEntryPointName( EntryPoint entry )
+{
+	return ENTRY_POINT_NAMES[entry];
+}
+
+void Device3DNull::ResetStats()
+{
+	std::lock_guard<std::mutex> lock( m_submitMutex );
+	for ( AtomicStats & stats : m_entryPoints )
+	{
+		stats.callCount.store( 0, std::memory_order_relaxed );
+		stats.totalNs.store( 0, std::memory_order_relaxed );
+	}
+	for ( uint64_t & count : m_commandCounts )
+	{
+		count = 0;
+	}
+	m_submittedBytes = 0;
+	m_invalidHandleCount = 0;
+}
+
+void Device3DNull::PrintReport( std::ostream & out ) const
+{
+	out << "entry point                calls     total_us   avg_ns\n";
+	for ( int entry = 0; entry < EntryPointCount; ++entry )
+	{
+		const EntryPointStats stats = GetEntryPointStats( (EntryPoint)entry );
+		if ( stats.callCount == 0 )
+			continue;
+
+		out << std::left << std::setw( 24 ) << ENTRY_POINT_NAMES[entry] << std::right
+			<< std::setw( 9 ) << stats.callCount
+			<< std::setw( 13 ) << stats.totalNs / 1000
+			<< std::setw( 9 ) << stats.totalNs / stats.callCount << "\n";
+	}
+	out << "submitted " << m_submittedBytes << " command bytes";
+	if ( m_invalidHandleCount )
+		out << ", " << m_invalidHandleCount << " commands with invalid handles";
+	out << "\n";
+}
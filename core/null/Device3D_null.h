@@ -0,0 +1,132 @@
+#pragma once
+#include "../device.h"
+#include "../CommandList.h"
+
+#include <atomic>
+#include <chrono>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+
+// Device making no GPU call at all. Resources are handles with a CPU shadow where the engine can see
+// memory (mapped buffers), submissions are decoded like a backend would and complete immediately.
+// Every entry point is counted and timed, so a frame run against it measures the engine's own CPU
+// cost per draw, without the driver, deterministically on any machine.
+class Device3DNull : public IDevice3D
+{
+public:
+	enum EntryPoint
+	{
+		EntryInit = 0,
+		EntryDestroy,
+		EntryGetQueue,
+		EntryCreateBuffer,
+		EntryDestroyBuffer,
+		EntryGetMappedBuffer,
+		EntryInvalidateMappedBuffer,
+		EntryCreateImage,
+		EntryDestroyImage,
+		EntryAddPipeline,
+		EntryDestroyPipeline,
+		EntrySubmit,
+		EntryIsComplete,
+		EntryWaitComplete,
+		EntryCreateTimestampQueries,
+		EntryDestroyQueries,
+		EntryGetTimestampDeltaMs,
+
+		EntryPointCount,
+	};
+
+	struct EntryPointStats
+	{
+		uint64_t callCount = 0;
+		uint64_t totalNs = 0;
+	};
+
+public:
+	Device3DNull();
+	virtual ~Device3DNull();
+
+	virtual void Init() override;
+	virtual void Destroy() override;
+
+	virtual QueueHandle GetQueue( QueueType type ) const override;
+
+	virtual BufferHandle CreateBuffer( const BufferDesc & desc ) override;
+	virtual void DestroyBuffer( BufferHandle buffer ) override;
+	virtual void * GetMappedBuffer( BufferHandle buffer ) const override;
+	virtual void InvalidateMappedBuffer( BufferHandle buffer ) override;
+	virtual ImageHandle CreateImage( const ImageDesc & desc ) override;
+	virtual void DestroyImage( ImageHandle image ) override;
+	virtual void DestroyPipeline( PipelineHandle pipeline ) override;
+
+	virtual uint64_t Submit( QueueType type, const CommandList * const * lists, uint32_t count ) override;
+	virtual bool IsComplete( QueueType type, uint64_t serial ) const override;
+	virtual void WaitComplete( QueueType type, uint64_t serial ) override;
+
+	// Pools are handles only: nothing executes, so no timestamp is ever available
+	virtual QueryPoolHandle CreateTimestampQueries( QueueType type, uint32_t count ) override;
+	virtual void DestroyQueries( QueryPoolHandle pool ) override;
+	virtual double GetTimestampDeltaMs( QueryPoolHandle pool, uint32_t begin, uint32_t end ) override;
+
+	// Stands in for the backend pipeline creation
+	PipelineHandle AddPipeline( bool isCompute = false );
+
+	EntryPointStats GetEntryPointStats( EntryPoint entry ) const;
+	// Commands of each type seen by Submit()
+	uint64_t GetCommandCount( CommandType type ) const { return m_commandCounts[(int)type]; }
+	uint64_t GetSubmittedBytes() const { return m_submittedBytes; }
+	// Commands referencing a destroyed or unknown resource
+	uint64_t GetInvalidHandleCount() const { return m_invalidHandleCount; }
+	static const char * GetEntryPointName( EntryPoint entry );
+
+	void ResetStats();
+	void PrintReport( std::ostream & out ) const;
+
+private:
+	struct AtomicStats
+	{
+		std::atomic<uint64_t> callCount{ 0 };
+		std::atomic<uint64_t> totalNs{ 0 };
+	};
+
+	// Counts and times one entry point call for the scope of the object
+	class EntryPointTimer
+	{
+	public:
+		EntryPointTimer( const Device3DNull & device, EntryPoint entry ) : m_stats( device.m_entryPoints[entry] ), m_start( std::chrono::steady_clock::now() ) {}
+		~EntryPointTimer()
+		{
+			const auto elapsed = std::chrono::steady_clock::now() - m_start;
+			m_stats.callCount.fetch_add( 1, std::memory_order_relaxed );
+			m_stats.totalNs.fetch_add( (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>( elapsed ).count(), std::memory_order_relaxed );
+		}
+
+	private:
+		AtomicStats & m_stats;
+		std::chrono::steady_clock::time_point m_start;
+	};
+
+	enum BufferComponent { BufferDescription = 0, BufferShadow };
+	enum ImageComponent { ImageDescription = 0 };
+	enum PipelineComponent { PipelineIsCompute = 0 };
+	enum QueryPoolComponent { QueryPoolCount = 0 };
+
+private:
+	mutable AtomicStats m_entryPoints[EntryPointCount];
+
+	HandlePool<BufferTag, BufferDesc, std::unique_ptr<char[]>> m_bufferPool;
+	HandlePool<ImageTag, ImageDesc> m_imagePool;
+	HandlePool<PipelineTag, bool> m_pipelinePool;
+	HandlePool<QueryPoolTag, uint32_t> m_queryPool;
+
+	// One queue per type, every submission completes as soon as it is made
+	QueueHandle m_queues[QueueCount];
+	std::atomic<uint64_t> m_submitSerials[QueueCount];
+
+	std::mutex m_submitMutex;
+	uint64_t m_commandCounts[(int)CommandType::Count] = {};
+	uint64_t m_submittedBytes = 0;
+	uint64_t m_invalidHandleCount = 0;
+};
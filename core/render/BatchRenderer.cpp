@@ -0,0 +1,242 @@
+#include <stdafx.h>
+#include "BatchRenderer.h"
+#include "../thread/JobSystem.h"
+
+#include <chrono>
+#include <iomanip>
+#include <new>
+#include <ostream>
+
+namespace
+{
+	const size_t SLOT_ARENA_CAPACITY = 64 * 1024;
+	const uint32_t COMPUTE_GROUP_SIZE = 8;
+
+	const char * QUEUE_NAMES[] = { "graphics", "compute", "copy", "present" };
+	static_assert( sizeof( QUEUE_NAMES ) / sizeof( QUEUE_NAMES[0] ) == IDevice3D::QueueCount, "QUEUE_NAMES must match QueueType" );
+}
+
+BatchRenderer::BatchRenderer( IDevice3D & device, JobSystem & jobs )
+	: m_device( device )
+	, m_jobs( jobs )
+{
+}
+
+BatchRenderer::~BatchRenderer()
+{
+	Destroy();
+}
+
+void BatchRenderer::Init( const BatchRendererDesc & desc )
+{
+	Destroy();
+	m_desc = desc;
+
+	ImageDesc imageDesc;
+	imageDesc.width = desc.width;
+	imageDesc.height = desc.height;
+	imageDesc.format = ImageFormat::RGBA8;
+	imageDesc.usage = ImageUsageColorTarget | ImageUsageStorage | ImageUsageTransferSrc;
+
+	BufferDesc readbackDesc;
+	readbackDesc.size = (uint64_t)desc.width * desc.height * 4;
+	readbackDesc.usage = BufferUsageTransferDst;
+	readbackDesc.memory = MemoryUsage::Readback;
+
+	m_slots.resize( desc.slotCount );
+	for ( Slot & slot : m_slots )
+	{
+		slot.target = m_device.CreateImage( imageDesc );
+		slot.readback = m_device.CreateBuffer( readbackDesc );
+		slot.mapped = static_cast<const uint8_t *>( m_device.GetMappedBuffer( slot.readback ) );
+		slot.arena.reset( new LinearArena( SLOT_ARENA_CAPACITY ) );
+	}
+
+	m_freeSlots.reserve( desc.slotCount );
+	m_busySlots.reserve( desc.slotCount );
+	m_waveSlots.reserve( desc.slotCount );
+	m_waveLists.reserve( desc.slotCount );
+}
+
+void BatchRenderer::Destroy()
+{
+	for ( Slot & slot : m_slots )
+	{
+		if ( slot.serial )
+			m_device.WaitComplete( slot.queue, slot.serial );
+		m_device.DestroyImage( slot.target );
+		m_device.DestroyBuffer( slot.readback );
+	}
+	m_slots.clear();
+}
+
+BatchRenderStats BatchRenderer::Render( const OfflineRenderJob * jobs, uint32_t count, const Callback & callback )
+{
+	BatchRenderStats stats;
+	const auto start = std::chrono::steady_clock::now();
+
+	m_freeSlots.clear();
+	m_busySlots.clear();
+	for ( uint32_t i = (uint32_t)m_slots.size(); i > 0; --i )
+	{
+		m_freeSlots.push_back( i - 1 );
+	}
+
+	uint32_t nextJob = 0;
+	while ( nextJob < count || !m_busySlots.empty() )
+	{
+		// Retire: deliver every finished image in parallel, then hand its slot back
+		m_waveSlots.clear();
+		for ( size_t i = 0; i < m_busySlots.size(); )
+		{
+			Slot & slot = m_slots[m_busySlots[i]];
+			if ( m_device.IsComplete( slot.queue, slot.serial ) )
+			{
+				m_waveSlots.push_back( m_busySlots[i] );
+				m_busySlots[i] = m_busySlots.back();
+				m_busySlots.pop_back();
+			}
+			else
+			{
+				++i;
+			}
+		}
+		m_jobs.ParallelFor( (uint32_t)m_waveSlots.size(), 1, [&]( uint32_t begin, uint32_t end ) {
+			for ( uint32_t i = begin; i < end; ++i )
+			{
+				Slot & slot = m_slots[m_waveSlots[i]];
+				m_device.InvalidateMappedBuffer( slot.readback );
+				if ( callback )
+					callback( { slot.job->id, m_desc.width, m_desc.height, slot.mapped } );
+			}
+		} );
+		for ( uint32_t slotIdx : m_waveSlots )
+		{
+			m_slots[slotIdx].serial = 0;
+			m_freeSlots.push_back( slotIdx );
+		}
+		stats.imageCount += m_waveSlots.size();
+
+		// Fill: every free slot takes a job, all of them are recorded in parallel
+		m_waveSlots.clear();
+		while ( nextJob < count && !m_freeSlots.empty() )
+		{
+			Slot & slot = m_slots[m_freeSlots.back()];
+			slot.job = &jobs[nextJob++];
+			slot.queue = slot.job->computePipeline.IsValid() ? IDevice3D::ComputeQueue : IDevice3D::GraphicsQueue;
+			m_waveSlots.push_back( m_freeSlots.back() );
+			m_freeSlots.pop_back();
+		}
+		m_jobs.ParallelFor( (uint32_t)m_waveSlots.size(), 1, [&]( uint32_t begin, uint32_t end ) {
+			for ( uint32_t i = begin; i < end; ++i )
+			{
+				Record( m_slots[m_waveSlots[i]] );
+			}
+		} );
+
+		// One submission per queue for the whole wave
+		for ( IDevice3D::QueueType queue : { IDevice3D::GraphicsQueue, IDevice3D::ComputeQueue } )
+		{
+			m_waveLists.clear();
+			for ( uint32_t slotIdx : m_waveSlots )
+			{
+				if ( m_slots[slotIdx].queue == queue )
+					m_waveLists.push_back( m_slots[slotIdx].list );
+			}
+			if ( m_waveLists.empty() )
+				continue;
+
+			const uint64_t serial = m_device.Submit( queue, m_waveLists.data(), (uint32_t)m_waveLists.size() );
+			for ( uint32_t slotIdx : m_waveSlots )
+			{
+				if ( m_slots[slotIdx].queue == queue )
+					m_slots[slotIdx].serial = serial;
+			}
+			++stats.submitCount[queue];
+			stats.jobCount[queue] += m_waveLists.size();
+		}
+		m_busySlots.insert( m_busySlots.end(), m_waveSlots.begin(), m_waveSlots.end() );
+
+		// Nothing to record until a slot frees up: block on work in flight instead of spinning
+		if ( m_waveSlots.empty() && !m_busySlots.empty() )
+		{
+			const Slot & busy = m_slots[m_busySlots.front()];
+			m_device.WaitComplete( busy.queue, busy.serial );
+		}
+	}
+
+	stats.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+	return stats;
+}
+
+void BatchRenderer::PrintReport( std::ostream & out, const BatchRenderStats & stats )
+{
+	out << std::fixed << std::setprecision( 1 );
+	out << "batch render: " << stats.imageCount << " images in " << stats.seconds * 1000.0 << " ms, "
+		<< stats.GetImagesPerSecond() << " images/s";
+	for ( uint32_t queue = 0; queue < IDevice3D::QueueCount; ++queue )
+	{
+		if ( stats.submitCount[queue] )
+			out << ", " << QUEUE_NAMES[queue] << " " << stats.jobCount[queue] << " jobs in " << stats.submitCount[queue] << " submits";
+	}
+	out << "\n" << std::defaultfloat;
+}
+
+void BatchRenderer::Record( Slot & slot )
+{
+	slot.arena->Reset();
+	slot.list = new ( slot.arena->Allocate( sizeof( CommandList ), alignof( CommandList ) ) ) CommandList( *slot.arena );
+	CommandList & list = *slot.list;
+
+	if ( slot.queue == IDevice3D::ComputeQueue )
+	{
+		list.Barrier( slot.target, ResourceState::Undefined, ResourceState::ShaderWrite );
+		EncodeDispatch( list, *slot.job, slot.target );
+		list.Barrier( slot.target, ResourceState::ShaderWrite, ResourceState::TransferSrc );
+	}
+	else
+	{
+		list.Barrier( slot.target, ResourceState::Undefined, ResourceState::ColorTarget );
+		list.BeginRenderPass( slot.target, m_desc.clearColor );
+		EncodeDraws( list, *slot.job );
+		list.EndRenderPass();
+		list.Barrier( slot.target, ResourceState::ColorTarget, ResourceState::TransferSrc );
+	}
+
+	// Read back on the queue that rendered: no cross-queue wait, both queues can copy
+	list.CopyImageToBuffer( slot.target, slot.readback, 0 );
+	list.Barrier( slot.readback, ResourceState::TransferDst, ResourceState::HostRead );
+}
+
+void BatchRenderer::EncodeDraws( CommandList & list, const OfflineRenderJob & job )
+{
+	PipelineHandle pipeline;
+	BufferHandle vertexBuffer;
+	for ( uint32_t i = 0; i < job.objectCount; ++i )
+	{
+		const RenderObject & object = job.objects[i];
+		if ( object.pipeline != pipeline )
+		{
+			list.BindPipeline( object.pipeline );
+			pipeline = object.pipeline;
+		}
+		if ( object.vertexBuffer != vertexBuffer )
+		{
+			list.BindVertexBuffer( 0, object.vertexBuffer );
+			vertexBuffer = object.vertexBuffer;
+		}
+
+		const DrawConstants constants = { i, object.materialIndex };
+		list.PushConstants( constants );
+		list.Draw( object.vertexCount );
+	}
+}
+
+void BatchRenderer::EncodeDispatch( CommandList & list, const OfflineRenderJob & job, ImageHandle target )
+{
+	const OfflineComputeConstants constants = { m_desc.width, m_desc.height, job.variant };
+	list.BindPipeline( job.computePipeline );
+	list.BindStorageImage( 0, target );
+	list.PushConstants( constants );
+	list.Dispatch( (m_desc.width + COMPUTE_GROUP_SIZE - 1) / COMPUTE_GROUP_SIZE, (m_desc.height + COMPUTE_GROUP_SIZE - 1) / COMPUTE_GROUP_SIZE );
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include "SceneRenderer.h"
+#include "../memory/LinearArena.h"
+
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <vector>
+
+class JobSystem;
+
+// One independent offscreen image. A job with a compute pipeline is a single dispatch writing the target,
+// bound as storage image 0, on the compute queue; any other job clears the target and draws its objects
+// on the graphics queue.
+struct OfflineRenderJob
+{
+	uint64_t id = 0;
+	const RenderObject * objects = nullptr;
+	uint32_t objectCount = 0;
+	PipelineHandle computePipeline;
+	uint32_t variant = 0;	// pushed to the compute pipeline with the image size
+};
+
+// Push constants of compute jobs
+struct OfflineComputeConstants
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t variant;
+};
+
+struct OfflineImage
+{
+	uint64_t jobId;
+	uint32_t width;
+	uint32_t height;
+	const uint8_t * rgba;	// tightly packed, valid during the callback only
+};
+
+struct BatchRendererDesc
+{
+	uint32_t width = 256;
+	uint32_t height = 256;
+	uint32_t slotCount = 32;	// jobs in flight, each with its own target, readback and command arena
+	float clearColor[4] = { 0.0f, 0.0f, 0.0f, 1.0f };	// of graphics jobs
+};
+
+struct BatchRenderStats
+{
+	uint64_t imageCount = 0;
+	uint64_t submitCount[IDevice3D::QueueCount] = {};
+	uint64_t jobCount[IDevice3D::QueueCount] = {};
+	double seconds = 0.0;
+
+	double GetImagesPerSecond() const { return seconds > 0.0 ? imageCount / seconds : 0.0; }
+};
+
+// Throughput mode: renders many independent offscreen jobs instead of one window's frames.
+// Jobs are recorded in parallel on the job system, one list each; all the lists of a wave go out in
+// one submission per queue, graphics and compute running side by side. Finished images are read
+// back and handed to the callback, in parallel, on the workers.
+class BatchRenderer
+{
+public:
+	typedef std::function<void( const OfflineImage & )> Callback;
+
+public:
+	BatchRenderer( IDevice3D & device, JobSystem & jobs );
+	~BatchRenderer();
+
+	BatchRenderer( const BatchRenderer & ) = delete;
+	BatchRenderer & operator=( const BatchRenderer & ) = delete;
+
+	void Init( const BatchRendererDesc & desc );
+	void Destroy();
+
+	// Returns once every job has been delivered
+	BatchRenderStats Render( const OfflineRenderJob * jobs, uint32_t count, const Callback & callback );
+
+	static void PrintReport( std::ostream & out, const BatchRenderStats & stats );
+
+private:
+	struct Slot
+	{
+		ImageHandle target;
+		BufferHandle readback;
+		const uint8_t * mapped = nullptr;
+		std::unique_ptr<LinearArena> arena;
+		CommandList * list = nullptr;
+		const OfflineRenderJob * job = nullptr;
+		IDevice3D::QueueType queue = IDevice3D::GraphicsQueue;
+		uint64_t serial = 0;
+	};
+
+	void Record( Slot & slot );
+	void EncodeDraws( CommandList & list, const OfflineRenderJob & job );
+	void EncodeDispatch( CommandList & list, const OfflineRenderJob & job, ImageHandle target );
+
+private:
+	IDevice3D & m_device;
+	JobSystem & m_jobs;
+	BatchRendererDesc m_desc;
+	std::vector<Slot> m_slots;
+	// Scratch of Render(), sized once in Init()
+	std::vector<uint32_t> m_freeSlots;
+	std::vector<uint32_t> m_busySlots;
+	std::vector<uint32_t> m_waveSlots;
+	std::vector<const CommandList *> m_waveLists;
+};
@@ -0,0 +1,218 @@
+#include <stdafx.h>
+#include "FrameCapture.h"
+#include "PixelConvert.h"
+#include "../CommandList.h"
+
+#include <algorithm>
+#include <ostream>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+	const size_t COMMAND_ARENA_CAPACITY = 4 * 1024;
+	// Below this, splitting the conversion costs more in job overhead than it saves
+	const uint32_t MIN_ROWS_PER_BAND = 64;
+}
+
+constexpr uint32_t FrameCapture::RING_SIZE;
+constexpr uint32_t FrameCapture::MAX_BANDS;
+
+FrameCapture::FrameCapture( IDevice3D & device, JobSystem & jobs )
+	: m_device( device )
+	, m_jobs( jobs )
+	, m_commandArena( COMMAND_ARENA_CAPACITY )
+{
+}
+
+FrameCapture::~FrameCapture()
+{
+	Destroy();
+}
+
+void FrameCapture::Init( uint32_t width, uint32_t height, ImageFormat format, Callback callback )
+{
+	if ( format != ImageFormat::RGBA8 && format != ImageFormat::BGRA8 )
+	{
+		throw std::runtime_error( "Frame capture only reads back 8 bit color images" );
+	}
+
+	Destroy();
+	m_width = width;
+	m_height = height;
+	m_isBgra = format == ImageFormat::BGRA8;
+	m_callback = std::move( callback );
+
+	const uint32_t maxBands = std::min( MAX_BANDS, std::max( 1U, m_jobs.GetWorkerCount() ) );
+	m_bandCount = std::max( 1U, std::min( maxBands, height / MIN_ROWS_PER_BAND ) );
+
+	BufferDesc desc;
+	desc.size = (uint64_t)width * height * 4;
+	desc.usage = BufferUsageTransferDst;
+	desc.memory = MemoryUsage::Readback;
+	for ( Slot & slot : m_slots )
+	{
+		slot.readback = m_device.CreateBuffer( desc );
+		slot.mapped = static_cast<const uint8_t *>( m_device.GetMappedBuffer( slot.readback ) );
+		slot.rgb.reset( new uint8_t[(size_t)width * height * 3] );
+		slot.state.store( SlotFree, std::memory_order_relaxed );
+
+		for ( uint32_t i = 0; i < m_bandCount; ++i )
+		{
+			slot.bands[i] = { this, &slot, height * i / m_bandCount, height * (i + 1) / m_bandCount };
+		}
+	}
+}
+
+void FrameCapture::Destroy()
+{
+	Flush();
+	for ( Slot & slot : m_slots )
+	{
+		if ( slot.readback.IsValid() )
+			m_device.DestroyBuffer( slot.readback );
+		slot.readback = BufferHandle();
+		slot.mapped = nullptr;
+		slot.rgb.reset();
+	}
+}
+
+bool FrameCapture::Capture( ImageHandle image, uint64_t graphicsSerial, uint64_t frameId )
+{
+	Slot & slot = m_slots[m_nextSlot];
+	if ( !slot.readback.IsValid() || slot.state.load( std::memory_order_acquire ) != SlotFree )
+	{
+		++m_droppedCount;
+		return false;
+	}
+
+	slot.image = image;
+	slot.graphicsSerial = graphicsSerial;
+	slot.frameId = frameId;
+	slot.captureTime = std::chrono::steady_clock::now();
+	slot.state.store( SlotRendering, std::memory_order_relaxed );
+	m_nextSlot = (m_nextSlot + 1) % RING_SIZE;
+	++m_capturedCount;
+
+	Update();
+	return true;
+}
+
+void FrameCapture::Update()
+{
+	// Oldest first, so copies are submitted in capture order. Only the oldest frame in flight may
+	// start converting, and only once the previous one is delivered: callbacks stay ordered.
+	bool canConvert = true;
+	for ( uint32_t i = 0; i < RING_SIZE; ++i )
+	{
+		Slot & slot = m_slots[(m_nextSlot + i) % RING_SIZE];
+		const uint32_t state = slot.state.load( std::memory_order_acquire );
+		if ( state == SlotRendering && m_device.IsComplete( IDevice3D::GraphicsQueue, slot.graphicsSerial ) )
+		{
+			SubmitCopy( slot );
+		}
+		else if ( state == SlotCopying && canConvert && m_device.IsComplete( IDevice3D::CopyQueue, slot.copySerial ) )
+		{
+			StartConversion( slot );
+		}
+		canConvert &= state == SlotFree;
+	}
+}
+
+void FrameCapture::Flush()
+{
+	for ( ;; )
+	{
+		Update();
+
+		// Waiting on the counters runs the band jobs here when called from a worker
+		bool isIdle = true;
+		for ( Slot & slot : m_slots )
+		{
+			m_jobs.Wait( slot.conversion );
+			isIdle &= slot.state.load( std::memory_order_acquire ) == SlotFree;
+		}
+		if ( isIdle )
+			return;
+		std::this_thread::yield();
+	}
+}
+
+bool FrameCapture::IsCopying( ImageHandle image ) const
+{
+	for ( const Slot & slot : m_slots )
+	{
+		const uint32_t state = slot.state.load( std::memory_order_acquire );
+		if ( slot.image == image && (state == SlotRendering || state == SlotCopying) )
+			return true;
+	}
+	return false;
+}
+
+FrameCapture::Stats FrameCapture::GetStats() const
+{
+	Stats stats;
+	stats.capturedCount = m_capturedCount;
+	stats.droppedCount = m_droppedCount;
+	stats.deliveredCount = m_deliveredCount.load( std::memory_order_acquire );
+	return stats;
+}
+
+void FrameCapture::PrintReport( std::ostream & out ) const
+{
+	const Stats stats = GetStats();
+	const double meanMs = stats.deliveredCount ? m_latencyTotalUs.load( std::memory_order_relaxed ) / 1000.0 / stats.deliveredCount : 0.0;
+	out << "capture " << m_width << "x" << m_height << ": " << stats.capturedCount << " captured, " << stats.droppedCount << " dropped, "
+		<< stats.deliveredCount << " delivered, " << meanMs << " ms capture to delivery, "
+		<< m_bandCount << " bands, " << (HasSimdPixelConvert() ? "ssse3" : "scalar") << " conversion\n";
+}
+
+void FrameCapture::SubmitCopy( Slot & slot )
+{
+	// No semaphores between queues: the copy is submitted once the frame is known complete, which
+	// also orders it after the image's transition to TransferSrc on the graphics queue
+	m_commandArena.Reset();
+	CommandList list( m_commandArena );
+	list.CopyImageToBuffer( slot.image, slot.readback, 0 );
+	list.Barrier( slot.readback, ResourceState::TransferDst, ResourceState::HostRead );
+
+	const CommandList * lists[] = { &list };
+	slot.copySerial = m_device.Submit( IDevice3D::CopyQueue, lists, 1 );
+	slot.state.store( SlotCopying, std::memory_order_release );
+}
+
+void FrameCapture::StartConversion( Slot & slot )
+{
+	m_device.InvalidateMappedBuffer( slot.readback );
+	slot.image = ImageHandle();
+	slot.bandsLeft.store( m_bandCount, std::memory_order_relaxed );
+	slot.state.store( SlotConverting, std::memory_order_release );
+	for ( uint32_t i = 0; i < m_bandCount; ++i )
+	{
+		m_jobs.Run( &ConvertBand, &slot.bands[i], &slot.conversion );
+	}
+}
+
+void FrameCapture::ConvertBand( void * data )
+{
+	const Band & band = *static_cast<const Band *>( data );
+	FrameCapture & capture = *band.capture;
+	Slot & slot = *band.slot;
+
+	const uint32_t width = capture.m_width;
+	ConvertToRgb( slot.mapped + (size_t)band.rowBegin * width * 4, slot.rgb.get() + (size_t)band.rowBegin * width * 3, (band.rowEnd - band.rowBegin) * width, capture.m_isBgra );
+
+	if ( slot.bandsLeft.fetch_sub( 1, std::memory_order_acq_rel ) != 1 )
+		return;
+
+	// Last band: the frame is whole
+	if ( capture.m_callback )
+	{
+		const CapturedFrame frame = { slot.frameId, width, capture.m_height, slot.rgb.get() };
+		capture.m_callback( frame );
+	}
+	const auto latency = std::chrono::steady_clock::now() - slot.captureTime;
+	capture.m_latencyTotalUs.fetch_add( (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>( latency ).count(), std::memory_order_relaxed );
+	capture.m_deliveredCount.fetch_add( 1, std::memory_order_release );
+	slot.state.store( SlotFree, std::memory_order_release );
+}
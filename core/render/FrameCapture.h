@@ -0,0 +1,124 @@
+#pragma once
+#include "../device.h"
+#include "../memory/LinearArena.h"
+#include "../thread/JobSystem.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+
+struct CapturedFrame
+{
+	uint64_t frameId;
+	uint32_t width;
+	uint32_t height;
+	const uint8_t * rgb;	// width * height * 3 bytes, rows top to bottom, valid during the callback only
+};
+
+// Reads rendered images back without stalling the render thread. Each capture takes one of
+// RING_SIZE host-visible readback buffers; the copy goes to the copy queue once the frame's graphics
+// submission is complete, the BGRA/RGBA to RGB conversion runs in bands on the job system, and the
+// last band hands the frame to the callback, on a worker. Frames convert one at a time, so callbacks
+// run in capture order and never overlap. A capture with no free buffer is dropped:
+// a slow consumer never pushes back on rendering.
+// Capture(), Update() and Flush() are called from the render thread.
+// Only IDevice3D images can be captured: the tutorial's swap chain and RenderTargetVulkan images are
+// raw Vulkan objects outside the device. main's --capture feeds it a test pattern rendered on the device,
+// --export passes the frames on to FrameExport.
+class FrameCapture
+{
+public:
+	typedef std::function<void( const CapturedFrame & )> Callback;
+	static constexpr uint32_t RING_SIZE = 3;
+	static constexpr uint32_t MAX_BANDS = 8;
+
+	struct Stats
+	{
+		uint64_t capturedCount = 0;
+		uint64_t droppedCount = 0;
+		uint64_t deliveredCount = 0;
+	};
+
+public:
+	FrameCapture( IDevice3D & device, JobSystem & jobs );
+	~FrameCapture();
+
+	FrameCapture( const FrameCapture & ) = delete;
+	FrameCapture & operator=( const FrameCapture & ) = delete;
+
+	// Images must be width x height, RGBA8 or BGRA8, created with ImageUsageTransferSrc
+	void Init( uint32_t width, uint32_t height, ImageFormat format, Callback callback );
+	void Destroy();
+
+	// The image must already be in ResourceState::TransferSrc when graphicsSerial completes, and stay
+	// untouched until IsCopying() turns false. Returns false when the frame is dropped.
+	bool Capture( ImageHandle image, uint64_t graphicsSerial, uint64_t frameId );
+	// Never blocks: starts the copies whose frame is rendered, the conversions whose copy is done
+	void Update();
+	// Blocks until every capture has been delivered
+	void Flush();
+
+	bool IsCopying( ImageHandle image ) const;
+	Stats GetStats() const;
+	void PrintReport( std::ostream & out ) const;
+
+private:
+	enum SlotState : uint32_t
+	{
+		SlotFree = 0,
+		SlotRendering,		// waiting for the graphics submission
+		SlotCopying,		// waiting for the copy queue
+		SlotConverting,		// owned by the band jobs, freed by the last one
+	};
+
+	struct Slot;
+
+	struct Band
+	{
+		FrameCapture * capture;
+		Slot * slot;
+		uint32_t rowBegin;
+		uint32_t rowEnd;
+	};
+
+	struct Slot
+	{
+		BufferHandle readback;
+		const uint8_t * mapped = nullptr;	// resolved once, workers never touch the device
+		std::unique_ptr<uint8_t[]> rgb;
+		ImageHandle image;
+		uint64_t graphicsSerial = 0;
+		uint64_t copySerial = 0;
+		uint64_t frameId = 0;
+		std::chrono::steady_clock::time_point captureTime;
+		std::atomic<uint32_t> state{ SlotFree };
+		std::atomic<uint32_t> bandsLeft{ 0 };
+		JobCounter conversion;
+		Band bands[MAX_BANDS];
+	};
+
+	void SubmitCopy( Slot & slot );
+	void StartConversion( Slot & slot );
+	static void ConvertBand( void * data );
+
+private:
+	IDevice3D & m_device;
+	JobSystem & m_jobs;
+	Callback m_callback;
+
+	uint32_t m_width = 0;
+	uint32_t m_height = 0;
+	bool m_isBgra = false;
+	uint32_t m_bandCount = 1;
+
+	Slot m_slots[RING_SIZE];
+	uint32_t m_nextSlot = 0;
+	LinearArena m_commandArena;
+
+	uint64_t m_capturedCount = 0;
+	uint64_t m_droppedCount = 0;
+	std::atomic<uint64_t> m_deliveredCount{ 0 };
+	std::atomic<uint64_t> m_latencyTotalUs{ 0 };
+};
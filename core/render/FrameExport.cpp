@@ -0,0 +1,210 @@
+#include <stdafx.h>
+#include "FrameExport.h"
+#include "PixelConvert.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <ostream>
+#include <stdexcept>
+
+namespace
+{
+	const uint32_t SLOT_ALIGNMENT = 4096;
+	const char Y4M_FRAME_TAG[] = "FRAME\n";
+	const uint32_t Y4M_FRAME_TAG_SIZE = sizeof( Y4M_FRAME_TAG ) - 1;
+
+	uint64_t GetTimestampNs()
+	{
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+	}
+
+	uint32_t GetHeaderSize()
+	{
+		return (sizeof( FrameRingHeader ) + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+	}
+}
+
+constexpr uint32_t FrameRingHeader::MAGIC;
+constexpr uint32_t FrameRingHeader::VERSION;
+
+//
+//
+//	FrameExport ===================================================================================
+//
+//
+FrameExport::~FrameExport()
+{
+	Close();
+}
+
+void FrameExport::Open( const FrameExportDesc & desc )
+{
+	Close();
+
+	if ( desc.format == FrameExportFormat::Y4M && ((desc.width | desc.height) & 1) )
+	{
+		throw std::runtime_error( "Y4M export needs an even frame size" );
+	}
+
+	const uint32_t payloadSize = GetPayloadSize( desc.format, desc.width, desc.height );
+	const uint32_t slotSize = (sizeof( FrameSlotHeader ) + payloadSize + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+	const size_t size = GetHeaderSize() + (size_t)slotSize * desc.slotCount;
+
+	const bool isOpen = desc.target == FrameExportTarget::SharedMemory
+		? m_mapping.CreateShared( desc.name, size )
+		: m_mapping.OpenWrite( desc.name, size );
+	if ( !isOpen )
+	{
+		// A shared ring is only removed by its producer's Close(): the name is taken by a live exporter,
+		// or left behind by one that crashed
+		throw std::runtime_error( desc.target == FrameExportTarget::SharedMemory
+			? "Cannot create frame ring " + desc.name + ", it may already exist and belong to another exporter"
+			: "Cannot create frame ring " + desc.name );
+	}
+
+	m_header = new ( m_mapping.Data() ) FrameRingHeader();
+	m_header->version = FrameRingHeader::VERSION;
+	m_header->headerSize = GetHeaderSize();
+	m_header->format = desc.format;
+	m_header->width = desc.width;
+	m_header->height = desc.height;
+	m_header->fpsNumerator = desc.fpsNumerator;
+	m_header->fpsDenominator = desc.fpsDenominator;
+	m_header->slotCount = desc.slotCount;
+	m_header->slotSize = slotSize;
+	if ( desc.format == FrameExportFormat::Y4M )
+	{
+		snprintf( m_header->streamHeader, sizeof( m_header->streamHeader ), "YUV4MPEG2 W%u H%u F%u:%u Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n",
+			desc.width, desc.height, desc.fpsNumerator, desc.fpsDenominator );
+	}
+	m_header->writeCount.store( 0, std::memory_order_relaxed );
+	m_header->readCount.store( 0, std::memory_order_relaxed );
+	m_header->isClosed.store( 0, std::memory_order_relaxed );
+	m_header->magic.store( FrameRingHeader::MAGIC, std::memory_order_release );
+
+	m_slots = static_cast<uint8_t *>( m_mapping.Data() ) + m_header->headerSize;
+	m_writtenCount = 0;
+	m_droppedCount = 0;
+	m_writeNs = 0;
+}
+
+void FrameExport::Close()
+{
+	if ( !m_header )
+		return;
+
+	m_header->isClosed.store( 1, std::memory_order_release );
+	m_mapping.Close();
+	m_header = nullptr;
+	m_slots = nullptr;
+}
+
+bool FrameExport::Write( const CapturedFrame & frame )
+{
+	if ( !m_header )
+	{
+		++m_droppedCount;
+		return false;
+	}
+	assert( frame.width == m_header->width && frame.height == m_header->height );
+
+	const uint64_t writeCount = m_header->writeCount.load( std::memory_order_relaxed );
+	if ( writeCount - m_header->readCount.load( std::memory_order_acquire ) >= m_header->slotCount )
+	{
+		++m_droppedCount;
+		return false;
+	}
+
+	const uint64_t start = GetTimestampNs();
+	uint8_t * slot = m_slots + (size_t)(writeCount % m_header->slotCount) * m_header->slotSize;
+	uint8_t * payload = slot + sizeof( FrameSlotHeader );
+	const uint32_t pixelCount = frame.width * frame.height;
+	if ( m_header->format == FrameExportFormat::Y4M )
+	{
+		memcpy( payload, Y4M_FRAME_TAG, Y4M_FRAME_TAG_SIZE );
+		uint8_t * y = payload + Y4M_FRAME_TAG_SIZE;
+		uint8_t * u = y + pixelCount;
+		uint8_t * v = u + pixelCount / 4;
+		ConvertRgbToI420( frame.rgb, frame.width, frame.height, y, u, v );
+	}
+	else
+	{
+		memcpy( payload, frame.rgb, (size_t)pixelCount * 3 );
+	}
+
+	FrameSlotHeader & slotHeader = *reinterpret_cast<FrameSlotHeader *>( slot );
+	slotHeader.frameId = frame.frameId;
+	slotHeader.timestampNs = GetTimestampNs();
+	slotHeader.payloadSize = GetPayloadSize( m_header->format, frame.width, frame.height );
+	slotHeader.reserved = 0;
+	m_header->writeCount.store( writeCount + 1, std::memory_order_release );
+
+	m_writeNs += slotHeader.timestampNs - start;
+	++m_writtenCount;
+	return true;
+}
+
+void FrameExport::PrintReport( std::ostream & out ) const
+{
+	const double meanMs = m_writtenCount ? m_writeNs / 1e6 / m_writtenCount : 0.0;
+	out << "frame export: " << m_writtenCount << " written, " << m_droppedCount << " dropped (consumer behind), "
+		<< meanMs << " ms per frame\n";
+}
+
+uint32_t FrameExport::GetPayloadSize( FrameExportFormat format, uint32_t width, uint32_t height )
+{
+	if ( format == FrameExportFormat::Y4M )
+		return Y4M_FRAME_TAG_SIZE + width * height * 3 / 2;
+	return width * height * 3;
+}
+
+//
+//
+//	FrameRingReader ===============================================================================
+//
+//
+bool FrameRingReader::Open( FrameExportTarget target, const std::string & name )
+{
+	Close();
+
+	const bool isOpen = target == FrameExportTarget::SharedMemory ? m_mapping.OpenShared( name ) : m_mapping.OpenReadWrite( name );
+	if ( !isOpen || m_mapping.Size() < sizeof( FrameRingHeader ) )
+		return false;
+
+	FrameRingHeader * header = static_cast<FrameRingHeader *>( m_mapping.Data() );
+	if ( header->magic.load( std::memory_order_acquire ) != FrameRingHeader::MAGIC || header->version != FrameRingHeader::VERSION
+		|| m_mapping.Size() < header->headerSize + (size_t)header->slotSize * header->slotCount )
+	{
+		m_mapping.Close();
+		return false;
+	}
+
+	m_header = header;
+	m_slots = static_cast<uint8_t *>( m_mapping.Data() ) + header->headerSize;
+	return true;
+}
+
+const FrameSlotHeader * FrameRingReader::Acquire( const uint8_t ** payload ) const
+{
+	const uint64_t readCount = m_header->readCount.load( std::memory_order_relaxed );
+	if ( readCount >= m_header->writeCount.load( std::memory_order_acquire ) )
+		return nullptr;
+
+	const uint8_t * slot = m_slots + (size_t)(readCount % m_header->slotCount) * m_header->slotSize;
+	*payload = slot + sizeof( FrameSlotHeader );
+	return reinterpret_cast<const FrameSlotHeader *>( slot );
+}
+
+void FrameRingReader::Release()
+{
+	m_header->readCount.fetch_add( 1, std::memory_order_release );
+}
+
+bool FrameRingReader::IsFinished() const
+{
+	// Closed is read first: a frame published before closing is then seen by the count check
+	return m_header->isClosed.load( std::memory_order_acquire )
+		&& m_header->readCount.load( std::memory_order_relaxed ) >= m_header->writeCount.load( std::memory_order_acquire );
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include "FrameCapture.h"
+#include "../io/MappedFile.h"
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+// Shared layout of a frame ring, written by FrameExport and read by a local encoder process.
+// The whole ring is one mapping: the header, then slotCount slots of slotSize bytes each, every slot
+// a FrameSlotHeader followed by the payload. Single producer, single consumer: the producer fills
+// slot writeCount % slotCount while writeCount - readCount < slotCount, then bumps writeCount; the
+// consumer reads slot readCount % slotCount while readCount < writeCount, then bumps readCount.
+// Counters only ever grow; both sides publish with release and read the other's with acquire.
+enum class FrameExportFormat : uint32_t
+{
+	Raw = 0,	// RGB24 rows, top to bottom
+	Y4M,		// "FRAME\n" then the I420 planes, streamHeader goes once in front of the stream
+};
+
+struct FrameRingHeader
+{
+	static constexpr uint32_t MAGIC = 0x52464B56;	// "VKFR"
+	static constexpr uint32_t VERSION = 1;
+
+	std::atomic<uint32_t> magic;	// stored last by the producer, once the rest is valid
+	uint32_t version;
+	uint32_t headerSize;		// where slot 0 starts, the header rounded to 4 KB
+	FrameExportFormat format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t fpsNumerator;
+	uint32_t fpsDenominator;
+	uint32_t slotCount;
+	uint32_t slotSize;			// FrameSlotHeader plus the largest payload, rounded to 4 KB
+	char streamHeader[64];		// Y4M stream header, null terminated, empty for Raw
+	alignas( 64 ) std::atomic<uint64_t> writeCount;
+	alignas( 64 ) std::atomic<uint64_t> readCount;
+	alignas( 64 ) std::atomic<uint32_t> isClosed;	// set by the producer after its last frame
+};
+
+struct FrameSlotHeader
+{
+	uint64_t frameId;
+	uint64_t timestampNs;		// steady clock at publication
+	uint32_t payloadSize;
+	uint32_t reserved;
+};
+
+static_assert( ATOMIC_LLONG_LOCK_FREE == 2, "the ring counters are shared between processes and must be lock-free" );
+
+enum class FrameExportTarget
+{
+	RingFile = 0,		// memory-mapped file, path as given
+	SharedMemory,		// POSIX shm (/dev/shm/<name>) or a named mapping on Windows
+};
+
+struct FrameExportDesc
+{
+	FrameExportTarget target = FrameExportTarget::SharedMemory;
+	std::string name;
+	FrameExportFormat format = FrameExportFormat::Raw;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t fpsNumerator = 60;
+	uint32_t fpsDenominator = 1;
+	uint32_t slotCount = 8;
+};
+
+// Producer side. Frames are converted straight into the mapped slot: no staging copy, no write()
+// call, the consumer maps the same pages. When the consumer falls behind the frame is dropped,
+// the producer never waits on it.
+// Write() is meant to be called from a FrameCapture callback, which delivers frames in order.
+class FrameExport
+{
+public:
+	FrameExport() = default;
+	~FrameExport();
+
+	FrameExport( const FrameExport & ) = delete;
+	FrameExport & operator=( const FrameExport & ) = delete;
+
+	void Open( const FrameExportDesc & desc );
+	// Marks the stream closed for the consumer and unmaps
+	void Close();
+	bool IsOpen() const { return m_header != nullptr; }
+
+	// Returns false when the ring is full or closed and the frame dropped
+	bool Write( const CapturedFrame & frame );
+
+	uint64_t GetWrittenCount() const { return m_writtenCount; }
+	uint64_t GetDroppedCount() const { return m_droppedCount; }
+	void PrintReport( std::ostream & out ) const;
+
+	static uint32_t GetPayloadSize( FrameExportFormat format, uint32_t width, uint32_t height );
+
+private:
+	MappedFile m_mapping;
+	FrameRingHeader * m_header = nullptr;
+	uint8_t * m_slots = nullptr;
+	uint64_t m_writtenCount = 0;
+	uint64_t m_droppedCount = 0;
+	uint64_t m_writeNs = 0;
+};
+
+// Consumer side, for the encoder process
+class FrameRingReader
+{
+public:
+	bool Open( FrameExportTarget target, const std::string & name );
+	void Close() { m_mapping.Close(); m_header = nullptr; }
+
+	const FrameRingHeader & GetHeader() const { return *m_header; }
+	// Oldest unread frame, nullptr when none is ready; payload stays valid until Release()
+	const FrameSlotHeader * Acquire( const uint8_t ** payload ) const;
+	void Release();
+	// Closed and drained
+	bool IsFinished() const;
+
+private:
+	MappedFile m_mapping;
+	FrameRingHeader * m_header = nullptr;
+	uint8_t * m_slots = nullptr;
+};
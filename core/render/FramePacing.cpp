@@ -0,0 +1,93 @@
+#include <stdafx.h>
+#include "FramePacing.h"
+
+#include <ostream>
+
+namespace
+{
+	double ToMs( FrameLatencyTracker::Clock::duration duration )
+	{
+		return std::chrono::duration<double, std::milli>( duration ).count();
+	}
+}
+
+//
+//
+//	FramePacer ====================================================================================
+//
+//
+void FramePacer::SignalSlotReady()
+{
+	{
+		std::lock_guard<std::mutex> lock( m_mutex );
+		++m_readyCount;
+	}
+	m_ready.notify_one();
+}
+
+bool FramePacer::WaitForSlot()
+{
+	std::unique_lock<std::mutex> lock( m_mutex );
+	m_ready.wait( lock, [this] { return m_readyCount > 0 || m_closed; } );
+	if ( m_closed )
+		return false;
+
+	--m_readyCount;
+	return true;
+}
+
+void FramePacer::Close()
+{
+	{
+		std::lock_guard<std::mutex> lock( m_mutex );
+		m_closed = true;
+	}
+	m_ready.notify_all();
+}
+
+//
+//
+//	FrameLatencyTracker ===========================================================================
+//
+//
+constexpr uint32_t FrameLatencyTracker::MAX_SLOTS;
+
+void FrameLatencyTracker::OnSubmit( uint32_t slot, Clock::time_point inputTime, Clock::time_point submitTime )
+{
+	assert( slot < MAX_SLOTS );
+	Pending & pending = m_pending[slot];
+	pending.inputTime = inputTime;
+	pending.submitTime = submitTime;
+	pending.isPending = true;
+	m_inputToSubmit.Add( ToMs( submitTime - inputTime ) );
+}
+
+void FrameLatencyTracker::OnComplete( uint32_t slot, Clock::time_point completeTime )
+{
+	assert( slot < MAX_SLOTS );
+	Pending & pending = m_pending[slot];
+	if ( !pending.isPending )
+		return;
+
+	m_submitToComplete.Add( ToMs( completeTime - pending.submitTime ) );
+	m_inputToComplete.Add( ToMs( completeTime - pending.inputTime ) );
+	pending.isPending = false;
+}
+
+void FrameLatencyTracker::Reset()
+{
+	for ( Pending & pending : m_pending )
+	{
+		pending.isPending = false;
+	}
+	m_inputToSubmit.Reset();
+	m_submitToComplete.Reset();
+	m_inputToComplete.Reset();
+}
+
+void FrameLatencyTracker::PrintReport( std::ostream & out ) const
+{
+	m_inputToSubmit.PrintReport( out, "  input to submit" );
+	m_submitToComplete.PrintReport( out, "  submit to gpu done" );
+	m_inputToComplete.PrintReport( out, "  input to gpu done" );
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "../LatencyWindow.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+
+// Just-in-time frame start. The render thread signals once it owns a frame slot, past every blocking
+// wait (GPU back-pressure, swap chain image); only then does the main thread sample input and build
+// the frame. Input is read after the stalls instead of before them.
+class FramePacer
+{
+public:
+	// Render thread, once per frame, when the frame can be recorded without waiting
+	void SignalSlotReady();
+	// Main thread, false once closed
+	bool WaitForSlot();
+	// Releases the waiting side for good
+	void Close();
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_ready;
+	uint32_t m_readyCount = 0;
+	bool m_closed = false;
+};
+
+// Per-frame latency stamps: input sampled, command buffers submitted and GPU done.
+// Present completion is not observable in core Vulkan, the frame fence signaling (GPU done, image
+// handed to the presentation engine) is the closest; it is stamped when found signaled.
+// Render thread only.
+class FrameLatencyTracker
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+	static constexpr uint32_t MAX_SLOTS = 4;
+
+public:
+	void OnSubmit( uint32_t slot, Clock::time_point inputTime, Clock::time_point submitTime );
+	// Ignored for a slot with no frame pending
+	void OnComplete( uint32_t slot, Clock::time_point completeTime );
+	bool IsPending( uint32_t slot ) const { return m_pending[slot].isPending; }
+
+	void Reset();
+	void PrintReport( std::ostream & out ) const;
+
+private:
+	struct Pending
+	{
+		Clock::time_point inputTime;
+		Clock::time_point submitTime;
+		bool isPending = false;
+	};
+
+	Pending m_pending[MAX_SLOTS];
+	LatencyWindow m_inputToSubmit;
+	LatencyWindow m_submitToComplete;
+	LatencyWindow m_inputToComplete;
+};
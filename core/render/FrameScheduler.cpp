@@ -0,0 +1,92 @@
+#include <stdafx.h>
+#include "FrameScheduler.h"
+
+#include <ostream>
+#include <thread>
+
+namespace
+{
+	// Sleeps on some systems overshoot by a whole scheduler tick
+	const FrameScheduler::Clock::duration MAX_SPIN_MARGIN = std::chrono::milliseconds( 20 );
+}
+
+constexpr double FrameScheduler::MAX_IDLE_WAIT_SECONDS;
+
+void FrameScheduler::SetTargetFps( double fps )
+{
+	m_targetFrameTime = fps > 0.0 ? std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double>( 1.0 / fps ) ) : Clock::duration::zero();
+}
+
+void FrameScheduler::RequestFrameIn( double seconds )
+{
+	const Clock::time_point time = Clock::now() + std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double>( seconds ) );
+	if ( !m_hasRequest || time < m_requestTime )
+		m_requestTime = time;
+	m_hasRequest = true;
+}
+
+bool FrameScheduler::ShouldRender( Clock::time_point now ) const
+{
+	if ( !m_isVisible )
+		return false;
+	if ( m_mode == Mode::Continuous || m_isDirty )
+		return true;
+	return m_hasRequest && now >= m_requestTime;
+}
+
+double FrameScheduler::GetIdleWaitSeconds( Clock::time_point now ) const
+{
+	double wait = MAX_IDLE_WAIT_SECONDS;
+	if ( m_isVisible && m_hasRequest )
+		wait = std::min( wait, std::chrono::duration<double>( m_requestTime - now ).count() );
+	return std::max( wait, 0.0 );
+}
+
+void FrameScheduler::BeginFrame()
+{
+	Clock::time_point now = Clock::now();
+	if ( m_targetFrameTime > Clock::duration::zero() )
+	{
+		const Clock::time_point deadline = m_frameStart + m_targetFrameTime;
+		if ( deadline - now > m_spinMargin )
+		{
+			const Clock::duration sleep = deadline - now - m_spinMargin;
+			std::this_thread::sleep_for( sleep );
+			const Clock::time_point woken = Clock::now();
+
+			// Grows at once on an oversleep, shrinks back slowly
+			const Clock::duration overshoot = std::min( woken - now - sleep, MAX_SPIN_MARGIN );
+			m_spinMargin = overshoot > m_spinMargin ? overshoot : (m_spinMargin * 15 + std::max( overshoot, Clock::duration::zero() )) / 16;
+			now = woken;
+		}
+
+		const Clock::time_point spinStart = now;
+		while ( now < deadline )
+		{
+			std::this_thread::yield();
+			now = Clock::now();
+		}
+		m_spinTime += now - spinStart;
+
+		// Keeps the cadence, unless more than a frame late: a late frame does not make the next ones early
+		m_frameStart = now - deadline < m_targetFrameTime ? deadline : now;
+	}
+	else
+	{
+		m_frameStart = now;
+	}
+	++m_frameCount;
+}
+
+void FrameScheduler::OnInputSampled()
+{
+	m_isDirty = false;
+	if ( m_hasRequest && Clock::now() >= m_requestTime )
+		m_hasRequest = false;
+}
+
+void FrameScheduler::PrintReport( std::ostream & out ) const
+{
+	out << "frame scheduler: " << m_frameCount << " frames, " << m_idleWaitCount << " idle waits, "
+		<< std::chrono::duration<double, std::milli>( m_spinTime ).count() << " ms spinning\n";
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+
+// Decides when the main loop renders and how long it may sleep in between.
+// OnDemand renders only when something changed (input, scene, reloads) or the scene asked for a frame
+// at a given time, and never while the window is hidden; the loop blocks on the OS event queue
+// otherwise. Continuous renders every frame. Either way, a target rate is held by sleeping most of the
+// frame time and spinning the rest, OS sleeps are too coarse to pace frames on their own.
+class FrameScheduler
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	enum class Mode
+	{
+		OnDemand = 0,
+		Continuous,
+	};
+
+	// Upper bound of an idle wait: anything not routed through the event queue is picked up this late
+	static constexpr double MAX_IDLE_WAIT_SECONDS = 0.25;
+
+public:
+	void SetMode( Mode mode ) { m_mode = mode; }
+	Mode GetMode() const { return m_mode; }
+	// 0 leaves the rate to the presentation engine
+	void SetTargetFps( double fps );
+	void SetVisible( bool visible ) { m_isVisible = visible; }
+
+	// Input or scene change, the next frame renders right away
+	void MarkDirty() { m_isDirty = true; }
+	// Scene changing on its own at a known time (animation step...), only the earliest request is kept
+	void RequestFrameIn( double seconds );
+
+	bool ShouldRender( Clock::time_point now ) const;
+	// Time the loop can block on events before a frame is due, capped by MAX_IDLE_WAIT_SECONDS
+	double GetIdleWaitSeconds( Clock::time_point now ) const;
+	void OnIdleWait() { ++m_idleWaitCount; }
+
+	// Blocks until the target frame time since the previous frame start elapsed, then starts the frame
+	void BeginFrame();
+	// Everything marked so far is in the frame being built
+	void OnInputSampled();
+
+	void PrintReport( std::ostream & out ) const;
+
+private:
+	Mode m_mode = Mode::OnDemand;
+	bool m_isVisible = true;
+	bool m_isDirty = true;
+	bool m_hasRequest = false;
+	Clock::time_point m_requestTime;
+
+	Clock::duration m_targetFrameTime = Clock::duration::zero();
+	Clock::time_point m_frameStart;
+	// Largest recent oversleep, the part of a wait that is spun instead of slept
+	Clock::duration m_spinMargin = std::chrono::milliseconds( 1 );
+
+	uint64_t m_frameCount = 0;
+	uint64_t m_idleWaitCount = 0;
+	Clock::duration m_spinTime = Clock::duration::zero();
+};
@@ -0,0 +1,131 @@
+#include <stdafx.h>
+#include "PixelConvert.h"
+
+#if defined( _M_X64 ) || defined( _M_IX86 ) || defined( __x86_64__ ) || defined( __i386__ )
+#define PIXEL_CONVERT_SSSE3 1
+#include <tmmintrin.h>
+#if defined( _MSC_VER )
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit SSSE3 in functions asking for it, MSVC always can
+#if defined( PIXEL_CONVERT_SSSE3 ) && !defined( _MSC_VER )
+#define TARGET_SSSE3 __attribute__( ( target( "ssse3" ) ) )
+#else
+#define TARGET_SSSE3
+#endif
+
+namespace
+{
+#if defined( PIXEL_CONVERT_SSSE3 )
+	bool DetectSsse3()
+	{
+#if defined( _MSC_VER )
+		int info[4];
+		__cpuid( info, 1 );
+		return (info[2] & (1 << 9)) != 0;
+#else
+		return __builtin_cpu_supports( "ssse3" ) != 0;
+#endif
+	}
+
+	const bool s_hasSsse3 = DetectSsse3();
+
+	// 16 pixels per iteration: each 16 byte load is packed to 12 bytes, the four results are
+	// stitched into three 16 byte stores
+	TARGET_SSSE3 uint32_t ConvertToRgbSsse3( const uint8_t * src, uint8_t * dst, uint32_t pixelCount, bool isBgra )
+	{
+		const __m128i pack = isBgra
+			? _mm_setr_epi8( 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1 )
+			: _mm_setr_epi8( 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1 );
+
+		uint32_t i = 0;
+		for ( ; i + 16 <= pixelCount; i += 16 )
+		{
+			const __m128i a = _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i *)(src + 0) ), pack );
+			const __m128i b = _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i *)(src + 16) ), pack );
+			const __m128i c = _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i *)(src + 32) ), pack );
+			const __m128i d = _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i *)(src + 48) ), pack );
+
+			_mm_storeu_si128( (__m128i *)(dst + 0), _mm_or_si128( a, _mm_slli_si128( b, 12 ) ) );
+			_mm_storeu_si128( (__m128i *)(dst + 16), _mm_or_si128( _mm_srli_si128( b, 4 ), _mm_slli_si128( c, 8 ) ) );
+			_mm_storeu_si128( (__m128i *)(dst + 32), _mm_or_si128( _mm_srli_si128( c, 8 ), _mm_slli_si128( d, 4 ) ) );
+
+			src += 64;
+			dst += 48;
+		}
+		return i;
+	}
+#endif
+}
+
+void ConvertToRgbScalar( const uint8_t * src, uint8_t * dst, uint32_t pixelCount, bool isBgra )
+{
+	const uint32_t r = isBgra ? 2 : 0;
+	const uint32_t b = isBgra ? 0 : 2;
+	for ( uint32_t i = 0; i < pixelCount; ++i )
+	{
+		dst[0] = src[r];
+		dst[1] = src[1];
+		dst[2] = src[b];
+		src += 4;
+		dst += 3;
+	}
+}
+
+void ConvertToRgb( const uint8_t * src, uint8_t * dst, uint32_t pixelCount, bool isBgra )
+{
+	uint32_t done = 0;
+#if defined( PIXEL_CONVERT_SSSE3 )
+	if ( s_hasSsse3 )
+		done = ConvertToRgbSsse3( src, dst, pixelCount, isBgra );
+#endif
+	ConvertToRgbScalar( src + done * 4, dst + done * 3, pixelCount - done, isBgra );
+}
+
+void ConvertRgbToI420( const uint8_t * rgb, uint32_t width, uint32_t height, uint8_t * y, uint8_t * u, uint8_t * v )
+{
+	const uint32_t stride = width * 3;
+	for ( uint32_t row = 0; row < height; row += 2 )
+	{
+		const uint8_t * top = rgb + (size_t)row * stride;
+		const uint8_t * bottom = top + stride;
+		uint8_t * yTop = y + (size_t)row * width;
+		uint8_t * yBottom = yTop + width;
+		uint8_t * uRow = u + (size_t)(row / 2) * (width / 2);
+		uint8_t * vRow = v + (size_t)(row / 2) * (width / 2);
+
+		for ( uint32_t col = 0; col < width; col += 2 )
+		{
+			int r = 0;
+			int g = 0;
+			int b = 0;
+			const uint8_t * quad[4] = { top + col * 3, top + col * 3 + 3, bottom + col * 3, bottom + col * 3 + 3 };
+			uint8_t * luma[4] = { yTop + col, yTop + col + 1, yBottom + col, yBottom + col + 1 };
+			for ( uint32_t i = 0; i < 4; ++i )
+			{
+				const int pr = quad[i][0];
+				const int pg = quad[i][1];
+				const int pb = quad[i][2];
+				*luma[i] = (uint8_t)(((66 * pr + 129 * pg + 25 * pb + 128) >> 8) + 16);
+				r += pr;
+				g += pg;
+				b += pb;
+			}
+
+			// Sums of four pixels, hence the extra shift by 2
+			uRow[col / 2] = (uint8_t)(((-38 * r - 74 * g + 112 * b + 512) >> 10) + 128);
+			vRow[col / 2] = (uint8_t)(((112 * r - 94 * g - 18 * b + 512) >> 10) + 128);
+		}
+	}
+}
+
+bool HasSimdPixelConvert()
+{
+#if defined( PIXEL_CONVERT_SSSE3 )
+	return s_hasSsse3;
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <cstdint>
+
+// CPU pixel conversions for frames read back from the GPU. The SSSE3 kernels are picked at run time
+// when the CPU has them, the scalar ones are the reference and handle the tails.
+
+// 4 bytes per pixel in, 3 out. isBgra swaps red and blue on the way, for BGRA8 swap chain images.
+void ConvertToRgb( const uint8_t * src, uint8_t * dst, uint32_t pixelCount, bool isBgra );
+void ConvertToRgbScalar( const uint8_t * src, uint8_t * dst, uint32_t pixelCount, bool isBgra );
+
+// Tightly packed RGB24 to the three I420 planes (BT.601, limited range), chroma averaged over 2x2 blocks.
+// Width and height must be even.
+void ConvertRgbToI420( const uint8_t * rgb, uint32_t width, uint32_t height, uint8_t * y, uint8_t * u, uint8_t * v );
+
+bool HasSimdPixelConvert();
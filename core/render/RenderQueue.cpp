@@ -0,0 +1,182 @@
+#include <stdafx.h>
+#include "RenderQueue.h"
+
+#include <cstddef>
+#include <cstring>
+
+// SSE2 is part of x64, and of every x86 target built with it: a compile-time check is enough
+#if defined( _M_X64 ) || defined( __x86_64__ ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 ) || defined( __SSE2__ )
+#define RENDER_QUEUE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	const uint32_t RADIX_BITS = 8;
+	const uint32_t RADIX_SIZE = 1 << RADIX_BITS;
+	const uint32_t KEY_DIGITS = 64 / RADIX_BITS;
+	// Below this the histograms cost more than the sort
+	const uint32_t INSERTION_SORT_MAX_COUNT = 64;
+	// Consecutive keys land in different copies of the histograms: runs of equal digits, the common case
+	// with sorted-ish input and few states, no longer serialize on one counter's load-increment-store
+	const uint32_t HISTOGRAM_LANES = 4;
+
+	const uint32_t PIPELINE_BITS = 16;
+	const uint32_t RESOURCES_BITS = 15;
+	const uint32_t MATERIAL_BITS = 16;
+	const uint32_t DEPTH_BITS = 16;
+	static_assert( 1 + PIPELINE_BITS + RESOURCES_BITS + MATERIAL_BITS + DEPTH_BITS == 64, "draw key fields must fill 64 bits" );
+
+	static_assert( sizeof( RenderQueueItem ) == 16 && offsetof( RenderQueueItem, key ) == 0, "items are loaded two keys per SSE2 register" );
+
+	uint64_t GetField( uint32_t value, uint32_t bits )
+	{
+		return value & ((1ull << bits) - 1);
+	}
+
+	// Bits set in some keys and clear in others, the ones the sort has to look at
+	uint64_t GetVaryingBits( const RenderQueueItem * items, uint32_t count )
+	{
+		uint64_t orBits = 0;
+		uint64_t andBits = ~0ull;
+		uint32_t i = 0;
+#if defined( RENDER_QUEUE_SSE2 )
+		// The key is the low half of each 16-byte item, two items make one register of keys
+		__m128i orKeys = _mm_setzero_si128();
+		__m128i andKeys = _mm_set1_epi32( -1 );
+		for ( ; i + 4 <= count; i += 4 )
+		{
+			const __m128i a = _mm_unpacklo_epi64( _mm_loadu_si128( (const __m128i *)&items[i] ), _mm_loadu_si128( (const __m128i *)&items[i + 1] ) );
+			const __m128i b = _mm_unpacklo_epi64( _mm_loadu_si128( (const __m128i *)&items[i + 2] ), _mm_loadu_si128( (const __m128i *)&items[i + 3] ) );
+			orKeys = _mm_or_si128( orKeys, _mm_or_si128( a, b ) );
+			andKeys = _mm_and_si128( andKeys, _mm_and_si128( a, b ) );
+		}
+		uint64_t lanes[2];
+		_mm_storeu_si128( (__m128i *)lanes, orKeys );
+		orBits = lanes[0] | lanes[1];
+		_mm_storeu_si128( (__m128i *)lanes, andKeys );
+		andBits = lanes[0] & lanes[1];
+#endif
+		for ( ; i < count; ++i )
+		{
+			orBits |= items[i].key;
+			andBits &= items[i].key;
+		}
+		return orBits ^ andBits;
+	}
+
+	void InsertionSort( RenderQueueItem * items, uint32_t count )
+	{
+		for ( uint32_t i = 1; i < count; ++i )
+		{
+			const RenderQueueItem item = items[i];
+			uint32_t j = i;
+			for ( ; j > 0 && items[j - 1].key > item.key; --j )
+			{
+				items[j] = items[j - 1];
+			}
+			items[j] = item;
+		}
+	}
+}
+
+uint32_t GetDepthBucket( float depth )
+{
+	// Non-negative floats order like their bit patterns; the sign bit is always clear, the next 16 are kept
+	if ( !(depth > 0.0f) )
+		return 0;
+	uint32_t bits;
+	memcpy( &bits, &depth, sizeof( bits ) );
+	return bits >> (31 - DEPTH_BITS);
+}
+
+uint64_t PackDrawKey( const DrawKeyFields & fields )
+{
+	uint64_t state = GetField( fields.pipeline, PIPELINE_BITS );
+	state = (state << RESOURCES_BITS) | GetField( fields.resources, RESOURCES_BITS );
+	state = (state << MATERIAL_BITS) | GetField( fields.material, MATERIAL_BITS );
+
+	const uint64_t depth = GetDepthBucket( fields.depth );
+	if ( fields.translucent )
+	{
+		const uint64_t farFirst = GetField( ~(uint32_t)depth, DEPTH_BITS );
+		return (1ull << 63) | (farFirst << (PIPELINE_BITS + RESOURCES_BITS + MATERIAL_BITS)) | state;
+	}
+	return (state << DEPTH_BITS) | depth;
+}
+
+void SortRenderQueue( RenderQueueItem * items, RenderQueueItem * scratch, uint32_t count )
+{
+	if ( count <= INSERTION_SORT_MAX_COUNT )
+	{
+		InsertionSort( items, count );
+		return;
+	}
+
+	// Only the digits some keys disagree on need a pass: with a few pipelines and materials most bytes are constant
+	const uint64_t varying = GetVaryingBits( items, count );
+	uint32_t shifts[KEY_DIGITS];
+	uint32_t passCount = 0;
+	for ( uint32_t shift = 0; shift < 64; shift += RADIX_BITS )
+	{
+		if ( (varying >> shift) & (RADIX_SIZE - 1) )
+			shifts[passCount++] = shift;
+	}
+	if ( passCount == 0 )
+		return;
+
+	// Every pass's histogram in one sweep, one copy per lane, then merged into the first slot of each digit
+	uint32_t laneHistograms[HISTOGRAM_LANES][KEY_DIGITS][RADIX_SIZE];
+	for ( auto & lane : laneHistograms )
+	{
+		memset( lane, 0, passCount * sizeof( lane[0] ) );
+	}
+	uint32_t i = 0;
+	for ( ; i + HISTOGRAM_LANES <= count; i += HISTOGRAM_LANES )
+	{
+		for ( uint32_t pass = 0; pass < passCount; ++pass )
+		{
+			const uint32_t shift = shifts[pass];
+			for ( uint32_t lane = 0; lane < HISTOGRAM_LANES; ++lane )
+			{
+				++laneHistograms[lane][pass][(items[i + lane].key >> shift) & (RADIX_SIZE - 1)];
+			}
+		}
+	}
+	for ( ; i < count; ++i )
+	{
+		for ( uint32_t pass = 0; pass < passCount; ++pass )
+		{
+			++laneHistograms[0][pass][(items[i].key >> shifts[pass]) & (RADIX_SIZE - 1)];
+		}
+	}
+
+	uint32_t histograms[KEY_DIGITS][RADIX_SIZE];
+	for ( uint32_t pass = 0; pass < passCount; ++pass )
+	{
+		uint32_t offset = 0;
+		for ( uint32_t digit = 0; digit < RADIX_SIZE; ++digit )
+		{
+			histograms[pass][digit] = offset;
+			for ( uint32_t lane = 0; lane < HISTOGRAM_LANES; ++lane )
+			{
+				offset += laneHistograms[lane][pass][digit];
+			}
+		}
+	}
+
+	RenderQueueItem * source = items;
+	RenderQueueItem * target = scratch;
+	for ( uint32_t pass = 0; pass < passCount; ++pass )
+	{
+		uint32_t * offsets = histograms[pass];
+		const uint32_t shift = shifts[pass];
+		for ( uint32_t i = 0; i < count; ++i )
+		{
+			target[offsets[(source[i].key >> shift) & (RADIX_SIZE - 1)]++] = source[i];
+		}
+		std::swap( source, target );
+	}
+	if ( source != items )
+		memcpy( items, source, count * sizeof( RenderQueueItem ) );
+}
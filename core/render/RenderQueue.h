@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+
+// State of one draw, packed by PackDrawKey() into a 64-bit key whose order is the submission order.
+// Opaque draws are grouped by state, the most expensive change first, then go front to back inside a
+// group; translucent draws come after all of them, back to front, state only breaking depth ties:
+//   opaque       translucent:1 | pipeline:16 | resources:15 | material:16 | depth:16
+//   translucent  translucent:1 | far depth:16 | pipeline:16 | resources:15 | material:16
+// Values wider than their field are truncated: that costs state changes, never a wrong bind, as long
+// as binds are decided on the draw's own state rather than on the key.
+struct DrawKeyFields
+{
+	uint32_t pipeline = 0;	// handle index
+	uint32_t resources = 0;	// what the draw binds besides its pipeline: a descriptor set, a vertex buffer
+	uint32_t material = 0;
+	float depth = 0.0f;		// view distance, negative clamps to 0
+	bool translucent = false;
+};
+
+uint64_t PackDrawKey( const DrawKeyFields & fields );
+
+// Depth quantized to 16 bits with the range of a float, nothing to configure: exponent and 8 bits of mantissa
+uint32_t GetDepthBucket( float depth );
+
+struct RenderQueueItem
+{
+	uint64_t key;
+	uint32_t index;		// of the draw in the caller's array
+};
+
+// Stable ascending sort by key: LSD radix sort, 8 bits per pass. A single SSE2 sweep finds the bytes
+// every key shares, their passes are skipped along with their histograms; the histograms of the
+// remaining passes are built in one more sweep, into per-lane copies merged at the end. The counting
+// itself stays scalar: SSE2 has no gather or scatter to increment counters with.
+// Small queues go through an insertion sort.
+// scratch holds count items, the result ends up in items.
+void SortRenderQueue( RenderQueueItem * items, RenderQueueItem * scratch, uint32_t count );
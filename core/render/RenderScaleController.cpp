@@ -0,0 +1,76 @@
+#include <stdafx.h>
+#include "RenderScaleController.h"
+
+#include <cmath>
+#include <ostream>
+
+namespace
+{
+	// Shrinking aims this far under the budget, to land clear of the threshold
+	const double SHRINK_TARGET = 0.9;
+}
+
+RenderScaleController::RenderScaleController( const RenderScaleSettings & settings )
+	: m_settings( settings )
+	, m_scale( settings.maxScale )
+	, m_lowestScale( settings.maxScale )
+{
+}
+
+float RenderScaleController::Update( double gpuMs, float frameScale )
+{
+	m_gpuTime.Add( gpuMs );
+
+	// A frame still in flight when the scale changed is brought to the current scale
+	const double ratio = (double)m_scale / frameScale;
+	const double costMs = gpuMs * ratio * ratio;
+	m_costMs = m_costMs < 0.0 ? costMs : m_costMs + (costMs - m_costMs) * m_settings.smoothing;
+
+	const double budgetMs = m_settings.budgetMs;
+	if ( m_costMs > budgetMs )
+	{
+		m_underBudgetCount = 0;
+		SetScale( (float)(m_scale * std::sqrt( budgetMs * SHRINK_TARGET / m_costMs )) );
+	}
+	else if ( m_costMs < budgetMs * m_settings.growThreshold )
+	{
+		if ( ++m_underBudgetCount >= m_settings.growFrameCount )
+		{
+			m_underBudgetCount = 0;
+			// Only when the grown frame would still be under the threshold
+			const float grown = m_scale + m_settings.growStep;
+			const double grownCostMs = m_costMs * (grown / m_scale) * (grown / m_scale);
+			if ( grownCostMs < budgetMs * m_settings.growThreshold )
+				SetScale( grown );
+		}
+	}
+	else
+	{
+		m_underBudgetCount = 0;
+	}
+	return m_scale;
+}
+
+uint32_t RenderScaleController::ScaleSize( uint32_t size, float scale )
+{
+	return std::max( 1U, (uint32_t)std::lround( size * scale ) );
+}
+
+void RenderScaleController::PrintReport( std::ostream & out ) const
+{
+	out << "render scale " << m_scale << ", lowest " << m_lowestScale << ", " << m_changeCount << " changes, budget " << m_settings.budgetMs << " ms\n";
+	m_gpuTime.PrintReport( out, "  gpu frame" );
+}
+
+void RenderScaleController::SetScale( float scale )
+{
+	scale = std::min( m_settings.maxScale, std::max( m_settings.minScale, scale ) );
+	if ( scale == m_scale )
+		return;
+
+	// The smoothed cost follows the pixel count
+	m_costMs *= ((double)scale / m_scale) * ((double)scale / m_scale);
+	m_scale = scale;
+	m_lowestScale = std::min( m_lowestScale, scale );
+	++m_changeCount;
+}
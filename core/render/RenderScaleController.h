@@ -0,0 +1,50 @@
+#pragma once
+#include "../LatencyWindow.h"
+
+#include <cstdint>
+#include <iosfwd>
+
+struct RenderScaleSettings
+{
+	double budgetMs = 14.0;
+	float minScale = 0.5f;
+	float maxScale = 1.0f;
+	float growStep = 0.05f;
+	// Fraction of the budget the cost must stay under before growing, and after growing
+	double growThreshold = 0.8;
+	uint32_t growFrameCount = 30;
+	// Weight of a new sample in the smoothed cost
+	double smoothing = 0.2;
+};
+
+// Resolution scale holding a GPU frame-time budget. Cost is taken as proportional to the pixel count,
+// the scale squared. Over budget, the scale drops at once to where the frame fits; well under budget for
+// a number of frames in a row, it grows back by a small step. Between the two thresholds nothing changes,
+// so the scale does not oscillate around the budget.
+class RenderScaleController
+{
+public:
+	explicit RenderScaleController( const RenderScaleSettings & settings = RenderScaleSettings() );
+
+	void SetBudgetMs( double budgetMs ) { m_settings.budgetMs = budgetMs; }
+	// GPU time of a frame rendered at frameScale, which lags the current scale by the frames in flight
+	float Update( double gpuMs, float frameScale );
+	float GetScale() const { return m_scale; }
+
+	// Never below one pixel
+	static uint32_t ScaleSize( uint32_t size, float scale );
+
+	void PrintReport( std::ostream & out ) const;
+
+private:
+	void SetScale( float scale );
+
+private:
+	RenderScaleSettings m_settings;
+	float m_scale;
+	double m_costMs = -1.0;	// smoothed, at the current scale
+	uint32_t m_underBudgetCount = 0;
+	uint32_t m_changeCount = 0;
+	float m_lowestScale;
+	LatencyWindow m_gpuTime;
+};
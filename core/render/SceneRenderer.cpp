@@ -0,0 +1,183 @@
+#include <stdafx.h>
+#include "SceneRenderer.h"
+#include "../thread/JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <new>
+
+namespace
+{
+	const uint32_t CULL_BATCH_SIZE = 1024;
+	const size_t FRAME_ARENA_CAPACITY = 1024 * 1024;
+	const size_t COMMAND_ARENA_CAPACITY = 256 * 1024;
+
+	double GetElapsedMs( std::chrono::steady_clock::time_point & start )
+	{
+		const auto now = std::chrono::steady_clock::now();
+		const double ms = std::chrono::duration<double, std::milli>( now - start ).count();
+		start = now;
+		return ms;
+	}
+
+	void SetPlane( float * plane, float a, float b, float c, float d )
+	{
+		const float invLength = 1.0f / std::sqrt( a * a + b * b + c * c );
+		plane[0] = a * invLength;
+		plane[1] = b * invLength;
+		plane[2] = c * invLength;
+		plane[3] = d * invLength;
+	}
+}
+
+//
+//
+//	Frustum =======================================================================================
+//
+//
+Frustum Frustum::FromPerspective( float fovY, float aspect, float zNear, float zFar )
+{
+	const float tanY = std::tan( fovY * 0.5f );
+	const float tanX = tanY * aspect;
+
+	Frustum frustum;
+	SetPlane( frustum.planes[0], 0.0f, 0.0f, -1.0f, -zNear );	// near
+	SetPlane( frustum.planes[1], 0.0f, 0.0f, 1.0f, zFar );		// far
+	SetPlane( frustum.planes[2], 1.0f, 0.0f, -tanX, 0.0f );		// left
+	SetPlane( frustum.planes[3], -1.0f, 0.0f, -tanX, 0.0f );	// right
+	SetPlane( frustum.planes[4], 0.0f, 1.0f, -tanY, 0.0f );		// bottom
+	SetPlane( frustum.planes[5], 0.0f, -1.0f, -tanY, 0.0f );	// top
+	return frustum;
+}
+
+bool Frustum::IsSphereVisible( const float center[3], float radius ) const
+{
+	for ( const float * plane : planes )
+	{
+		if ( plane[0] * center[0] + plane[1] * center[1] + plane[2] * center[2] + plane[3] < -radius )
+			return false;
+	}
+	return true;
+}
+
+float Frustum::GetDepth( const float point[3] ) const
+{
+	const float * plane = planes[0];
+	return plane[0] * point[0] + plane[1] * point[1] + plane[2] * point[2] + plane[3];
+}
+
+//
+//
+//	SceneRenderer =================================================================================
+//
+//
+SceneRenderer::SceneRenderer( IDevice3D & device, JobSystem & jobs )
+	: m_device( device )
+	, m_jobs( jobs )
+	, m_frameArenas( MAX_FRAMES_IN_FLIGHT, FRAME_ARENA_CAPACITY )
+	, m_commandArenas( MAX_FRAMES_IN_FLIGHT, COMMAND_ARENA_CAPACITY )
+{
+}
+
+SceneFrameStats SceneRenderer::RenderFrame( uint64_t frameNumber, const RenderObject * objects, uint32_t count, const Frustum & frustum )
+{
+	SceneFrameStats stats;
+	stats.objectCount = count;
+	auto start = std::chrono::steady_clock::now();
+
+	// The frame slot is free again once the GPU is done with the frame that used it last
+	const uint32_t slot = (uint32_t)(frameNumber % MAX_FRAMES_IN_FLIGHT);
+	if ( m_frameSerials[slot] && !m_device.IsComplete( IDevice3D::GraphicsQueue, m_frameSerials[slot] ) )
+		m_device.WaitComplete( IDevice3D::GraphicsQueue, m_frameSerials[slot] );
+	LinearArena & arena = m_frameArenas.BeginFrame( frameNumber );
+	m_commandArenas.BeginFrame( frameNumber );
+	stats.waitMs = GetElapsedMs( start );
+
+	uint8_t * visible = arena.AllocateArray<uint8_t>( count );
+	m_jobs.ParallelFor( count, CULL_BATCH_SIZE, [&]( uint32_t begin, uint32_t end ) {
+		for ( uint32_t i = begin; i < end; ++i )
+		{
+			visible[i] = frustum.IsSphereVisible( objects[i].center, objects[i].radius ) ? 1 : 0;
+		}
+	} );
+
+	RenderQueueItem * items = arena.AllocateArray<RenderQueueItem>( count );
+	uint32_t itemCount = 0;
+	for ( uint32_t i = 0; i < count; ++i )
+	{
+		if ( !visible[i] )
+			continue;
+		const RenderObject & object = objects[i];
+		DrawKeyFields fields;
+		fields.pipeline = object.pipeline.GetIndex();
+		fields.resources = object.vertexBuffer.GetIndex();
+		fields.material = object.materialIndex;
+		fields.depth = frustum.GetDepth( object.center );
+		fields.translucent = object.translucent;
+		items[itemCount].key = PackDrawKey( fields );
+		items[itemCount].index = i;
+		++itemCount;
+	}
+	stats.visibleCount = itemCount;
+	stats.cullMs = GetElapsedMs( start );
+
+	RenderQueueItem * sortScratch = arena.AllocateArray<RenderQueueItem>( itemCount );
+	SortRenderQueue( items, sortScratch, itemCount );
+	stats.sortMs = GetElapsedMs( start );
+
+	// One list per contiguous range of sorted draws, each recorded by whichever worker picks it up
+	const uint32_t maxLists = std::max( 1U, m_jobs.GetWorkerCount() );
+	const uint32_t listCount = std::min( maxLists, (itemCount + MIN_DRAWS_PER_LIST - 1) / MIN_DRAWS_PER_LIST );
+	CommandList ** lists = arena.AllocateArray<CommandList *>( std::max( 1U, listCount ) );
+	const uint32_t drawsPerList = listCount ? (itemCount + listCount - 1) / listCount : 0;
+	m_jobs.ParallelFor( listCount, 1, [&]( uint32_t begin, uint32_t end ) {
+		for ( uint32_t i = begin; i < end; ++i )
+		{
+			LinearArena & listArena = m_commandArenas.GetArena();
+			lists[i] = new ( listArena.Allocate( sizeof( CommandList ), alignof( CommandList ) ) ) CommandList( listArena );
+			Encode( *lists[i], objects, items, i * drawsPerList, std::min( itemCount, (i + 1) * drawsPerList ) );
+		}
+	} );
+	stats.listCount = listCount;
+	stats.encodeMs = GetElapsedMs( start );
+
+	m_frameSerials[slot] = m_device.Submit( IDevice3D::GraphicsQueue, lists, listCount );
+	stats.submitMs = GetElapsedMs( start );
+	return stats;
+}
+
+void SceneRenderer::WaitIdle()
+{
+	for ( uint64_t serial : m_frameSerials )
+	{
+		if ( serial )
+			m_device.WaitComplete( IDevice3D::GraphicsQueue, serial );
+	}
+}
+
+void SceneRenderer::Encode( CommandList & list, const RenderObject * objects, const RenderQueueItem * items, uint32_t begin, uint32_t end )
+{
+	// Sorted by key, state only changes at key boundaries. Binds still compare the handles, a key field
+	// too narrow for one would only cost extra binds. Every list starts with nothing bound.
+	PipelineHandle pipeline;
+	BufferHandle vertexBuffer;
+	for ( uint32_t i = begin; i < end; ++i )
+	{
+		const RenderObject & object = objects[items[i].index];
+		if ( object.pipeline != pipeline )
+		{
+			list.BindPipeline( object.pipeline );
+			pipeline = object.pipeline;
+		}
+		if ( object.vertexBuffer != vertexBuffer )
+		{
+			list.BindVertexBuffer( 0, object.vertexBuffer );
+			vertexBuffer = object.vertexBuffer;
+		}
+
+		const DrawConstants constants = { items[i].index, object.materialIndex };
+		list.PushConstants( constants );
+		list.Draw( object.vertexCount );
+	}
+}
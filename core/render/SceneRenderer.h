@@ -0,0 +1,80 @@
+#pragma once
+#include "../device.h"
+#include "../CommandList.h"
+#include "../memory/LinearArena.h"
+#include "RenderQueue.h"
+
+#include <cstdint>
+
+class JobSystem;
+
+struct RenderObject
+{
+	float center[3];
+	float radius;
+	PipelineHandle pipeline;
+	BufferHandle vertexBuffer;
+	uint32_t vertexCount;
+	uint32_t materialIndex;
+	bool translucent;	// drawn after every opaque object, back to front
+};
+
+// Per-draw push constants of the scene draws
+struct DrawConstants
+{
+	uint32_t objectIndex;
+	uint32_t materialIndex;
+};
+
+// View volume as 6 inward-facing planes (a, b, c, d): a point p is inside a plane when dot( abc, p ) + d >= 0
+struct Frustum
+{
+	float planes[6][4];
+
+	// Camera at the origin looking down -Z
+	static Frustum FromPerspective( float fovY, float aspect, float zNear, float zFar );
+	bool IsSphereVisible( const float center[3], float radius ) const;
+	// Signed distance to the near plane, the view depth used to order draws
+	float GetDepth( const float point[3] ) const;
+};
+
+struct SceneFrameStats
+{
+	uint32_t objectCount = 0;
+	uint32_t visibleCount = 0;
+	uint32_t listCount = 0;
+	double waitMs = 0.0;
+	double cullMs = 0.0;
+	double sortMs = 0.0;
+	double encodeMs = 0.0;
+	double submitMs = 0.0;
+};
+
+// Backend-agnostic frame: cull the objects against the frustum, sort the visible ones by their draw
+// key (RenderQueue.h: state, then depth, translucent objects last), encode them into command lists on every worker and submit the lists on the graphics queue.
+// Against Device3DNull this is the engine CPU cost of a frame with the driver taken out.
+// Draws are submitted outside of any render pass, the abstraction does not model render targets yet.
+class SceneRenderer
+{
+public:
+	static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+	// Fewer draws than this per list costs more in list overhead than the parallel encode gains
+	static constexpr uint32_t MIN_DRAWS_PER_LIST = 256;
+
+public:
+	SceneRenderer( IDevice3D & device, JobSystem & jobs );
+
+	SceneFrameStats RenderFrame( uint64_t frameNumber, const RenderObject * objects, uint32_t count, const Frustum & frustum );
+	// Waits for every submitted frame
+	void WaitIdle();
+
+private:
+	void Encode( CommandList & list, const RenderObject * objects, const RenderQueueItem * items, uint32_t begin, uint32_t end );
+
+private:
+	IDevice3D & m_device;
+	JobSystem & m_jobs;
+	FrameArenas m_frameArenas;
+	CommandArenas m_commandArenas;
+	uint64_t m_frameSerials[MAX_FRAMES_IN_FLIGHT] = {};
+};
@@ -0,0 +1,199 @@
+#include <stdafx.h>
+#include "ShaderCompiler.h"
+#include "../Hash.h"
+
+#include <sstream>
+#include <glslang/Public/ShaderLang.h>
+#include <glslang/Public/ResourceLimits.h>
+#include <SPIRV/GlslangToSpv.h>
+
+namespace
+{
+	// Bump when the compiler or its options change, to invalidate every cached blob
+	const uint32_t COMPILER_VERSION = 1;
+	const int MAX_INCLUDE_DEPTH = 16;
+
+	std::atomic<int> s_glslangUsers( 0 );
+
+	std::string ReadText( const std::string & path )
+	{
+		std::ifstream file( path, std::ios::binary );
+		if ( !file.is_open() )
+		{
+			throw std::runtime_error( "cannot open shader " + path );
+		}
+		std::stringstream ss;
+		ss << file.rdbuf();
+		return ss.str();
+	}
+
+	// Makes the next line number line of path in glslang's messages. The file name form needs
+	// GL_GOOGLE_cpp_style_line_directive, enabled right after #version.
+	std::string LineDirective( uint32_t line, const std::string & path )
+	{
+		std::string name = path;
+		std::replace( name.begin(), name.end(), '\\', '/' );
+		return "#line " + std::to_string( line ) + " \"" + name + "\"\n";
+	}
+
+	std::string DirectoryOf( const std::string & path )
+	{
+		size_t slash = path.find_last_of( "/\\" );
+		return slash == std::string::npos ? std::string() : path.substr( 0, slash + 1 );
+	}
+
+	EShLanguage ToGlslang( ShaderStage stage )
+	{
+		switch ( stage )
+		{
+		case ShaderStage::Vertex: return EShLangVertex;
+		case ShaderStage::Fragment: return EShLangFragment;
+		case ShaderStage::Compute: return EShLangCompute;
+		}
+		return EShLangVertex;
+	}
+}
+
+ShaderCompiler::ShaderCompiler( const std::string & cacheDirectory )
+	: m_store( cacheDirectory )
+{
+	if ( s_glslangUsers++ == 0 )
+	{
+		glslang::InitializeProcess();
+	}
+}
+
+ShaderCompiler::~ShaderCompiler()
+{
+	if ( --s_glslangUsers == 0 )
+	{
+		glslang::FinalizeProcess();
+	}
+}
+
+ShaderBinary ShaderCompiler::Compile( const ShaderDesc & desc )
+{
+	ShaderBinary binary;
+	const std::string source = Preprocess( desc.path, binary.dependencies, 0 );
+
+	uint64_t hash = HashValue( COMPILER_VERSION );
+	hash = HashValue( desc.stage, hash );
+	hash = HashValue( desc.target, hash );
+	hash = HashBytes( source.data(), source.size(), hash );
+	for ( const auto & define : desc.defines )
+	{
+		hash = HashBytes( define.data(), define.size() + 1, hash );
+	}
+	binary.hash = hash;
+
+	if ( !m_store.Find( hash, binary.spirv ) )
+	{
+		binary.spirv = m_store.Insert( hash, CompileGlsl( source, desc ) );
+		++m_compileCount;
+	}
+	return binary;
+}
+
+// Inlines #include "file" directives so the cache key sees the whole translation unit.
+// #line directives around every include keep glslang's messages on the original files and lines.
+std::string ShaderCompiler::Preprocess( const std::string & path, std::vector<std::string> & dependencies, int depth )
+{
+	if ( depth > MAX_INCLUDE_DEPTH )
+	{
+		throw std::runtime_error( "shader include depth exceeded in " + path );
+	}
+
+	dependencies.push_back( path );
+
+	std::istringstream input( ReadText( path ) );
+	std::string output;
+	std::string line;
+	uint32_t lineNumber = 0;
+	bool lineDirectivesEnabled = depth > 0;
+	while ( std::getline( input, line ) )
+	{
+		++lineNumber;
+		size_t first = line.find_first_not_of( " \t" );
+		if ( first != std::string::npos && line.compare( first, 8, "#version" ) == 0 && !lineDirectivesEnabled )
+		{
+			output += line;
+			output += "\n#extension GL_GOOGLE_cpp_style_line_directive : require\n";
+			output += LineDirective( lineNumber + 1, path );
+			lineDirectivesEnabled = true;
+			continue;
+		}
+
+		if ( first != std::string::npos && line.compare( first, 8, "#include" ) == 0 )
+		{
+			size_t open = line.find( '"', first + 8 );
+			size_t close = open == std::string::npos ? open : line.find( '"', open + 1 );
+			if ( close == std::string::npos )
+			{
+				throw std::runtime_error( "malformed #include in " + path );
+			}
+			if ( !lineDirectivesEnabled )
+			{
+				throw std::runtime_error( "#include before #version in " + path );
+			}
+
+			const std::string included = DirectoryOf( path ) + line.substr( open + 1, close - open - 1 );
+			if ( std::find( dependencies.begin(), dependencies.end(), included ) == dependencies.end() )
+			{
+				output += LineDirective( 1, included );
+				output += Preprocess( included, dependencies, depth + 1 );
+				output += LineDirective( lineNumber + 1, path );
+			}
+			else
+			{
+				// Already inlined: an empty line keeps the numbering
+				output += '\n';
+			}
+			continue;
+		}
+
+		output += line;
+		output += '\n';
+	}
+	return output;
+}
+
+std::vector<uint32_t> ShaderCompiler::CompileGlsl( const std::string & source, const ShaderDesc & desc )
+{
+	const EShLanguage stage = ToGlslang( desc.stage );
+
+	std::string preamble;
+	for ( const auto & define : desc.defines )
+	{
+		size_t eq = define.find( '=' );
+		preamble += "#define ";
+		preamble += eq == std::string::npos ? define : define.substr( 0, eq ) + " " + define.substr( eq + 1 );
+		preamble += '\n';
+	}
+
+	const char * text = source.c_str();
+	glslang::TShader shader( stage );
+	shader.setStrings( &text, 1 );
+	shader.setPreamble( preamble.c_str() );
+	if ( desc.target == ShaderTarget::Vulkan11 )
+	{
+		shader.setEnvClient( glslang::EShClientVulkan, glslang::EShTargetVulkan_1_1 );
+		shader.setEnvTarget( glslang::EShTargetSpv, glslang::EShTargetSpv_1_3 );
+	}
+
+	const EShMessages messages = (EShMessages)(EShMsgSpvRules | EShMsgVulkanRules);
+	if ( !shader.parse( GetDefaultResources(), 100, false, messages ) )
+	{
+		throw std::runtime_error( desc.path + ": " + shader.getInfoLog() );
+	}
+
+	glslang::TProgram program;
+	program.addShader( &shader );
+	if ( !program.link( messages ) )
+	{
+		throw std::runtime_error( desc.path + ": " + program.getInfoLog() );
+	}
+
+	std::vector<uint32_t> spirv;
+	glslang::GlslangToSpv( *program.getIntermediate( stage ), spirv );
+	return spirv;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "SpirvStore.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+enum class ShaderStage
+{
+	Vertex = 0,
+	Fragment,
+	Compute,
+};
+
+enum class ShaderTarget
+{
+	Vulkan10 = 0,	// SPIR-V 1.0
+	Vulkan11,		// SPIR-V 1.3, needed by the subgroup extensions
+};
+
+struct ShaderDesc
+{
+	std::string path;
+	ShaderStage stage = ShaderStage::Vertex;
+	std::vector<std::string> defines;	// "NAME" or "NAME=VALUE"
+	ShaderTarget target = ShaderTarget::Vulkan10;
+};
+
+struct ShaderBinary
+{
+	uint64_t hash = 0;
+	SpirvBlob spirv;
+	std::vector<std::string> dependencies;	// source file first, then every resolved include
+};
+
+// In-process GLSL to SPIR-V compiler backed by a content-hashed disk cache.
+// The cache key covers the fully expanded source (includes inlined), the defines and the stage,
+// so an unchanged shader is never handed to glslang twice, even across runs.
+class ShaderCompiler
+{
+public:
+	explicit ShaderCompiler( const std::string & cacheDirectory );
+	~ShaderCompiler();
+
+	ShaderBinary Compile( const ShaderDesc & desc );
+
+	uint32_t GetCompileCount() const { return m_compileCount; }
+
+private:
+	std::string Preprocess( const std::string & path, std::vector<std::string> & dependencies, int depth );
+	std::vector<uint32_t> CompileGlsl( const std::string & source, const ShaderDesc & desc );
+
+private:
+	SpirvStore m_store;
+	std::atomic<uint32_t> m_compileCount{ 0 };
+};
@@ -0,0 +1,143 @@
+#include <stdafx.h>
+#include "ShaderWatcher.h"
+
+#include <chrono>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+	// Last write time with sub-second resolution, 0 when the file is missing
+	int64_t FileStamp( const std::string & path )
+	{
+#ifdef _WIN32
+		WIN32_FILE_ATTRIBUTE_DATA data;
+		if ( !GetFileAttributesExA( path.c_str(), GetFileExInfoStandard, &data ) )
+			return 0;
+		return ((int64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+#else
+		struct stat st;
+		if ( stat( path.c_str(), &st ) != 0 )
+			return 0;
+		return (int64_t)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+	}
+
+	std::vector<int64_t> StampAll( const std::vector<std::string> & paths )
+	{
+		std::vector<int64_t> stamps;
+		stamps.reserve( paths.size() );
+		for ( const auto & path : paths )
+		{
+			stamps.push_back( FileStamp( path ) );
+		}
+		return stamps;
+	}
+}
+
+ShaderWatcher::ShaderWatcher( ShaderCompiler & compiler, unsigned int pollIntervalMs )
+	: m_compiler( compiler )
+	, m_pollIntervalMs( pollIntervalMs )
+{
+	m_thread = std::thread( &ShaderWatcher::ThreadMain, this );
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+	{
+		std::lock_guard<std::mutex> lock( m_mutex );
+		m_quit = true;
+	}
+	m_wakeUp.notify_one();
+	m_thread.join();
+}
+
+void ShaderWatcher::Watch( const ShaderDesc & desc, const ShaderBinary & current, ReloadCallback callback )
+{
+	Entry entry;
+	entry.desc = desc;
+	entry.dependencies = current.dependencies;
+	entry.stamps = StampAll( current.dependencies );
+	entry.hash = current.hash;
+	entry.callback = callback;
+
+	std::lock_guard<std::mutex> lock( m_mutex );
+	m_entries.push_back( std::move( entry ) );
+}
+
+void ShaderWatcher::DispatchReloads()
+{
+	// Called every frame: bail out before building anything, even empty containers allocate in debug STL builds
+	std::unique_lock<std::mutex> lock( m_mutex );
+	if ( m_pending.empty() )
+		return;
+
+	std::vector<Reload> reloads;
+	std::vector<ReloadCallback> callbacks;
+	{
+		reloads.swap( m_pending );
+		for ( const auto & reload : reloads )
+		{
+			callbacks.push_back( m_entries[reload.entryIdx].callback );
+		}
+		lock.unlock();
+	}
+
+	// Callbacks run unlocked, they are free to call Watch()
+	for ( size_t i = 0; i < reloads.size(); ++i )
+	{
+		callbacks[i]( reloads[i].binary );
+	}
+}
+
+void ShaderWatcher::ThreadMain()
+{
+	std::unique_lock<std::mutex> lock( m_mutex );
+	while ( !m_quit )
+	{
+		m_wakeUp.wait_for( lock, std::chrono::milliseconds( m_pollIntervalMs ) );
+		if ( m_quit )
+			break;
+
+		for ( size_t i = 0; i < m_entries.size(); ++i )
+		{
+			Entry & entry = m_entries[i];
+			std::vector<int64_t> stamps = StampAll( entry.dependencies );
+			if ( stamps == entry.stamps )
+				continue;
+
+			// Compile unlocked so the main thread never waits on glslang
+			entry.stamps = stamps;
+			const ShaderDesc desc = entry.desc;
+			lock.unlock();
+
+			ShaderBinary binary;
+			bool success = true;
+			try
+			{
+				binary = m_compiler.Compile( desc );
+			}
+			catch ( const std::runtime_error & e )
+			{
+				// Keep the previous binary alive, the next save will retry
+				std::cerr << "shader reload failed: " << e.what() << std::endl;
+				success = false;
+			}
+
+			lock.lock();
+			Entry & current = m_entries[i];
+			if ( success && binary.hash != current.hash )
+			{
+				current.hash = binary.hash;
+				current.dependencies = binary.dependencies;
+				current.stamps = StampAll( binary.dependencies );
+				m_pending.push_back( Reload{ i, std::move( binary ) } );
+			}
+		}
+	}
+}
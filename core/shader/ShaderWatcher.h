@@ -0,0 +1,52 @@
+#pragma once
+#include "ShaderCompiler.h"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Polls the source files (and includes) of watched shaders on a background thread and
+// recompiles the ones that changed. Results are handed back on the caller's thread through
+// DispatchReloads(), which is where pipelines depending on the shader get rebuilt.
+class ShaderWatcher
+{
+public:
+	typedef std::function<void( const ShaderBinary & )> ReloadCallback;
+
+public:
+	explicit ShaderWatcher( ShaderCompiler & compiler, unsigned int pollIntervalMs = 20 );
+	~ShaderWatcher();
+
+	void Watch( const ShaderDesc & desc, const ShaderBinary & current, ReloadCallback callback );
+	void DispatchReloads();
+
+private:
+	struct Entry
+	{
+		ShaderDesc desc;
+		std::vector<std::string> dependencies;
+		std::vector<int64_t> stamps;
+		uint64_t hash;
+		ReloadCallback callback;
+	};
+
+	struct Reload
+	{
+		size_t entryIdx;
+		ShaderBinary binary;
+	};
+
+	void ThreadMain();
+
+private:
+	ShaderCompiler & m_compiler;
+	unsigned int m_pollIntervalMs;
+	std::mutex m_mutex;
+	std::condition_variable m_wakeUp;
+	bool m_quit = false;
+	std::vector<Entry> m_entries;
+	std::vector<Reload> m_pending;
+	std::thread m_thread;
+};
@@ -0,0 +1,91 @@
+#include <stdafx.h>
+#include "SpirvStore.h"
+
+#include <cstdio>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+namespace
+{
+	const uint32_t SPIRV_MAGIC = 0x07230203;
+
+	void MakeDirectory( const std::string & path )
+	{
+#ifdef _WIN32
+		_mkdir( path.c_str() );
+#else
+		mkdir( path.c_str(), 0755 );
+#endif
+	}
+}
+
+SpirvStore::SpirvStore( const std::string & directory )
+	: m_directory( directory )
+{
+	MakeDirectory( m_directory );
+}
+
+bool SpirvStore::Find( uint64_t key, SpirvBlob & blob )
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	return MapLocked( key, blob );
+}
+
+SpirvBlob SpirvStore::Insert( uint64_t key, const std::vector<uint32_t> & words )
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+
+	SpirvBlob blob;
+	if ( MapLocked( key, blob ) )
+		return blob;
+
+	// Write to a temporary file then rename so a concurrent reader never maps a partial blob
+	const std::string path = PathFor( key );
+	const std::string tmpPath = path + ".tmp";
+	{
+		std::ofstream file( tmpPath, std::ios::binary | std::ios::trunc );
+		if ( !file.is_open() )
+		{
+			throw std::runtime_error( "cannot write shader cache entry " + tmpPath );
+		}
+		file.write( reinterpret_cast<const char *>( words.data() ), words.size() * sizeof( uint32_t ) );
+	}
+
+	std::remove( path.c_str() );
+	if ( std::rename( tmpPath.c_str(), path.c_str() ) != 0 || !MapLocked( key, blob ) )
+	{
+		throw std::runtime_error( "cannot store shader cache entry " + path );
+	}
+	return blob;
+}
+
+std::string SpirvStore::PathFor( uint64_t key ) const
+{
+	char name[32];
+	snprintf( name, sizeof( name ), "%016llx.spv", (unsigned long long)key );
+	return m_directory + "/" + name;
+}
+
+bool SpirvStore::MapLocked( uint64_t key, SpirvBlob & blob )
+{
+	auto it = m_files.find( key );
+	if ( it == m_files.end() )
+	{
+		std::unique_ptr<MappedFile> file( new MappedFile );
+		if ( !file->OpenRead( PathFor( key ) ) )
+			return false;
+
+		// Reject truncated or foreign files, they will be overwritten by the next insert
+		const uint32_t * words = static_cast<const uint32_t *>( file->Data() );
+		if ( file->Size() % sizeof( uint32_t ) != 0 || words[0] != SPIRV_MAGIC )
+			return false;
+
+		it = m_files.emplace( key, std::move( file ) ).first;
+	}
+
+	blob.words = static_cast<const uint32_t *>( it->second->Data() );
+	blob.wordCount = it->second->Size() / sizeof( uint32_t );
+	return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "../io/MappedFile.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// View on SPIR-V words living in a mapped cache file.
+struct SpirvBlob
+{
+	const uint32_t * words = nullptr;
+	size_t wordCount = 0;
+
+	size_t SizeInBytes() const { return wordCount * sizeof( uint32_t ); }
+	bool IsValid() const { return words != nullptr && wordCount > 0; }
+};
+
+// Disk cache of SPIR-V blobs keyed by a 64-bit content hash. One file per key, mapped on
+// first access and kept mapped for the lifetime of the store so blobs are never copied.
+class SpirvStore
+{
+public:
+	explicit SpirvStore( const std::string & directory );
+
+	bool Find( uint64_t key, SpirvBlob & blob );
+	SpirvBlob Insert( uint64_t key, const std::vector<uint32_t> & words );
+
+private:
+	std::string PathFor( uint64_t key ) const;
+	bool MapLocked( uint64_t key, SpirvBlob & blob );
+
+private:
+	std::string m_directory;
+	std::mutex m_mutex;
+	std::unordered_map<uint64_t, std::unique_ptr<MappedFile>> m_files;
+};
@@ -0,0 +1,69 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Fixed capacity FIFO between a producer and a consumer thread.
+// Push() blocks while the queue is full, which is how a producer running ahead gets throttled,
+// Pop() blocks while it is empty. Close() releases both sides; Pop() still drains what is queued.
+template<typename T>
+class BoundedQueue
+{
+public:
+	explicit BoundedQueue( uint32_t capacity )
+		: m_items( capacity )
+	{
+	}
+
+	bool Push( T && item )
+	{
+		std::unique_lock<std::mutex> lock( m_mutex );
+		m_notFull.wait( lock, [this] { return m_count < m_items.size() || m_closed; } );
+		if ( m_closed )
+			return false;
+
+		m_items[(m_head + m_count) % m_items.size()] = std::move( item );
+		++m_count;
+		lock.unlock();
+		m_notEmpty.notify_one();
+		return true;
+	}
+
+	bool Pop( T & item )
+	{
+		std::unique_lock<std::mutex> lock( m_mutex );
+		m_notEmpty.wait( lock, [this] { return m_count > 0 || m_closed; } );
+		if ( m_count == 0 )
+			return false;
+
+		item = std::move( m_items[m_head] );
+		m_head = (m_head + 1) % m_items.size();
+		--m_count;
+		lock.unlock();
+		m_notFull.notify_one();
+		return true;
+	}
+
+	void Close()
+	{
+		{
+			std::lock_guard<std::mutex> lock( m_mutex );
+			m_closed = true;
+		}
+		m_notFull.notify_all();
+		m_notEmpty.notify_all();
+	}
+
+	uint32_t GetCapacity() const { return (uint32_t)m_items.size(); }
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_notFull;
+	std::condition_variable m_notEmpty;
+	std::vector<T> m_items;
+	size_t m_head = 0;
+	size_t m_count = 0;
+	bool m_closed = false;
+};
@@ -0,0 +1,316 @@
+#include <stdafx.h>
+#include "JobSystem.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace
+{
+	thread_local int s_workerIdx = -1;
+
+	// Spins before a worker with nothing to do goes to sleep
+	const uint32_t IDLE_SPIN_COUNT = 64;
+
+	void PinCurrentThread( uint32_t core )
+	{
+#ifdef _WIN32
+		SetThreadAffinityMask( GetCurrentThread(), DWORD_PTR( 1 ) << (core % (sizeof( DWORD_PTR ) * 8)) );
+#else
+		cpu_set_t set;
+		CPU_ZERO( &set );
+		CPU_SET( core % CPU_SETSIZE, &set );
+		pthread_setaffinity_np( pthread_self(), sizeof( set ), &set );
+#endif
+	}
+
+	uint32_t XorShift( uint32_t & state )
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+}
+
+JobSystem::JobSystem()
+{
+}
+
+JobSystem::~JobSystem()
+{
+	Shutdown();
+}
+
+int JobSystem::GetCurrentWorkerIdx()
+{
+	return s_workerIdx;
+}
+
+void JobSystem::Init( uint32_t workerCount, bool pinThreads )
+{
+	assert( !m_running );
+
+	if ( workerCount == 0 )
+	{
+		workerCount = std::max( 1U, std::thread::hardware_concurrency() );
+	}
+
+	m_workers.clear();
+	for ( uint32_t i = 0; i < workerCount; ++i )
+	{
+		m_workers.emplace_back( new Worker );
+		m_workers[i]->rngState = 0x9E3779B9U * (i + 1);
+	}
+
+	// The calling thread is the main thread and stays unpinned, GLFW and the OS own its scheduling
+	s_workerIdx = 0;
+	m_running = true;
+
+	for ( uint32_t i = 1; i < workerCount; ++i )
+	{
+		m_workers[i]->thread = std::thread( &JobSystem::WorkerMain, this, i, pinThreads );
+	}
+}
+
+void JobSystem::Shutdown()
+{
+	if ( !m_running )
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock( m_sleepMutex );
+		m_running = false;
+	}
+	m_sleepCv.notify_all();
+
+	for ( auto & worker : m_workers )
+	{
+		if ( worker->thread.joinable() )
+			worker->thread.join();
+	}
+	m_workers.clear();
+	s_workerIdx = -1;
+}
+
+void JobSystem::Run( JobFunction function, void * data, JobCounter * counter, Affinity affinity )
+{
+	Job job;
+	job.function = function;
+	job.data = data;
+	job.counter = counter;
+
+	if ( counter )
+	{
+		counter->value.fetch_add( 1, std::memory_order_relaxed );
+	}
+
+	const int workerIdx = s_workerIdx;
+	if ( affinity == MainThread || workerIdx < 0 )
+	{
+		std::lock_guard<std::mutex> lock( m_queueMutex );
+		if ( affinity == MainThread )
+		{
+			m_mainThread.push_back( job );
+		}
+		else
+		{
+			m_injected.push_back( job );
+			m_injectedCount.fetch_add( 1, std::memory_order_release );
+		}
+	}
+	else
+	{
+		Worker & worker = *m_workers[workerIdx];
+		JobSlot * slot = ClaimSlot( worker );
+		if ( slot )
+		{
+			slot->job = job;
+			if ( !worker.deque.Push( slot ) )
+			{
+				slot->busy.store( false, std::memory_order_relaxed );
+				slot = nullptr;
+			}
+		}
+		if ( !slot )
+		{
+			// Deque or slots full: running inline keeps the ordering guarantees of the counter
+			Execute( job );
+			return;
+		}
+	}
+
+	WakeWorkers();
+}
+
+void JobSystem::Wait( JobCounter & counter )
+{
+	const bool isMainThread = s_workerIdx == 0;
+	Job job;
+	while ( !counter.IsDone() )
+	{
+		if ( s_workerIdx >= 0 && FetchJob( job, isMainThread ) )
+		{
+			Execute( job );
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::PumpMainThread()
+{
+	assert( s_workerIdx == 0 );
+
+	std::deque<Job> jobs;
+	{
+		std::lock_guard<std::mutex> lock( m_queueMutex );
+		jobs.swap( m_mainThread );
+	}
+
+	for ( const auto & job : jobs )
+	{
+		Execute( job );
+	}
+}
+
+void JobSystem::WorkerMain( uint32_t workerIdx, bool pin )
+{
+	s_workerIdx = (int)workerIdx;
+	if ( pin )
+	{
+		PinCurrentThread( workerIdx );
+	}
+
+	Job job;
+	uint32_t idleSpins = 0;
+	while ( m_running.load( std::memory_order_relaxed ) )
+	{
+		if ( FetchJob( job, false ) )
+		{
+			Execute( job );
+			idleSpins = 0;
+			continue;
+		}
+
+		if ( ++idleSpins < IDLE_SPIN_COUNT )
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		// Sleep until new work is published; the timeout covers a wake-up racing with the sleep
+		std::unique_lock<std::mutex> lock( m_sleepMutex );
+		m_sleeping.fetch_add( 1, std::memory_order_seq_cst );
+		if ( m_running )
+		{
+			m_sleepCv.wait_for( lock, std::chrono::milliseconds( 1 ) );
+		}
+		m_sleeping.fetch_sub( 1, std::memory_order_relaxed );
+		idleSpins = 0;
+	}
+}
+
+bool JobSystem::FetchJob( Job & job, bool allowMainThread )
+{
+	Worker & self = *m_workers[s_workerIdx];
+
+	if ( allowMainThread )
+	{
+		std::lock_guard<std::mutex> lock( m_queueMutex );
+		if ( !m_mainThread.empty() )
+		{
+			job = m_mainThread.front();
+			m_mainThread.pop_front();
+			return true;
+		}
+	}
+
+	if ( JobSlot * local = self.deque.Pop() )
+	{
+		TakeJob( *local, job );
+		return true;
+	}
+
+	if ( m_injectedCount.load( std::memory_order_acquire ) > 0 )
+	{
+		std::lock_guard<std::mutex> lock( m_queueMutex );
+		if ( !m_injected.empty() )
+		{
+			job = m_injected.front();
+			m_injected.pop_front();
+			m_injectedCount.fetch_sub( 1, std::memory_order_relaxed );
+			return true;
+		}
+	}
+
+	return StealJob( self, job );
+}
+
+bool JobSystem::StealJob( Worker & self, Job & job )
+{
+	const uint32_t count = (uint32_t)m_workers.size();
+	if ( count < 2 )
+		return false;
+
+	// Random start so thieves spread over victims instead of all hitting worker 0
+	const uint32_t start = XorShift( self.rngState ) % count;
+	for ( uint32_t i = 0; i < count; ++i )
+	{
+		Worker & victim = *m_workers[(start + i) % count];
+		if ( &victim == &self )
+			continue;
+
+		if ( JobSlot * stolen = victim.deque.Steal() )
+		{
+			TakeJob( *stolen, job );
+			return true;
+		}
+	}
+	return false;
+}
+
+JobSystem::JobSlot * JobSystem::ClaimSlot( Worker & worker )
+{
+	for ( uint32_t i = 0; i < POOL_SIZE; ++i )
+	{
+		JobSlot & slot = worker.pool[worker.poolNext++ % POOL_SIZE];
+		// Acquire pairs with the release in TakeJob, the previous reader is done with the job
+		if ( !slot.busy.load( std::memory_order_acquire ) )
+		{
+			slot.busy.store( true, std::memory_order_relaxed );
+			return &slot;
+		}
+	}
+	return nullptr;
+}
+
+void JobSystem::TakeJob( JobSlot & slot, Job & job )
+{
+	job = slot.job;
+	slot.busy.store( false, std::memory_order_release );
+}
+
+void JobSystem::Execute( const Job & job )
+{
+	job.function( job.data );
+	if ( job.counter )
+	{
+		job.counter->value.fetch_sub( 1, std::memory_order_release );
+	}
+}
+
+void JobSystem::WakeWorkers()
+{
+	if ( m_sleeping.load( std::memory_order_seq_cst ) > 0 )
+	{
+		m_sleepCv.notify_one();
+	}
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "WorkStealingDeque.h"
+#include "../memory/LinearArena.h"
+
+typedef void ( *JobFunction )( void * data );
+
+// Number of jobs still to complete. Jobs started with a counter decrement it when done,
+// a job can start children on its own counter (or a nested one) and Wait() on it.
+struct JobCounter
+{
+	std::atomic<uint32_t> value{ 0 };
+
+	bool IsDone() const { return value.load( std::memory_order_acquire ) == 0; }
+};
+
+struct Job
+{
+	JobFunction function = nullptr;
+	void * data = nullptr;
+	JobCounter * counter = nullptr;
+};
+
+// Engine task backbone. One work-stealing deque per worker; the thread calling Init() is worker 0
+// and is the only one running MainThread jobs (GLFW and anything else bound to the main thread).
+// Waiting never blocks a worker: Wait() keeps executing other jobs until the counter drops to zero.
+class JobSystem
+{
+public:
+	enum Affinity
+	{
+		AnyThread = 0,
+		MainThread,
+	};
+
+public:
+	JobSystem();
+	~JobSystem();
+
+	// workerCount includes the calling thread, 0 sizes the pool to the hardware
+	void Init( uint32_t workerCount = 0, bool pinThreads = true );
+	void Shutdown();
+
+	void Run( JobFunction function, void * data, JobCounter * counter, Affinity affinity = AnyThread );
+	void Wait( JobCounter & counter );
+	void PumpMainThread();
+
+	// Splits [0, count) in batches and runs fn( begin, end ) on every worker, returns when all are done
+	template<typename F>
+	void ParallelFor( uint32_t count, uint32_t batchSize, const F & fn );
+
+	uint32_t GetWorkerCount() const { return (uint32_t)m_workers.size(); }
+	static int GetCurrentWorkerIdx();
+
+private:
+	static constexpr uint32_t DEQUE_CAPACITY = 4096;
+	static constexpr uint32_t POOL_SIZE = DEQUE_CAPACITY * 2;
+
+	// A job published in a worker's deque. Only the owner claims a slot, whoever pops or steals
+	// the job frees it once copied out: a job waiting deep in the LIFO deque keeps its slot busy
+	// however many jobs are pushed after it.
+	struct JobSlot
+	{
+		Job job;
+		std::atomic<bool> busy{ false };
+	};
+
+	struct Worker
+	{
+		Worker() : deque( DEQUE_CAPACITY ), pool( new JobSlot[POOL_SIZE] ) {}
+
+		WorkStealingDeque<JobSlot> deque;
+		std::unique_ptr<JobSlot[]> pool;	// twice the deque, the next free slot is almost always the one after the last
+		uint32_t poolNext = 0;
+		uint32_t rngState = 0;
+		std::thread thread;
+	};
+
+	void WorkerMain( uint32_t workerIdx, bool pin );
+	bool FetchJob( Job & job, bool allowMainThread );
+	bool StealJob( Worker & self, Job & job );
+	JobSlot * ClaimSlot( Worker & worker );
+	static void TakeJob( JobSlot & slot, Job & job );
+	void Execute( const Job & job );
+	void WakeWorkers();
+
+private:
+	std::vector<std::unique_ptr<Worker>> m_workers;
+	std::atomic<bool> m_running{ false };
+
+	// Jobs coming from threads outside the pool, and main-thread-only jobs
+	std::mutex m_queueMutex;
+	std::deque<Job> m_injected;
+	std::deque<Job> m_mainThread;
+	std::atomic<uint32_t> m_injectedCount{ 0 };
+
+	std::mutex m_sleepMutex;
+	std::condition_variable m_sleepCv;
+	std::atomic<uint32_t> m_sleeping{ 0 };
+};
+
+template<typename F>
+void JobSystem::ParallelFor( uint32_t count, uint32_t batchSize, const F & fn )
+{
+	struct Batch
+	{
+		const F * fn;
+		uint32_t begin;
+		uint32_t end;
+	};
+
+	if ( count == 0 )
+		return;
+
+	batchSize = batchSize ? batchSize : 1;
+	const uint32_t batchCount = (count + batchSize - 1) / batchSize;
+
+	// Batches only live until Wait() returns, the calling thread's scratch arena keeps this allocation free
+	ArenaScope scratch( LinearArena::ThreadLocal() );
+	Batch * batches = scratch.GetArena().AllocateArray<Batch>( batchCount );
+
+	JobCounter counter;
+	for ( uint32_t i = 0; i < batchCount; ++i )
+	{
+		batches[i] = { &fn, i * batchSize, std::min( count, (i + 1) * batchSize ) };
+		Run( []( void * data ) {
+			const Batch * batch = static_cast<const Batch *>( data );
+			( *batch->fn )( batch->begin, batch->end );
+		}, &batches[i], &counter );
+	}
+	Wait( counter );
+}
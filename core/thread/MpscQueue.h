@@ -0,0 +1,90 @@
+#pragma once
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+
+// Bounded lock-free multi-producer single-consumer ring (Vyukov's sequence-per-cell scheme).
+// Producers claim a position with a CAS and publish the cell through its sequence number,
+// the consumer reads cells strictly in position order. Push() reports a full ring instead of waiting.
+template<typename T>
+class MpscQueue
+{
+public:
+	explicit MpscQueue( uint32_t capacity )
+		: m_mask( capacity - 1 )
+		, m_cells( new Cell[capacity] )
+	{
+		// Capacity must be a power of two for the index mask
+		assert( capacity > 0 && (capacity & m_mask) == 0 );
+		for ( uint32_t i = 0; i < capacity; ++i )
+		{
+			m_cells[i].sequence.store( i, std::memory_order_relaxed );
+		}
+	}
+
+	// Any thread. position receives the rank of the item in consumption order
+	bool Push( const T & item, uint64_t * position = nullptr )
+	{
+		uint64_t pos = m_enqueuePos.load( std::memory_order_relaxed );
+		Cell * cell;
+		for ( ;; )
+		{
+			cell = &m_cells[pos & m_mask];
+			const uint64_t seq = cell->sequence.load( std::memory_order_acquire );
+			const int64_t diff = (int64_t)seq - (int64_t)pos;
+			if ( diff == 0 )
+			{
+				if ( m_enqueuePos.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) )
+					break;
+			}
+			else if ( diff < 0 )
+			{
+				return false;
+			}
+			else
+			{
+				pos = m_enqueuePos.load( std::memory_order_relaxed );
+			}
+		}
+
+		cell->data = item;
+		cell->sequence.store( pos + 1, std::memory_order_release );
+		if ( position )
+			*position = pos;
+		return true;
+	}
+
+	// Consumer thread only
+	bool Pop( T & item )
+	{
+		Cell & cell = m_cells[m_dequeuePos & m_mask];
+		if ( cell.sequence.load( std::memory_order_acquire ) != m_dequeuePos + 1 )
+			return false;
+
+		item = cell.data;
+		cell.sequence.store( m_dequeuePos + m_mask + 1, std::memory_order_release );
+		++m_dequeuePos;
+		return true;
+	}
+
+	// Consumer thread only
+	bool HasPending() const
+	{
+		return m_cells[m_dequeuePos & m_mask].sequence.load( std::memory_order_acquire ) == m_dequeuePos + 1;
+	}
+
+private:
+	struct Cell
+	{
+		std::atomic<uint64_t> sequence;
+		T data;
+	};
+
+	// Producers hammer the enqueue position, keep it off the consumer's cache line
+	std::atomic<uint64_t> m_enqueuePos{ 0 };
+	char m_padEnqueue[64 - sizeof( std::atomic<uint64_t> )];
+	uint64_t m_dequeuePos = 0;
+	const uint32_t m_mask;
+	std::unique_ptr<Cell[]> m_cells;
+};
@@ -0,0 +1,87 @@
+#pragma once
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+
+// Chase-Lev deque with the memory orderings from Le et al. 2013.
+// The owner pushes and pops at the bottom, any other thread steals from the top.
+// Capacity is fixed, Push() reports a full deque instead of growing.
+template<typename T>
+class WorkStealingDeque
+{
+public:
+	explicit WorkStealingDeque( uint32_t capacity )
+		: m_mask( capacity - 1 )
+		, m_items( new std::atomic<T *>[capacity] )
+	{
+		static_assert( sizeof( std::atomic<T *> ) == sizeof( T * ), "deque slots must be plain pointers" );
+		// Capacity must be a power of two for the index mask
+		assert( capacity > 0 && (capacity & m_mask) == 0 );
+	}
+
+	bool Push( T * item )
+	{
+		const int64_t b = m_bottom.load( std::memory_order_relaxed );
+		const int64_t t = m_top.load( std::memory_order_acquire );
+		if ( b - t > (int64_t)m_mask )
+			return false;
+
+		m_items[b & m_mask].store( item, std::memory_order_relaxed );
+		m_bottom.store( b + 1, std::memory_order_release );
+		return true;
+	}
+
+	T * Pop()
+	{
+		const int64_t b = m_bottom.load( std::memory_order_relaxed ) - 1;
+		m_bottom.store( b, std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		int64_t t = m_top.load( std::memory_order_relaxed );
+
+		if ( t > b )
+		{
+			m_bottom.store( b + 1, std::memory_order_relaxed );
+			return nullptr;
+		}
+
+		T * item = m_items[b & m_mask].load( std::memory_order_relaxed );
+		if ( t == b )
+		{
+			// Last item, race against thieves for it
+			if ( !m_top.compare_exchange_strong( t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed ) )
+				item = nullptr;
+			m_bottom.store( b + 1, std::memory_order_relaxed );
+		}
+		return item;
+	}
+
+	T * Steal()
+	{
+		int64_t t = m_top.load( std::memory_order_acquire );
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		const int64_t b = m_bottom.load( std::memory_order_acquire );
+		if ( t >= b )
+			return nullptr;
+
+		T * item = m_items[t & m_mask].load( std::memory_order_relaxed );
+		if ( !m_top.compare_exchange_strong( t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed ) )
+			return nullptr;
+		return item;
+	}
+
+	bool IsEmpty() const
+	{
+		return m_bottom.load( std::memory_order_relaxed ) <= m_top.load( std::memory_order_relaxed );
+	}
+
+private:
+	// Owner and thieves hammer different ends, keep them on different cache lines.
+	// Explicit padding rather than alignas so heap allocated deques need no aligned new.
+	std::atomic<int64_t> m_top{ 0 };
+	char m_padTop[64 - sizeof( std::atomic<int64_t> )];
+	std::atomic<int64_t> m_bottom{ 0 };
+	char m_padBottom[64 - sizeof( std::atomic<int64_t> )];
+	const uint32_t m_mask;
+	std::unique_ptr<std::atomic<T *>[]> m_items;
+};
@@ -0,0 +1,76 @@
+#include <stdafx.h>
+#include "Buffer_vulkan.h"
+
+uint32_t FindMemoryTypeVulkan( VkPhysicalDevice physicalDevice, uint32_t typeBits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred )
+{
+	VkPhysicalDeviceMemoryProperties memProps = {};
+	vkGetPhysicalDeviceMemoryProperties( physicalDevice, &memProps );
+
+	// First pass takes the preferred flags into account, second one only the required ones
+	for ( int pass = 0; pass < 2; ++pass )
+	{
+		const VkMemoryPropertyFlags wanted = pass == 0 ? (required | preferred) : required;
+		for ( uint32_t i = 0; i < memProps.memoryTypeCount; ++i )
+		{
+			if ( (typeBits & (1U << i)) && (memProps.memoryTypes[i].propertyFlags & wanted) == wanted )
+				return i;
+		}
+	}
+	throw std::runtime_error( "no suitable memory type" );
+}
+
+void BufferVulkan::Init( VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred )
+{
+	m_device = device;
+	m_size = size;
+
+	VkBufferCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	createInfo.size = size;
+	createInfo.usage = usage;
+	createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if ( vkCreateBuffer( m_device, &createInfo, nullptr, &m_native ) != VK_SUCCESS )
+	{
+		throw std::runtime_error( "Cannot create buffer" );
+	}
+
+	VkMemoryRequirements memReqs = {};
+	vkGetBufferMemoryRequirements( m_device, m_native, &memReqs );
+
+	VkPhysicalDeviceMemoryProperties memProps = {};
+	vkGetPhysicalDeviceMemoryProperties( physicalDevice, &memProps );
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memReqs.size;
+	allocInfo.memoryTypeIndex = FindMemoryTypeVulkan( physicalDevice, memReqs.memoryTypeBits, required, preferred );
+	m_memoryFlags = memProps.memoryTypes[allocInfo.memoryTypeIndex].propertyFlags;
+
+	if ( vkAllocateMemory( m_device, &allocInfo, nullptr, &m_memory ) != VK_SUCCESS )
+	{
+		throw std::runtime_error( "Cannot allocate buffer memory" );
+	}
+	vkBindBufferMemory( m_device, m_native, m_memory, 0 );
+
+	if ( m_memoryFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT )
+	{
+		if ( vkMapMemory( m_device, m_memory, 0, VK_WHOLE_SIZE, 0, &m_mapped ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "Cannot map buffer memory" );
+		}
+	}
+}
+
+void BufferVulkan::Destroy()
+{
+	if ( m_mapped )
+		vkUnmapMemory( m_device, m_memory );
+
+	vkDestroyBuffer( m_device, m_native, nullptr );
+	vkFreeMemory( m_device, m_memory, nullptr );
+
+	m_native = VK_NULL_HANDLE;
+	m_memory = VK_NULL_HANDLE;
+	m_mapped = nullptr;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+uint32_t FindMemoryTypeVulkan( VkPhysicalDevice physicalDevice, uint32_t typeBits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred = 0 );
+
+// Buffer with its own dedicated allocation. Host-visible buffers stay persistently mapped.
+class BufferVulkan
+{
+public:
+	void Init( VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred = 0 );
+	void Destroy();
+
+	bool IsHostVisible() const { return m_mapped != nullptr; }
+
+public:
+	VkDevice m_device = VK_NULL_HANDLE;
+	VkBuffer m_native = VK_NULL_HANDLE;
+	VkDeviceMemory m_memory = VK_NULL_HANDLE;
+	VkDeviceSize m_size = 0;
+	VkMemoryPropertyFlags m_memoryFlags = 0;
+	void * m_mapped = nullptr;
+};
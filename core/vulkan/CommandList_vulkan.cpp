@@ -0,0 +1,505 @@
+#include <stdafx.h>
+#include "CommandList_vulkan.h"
+#include "Device3D_vulkan.h"
+
+namespace
+{
+	struct StateInfoVulkan
+	{
+		VkPipelineStageFlags stages;
+		VkAccessFlags access;
+		VkImageLayout layout;
+	};
+
+	// Indexed by ResourceState
+	const StateInfoVulkan STATE_INFOS[] = {
+		{ VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED },
+		{ VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL },
+		{ VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL },
+		{ VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED },
+		{ VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED },
+		{ VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_UNIFORM_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED },
+		{ VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+		{ VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL },
+		{ VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+		{ VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL },
+		{ VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR },
+		{ VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED },
+	};
+	static_assert( sizeof( STATE_INFOS ) / sizeof( STATE_INFOS[0] ) == (size_t)ResourceState::HostRead + 1, "STATE_INFOS must match ResourceState" );
+
+	bool IsBindCommand( CommandType type )
+	{
+		return type == CommandType::BindPipeline || type == CommandType::BindVertexBuffer || type == CommandType::BindIndexBuffer
+			|| type == CommandType::BindStorageBuffer || type == CommandType::BindStorageImage || type == CommandType::PushConstants;
+	}
+
+	VkImageAspectFlags GetAspect( VkFormat format )
+	{
+		return format == VK_FORMAT_D32_SFLOAT ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+}
+
+VkPipelineStageFlags CommandTranslatorVulkan::GetSupportedStages( VkQueueFlags queueFlags )
+{
+	VkPipelineStageFlags stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_HOST_BIT;
+	// Graphics and compute families can always copy, even when they do not report it
+	if ( queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT) )
+		stages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+	if ( queueFlags & VK_QUEUE_COMPUTE_BIT )
+		stages |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+	if ( queueFlags & VK_QUEUE_GRAPHICS_BIT )
+	{
+		stages |= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+			| VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT
+			| VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	}
+	return stages;
+}
+
+void CommandTranslatorVulkan::Translate( VkCommandBuffer cmd, const CommandList * const * lists, uint32_t count, VkPipelineStageFlags supportedStages )
+{
+	// A command buffer starts with no state bound
+	ResetState();
+	m_supportedStages = supportedStages;
+
+	uint32_t bindCommandCount = 0;
+	uint32_t bindCallCount = 0;
+
+	for ( uint32_t i = 0; i < count; ++i )
+	{
+		CommandList::Reader reader( *lists[i] );
+		CommandList::Header header;
+		while ( reader.Next( header ) )
+		{
+			++m_stats.commandCount;
+
+			if ( header.type != CommandType::BufferBarrier && header.type != CommandType::ImageBarrier )
+				FlushBarriers( cmd );
+
+			if ( IsBindCommand( header.type ) )
+				++bindCommandCount;
+
+			switch ( header.type )
+			{
+			case CommandType::BindPipeline:
+				SetPipeline( reader.Read<CmdBindPipeline>().pipeline );
+				break;
+
+			case CommandType::BindVertexBuffer:
+			{
+				const CmdBindVertexBuffer bind = reader.Read<CmdBindVertexBuffer>();
+				assert( bind.binding < MAX_VERTEX_BINDINGS );
+				m_pendingVertex[bind.binding] = { bind.buffer, bind.offset };
+				break;
+			}
+
+			case CommandType::BindIndexBuffer:
+			{
+				const CmdBindIndexBuffer bind = reader.Read<CmdBindIndexBuffer>();
+				m_pendingIndex = { bind.buffer, bind.offset, bind.indexType };
+				break;
+			}
+
+			case CommandType::BindStorageBuffer:
+			{
+				const CmdBindStorageBuffer bind = reader.Read<CmdBindStorageBuffer>();
+				assert( bind.binding < MAX_STORAGE_BUFFERS );
+				const StorageBinding binding = { bind.buffer, bind.offset, bind.range, ImageHandle() };
+				if ( binding != m_pendingStorage[bind.binding] )
+				{
+					m_pendingStorage[bind.binding] = binding;
+					m_storageChanged = true;
+				}
+				break;
+			}
+
+			case CommandType::BindStorageImage:
+			{
+				const CmdBindStorageImage bind = reader.Read<CmdBindStorageImage>();
+				assert( bind.binding < MAX_STORAGE_BUFFERS );
+				const StorageBinding binding = { BufferHandle(), 0, 0, bind.image };
+				if ( binding != m_pendingStorage[bind.binding] )
+				{
+					m_pendingStorage[bind.binding] = binding;
+					m_storageChanged = true;
+				}
+				break;
+			}
+
+			case CommandType::PushConstants:
+			{
+				const uint32_t before = m_stats.vkCallCount;
+				const CmdPushConstants push = reader.Read<CmdPushConstants>();
+				PushConstants( cmd, push, static_cast<const char *>( reader.GetPayload() ) + sizeof( CmdPushConstants ) );
+				bindCallCount += m_stats.vkCallCount - before;
+				break;
+			}
+
+			case CommandType::Draw:
+			{
+				const uint32_t before = m_stats.vkCallCount;
+				FlushPipeline( cmd, VK_PIPELINE_BIND_POINT_GRAPHICS );
+				FlushVertexInput( cmd, false );
+				bindCallCount += m_stats.vkCallCount - before;
+
+				const CmdDraw draw = reader.Read<CmdDraw>();
+				vkCmdDraw( cmd, draw.vertexCount, draw.instanceCount, draw.firstVertex, draw.firstInstance );
+				++m_stats.vkCallCount;
+				break;
+			}
+
+			case CommandType::DrawIndexed:
+			{
+				const uint32_t before = m_stats.vkCallCount;
+				FlushPipeline( cmd, VK_PIPELINE_BIND_POINT_GRAPHICS );
+				FlushVertexInput( cmd, true );
+				bindCallCount += m_stats.vkCallCount - before;
+
+				const CmdDrawIndexed draw = reader.Read<CmdDrawIndexed>();
+				vkCmdDrawIndexed( cmd, draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset, draw.firstInstance );
+				++m_stats.vkCallCount;
+				break;
+			}
+
+			case CommandType::Dispatch:
+			{
+				const uint32_t before = m_stats.vkCallCount;
+				FlushPipeline( cmd, VK_PIPELINE_BIND_POINT_COMPUTE );
+				FlushStorageBuffers( cmd );
+				bindCallCount += m_stats.vkCallCount - before;
+
+				const CmdDispatch dispatch = reader.Read<CmdDispatch>();
+				vkCmdDispatch( cmd, dispatch.groupCountX, dispatch.groupCountY, dispatch.groupCountZ );
+				++m_stats.vkCallCount;
+				break;
+			}
+
+			case CommandType::CopyBuffer:
+			{
+				const CmdCopyBuffer copy = reader.Read<CmdCopyBuffer>();
+				const VkBufferCopy region = { copy.srcOffset, copy.dstOffset, copy.size };
+				vkCmdCopyBuffer( cmd, m_device.GetNativeBuffer( copy.src ), m_device.GetNativeBuffer( copy.dst ), 1, &region );
+				++m_stats.vkCallCount;
+				break;
+			}
+
+			case CommandType::CopyBufferToImage:
+			{
+				const CmdCopyBufferToImage copy = reader.Read<CmdCopyBufferToImage>();
+				const VkExtent2D extent = m_device.GetImageExtent( copy.dst );
+
+				VkBufferImageCopy region = {};
+				region.bufferOffset = copy.srcOffset;
+				region.imageSubresource.aspectMask = GetAspect( m_device.GetNativeImageFormat( copy.dst ) );
+				region.imageSubresource.layerCount = 1;
+				region.imageExtent = { extent.width, extent.height, 1 };
+				vkCmdCopyBufferToImage( cmd, m_device.GetNativeBuffer( copy.src ), m_device.GetNativeImage( copy.dst ), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region );
+				++m_stats.vkCallCount;
+				break;
+			}
+
+			case CommandType::CopyImageToBuffer:
+			{
+				const CmdCopyImageToBuffer copy = reader.Read<CmdCopyImageToBuffer>();
+				const VkExtent2D extent = m_device.GetImageExtent( copy.src );
+
+				VkBufferImageCopy region = {};
+				region.bufferOffset = copy.dstOffset;
+				region.imageSubresource.aspectMask = GetAspect( m_device.GetNativeImageFormat( copy.src ) );
+				region.imageSubresource.layerCount = 1;
+				region.imageExtent = { extent.width, extent.height, 1 };
+				vkCmdCopyImageToBuffer( cmd, m_device.GetNativeImage( copy.src ), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_device.GetNativeBuffer( copy.dst ), 1, &region );
+				++m_stats.vkCallCount;
+				break;
+			}
+
+			case CommandType::BufferBarrier:
+			{
+				const CmdBufferBarrier barrier = reader.Read<CmdBufferBarrier>();
+
+				VkBufferMemoryBarrier vkBarrier = {};
+				vkBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+				AddBarrier( barrier.before, barrier.after, vkBarrier.srcAccessMask, vkBarrier.dstAccessMask );
+				vkBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				vkBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				vkBarrier.buffer = m_device.GetNativeBuffer( barrier.buffer );
+				vkBarrier.size = VK_WHOLE_SIZE;
+				m_bufferBarriers.push_back( vkBarrier );
+				break;
+			}
+
+			case CommandType::ImageBarrier:
+			{
+				const CmdImageBarrier barrier = reader.Read<CmdImageBarrier>();
+
+				VkImageMemoryBarrier vkBarrier = {};
+				vkBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				AddBarrier( barrier.before, barrier.after, vkBarrier.srcAccessMask, vkBarrier.dstAccessMask );
+				vkBarrier.oldLayout = STATE_INFOS[(int)barrier.before].layout;
+				vkBarrier.newLayout = STATE_INFOS[(int)barrier.after].layout;
+				vkBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				vkBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				vkBarrier.image = m_device.GetNativeImage( barrier.image );
+				vkBarrier.subresourceRange.aspectMask = GetAspect( m_device.GetNativeImageFormat( barrier.image ) );
+				vkBarrier.subresourceRange.levelCount = 1;
+				vkBarrier.subresourceRange.layerCount = 1;
+				m_imageBarriers.push_back( vkBarrier );
+				break;
+			}
+
+			case CommandType::BeginRenderPass:
+				BeginRenderPass( cmd, reader.Read<CmdBeginRenderPass>() );
+				break;
+
+			case CommandType::EndRenderPass:
+				assert( m_inRenderPass && "EndRenderPass without BeginRenderPass" );
+				vkCmdEndRenderPass( cmd );
+				++m_stats.vkCallCount;
+				m_inRenderPass = false;
+				break;
+
+			case CommandType::WriteTimestamp:
+			{
+				// Reset right before the write, pools need no separate reset pass
+				const CmdWriteTimestamp write = reader.Read<CmdWriteTimestamp>();
+				const VkQueryPool pool = m_device.GetNativeQueryPool( write.pool );
+				vkCmdResetQueryPool( cmd, pool, write.query, 1 );
+				vkCmdWriteTimestamp( cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, pool, write.query );
+				m_stats.vkCallCount += 2;
+				break;
+			}
+
+			default:
+				assert( false );
+				break;
+			}
+		}
+	}
+	FlushBarriers( cmd );
+	assert( !m_inRenderPass && "render pass left open at the end of the lists" );
+
+	if ( bindCommandCount > bindCallCount )
+		m_stats.skippedBindCount += bindCommandCount - bindCallCount;
+}
+
+void CommandTranslatorVulkan::ResetState()
+{
+	m_pendingPipeline = PipelineHandle();
+	m_boundPipeline[0] = PipelineHandle();
+	m_boundPipeline[1] = PipelineHandle();
+	m_pushLayout = VK_NULL_HANDLE;
+	m_pushStages = 0;
+	m_pushValidWords = 0;
+
+	for ( uint32_t i = 0; i < MAX_VERTEX_BINDINGS; ++i )
+	{
+		m_pendingVertex[i] = { BufferHandle(), 0 };
+		m_boundVertex[i] = { BufferHandle(), 0 };
+	}
+	m_pendingIndex = { BufferHandle(), 0, IndexType::Uint16 };
+	m_boundIndex = { BufferHandle(), 0, IndexType::Uint16 };
+
+	for ( StorageBinding & binding : m_pendingStorage )
+	{
+		binding = { BufferHandle(), 0, 0, ImageHandle() };
+	}
+	m_storageChanged = false;
+	m_storageLayout = VK_NULL_HANDLE;
+	m_inRenderPass = false;
+
+	m_barrierSrcStages = 0;
+	m_barrierDstStages = 0;
+	m_bufferBarriers.clear();
+	m_imageBarriers.clear();
+}
+
+void CommandTranslatorVulkan::SetPipeline( PipelineHandle pipeline )
+{
+	m_pendingPipeline = pipeline;
+
+	// Push constants only carry over between pipelines sharing the layout
+	const VkPipelineLayout layout = m_device.GetPipelineLayout( pipeline );
+	if ( layout != m_pushLayout )
+	{
+		m_pushLayout = layout;
+		m_pushStages = m_device.GetPipelineBindPoint( pipeline ) == VK_PIPELINE_BIND_POINT_COMPUTE ? VK_SHADER_STAGE_COMPUTE_BIT : VK_SHADER_STAGE_ALL_GRAPHICS;
+		m_pushValidWords = 0;
+	}
+}
+
+void CommandTranslatorVulkan::PushConstants( VkCommandBuffer cmd, const CmdPushConstants & push, const void * data )
+{
+	assert( m_pushLayout != VK_NULL_HANDLE && "bind a pipeline before pushing constants" );
+	assert( push.offset % 4 == 0 && push.size % 4 == 0 && push.offset + push.size <= MAX_PUSH_CONSTANT_SIZE );
+
+	const uint64_t words = ((uint64_t( 1 ) << (push.size / 4)) - 1) << (push.offset / 4);
+	const uint32_t mask = (uint32_t)words;
+	if ( (m_pushValidWords & mask) == mask && memcmp( m_pushShadow + push.offset, data, push.size ) == 0 )
+		return;
+
+	vkCmdPushConstants( cmd, m_pushLayout, m_pushStages, push.offset, push.size, data );
+	++m_stats.vkCallCount;
+	memcpy( m_pushShadow + push.offset, data, push.size );
+	m_pushValidWords |= mask;
+}
+
+void CommandTranslatorVulkan::FlushPipeline( VkCommandBuffer cmd, VkPipelineBindPoint bindPoint )
+{
+	assert( m_pendingPipeline.IsValid() && m_device.GetPipelineBindPoint( m_pendingPipeline ) == bindPoint );
+
+	PipelineHandle & bound = m_boundPipeline[bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE ? 1 : 0];
+	if ( bound == m_pendingPipeline )
+		return;
+
+	vkCmdBindPipeline( cmd, bindPoint, m_device.GetNativePipeline( m_pendingPipeline ) );
+	++m_stats.vkCallCount;
+	bound = m_pendingPipeline;
+}
+
+void CommandTranslatorVulkan::FlushVertexInput( VkCommandBuffer cmd, bool indexed )
+{
+	// Every run of consecutive changed bindings goes out in a single call
+	VkBuffer buffers[MAX_VERTEX_BINDINGS];
+	VkDeviceSize offsets[MAX_VERTEX_BINDINGS];
+	uint32_t first = 0;
+	uint32_t runCount = 0;
+	for ( uint32_t i = 0; i <= MAX_VERTEX_BINDINGS; ++i )
+	{
+		const bool changed = i < MAX_VERTEX_BINDINGS && m_pendingVertex[i].buffer.IsValid() && m_pendingVertex[i] != m_boundVertex[i];
+		if ( changed )
+		{
+			if ( runCount == 0 )
+				first = i;
+			buffers[runCount] = m_device.GetNativeBuffer( m_pendingVertex[i].buffer );
+			offsets[runCount] = m_pendingVertex[i].offset;
+			m_boundVertex[i] = m_pendingVertex[i];
+			++runCount;
+		}
+		else if ( runCount > 0 )
+		{
+			vkCmdBindVertexBuffers( cmd, first, runCount, buffers, offsets );
+			++m_stats.vkCallCount;
+			runCount = 0;
+		}
+	}
+
+	if ( indexed && m_pendingIndex != m_boundIndex )
+	{
+		assert( m_pendingIndex.buffer.IsValid() );
+		const VkIndexType indexType = m_pendingIndex.indexType == IndexType::Uint32 ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
+		vkCmdBindIndexBuffer( cmd, m_device.GetNativeBuffer( m_pendingIndex.buffer ), m_pendingIndex.offset, indexType );
+		++m_stats.vkCallCount;
+		m_boundIndex = m_pendingIndex;
+	}
+}
+
+void CommandTranslatorVulkan::FlushStorageBuffers( VkCommandBuffer cmd )
+{
+	const uint32_t count = m_device.GetPipelineStorageBufferCount( m_pendingPipeline );
+	const VkPipelineLayout layout = m_device.GetPipelineLayout( m_pendingPipeline );
+	if ( count == 0 || (!m_storageChanged && layout == m_storageLayout) )
+		return;
+
+	VkDescriptorBufferInfo bufferInfos[MAX_STORAGE_BUFFERS];
+	VkDescriptorImageInfo imageInfos[MAX_STORAGE_BUFFERS];
+	VkWriteDescriptorSet writes[MAX_STORAGE_BUFFERS];
+	const uint32_t imageMask = m_device.GetPipelineStorageImageMask( m_pendingPipeline );
+	const VkDescriptorSet set = m_device.AllocateDescriptorSet( m_device.GetPipelineSetLayout( m_pendingPipeline ) );
+	for ( uint32_t i = 0; i < count; ++i )
+	{
+		const StorageBinding & binding = m_pendingStorage[i];
+		writes[i] = {};
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = set;
+		writes[i].dstBinding = i;
+		writes[i].descriptorCount = 1;
+
+		if ( imageMask & (1u << i) )
+		{
+			assert( binding.image.IsValid() && "every storage image of the pipeline must be bound before dispatching" );
+			imageInfos[i].sampler = VK_NULL_HANDLE;
+			imageInfos[i].imageView = m_device.GetNativeImageView( binding.image );
+			imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+			writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			writes[i].pImageInfo = &imageInfos[i];
+		}
+		else
+		{
+			assert( binding.buffer.IsValid() && "every storage buffer of the pipeline must be bound before dispatching" );
+			bufferInfos[i].buffer = m_device.GetNativeBuffer( binding.buffer );
+			bufferInfos[i].offset = binding.offset;
+			bufferInfos[i].range = binding.range ? binding.range : VK_WHOLE_SIZE;
+			writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[i].pBufferInfo = &bufferInfos[i];
+		}
+	}
+	vkUpdateDescriptorSets( m_device.GetNativeDevice(), count, writes, 0, nullptr );
+
+	vkCmdBindDescriptorSets( cmd, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &set, 0, nullptr );
+	++m_stats.vkCallCount;
+	m_storageChanged = false;
+	m_storageLayout = layout;
+}
+
+void CommandTranslatorVulkan::BeginRenderPass( VkCommandBuffer cmd, const CmdBeginRenderPass & begin )
+{
+	assert( !m_inRenderPass && "render passes do not nest" );
+	const VkFramebuffer framebuffer = m_device.GetImageFramebuffer( begin.colorTarget );
+	assert( framebuffer != VK_NULL_HANDLE && "render pass target without ImageUsageColorTarget" );
+	const VkExtent2D extent = m_device.GetImageExtent( begin.colorTarget );
+
+	VkClearValue clearValue = {};
+	memcpy( clearValue.color.float32, begin.clearColor, sizeof( begin.clearColor ) );
+
+	VkRenderPassBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	beginInfo.renderPass = m_device.GetRenderPass( m_device.GetNativeImageFormat( begin.colorTarget ) );
+	beginInfo.framebuffer = framebuffer;
+	beginInfo.renderArea.extent = extent;
+	beginInfo.clearValueCount = 1;
+	beginInfo.pClearValues = &clearValue;
+	vkCmdBeginRenderPass( cmd, &beginInfo, VK_SUBPASS_CONTENTS_INLINE );
+
+	// Pipelines used in these render passes take viewport and scissor as dynamic state
+	const VkViewport viewport = { 0.0f, 0.0f, (float)extent.width, (float)extent.height, 0.0f, 1.0f };
+	const VkRect2D scissor = { { 0, 0 }, extent };
+	vkCmdSetViewport( cmd, 0, 1, &viewport );
+	vkCmdSetScissor( cmd, 0, 1, &scissor );
+	m_stats.vkCallCount += 3;
+	m_inRenderPass = true;
+}
+
+void CommandTranslatorVulkan::AddBarrier( ResourceState before, ResourceState after, VkAccessFlags & srcAccess, VkAccessFlags & dstAccess )
+{
+	const StateInfoVulkan & src = STATE_INFOS[(int)before];
+	const StateInfoVulkan & dst = STATE_INFOS[(int)after];
+
+	// A state whose stages do not exist on this queue cannot have been reached on it: nothing to make available
+	const VkPipelineStageFlags srcStages = src.stages & m_supportedStages;
+	const VkPipelineStageFlags dstStages = dst.stages & m_supportedStages;
+	srcAccess = srcStages ? src.access : 0;
+	dstAccess = dstStages ? dst.access : 0;
+	m_barrierSrcStages |= srcStages ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	m_barrierDstStages |= dstStages ? dstStages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+}
+
+void CommandTranslatorVulkan::FlushBarriers( VkCommandBuffer cmd )
+{
+	const uint32_t barrierCount = (uint32_t)(m_bufferBarriers.size() + m_imageBarriers.size());
+	if ( barrierCount == 0 )
+		return;
+
+	vkCmdPipelineBarrier( cmd, m_barrierSrcStages, m_barrierDstStages, 0,
+		0, nullptr,
+		(uint32_t)m_bufferBarriers.size(), m_bufferBarriers.data(),
+		(uint32_t)m_imageBarriers.size(), m_imageBarriers.data() );
+	++m_stats.vkCallCount;
+	m_stats.mergedBarrierCount += barrierCount - 1;
+	m_stats.barrierStages |= m_barrierSrcStages | m_barrierDstStages;
+
+	m_barrierSrcStages = 0;
+	m_barrierDstStages = 0;
+	m_bufferBarriers.clear();
+	m_imageBarriers.clear();
+}
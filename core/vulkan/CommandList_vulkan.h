@@ -0,0 +1,116 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include "../CommandList.h"
+
+#include <vector>
+
+class Device3DVulkan;
+
+// Replays CommandList streams into a Vulkan command buffer.
+// Binds are lazy: they only update the pending state, which is flushed right before the draw or dispatch
+// that needs it, and only for what differs from the bound state. Binds overwritten before any draw and
+// rebinds of the same pipeline, buffer or push constant bytes never reach the driver.
+// Consecutive barriers are merged into one vkCmdPipelineBarrier. Their stages are masked with what the
+// queue family supports: a shader-read barrier on a compute-only family only waits on the compute stage.
+// Storage buffers and images are written into a descriptor set allocated from the device at the dispatch
+// that first sees them changed; a dispatch with the same bindings and pipeline layout reuses the bound set.
+// Render passes come from the device, one per target format, with the framebuffer of the target image.
+class CommandTranslatorVulkan
+{
+public:
+	static constexpr uint32_t MAX_STORAGE_BUFFERS = 8;
+
+	struct Stats
+	{
+		uint32_t commandCount = 0;	// commands read from the lists
+		uint32_t vkCallCount = 0;	// vkCmd* calls emitted
+		uint32_t skippedBindCount = 0;
+		uint32_t mergedBarrierCount = 0;
+		VkPipelineStageFlags barrierStages = 0;	// every src and dst stage emitted
+	};
+
+public:
+	explicit CommandTranslatorVulkan( Device3DVulkan & device ) : m_device( device ) {}
+
+	// Pipeline stages a queue family with these capabilities accepts in its barriers
+	static VkPipelineStageFlags GetSupportedStages( VkQueueFlags queueFlags );
+
+	// The lists are translated in order as one stream: state bound by a list carries over to the next one.
+	// Draws must land between BeginRenderPass and EndRenderPass commands. supportedStages comes from GetSupportedStages()
+	// for the family the command buffer is submitted to.
+	void Translate( VkCommandBuffer cmd, const CommandList * const * lists, uint32_t count, VkPipelineStageFlags supportedStages );
+	void Translate( VkCommandBuffer cmd, const CommandList & list, VkPipelineStageFlags supportedStages ) { const CommandList * lists[] = { &list }; Translate( cmd, lists, 1, supportedStages ); }
+
+	const Stats & GetStats() const { return m_stats; }
+	void ResetStats() { m_stats = Stats(); }
+
+private:
+	static constexpr uint32_t MAX_VERTEX_BINDINGS = 8;
+	static constexpr uint32_t MAX_PUSH_CONSTANT_SIZE = 128;
+
+	struct VertexBinding
+	{
+		BufferHandle buffer;
+		uint64_t offset;
+
+		bool operator!=( const VertexBinding & other ) const { return buffer != other.buffer || offset != other.offset; }
+	};
+
+	// Either a buffer range or an image
+	struct StorageBinding
+	{
+		BufferHandle buffer;
+		uint64_t offset;
+		uint64_t range;
+		ImageHandle image;
+
+		bool operator!=( const StorageBinding & other ) const { return buffer != other.buffer || offset != other.offset || range != other.range || image != other.image; }
+	};
+
+	struct IndexBinding
+	{
+		BufferHandle buffer;
+		uint64_t offset;
+		IndexType indexType;
+
+		bool operator!=( const IndexBinding & other ) const { return buffer != other.buffer || offset != other.offset || indexType != other.indexType; }
+	};
+
+	void ResetState();
+	void SetPipeline( PipelineHandle pipeline );
+	void PushConstants( VkCommandBuffer cmd, const CmdPushConstants & push, const void * data );
+	void FlushPipeline( VkCommandBuffer cmd, VkPipelineBindPoint bindPoint );
+	void FlushVertexInput( VkCommandBuffer cmd, bool indexed );
+	void FlushStorageBuffers( VkCommandBuffer cmd );
+	void BeginRenderPass( VkCommandBuffer cmd, const CmdBeginRenderPass & begin );
+	void AddBarrier( ResourceState before, ResourceState after, VkAccessFlags & srcAccess, VkAccessFlags & dstAccess );
+	void FlushBarriers( VkCommandBuffer cmd );
+
+private:
+	Device3DVulkan & m_device;
+	Stats m_stats;
+
+	PipelineHandle m_pendingPipeline;
+	PipelineHandle m_boundPipeline[2];	// graphics, compute
+	VkPipelineLayout m_pushLayout = VK_NULL_HANDLE;
+	VkShaderStageFlags m_pushStages = 0;
+	uint8_t m_pushShadow[MAX_PUSH_CONSTANT_SIZE];
+	uint32_t m_pushValidWords = 0;	// one bit per 4 bytes of m_pushShadow holding what the command buffer has
+
+	VertexBinding m_pendingVertex[MAX_VERTEX_BINDINGS];
+	VertexBinding m_boundVertex[MAX_VERTEX_BINDINGS];
+	IndexBinding m_pendingIndex;
+	IndexBinding m_boundIndex;
+
+	StorageBinding m_pendingStorage[MAX_STORAGE_BUFFERS];
+	bool m_storageChanged = false;	// since the last descriptor set was bound
+	VkPipelineLayout m_storageLayout = VK_NULL_HANDLE;	// layout the bound descriptor set was bound with
+
+	bool m_inRenderPass = false;
+
+	VkPipelineStageFlags m_supportedStages = 0;
+	VkPipelineStageFlags m_barrierSrcStages = 0;
+	VkPipelineStageFlags m_barrierDstStages = 0;
+	std::vector<VkBufferMemoryBarrier> m_bufferBarriers;
+	std::vector<VkImageMemoryBarrier> m_imageBarriers;
+};
@@ -3,16 +3,21 @@
 #include <GLFW/glfw3.h>
 #include "Device3D_vulkan.h"
 #include "DeviceQueue_vulkan.h"
+#include "Buffer_vulkan.h"
+#include "ShaderReflection_vulkan.h"
+#include "../Hash.h"
+#include "../shader/SpirvStore.h"
+#include "../memory/AllocationCounter.h"
+#include "../memory/LinearArena.h"
+#include "../StartupProfile.h"
 
-#define SAFE_DELETE( ptr ) do { if ( ptr ) { delete ptr; ptr = nullptr; } } while(0)
 #define SAFE_DELETE_ARRAY( ptr ) do { if ( ptr ) { delete[] ptr; ptr = nullptr; } } while(0)
 
 namespace
 {
 	const int WIDTH = 800;
 	const int HEIGHT = 600;
-	constexpr unsigned int NUM_BACK_BUFFER = 2;
-	const VkPresentModeKHR preferredPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+	const char * PIPELINE_CACHE_PATH = "Shaders/cache/pipeline.cache";
 	const char * deviceExtensions[] = {
 		VK_KHR_SWAPCHAIN_EXTENSION_NAME
 	};
@@ -34,22 +39,136 @@ SwapChainVulkan::~SwapChainVulkan()
 //	Device3DVulkan ================================================================================
 //
 //
+constexpr uint32_t Device3DVulkan::DESCRIPTOR_SETS_PER_POOL;
+
+Device3DVulkan::Device3DVulkan( JobSystem * jobs, const DeviceDescVulkan & desc )
+	: m_desc( desc )
+	, m_jobs( jobs )
+{
+}
+
+Device3DVulkan::~Device3DVulkan()
+{
+}
+
+void Device3DVulkan::AddInitTask( JobFunction function, void * data )
+{
+	m_initTasks.push_back( { this, function, data } );
+}
+
 void Device3DVulkan::Init()
 {
-	CreateInstance();
+	AllocationScopeGuard scope( AllocationScope::Init );
+	StartupPhase initPhase( "Device3DVulkan::Init" );
 
-	if ( glfwInit() == GLFW_FALSE )
+	if ( !IsComputeOnly() )
 	{
-		throw std::runtime_error( "Error initializing GLFW" );
+		// Before the instance, which needs the extensions GLFW requires
+		StartupPhase phase( "glfwInit" );
+		if ( glfwInit() == GLFW_FALSE )
+		{
+			throw std::runtime_error( "Error initializing GLFW" );
+		}
+
+		if ( glfwVulkanSupported() == GLFW_FALSE )
+		{
+			throw std::runtime_error( "Error GLFW does not support Vulkan" );
+		}
 	}
 
-	if ( glfwVulkanSupported() == GLFW_FALSE )
 	{
-		throw std::runtime_error( "Error GLFW does not support Vulkan" );
+		StartupPhase phase( "CreateInstance" );
+		CreateInstance();
 	}
 
-	CreateWindow();
+	// Only the swap chain needs the window: device, queues and pipeline cache are set up without it
+	InitTask deviceTask = { this, []( void * data ) { static_cast<Device3DVulkan *>( data )->InitDevice(); }, this };
+	InitTask windowTask = { this, []( void * data ) {
+		StartupPhase phase( "CreateWindow" );
+		static_cast<Device3DVulkan *>( data )->CreateWindow();
+	}, this };
 
+	if ( m_jobs )
+	{
+		JobCounter counter;
+		m_jobs->Run( &RunInitTask, &deviceTask, &counter );
+		for ( InitTask & task : m_initTasks )
+		{
+			m_jobs->Run( &RunInitTask, &task, &counter );
+		}
+		if ( !IsComputeOnly() )
+			RunInitTask( &windowTask );
+		m_jobs->Wait( counter );
+	}
+	else
+	{
+		if ( !IsComputeOnly() )
+			RunInitTask( &windowTask );
+		RunInitTask( &deviceTask );
+		for ( InitTask & task : m_initTasks )
+		{
+			RunInitTask( &task );
+		}
+	}
+	m_initTasks.clear();
+
+	if ( m_initError )
+	{
+		std::exception_ptr error = m_initError;
+		m_initError = nullptr;
+		std::rethrow_exception( error );
+	}
+}
+
+// Errors are kept until every task is done, the tasks reference Init()'s stack
+void Device3DVulkan::RunInitTask( void * data )
+{
+	const InitTask & task = *static_cast<const InitTask *>( data );
+	AllocationScopeGuard scope( AllocationScope::Init );
+	try
+	{
+		task.function( task.data );
+	}
+	catch ( ... )
+	{
+		std::lock_guard<std::mutex> lock( task.device->m_initErrorMutex );
+		if ( !task.device->m_initError )
+			task.device->m_initError = std::current_exception();
+	}
+}
+
+void Device3DVulkan::InitDevice()
+{
+	{
+		StartupPhase phase( "PickPhysicalDevice" );
+		PickPhysicalDevice();
+	}
+	{
+		StartupPhase phase( "CreateDeviceAndQueues" );
+		CreateDeviceAndQueues();
+	}
+	{
+		StartupPhase phase( "PipelineCache" );
+		m_pipelineCache.Init( m_device, m_physicalDevice, PIPELINE_CACHE_PATH );
+		m_layoutCache.Init( m_device );
+	}
+}
+
+void Device3DVulkan::Destroy()
+{
+	DestroySwapChain();
+	if ( m_pipelineCache.GetNative() != VK_NULL_HANDLE )
+		m_pipelineCache.Destroy();
+	m_layoutCache.Destroy();
+	DestroyDeviceAndQueues();
+	if ( !IsComputeOnly() )
+		DestroyWindow();
+	m_window = nullptr;
+	DestroyInstance();
+}
+
+void Device3DVulkan::PickPhysicalDevice()
+{
 	uint32_t count = 0;
 	vkEnumeratePhysicalDevices( m_instance, &count, nullptr );
 	if ( count == 0 )
@@ -61,6 +180,21 @@ void Device3DVulkan::Init()
 	vkEnumeratePhysicalDevices( m_instance, &count, devices.data() );
 
 	m_physicalDevice = devices[0];
+	if ( m_desc.preferCpuDevice )
+	{
+		// Software implementation, the reference GPU timings are measured against
+		m_physicalDevice = VK_NULL_HANDLE;
+		for ( VkPhysicalDevice device : devices )
+		{
+			VkPhysicalDeviceProperties props;
+			vkGetPhysicalDeviceProperties( device, &props );
+			if ( props.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU )
+			{
+				m_physicalDevice = device;
+				break;
+			}
+		}
+	}
 	//for ( auto& device : devices )
 	//{
 	//	if ( IsDeviceSuitable( device, m_surface ) )
@@ -74,13 +208,33 @@ void Device3DVulkan::Init()
 		throw std::runtime_error( "No suitable device" );
 	}
 
-	CreateDeviceAndQueues();
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties( m_physicalDevice, &props );
+	m_limits = props.limits;
+	QuerySubgroupSupport( props );
 }
 
-void Device3DVulkan::Destroy()
+void Device3DVulkan::QuerySubgroupSupport( const VkPhysicalDeviceProperties & props )
 {
-	glfwDestroyWindow( m_window );
-	m_window = nullptr;
+	m_computeSubgroupSize = 0;
+	if ( m_instanceVersion < VK_API_VERSION_1_1 || props.apiVersion < VK_API_VERSION_1_1 )
+		return;
+
+	// Core in 1.1, looked up so that an older loader still links
+	auto getProperties2 = (PFN_vkGetPhysicalDeviceProperties2)vkGetInstanceProcAddr( m_instance, "vkGetPhysicalDeviceProperties2" );
+	if ( !getProperties2 )
+		return;
+
+	VkPhysicalDeviceSubgroupProperties subgroup = {};
+	subgroup.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+	VkPhysicalDeviceProperties2 props2 = {};
+	props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	props2.pNext = &subgroup;
+	getProperties2( m_physicalDevice, &props2 );
+
+	const VkSubgroupFeatureFlags required = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT;
+	if ( (subgroup.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) && (subgroup.supportedOperations & required) == required )
+		m_computeSubgroupSize = subgroup.subgroupSize;
 }
 
 void Device3DVulkan::CreateInstance()
@@ -92,7 +246,13 @@ void Device3DVulkan::CreateInstance()
 	appInfo.applicationVersion = VK_MAKE_VERSION( 0, 1, 0 );
 	appInfo.pEngineName = "HomeMade";
 	appInfo.engineVersion = VK_MAKE_VERSION( 0, 1, 0 );
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	// 1.1 when the loader has it, for subgroup operations; vkEnumerateInstanceVersion is missing from 1.0 loaders
+	auto enumerateVersion = (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr( VK_NULL_HANDLE, "vkEnumerateInstanceVersion" );
+	uint32_t loaderVersion = VK_API_VERSION_1_0;
+	if ( !enumerateVersion || enumerateVersion( &loaderVersion ) != VK_SUCCESS )
+		loaderVersion = VK_API_VERSION_1_0;
+	m_instanceVersion = loaderVersion >= VK_API_VERSION_1_1 ? VK_API_VERSION_1_1 : VK_API_VERSION_1_0;
+	appInfo.apiVersion = m_instanceVersion;
 
 	VkInstanceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -112,15 +272,18 @@ void Device3DVulkan::CreateInstance()
 	}
 #endif
 
-	// extensions
+	// extensions, none for presenting when headless
 	std::vector<const char*> extensions;
-	unsigned int glfwExtensionCount = 0;
-	const char** glfwExtensions;
-	glfwExtensions = glfwGetRequiredInstanceExtensions( &glfwExtensionCount );
-
-	for ( unsigned int i = 0; i < glfwExtensionCount; i++ )
+	if ( !IsComputeOnly() )
 	{
-		extensions.push_back( glfwExtensions[i] );
+		unsigned int glfwExtensionCount = 0;
+		const char** glfwExtensions;
+		glfwExtensions = glfwGetRequiredInstanceExtensions( &glfwExtensionCount );
+
+		for ( unsigned int i = 0; i < glfwExtensionCount; i++ )
+		{
+			extensions.push_back( glfwExtensions[i] );
+		}
 	}
 
 #ifdef _DEBUG
@@ -130,7 +293,7 @@ void Device3DVulkan::CreateInstance()
 	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
 	createInfo.ppEnabledExtensionNames = extensions.data();
 
-	if ( CheckInstanceExtensions( extensions ) )
+	if ( !CheckInstanceExtensions( extensions ) )
 	{
 		throw std::runtime_error( "missing extension" );
 	}
@@ -167,10 +330,12 @@ void Device3DVulkan::DestroyWindow()
 
 void Device3DVulkan::CreateDeviceAndQueues()
 {
+	ArenaScope scratch( LinearArena::ThreadLocal() );
+
 	uint32_t queueFamCount = 0;
 	vkGetPhysicalDeviceQueueFamilyProperties( m_physicalDevice, &queueFamCount, nullptr );
 
-	VkQueueFamilyProperties * queueProps = (VkQueueFamilyProperties *)alloca( sizeof( VkQueueFamilyProperties ) * queueFamCount );
+	VkQueueFamilyProperties * queueProps = scratch.GetArena().AllocateArray<VkQueueFamilyProperties>( queueFamCount );
 	vkGetPhysicalDeviceQueueFamilyProperties( m_physicalDevice, &queueFamCount, queueProps );
 
 	int gfxAndPresentQueueIdx = -1;
@@ -178,18 +343,22 @@ void Device3DVulkan::CreateDeviceAndQueues()
 	int computeQueueIdx = -1;
 	int copyQueueIdx = -1;
 	int presentQueueIdx = -1;
+	int asyncComputeQueueIdx = -1;
+	int asyncCopyQueueIdx = -1;
+	const bool computeOnly = IsComputeOnly();
 
 	for ( int i = 0; i < (int)queueFamCount; ++i )
 	{
-		if ( queueProps->queueCount == 0 )
+		const VkQueueFamilyProperties & props = queueProps[i];
+		if ( props.queueCount == 0 )
 			continue;
 
-		VkBool32 presentSupport = VK_FALSE;
-		vkGetPhysicalDeviceSurfaceSupportKHR( m_physicalDevice, i, m_surface, &presentSupport );
+		// Asked through GLFW rather than the surface, so this does not wait for the window
+		const bool presentSupport = !computeOnly && glfwGetPhysicalDevicePresentationSupport( m_instance, m_physicalDevice, i ) == GLFW_TRUE;
 
 		if ( gfxAndPresentQueueIdx < 0 )
 		{
-			if ( presentSupport && (queueProps->queueFlags & VK_QUEUE_GRAPHICS_BIT) == VK_QUEUE_GRAPHICS_BIT )
+			if ( presentSupport && (props.queueFlags & VK_QUEUE_GRAPHICS_BIT) == VK_QUEUE_GRAPHICS_BIT )
 			{
 				gfxAndPresentQueueIdx = i;
 			}
@@ -199,64 +368,82 @@ void Device3DVulkan::CreateDeviceAndQueues()
 		{
 			presentQueueIdx = i;
 		}
-		if ( gfxQueueIdx < 0 && (queueProps->queueFlags & VK_QUEUE_GRAPHICS_BIT) == VK_QUEUE_GRAPHICS_BIT )
+		if ( gfxQueueIdx < 0 && (props.queueFlags & VK_QUEUE_GRAPHICS_BIT) == VK_QUEUE_GRAPHICS_BIT )
 		{
 			gfxQueueIdx = i;
 		}
-		if ( computeQueueIdx < 0 && (queueProps->queueFlags & VK_QUEUE_COMPUTE_BIT) == VK_QUEUE_COMPUTE_BIT )
+		if ( computeQueueIdx < 0 && (props.queueFlags & VK_QUEUE_COMPUTE_BIT) == VK_QUEUE_COMPUTE_BIT )
 		{
 			computeQueueIdx = i;
 		}
-		if ( copyQueueIdx < 0 && (queueProps->queueFlags & VK_QUEUE_TRANSFER_BIT) == VK_QUEUE_TRANSFER_BIT )
+		if ( copyQueueIdx < 0 && (props.queueFlags & VK_QUEUE_TRANSFER_BIT) == VK_QUEUE_TRANSFER_BIT )
 		{
 			copyQueueIdx = i;
 		}
+
+		// Families without graphics, running beside it rather than time-sliced with it
+		const VkQueueFlags flags = props.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT);
+		if ( asyncComputeQueueIdx < 0 && (flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) == VK_QUEUE_COMPUTE_BIT )
+		{
+			asyncComputeQueueIdx = i;
+		}
+		if ( asyncCopyQueueIdx < 0 && flags == VK_QUEUE_TRANSFER_BIT )
+		{
+			asyncCopyQueueIdx = i;
+		}
 	}
 
-	std::vector<VkDeviceQueueCreateInfo> queue_ci;
-	float priority = 1.0f;
-	if ( gfxAndPresentQueueIdx >= 0 )
+	int familyOfType[QueueCount];
+	if ( computeOnly )
 	{
-		queue_ci.push_back( VkDeviceQueueCreateInfo{} );
-		VkDeviceQueueCreateInfo & ci = queue_ci.back();
-		ci.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-		ci.queueFamilyIndex = gfxAndPresentQueueIdx;
-		ci.queueCount = 1;
-		ci.pQueuePriorities = &priority;
+		if ( computeQueueIdx < 0 )
+		{
+			throw std::runtime_error( "no compute queue" );
+		}
+
+		// Nothing else runs on the device: dedicated families when there are some, and any compute family can copy
+		familyOfType[GraphicsQueue] = -1;
+		familyOfType[PresentQueue] = -1;
+		familyOfType[ComputeQueue] = asyncComputeQueueIdx >= 0 ? asyncComputeQueueIdx : computeQueueIdx;
+		familyOfType[CopyQueue] = asyncCopyQueueIdx >= 0 ? asyncCopyQueueIdx : familyOfType[ComputeQueue];
 	}
-	else if ( gfxQueueIdx >= 0 && presentQueueIdx >= 0 )
+	else
 	{
-		queue_ci.push_back( VkDeviceQueueCreateInfo{} );
-		VkDeviceQueueCreateInfo & ci = queue_ci.back();
-		ci.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-		ci.queueFamilyIndex = gfxQueueIdx;
-		ci.queueCount = 1;
-		ci.pQueuePriorities = &priority;
-		
-		queue_ci.push_back( VkDeviceQueueCreateInfo{} );
-		VkDeviceQueueCreateInfo & ci2 = queue_ci.back();
-		ci2.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-		ci2.queueFamilyIndex = presentQueueIdx;
-		ci2.queueCount = 1;
-		ci2.pQueuePriorities = &priority;
+		if ( gfxAndPresentQueueIdx < 0 && (gfxQueueIdx < 0 || presentQueueIdx < 0) )
+		{
+			throw std::runtime_error( "no graphics or present queue" );
+		}
+
+		familyOfType[GraphicsQueue] = gfxAndPresentQueueIdx >= 0 ? gfxAndPresentQueueIdx : gfxQueueIdx;
+		familyOfType[PresentQueue] = gfxAndPresentQueueIdx >= 0 ? gfxAndPresentQueueIdx : presentQueueIdx;
+		familyOfType[ComputeQueue] = computeQueueIdx;
+		familyOfType[CopyQueue] = copyQueueIdx;
 	}
 
-	if ( computeQueueIdx >= 0 )
+	for ( int type = 0; type < QueueCount; ++type )
 	{
-		queue_ci.push_back( VkDeviceQueueCreateInfo{} );
-		VkDeviceQueueCreateInfo & ci = queue_ci.back();
-		ci.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-		ci.queueFamilyIndex = computeQueueIdx;
-		ci.queueCount = 1;
-		ci.pQueuePriorities = &priority;
+		m_queueStages[type] = familyOfType[type] >= 0 ? CommandTranslatorVulkan::GetSupportedStages( queueProps[familyOfType[type]].queueFlags ) : 0;
+		m_queueTimestampBits[type] = familyOfType[type] >= 0 ? queueProps[familyOfType[type]].timestampValidBits : 0;
 	}
 
-	if ( copyQueueIdx >= 0 )
+	// One queue per family: vkGetDeviceQueue would return the same VkQueue for every type sharing it
+	ArenaVector<VkDeviceQueueCreateInfo> queue_ci( scratch.GetArena() );
+	queue_ci.reserve( QueueCount );
+	float priority = 1.0f;
+	for ( int type = 0; type < QueueCount; ++type )
 	{
+		const int family = familyOfType[type];
+		if ( family < 0 )
+			continue;
+
+		auto sameFamily = [family]( const VkDeviceQueueCreateInfo & ci ) { return ci.queueFamilyIndex == (uint32_t)family; };
+		if ( std::any_of( queue_ci.begin(), queue_ci.end(), sameFamily ) )
+			continue;
+
 		queue_ci.push_back( VkDeviceQueueCreateInfo{} );
 		VkDeviceQueueCreateInfo & ci = queue_ci.back();
 		ci.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-		ci.queueFamilyIndex = copyQueueIdx;
+		ci.queueFamilyIndex = family;
 		ci.queueCount = 1;
 		ci.pQueuePriorities = &priority;
 	}
@@ -269,8 +456,8 @@ void Device3DVulkan::CreateDeviceAndQueues()
 	deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	deviceCreateInfo.pQueueCreateInfos = queue_ci.data();
 	deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queue_ci.size());
-	deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions;
-	deviceCreateInfo.enabledExtensionCount = deviceExtensionCount;
+	deviceCreateInfo.ppEnabledExtensionNames = computeOnly ? nullptr : deviceExtensions;
+	deviceCreateInfo.enabledExtensionCount = computeOnly ? 0 : deviceExtensionCount;
 	deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
 
 #if 0
@@ -290,60 +477,555 @@ void Device3DVulkan::CreateDeviceAndQueues()
 		throw std::runtime_error( "failed to create logical device!" );
 	}
 
-	if ( gfxAndPresentQueueIdx >= 0 )
+	for ( const VkDeviceQueueCreateInfo & ci : queue_ci )
 	{
-		m_gfxQueue = new DeviceQueueVulkan();
-		m_gfxQueue->m_familyIdx = gfxAndPresentQueueIdx;
-		vkGetDeviceQueue( m_device, gfxAndPresentQueueIdx, 0, &m_gfxQueue->m_queueNative );
-		m_gfxQueue->InitCommandPool( m_device );
+		std::unique_ptr<DeviceQueueVulkan> queue( new DeviceQueueVulkan() );
+		queue->m_familyIdx = ci.queueFamilyIndex;
+		vkGetDeviceQueue( m_device, ci.queueFamilyIndex, 0, &queue->m_queueNative );
+		queue->InitCommandPool( m_device );
+		queue->InitSubmission( m_device );
+
+		const QueueHandle handle = m_queuePool.Create( (int)ci.queueFamilyIndex, std::move( queue ) );
+		for ( int type = 0; type < QueueCount; ++type )
+		{
+			if ( familyOfType[type] == (int)ci.queueFamilyIndex )
+				m_queues[type] = handle;
+		}
+	}
+}
 
-		m_presentQueue = m_gfxQueue;
+void Device3DVulkan::DestroyDeviceAndQueues()
+{
+	// Each queue is in the pool once, however many queue types alias it
+	while ( !m_queuePool.IsEmpty() )
+	{
+		const QueueHandle queue = m_queuePool.GetHandle( 0 );
+		DeviceQueueVulkan * queueVulkan = m_queuePool.Get<QueueObject>( queue ).get();
+		queueVulkan->DestroySubmission();
+		queueVulkan->DestroyCommandPool( m_device );
+		m_queuePool.Destroy( queue );
 	}
-	else
+	for ( QueueHandle & queue : m_queues )
 	{
-		assert( gfxQueueIdx >= 0 );
-		m_gfxQueue = new DeviceQueueVulkan();
-		m_gfxQueue->m_familyIdx = gfxQueueIdx;
-		vkGetDeviceQueue( m_device, gfxQueueIdx, 0, &m_gfxQueue->m_queueNative );
-		m_gfxQueue->InitCommandPool( m_device );
+		queue = QueueHandle();
+	}
 
-		assert( presentQueueIdx >= 0 );
-		m_presentQueue = new DeviceQueueVulkan();
-		m_presentQueue->m_familyIdx = presentQueueIdx;
-		vkGetDeviceQueue( m_device, presentQueueIdx, 0, &m_presentQueue->m_queueNative );
-		m_presentQueue->InitCommandPool( m_device );
+	while ( !m_bufferPool.IsEmpty() )
+	{
+		DestroyBuffer( m_bufferPool.GetHandle( 0 ) );
+	}
+	while ( !m_imagePool.IsEmpty() )
+	{
+		DestroyImage( m_imagePool.GetHandle( 0 ) );
+	}
+	while ( !m_pipelinePool.IsEmpty() )
+	{
+		DestroyPipeline( m_pipelinePool.GetHandle( 0 ) );
+	}
+	while ( !m_queryPools.IsEmpty() )
+	{
+		DestroyQueries( m_queryPools.GetHandle( 0 ) );
+	}
+	for ( const auto & it : m_renderPasses )
+	{
+		vkDestroyRenderPass( m_device, it.second, nullptr );
 	}
+	m_renderPasses.clear();
+	DestroyDescriptorPools();
 
-	if ( computeQueueIdx >= 0 )
+	vkDestroyDevice( m_device, nullptr );
+	m_device = VK_NULL_HANDLE;
+}
+
+BufferHandle Device3DVulkan::CreateBuffer( const BufferDesc & desc )
+{
+	VkBufferUsageFlags usage = 0;
+	usage |= (desc.usage & BufferUsageVertex) ? VK_BUFFER_USAGE_VERTEX_BUFFER_BIT : 0;
+	usage |= (desc.usage & BufferUsageIndex) ? VK_BUFFER_USAGE_INDEX_BUFFER_BIT : 0;
+	usage |= (desc.usage & BufferUsageUniform) ? VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT : 0;
+	usage |= (desc.usage & BufferUsageStorage) ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : 0;
+	usage |= (desc.usage & BufferUsageTransferSrc) ? VK_BUFFER_USAGE_TRANSFER_SRC_BIT : 0;
+	usage |= (desc.usage & BufferUsageTransferDst) ? VK_BUFFER_USAGE_TRANSFER_DST_BIT : 0;
+
+	VkMemoryPropertyFlags required = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	VkMemoryPropertyFlags preferred = 0;
+	if ( desc.memory == MemoryUsage::Upload )
 	{
-		m_computeQueue = new DeviceQueueVulkan();
-		m_computeQueue->m_familyIdx = computeQueueIdx;
-		vkGetDeviceQueue( m_device, computeQueueIdx, 0, &m_computeQueue->m_queueNative );
-		m_computeQueue->InitCommandPool( m_device );
+		required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+		preferred = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
 	}
+	else if ( desc.memory == MemoryUsage::Readback )
+	{
+		required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+		preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+	}
+
+	BufferVulkan buffer;
+	buffer.Init( m_device, m_physicalDevice, desc.size, usage, required, preferred );
+	return m_bufferPool.Create( buffer.m_native, buffer.m_memory, buffer.m_size, buffer.m_mapped );
+}
+
+void Device3DVulkan::DestroyBuffer( BufferHandle buffer )
+{
+	if ( !m_bufferPool.IsValid( buffer ) )
+		return;
+
+	if ( m_bufferPool.Get<BufferMapped>( buffer ) )
+		vkUnmapMemory( m_device, m_bufferPool.Get<BufferMemory>( buffer ) );
+	vkDestroyBuffer( m_device, m_bufferPool.Get<BufferNative>( buffer ), nullptr );
+	vkFreeMemory( m_device, m_bufferPool.Get<BufferMemory>( buffer ), nullptr );
+	m_bufferPool.Destroy( buffer );
+}
 
-	if ( copyQueueIdx >= 0 )
+void Device3DVulkan::InvalidateMappedBuffer( BufferHandle buffer )
+{
+	// No-op on coherent memory, required on the cached memory Readback buffers prefer
+	VkMappedMemoryRange range = {};
+	range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	range.memory = m_bufferPool.Get<BufferMemory>( buffer );
+	range.offset = 0;
+	range.size = VK_WHOLE_SIZE;
+	if ( vkInvalidateMappedMemoryRanges( m_device, 1, &range ) != VK_SUCCESS )
 	{
-		m_copyQueue = new DeviceQueueVulkan();
-		m_copyQueue->m_familyIdx = copyQueueIdx;
-		vkGetDeviceQueue( m_device, copyQueueIdx, 0, &m_copyQueue->m_queueNative );
-		m_copyQueue->InitCommandPool( m_device );
+		throw std::runtime_error( "Cannot invalidate mapped buffer" );
 	}
 }
 
-void Device3DVulkan::DestroyDeviceAndQueues()
+ImageHandle Device3DVulkan::CreateImage( const ImageDesc & desc )
 {
-	SAFE_DELETE( m_gfxQueue );
-	SAFE_DELETE( m_computeQueue );
-	SAFE_DELETE( m_copyQueue );
-	SAFE_DELETE( m_presentQueue );
+	static const VkFormat formats[] = {
+		VK_FORMAT_R8G8B8A8_UNORM,
+		VK_FORMAT_B8G8R8A8_UNORM,
+		VK_FORMAT_R16G16B16A16_SFLOAT,
+		VK_FORMAT_D32_SFLOAT,
+	};
+	const VkFormat format = formats[(int)desc.format];
+	const bool isDepth = desc.format == ImageFormat::D32F;
+
+	VkImageUsageFlags usage = 0;
+	usage |= (desc.usage & ImageUsageSampled) ? VK_IMAGE_USAGE_SAMPLED_BIT : 0;
+	usage |= (desc.usage & ImageUsageStorage) ? VK_IMAGE_USAGE_STORAGE_BIT : 0;
+	usage |= (desc.usage & ImageUsageColorTarget) ? VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT : 0;
+	usage |= (desc.usage & ImageUsageDepthTarget) ? VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT : 0;
+	usage |= (desc.usage & ImageUsageTransferSrc) ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0;
+	usage |= (desc.usage & ImageUsageTransferDst) ? VK_IMAGE_USAGE_TRANSFER_DST_BIT : 0;
+
+	VkImageCreateInfo imageInfo = {};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = format;
+	imageInfo.extent = { desc.width, desc.height, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = usage;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	// Images copied out on the copy queue, or written on the compute queue, are shared across the
+	// families rather than transferred back and forth
+	uint32_t families[3];
+	uint32_t familyCount = 0;
+	for ( QueueType type : { GraphicsQueue, ComputeQueue, CopyQueue } )
+	{
+		if ( !m_queues[type].IsValid() )
+			continue;
+		const uint32_t family = (uint32_t)m_queuePool.Get<QueueFamily>( m_queues[type] );
+		if ( std::find( families, families + familyCount, family ) == families + familyCount )
+			families[familyCount++] = family;
+	}
+	if ( (desc.usage & (ImageUsageTransferSrc | ImageUsageStorage)) && familyCount > 1 )
+	{
+		imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		imageInfo.queueFamilyIndexCount = familyCount;
+		imageInfo.pQueueFamilyIndices = families;
+	}
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
-	vkDestroyDevice( m_device, nullptr );
+	VkImage image;
+	if ( vkCreateImage( m_device, &imageInfo, nullptr, &image ) != VK_SUCCESS )
+	{
+		throw std::runtime_error( "Cannot create image" );
+	}
+
+	VkMemoryRequirements memReqs = {};
+	vkGetImageMemoryRequirements( m_device, image, &memReqs );
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memReqs.size;
+	allocInfo.memoryTypeIndex = FindMemoryTypeVulkan( m_physicalDevice, memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
+
+	VkDeviceMemory memory;
+	if ( vkAllocateMemory( m_device, &allocInfo, nullptr, &memory ) != VK_SUCCESS )
+	{
+		throw std::runtime_error( "Cannot allocate image memory" );
+	}
+	vkBindImageMemory( m_device, image, memory, 0 );
+
+	// Transfer-only images are never bound to a shader or a framebuffer, they get no view
+	VkImageView view = VK_NULL_HANDLE;
+	if ( usage & ~(VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT) )
+	{
+		VkImageViewCreateInfo viewInfo = {};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = format;
+		viewInfo.subresourceRange.aspectMask = isDepth ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		if ( vkCreateImageView( m_device, &viewInfo, nullptr, &view ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "Cannot create image view" );
+		}
+	}
+
+	// Color targets are only ever rendered whole, in the render pass of their format
+	VkFramebuffer framebuffer = VK_NULL_HANDLE;
+	if ( usage & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT )
+	{
+		VkFramebufferCreateInfo framebufferInfo = {};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = GetRenderPass( format );
+		framebufferInfo.attachmentCount = 1;
+		framebufferInfo.pAttachments = &view;
+		framebufferInfo.width = desc.width;
+		framebufferInfo.height = desc.height;
+		framebufferInfo.layers = 1;
+
+		if ( vkCreateFramebuffer( m_device, &framebufferInfo, nullptr, &framebuffer ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "Cannot create framebuffer" );
+		}
+	}
+
+	return m_imagePool.Create( image, view, memory, VkExtent2D{ desc.width, desc.height }, format, framebuffer );
+}
+
+void Device3DVulkan::DestroyImage( ImageHandle image )
+{
+	if ( !m_imagePool.IsValid( image ) )
+		return;
+
+	if ( m_imagePool.Get<ImageFramebuffer>( image ) != VK_NULL_HANDLE )
+		vkDestroyFramebuffer( m_device, m_imagePool.Get<ImageFramebuffer>( image ), nullptr );
+	if ( m_imagePool.Get<ImageView>( image ) != VK_NULL_HANDLE )
+		vkDestroyImageView( m_device, m_imagePool.Get<ImageView>( image ), nullptr );
+	vkDestroyImage( m_device, m_imagePool.Get<ImageNative>( image ), nullptr );
+	vkFreeMemory( m_device, m_imagePool.Get<ImageMemory>( image ), nullptr );
+	m_imagePool.Destroy( image );
+}
+
+PipelineHandle Device3DVulkan::AddPipeline( VkPipeline pipeline, VkPipelineLayout layout, VkPipelineBindPoint bindPoint,
+	VkDescriptorSetLayout storageSetLayout, uint32_t storageBufferCount, uint32_t storageImageMask )
+{
+	assert( storageBufferCount <= CommandTranslatorVulkan::MAX_STORAGE_BUFFERS && (storageImageMask >> storageBufferCount) == 0 );
+	return m_pipelinePool.Create( pipeline, layout, bindPoint, storageSetLayout, storageBufferCount, storageImageMask );
+}
+
+PipelineHandle Device3DVulkan::CreateComputePipeline( const SpirvBlob & spirv )
+{
+	ShaderReflectionVulkan reflection;
+	reflection.Reflect( spirv );
+	if ( reflection.stage != VK_SHADER_STAGE_COMPUTE_BIT )
+	{
+		throw std::runtime_error( "not a compute shader" );
+	}
+
+	// The translator writes bindings 0..n-1 of set 0, each from a BindStorageBuffer() or BindStorageImage()
+	uint32_t storageBufferCount = 0;
+	uint32_t storageImageMask = 0;
+	for ( const DescriptorBindingVulkan & desc : reflection.bindings )
+	{
+		const VkDescriptorType type = desc.binding.descriptorType;
+		if ( desc.set != 0 || (type != VK_DESCRIPTOR_TYPE_STORAGE_BUFFER && type != VK_DESCRIPTOR_TYPE_STORAGE_IMAGE) || desc.binding.descriptorCount != 1 )
+		{
+			throw std::runtime_error( "compute pipelines only take single storage buffers and images in set 0" );
+		}
+		storageBufferCount = std::max( storageBufferCount, desc.binding.binding + 1 );
+		if ( type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE && desc.binding.binding < 32 )
+			storageImageMask |= 1u << desc.binding.binding;
+	}
+	if ( storageBufferCount != reflection.bindings.size() || storageBufferCount > CommandTranslatorVulkan::MAX_STORAGE_BUFFERS )
+	{
+		throw std::runtime_error( "storage bindings must be contiguous from 0, 8 at most" );
+	}
+
+	const ShaderReflectionVulkan * stages[] = { &reflection };
+	const PipelineLayoutVulkan & layout = m_layoutCache.GetLayout( stages, 1 );
+	const VkDescriptorSetLayout setLayout = layout.setCount ? layout.setLayouts[0] : VK_NULL_HANDLE;
+
+	PipelineKeyVulkan key;
+	key.AddBytes( spirv.words, spirv.SizeInBytes() ).Add( layout.m_native );
+	VkPipeline pipeline = m_pipelineCache.Find( key );
+	if ( pipeline == VK_NULL_HANDLE )
+	{
+		VkShaderModuleCreateInfo moduleInfo = {};
+		moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleInfo.codeSize = spirv.SizeInBytes();
+		moduleInfo.pCode = spirv.words;
+		VkShaderModule module;
+		if ( vkCreateShaderModule( m_device, &moduleInfo, nullptr, &module ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "Cannot create shader module" );
+		}
+
+		VkComputePipelineCreateInfo createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		createInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		createInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		createInfo.stage.module = module;
+		createInfo.stage.pName = reflection.entryPoint.c_str();
+		createInfo.layout = layout.m_native;
+		createInfo.basePipelineIndex = -1;
+
+		try
+		{
+			pipeline = m_pipelineCache.CreateComputePipeline( key, createInfo );
+		}
+		catch ( ... )
+		{
+			vkDestroyShaderModule( m_device, module, nullptr );
+			throw;
+		}
+		vkDestroyShaderModule( m_device, module, nullptr );
+	}
+
+	return AddPipeline( pipeline, layout.m_native, VK_PIPELINE_BIND_POINT_COMPUTE, setLayout, storageBufferCount, storageImageMask );
+}
+
+VkRenderPass Device3DVulkan::GetRenderPass( VkFormat colorFormat )
+{
+	std::lock_guard<std::mutex> lock( m_renderPassMutex );
+	for ( const auto & it : m_renderPasses )
+	{
+		if ( it.first == colorFormat )
+			return it.second;
+	}
+
+	// Layouts are the lists' business: the target enters and leaves in the ColorTarget state's layout
+	VkAttachmentDescription colorAttachment = {};
+	colorAttachment.format = colorFormat;
+	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference colorAttachmentRef = {};
+	colorAttachmentRef.attachment = 0;
+	colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &colorAttachmentRef;
+
+	VkRenderPassCreateInfo renderPassInfo = {};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassInfo.attachmentCount = 1;
+	renderPassInfo.pAttachments = &colorAttachment;
+	renderPassInfo.subpassCount = 1;
+	renderPassInfo.pSubpasses = &subpass;
+
+	VkRenderPass renderPass;
+	if ( vkCreateRenderPass( m_device, &renderPassInfo, nullptr, &renderPass ) != VK_SUCCESS )
+	{
+		throw std::runtime_error( "Cannot create render pass" );
+	}
+	m_renderPasses.emplace_back( colorFormat, renderPass );
+	return renderPass;
+}
+
+void Device3DVulkan::DestroyPipeline( PipelineHandle pipeline )
+{
+	m_pipelinePool.Destroy( pipeline );
+}
+
+uint64_t Device3DVulkan::Submit( QueueType type, const CommandList * const * lists, uint32_t count )
+{
+	std::lock_guard<std::mutex> lock( m_submitMutex );
+
+	if ( !m_queues[type].IsValid() )
+	{
+		throw std::runtime_error( "no such queue on this device" );
+	}
+
+	DeviceQueueVulkan * queue = GetQueueVulkan( type );
+	VkCommandBuffer cmd = queue->AcquireCommandBuffer();
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	if ( vkBeginCommandBuffer( cmd, &beginInfo ) != VK_SUCCESS )
+	{
+		throw std::runtime_error( "failed to begin recording command buffer!" );
+	}
+
+	m_translator.Translate( cmd, lists, count, m_queueStages[type] );
+
+	if ( vkEndCommandBuffer( cmd ) != VK_SUCCESS )
+	{
+		throw std::runtime_error( "failed to end recording command buffer!" );
+	}
+
+	SubmitBatchVulkan batch;
+	batch.AddCommandBuffer( cmd );
+	const uint64_t serial = queue->Enqueue( batch );
+	queue->RetireCommandBuffer( cmd, serial );
+	RetireDescriptorPools( type, serial );
+	return serial;
+}
+
+VkDescriptorSet Device3DVulkan::AllocateDescriptorSet( VkDescriptorSetLayout setLayout )
+{
+	if ( m_descriptorSetsLeft == 0 )
+	{
+		m_submitDescriptorPools.push_back( AcquireDescriptorPool() );
+		m_descriptorSetsLeft = DESCRIPTOR_SETS_PER_POOL;
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = m_submitDescriptorPools.back();
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &setLayout;
+
+	VkDescriptorSet set;
+	if ( vkAllocateDescriptorSets( m_device, &allocInfo, &set ) != VK_SUCCESS )
+	{
+		throw std::runtime_error( "Cannot allocate descriptor set" );
+	}
+	--m_descriptorSetsLeft;
+	return set;
+}
+
+VkDescriptorPool Device3DVulkan::AcquireDescriptorPool()
+{
+	for ( auto it = m_retiredDescriptorPools.begin(); it != m_retiredDescriptorPools.end(); ++it )
+	{
+		if ( IsComplete( it->queue, it->serial ) )
+		{
+			const VkDescriptorPool pool = it->pool;
+			m_retiredDescriptorPools.erase( it );
+			vkResetDescriptorPool( m_device, pool, 0 );
+			return pool;
+		}
+	}
+
+	// Room for the set count whatever the storage buffer and image count of each set
+	VkDescriptorPoolSize poolSizes[2] = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[0].descriptorCount = DESCRIPTOR_SETS_PER_POOL * CommandTranslatorVulkan::MAX_STORAGE_BUFFERS;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSizes[1].descriptorCount = DESCRIPTOR_SETS_PER_POOL * CommandTranslatorVulkan::MAX_STORAGE_BUFFERS;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = DESCRIPTOR_SETS_PER_POOL;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes = poolSizes;
+
+	VkDescriptorPool pool;
+	if ( vkCreateDescriptorPool( m_device, &poolInfo, nullptr, &pool ) != VK_SUCCESS )
+	{
+		throw std::runtime_error( "Cannot create descriptor pool" );
+	}
+	m_descriptorPools.push_back( pool );
+	return pool;
+}
+
+void Device3DVulkan::RetireDescriptorPools( QueueType type, uint64_t serial )
+{
+	// A partly used pool is retired too: the next submission may go to another queue
+	for ( VkDescriptorPool pool : m_submitDescriptorPools )
+	{
+		m_retiredDescriptorPools.push_back( { pool, type, serial } );
+	}
+	m_submitDescriptorPools.clear();
+	m_descriptorSetsLeft = 0;
+}
+
+void Device3DVulkan::DestroyDescriptorPools()
+{
+	for ( VkDescriptorPool pool : m_descriptorPools )
+	{
+		vkDestroyDescriptorPool( m_device, pool, nullptr );
+	}
+	m_descriptorPools.clear();
+	m_submitDescriptorPools.clear();
+	m_retiredDescriptorPools.clear();
+	m_descriptorSetsLeft = 0;
+}
+
+bool Device3DVulkan::IsComplete( QueueType type, uint64_t serial ) const
+{
+	return GetQueueVulkan( type )->IsComplete( serial );
+}
+
+void Device3DVulkan::WaitComplete( QueueType type, uint64_t serial )
+{
+	GetQueueVulkan( type )->WaitComplete( serial );
+}
+
+QueryPoolHandle Device3DVulkan::CreateTimestampQueries( QueueType type, uint32_t count )
+{
+	const uint32_t validBits = m_queueTimestampBits[type];
+	if ( validBits == 0 || m_limits.timestampPeriod <= 0.0f )
+		return QueryPoolHandle();
+
+	VkQueryPoolCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	createInfo.queryCount = count;
+
+	VkQueryPool pool = VK_NULL_HANDLE;
+	if ( vkCreateQueryPool( m_device, &createInfo, nullptr, &pool ) != VK_SUCCESS )
+	{
+		throw std::runtime_error( "cannot create timestamp query pool" );
+	}
+	return m_queryPools.Create( pool, validBits >= 64 ? ~0ull : (1ull << validBits) - 1 );
+}
+
+void Device3DVulkan::DestroyQueries( QueryPoolHandle pool )
+{
+	if ( !m_queryPools.IsValid( pool ) )
+		return;
+
+	vkDestroyQueryPool( m_device, m_queryPools.Get<QueryPoolNative>( pool ), nullptr );
+	m_queryPools.Destroy( pool );
+}
+
+double Device3DVulkan::GetTimestampDeltaMs( QueryPoolHandle pool, uint32_t begin, uint32_t end )
+{
+	// No wait flag: the caller waited for the submission, a query that is not ready was never written
+	uint64_t timestamps[2];
+	const VkQueryPool native = m_queryPools.Get<QueryPoolNative>( pool );
+	if ( vkGetQueryPoolResults( m_device, native, begin, 1, sizeof( uint64_t ), &timestamps[0], sizeof( uint64_t ), VK_QUERY_RESULT_64_BIT ) != VK_SUCCESS
+		|| vkGetQueryPoolResults( m_device, native, end, 1, sizeof( uint64_t ), &timestamps[1], sizeof( uint64_t ), VK_QUERY_RESULT_64_BIT ) != VK_SUCCESS )
+	{
+		return -1.0;
+	}
+	const uint64_t ticks = (timestamps[1] - timestamps[0]) & m_queryPools.Get<QueryPoolTimestampMask>( pool );
+	return (double)ticks * m_limits.timestampPeriod / 1e6;
 }
 
 void Device3DVulkan::CreateSwapChain()
 {
+	AllocationScopeGuard scope( AllocationScope::SwapChain );
 	assert( m_surface != VK_NULL_HANDLE );
+
+	// Queue families were picked before the surface existed
+	VkBool32 presentSupport = VK_FALSE;
+	vkGetPhysicalDeviceSurfaceSupportKHR( m_physicalDevice, (uint32_t)m_queuePool.Get<QueueFamily>( m_queues[PresentQueue] ), m_surface, &presentSupport );
+	if ( !presentSupport )
+	{
+		throw std::runtime_error( "present queue cannot present to the window surface" );
+	}
 	
 	VkSurfaceCapabilitiesKHR surfaceCaps = {};
 	vkGetPhysicalDeviceSurfaceCapabilitiesKHR( m_physicalDevice, m_surface, &surfaceCaps );
@@ -371,26 +1053,15 @@ void Device3DVulkan::CreateSwapChain()
 		}
 	}
 
-	// Present mode
-	uint32_t presentModeCount;
+	// Present mode and image count
+	uint32_t presentModeCount = 0;
 	vkGetPhysicalDeviceSurfacePresentModesKHR( m_physicalDevice, m_surface, &presentModeCount, nullptr );
-	if ( presentModeCount > 0 )
-	{
-		std::vector<VkPresentModeKHR> presentModes;
-		presentModes.resize( presentModeCount );
-		vkGetPhysicalDeviceSurfacePresentModesKHR( m_physicalDevice, m_surface, &presentModeCount, presentModes.data() );
-
-		m_swapChain.presentMode = presentModes[0];
+	std::vector<VkPresentModeKHR> presentModes( presentModeCount );
+	vkGetPhysicalDeviceSurfacePresentModesKHR( m_physicalDevice, m_surface, &presentModeCount, presentModes.data() );
 
-		for ( auto& availablePresentMode : presentModes )
-		{
-			if ( availablePresentMode == preferredPresentMode )
-			{
-				m_swapChain.presentMode = preferredPresentMode;
-				break;
-			}
-		}
-	}
+	const PresentConfigVulkan presentConfig = ChoosePresentConfigVulkan( m_presentPolicy, surfaceCaps, presentModes.data(), presentModeCount );
+	m_swapChain.presentMode = presentConfig.presentMode;
+	m_swapChain.imageCount = presentConfig.imageCount;
 
 	// Extent
 	if ( surfaceCaps.currentExtent.width != std::numeric_limits<uint32_t>::max() )
@@ -405,8 +1076,6 @@ void Device3DVulkan::CreateSwapChain()
 		m_swapChain.extent = actualExtent;
 	}
 
-	m_swapChain.imageCount = std::min( std::max( surfaceCaps.minImageCount, NUM_BACK_BUFFER ), surfaceCaps.maxImageCount );
-
 	VkSwapchainCreateInfoKHR createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
 	createInfo.surface = m_surface;
@@ -417,7 +1086,7 @@ void Device3DVulkan::CreateSwapChain()
 	createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 	createInfo.minImageCount = m_swapChain.imageCount;
 
-	uint32_t queueFamilyIndices[] = { (uint32_t)m_gfxQueue->m_familyIdx, (uint32_t)m_presentQueue->m_familyIdx };
+	uint32_t queueFamilyIndices[] = { (uint32_t)m_queuePool.Get<QueueFamily>( m_queues[GraphicsQueue] ), (uint32_t)m_queuePool.Get<QueueFamily>( m_queues[PresentQueue] ) };
 
 	if ( queueFamilyIndices[0] != queueFamilyIndices[1] )
 	{
@@ -437,20 +1106,50 @@ void Device3DVulkan::CreateSwapChain()
 
 	createInfo.presentMode = m_swapChain.presentMode;
 	createInfo.clipped = VK_TRUE;
-	createInfo.oldSwapchain = VK_NULL_HANDLE;
+	// Lets the presentation engine hand over to the new swap chain without a blank frame
+	createInfo.oldSwapchain = m_swapChain.m_native;
 
-	if ( vkCreateSwapchainKHR( m_device, &createInfo, nullptr, &m_swapChain.m_native ) != VK_SUCCESS )
+	VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+	if ( vkCreateSwapchainKHR( m_device, &createInfo, nullptr, &swapChain ) != VK_SUCCESS )
 	{
 		throw std::runtime_error( "failed to create swap chain" );
 	}
+	DestroySwapChain();
+	m_swapChain.m_native = swapChain;
 
-	// Retrieves swap chain images
+	// Retrieves swap chain images, there may be more than asked for
 	uint32_t imageCount;
 	vkGetSwapchainImagesKHR( m_device, m_swapChain.m_native, &imageCount, nullptr );
+	m_swapChain.imageCount = imageCount;
 	m_swapChain.m_image = new VkImage[imageCount];
 	vkGetSwapchainImagesKHR( m_device, m_swapChain.m_native, &imageCount, m_swapChain.m_image );
 }
 
+void Device3DVulkan::DestroySwapChain()
+{
+	if ( m_swapChain.m_native == VK_NULL_HANDLE )
+		return;
+
+	vkDestroySwapchainKHR( m_device, m_swapChain.m_native, nullptr );
+	m_swapChain.m_native = VK_NULL_HANDLE;
+	SAFE_DELETE_ARRAY( m_swapChain.m_image );
+	m_swapChain.imageCount = 0;
+}
+
+void Device3DVulkan::SetPresentPolicy( PresentPolicy policy )
+{
+	if ( policy == m_presentPolicy )
+		return;
+
+	m_presentPolicy = policy;
+	if ( m_swapChain.m_native == VK_NULL_HANDLE )
+		return;
+
+	// No image of the old swap chain may still be in use
+	vkDeviceWaitIdle( m_device );
+	CreateSwapChain();
+}
+
 bool Device3DVulkan::CheckInstanceExtensions( const std::vector<const char*>& requiredExt ) {
 	uint32_t extensionCount = 0;
 	vkEnumerateInstanceExtensionProperties( nullptr, &extensionCount, nullptr );
@@ -458,13 +1157,6 @@ bool Device3DVulkan::CheckInstanceExtensions( const std::vector<const char*>& re
 	std::vector<VkExtensionProperties> extensions( extensionCount );
 	vkEnumerateInstanceExtensionProperties( nullptr, &extensionCount, extensions.data() );
 
-	std::cout << "available extensions:" << std::endl;
-
-	for ( const auto & extension : extensions )
-	{
-		std::cout << "\t" << extension.extensionName << std::endl;
-	}
-
 	bool allFound = true;
 	for ( const auto & req : requiredExt )
 	{
@@ -477,9 +1169,11 @@ bool Device3DVulkan::CheckInstanceExtensions( const std::vector<const char*>& re
 				break;
 			}
 		}
+		if ( !found )
+			std::cerr << "missing instance extension: " << req << std::endl;
 		allFound &= found;
 	}
-	return false;
+	return allFound;
 }
 
 bool Device3DVulkan::CheckDeviceExtensionSupport( VkPhysicalDevice device, const std::vector<const char *> & deviceExtensions ) {
@@ -1,12 +1,35 @@
 #pragma once
 #include "../device.h"
+#include "CommandList_vulkan.h"
+#include "PipelineCache_vulkan.h"
+#include "PipelineLayoutCache_vulkan.h"
+#include "PresentPolicy_vulkan.h"
+#include "../thread/JobSystem.h"
 
 #include <vulkan/vulkan.h>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 struct GLFWwindow;
+struct SpirvBlob;
 class DeviceQueueVulkan;
 
+enum class DeviceModeVulkan
+{
+	Windowed,		// window, surface and swap chain, graphics and present queues
+	ComputeOnly,	// headless: no GLFW, no surface, no swap chain extension, compute and copy queues only
+};
+
+struct DeviceDescVulkan
+{
+	DeviceModeVulkan mode = DeviceModeVulkan::Windowed;
+	// A CPU implementation (lavapipe, SwiftShader) rather than the first device, Init() fails without one
+	bool preferCpuDevice = false;
+};
+
 class SwapChainVulkan
 {
 public:
@@ -16,40 +39,173 @@ public:
 	VkSurfaceFormatKHR surfaceFormat = {};
 	VkPresentModeKHR presentMode = {};
 	VkExtent2D extent = {};
-	VkSwapchainKHR m_native = {};
+	VkSwapchainKHR m_native = VK_NULL_HANDLE;
 	uint32_t imageCount = 0U;
 	VkImage * m_image = nullptr;
 };
 
+// Init() must be called from the main thread (GLFW). Given a job system, the window is created there
+// while device, queues and pipeline cache are set up on a worker, next to any tasks added with AddInitTask().
+// In ComputeOnly mode there is no window: GetQueue() returns invalid handles for the graphics and present
+// queues, and submitting to them throws.
 class Device3DVulkan : public IDevice3D
 {
 public:
+	explicit Device3DVulkan( JobSystem * jobs = nullptr, const DeviceDescVulkan & desc = DeviceDescVulkan() );
+	virtual ~Device3DVulkan();
+
+	// Work independent of the device (shader loading...) overlapped with Init(), which rethrows its errors
+	void AddInitTask( JobFunction function, void * data );
 	virtual void Init() override;
 	virtual void Destroy() override;
 
+	virtual QueueHandle GetQueue( QueueType type ) const override { return m_queues[type]; }
+
+	virtual BufferHandle CreateBuffer( const BufferDesc & desc ) override;
+	virtual void DestroyBuffer( BufferHandle buffer ) override;
+	virtual void * GetMappedBuffer( BufferHandle buffer ) const override { return m_bufferPool.Get<BufferMapped>( buffer ); }
+	virtual void InvalidateMappedBuffer( BufferHandle buffer ) override;
+	virtual ImageHandle CreateImage( const ImageDesc & desc ) override;
+	virtual void DestroyImage( ImageHandle image ) override;
+	virtual void DestroyPipeline( PipelineHandle pipeline ) override;
+
+	virtual uint64_t Submit( QueueType type, const CommandList * const * lists, uint32_t count ) override;
+	virtual bool IsComplete( QueueType type, uint64_t serial ) const override;
+	virtual void WaitComplete( QueueType type, uint64_t serial ) override;
+	virtual QueryPoolHandle CreateTimestampQueries( QueueType type, uint32_t count ) override;
+	virtual void DestroyQueries( QueryPoolHandle pool ) override;
+	virtual double GetTimestampDeltaMs( QueryPoolHandle pool, uint32_t begin, uint32_t end ) override;
+	const CommandTranslatorVulkan::Stats & GetTranslatorStats() const { return m_translator.GetStats(); }
+	void ResetTranslatorStats() { std::lock_guard<std::mutex> lock( m_submitMutex ); m_translator.ResetStats(); }
+
+	// Pipelines stay owned by whoever created them (PipelineCacheVulkan), the device only hands out handles
+	// storageImageMask has a bit per binding of the storage set that is a storage image rather than a buffer
+	PipelineHandle AddPipeline( VkPipeline pipeline, VkPipelineLayout layout, VkPipelineBindPoint bindPoint,
+		VkDescriptorSetLayout storageSetLayout = VK_NULL_HANDLE, uint32_t storageBufferCount = 0, uint32_t storageImageMask = 0 );
+	// Compute shader whose set 0 holds storage buffers and images only, bound 0..n-1 with
+	// CommandList::BindStorageBuffer() and BindStorageImage()
+	PipelineHandle CreateComputePipeline( const SpirvBlob & spirv );
+	// Render pass CommandList::BeginRenderPass() uses for targets of this format: one color attachment,
+	// cleared and stored. Graphics pipelines drawing into those targets are created against it, with
+	// dynamic viewport and scissor.
+	VkRenderPass GetRenderPass( VkFormat colorFormat );
+	PipelineCacheVulkan & GetPipelineCache() { return m_pipelineCache; }
+
+	// For the translator, under the submit lock: sets live until the submission they were written for completes
+	VkDescriptorSet AllocateDescriptorSet( VkDescriptorSetLayout setLayout );
+
+	// Recreates the swap chain, if there is one, with the present mode and image count of the policy
+	void SetPresentPolicy( PresentPolicy policy );
+	PresentPolicy GetPresentPolicy() const { return m_presentPolicy; }
+
+	bool IsComputeOnly() const { return m_desc.mode == DeviceModeVulkan::ComputeOnly; }
+	const VkPhysicalDeviceLimits & GetLimits() const { return m_limits; }
+	// Subgroup size when compute shaders get subgroup arithmetic (Vulkan 1.1 instance and device), 0 otherwise
+	uint32_t GetComputeSubgroupSize() const { return m_computeSubgroupSize; }
+	VkDevice GetNativeDevice() const { return m_device; }
+	DeviceQueueVulkan * GetQueueVulkan( QueueType type ) const { return m_queuePool.Get<QueueObject>( m_queues[type] ).get(); }
+	// Pipeline stages the queue's family accepts, what its submissions are translated with
+	VkPipelineStageFlags GetQueueStages( QueueType type ) const { return m_queueStages[type]; }
+	VkBuffer GetNativeBuffer( BufferHandle buffer ) const { return m_bufferPool.Get<BufferNative>( buffer ); }
+	VkImage GetNativeImage( ImageHandle image ) const { return m_imagePool.Get<ImageNative>( image ); }
+	VkImageView GetNativeImageView( ImageHandle image ) const { return m_imagePool.Get<ImageView>( image ); }
+	VkExtent2D GetImageExtent( ImageHandle image ) const { return m_imagePool.Get<ImageExtent>( image ); }
+	VkFormat GetNativeImageFormat( ImageHandle image ) const { return m_imagePool.Get<ImageFormatNative>( image ); }
+	VkPipeline GetNativePipeline( PipelineHandle pipeline ) const { return m_pipelinePool.Get<PipelineNative>( pipeline ); }
+	VkPipelineLayout GetPipelineLayout( PipelineHandle pipeline ) const { return m_pipelinePool.Get<PipelineLayout>( pipeline ); }
+	VkPipelineBindPoint GetPipelineBindPoint( PipelineHandle pipeline ) const { return m_pipelinePool.Get<PipelineBindPoint>( pipeline ); }
+	VkDescriptorSetLayout GetPipelineSetLayout( PipelineHandle pipeline ) const { return m_pipelinePool.Get<PipelineSetLayout>( pipeline ); }
+	uint32_t GetPipelineStorageBufferCount( PipelineHandle pipeline ) const { return m_pipelinePool.Get<PipelineStorageBufferCount>( pipeline ); }
+	uint32_t GetPipelineStorageImageMask( PipelineHandle pipeline ) const { return m_pipelinePool.Get<PipelineStorageImageMask>( pipeline ); }
+	// VK_NULL_HANDLE unless the image was created with ImageUsageColorTarget
+	VkFramebuffer GetImageFramebuffer( ImageHandle image ) const { return m_imagePool.Get<ImageFramebuffer>( image ); }
+	VkQueryPool GetNativeQueryPool( QueryPoolHandle pool ) const { return m_queryPools.Get<QueryPoolNative>( pool ); }
+
 public:
 	void CreateInstance();
 	void DestroyInstance();
 	void CreateWindow();
 	void DestroyWindow();
+	void PickPhysicalDevice();
+	void QuerySubgroupSupport( const VkPhysicalDeviceProperties & props );
 	void CreateDeviceAndQueues();
 	void DestroyDeviceAndQueues();
 	void CreateSwapChain();
+	void DestroySwapChain();
 
 private:
+	struct InitTask
+	{
+		Device3DVulkan * device;
+		JobFunction function;
+		void * data;
+	};
+
+	struct RetiredDescriptorPool
+	{
+		VkDescriptorPool pool;
+		QueueType queue;
+		uint64_t serial;
+	};
+
+	static void RunInitTask( void * data );
+	void InitDevice();
 	bool CheckInstanceExtensions( const std::vector<const char *> & requiredExt );
 	bool CheckDeviceExtensionSupport( VkPhysicalDevice device, const std::vector<const char *> & deviceExtensions );
+	VkDescriptorPool AcquireDescriptorPool();
+	void RetireDescriptorPools( QueueType type, uint64_t serial );
+	void DestroyDescriptorPools();
 
 private:
+	static constexpr uint32_t DESCRIPTOR_SETS_PER_POOL = 256;
+
+	DeviceDescVulkan m_desc;
 	VkDevice m_device = VK_NULL_HANDLE;
 	VkInstance m_instance = VK_NULL_HANDLE;
 	VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+	uint32_t m_instanceVersion = VK_API_VERSION_1_0;
+	VkPhysicalDeviceLimits m_limits = {};
+	uint32_t m_computeSubgroupSize = 0;
 	VkSurfaceKHR m_surface = VK_NULL_HANDLE;
 	SwapChainVulkan m_swapChain;
+	PresentPolicy m_presentPolicy = PresentPolicy::Throughput;
 	GLFWwindow * m_window = nullptr;
-	DeviceQueueVulkan * m_queues[QueueCount];
-	DeviceQueueVulkan * & m_gfxQueue = m_queues[GraphicsQueue];
-	DeviceQueueVulkan * & m_computeQueue = m_queues[ComputeQueue];
-	DeviceQueueVulkan * & m_copyQueue = m_queues[CopyQueue];
-	DeviceQueueVulkan * & m_presentQueue = m_queues[PresentQueue];
+
+	// Resources live in SoA pools, the component indices below name the fields
+	enum QueueComponent { QueueFamily = 0, QueueObject };
+	enum BufferComponent { BufferNative = 0, BufferMemory, BufferSize, BufferMapped };
+	enum ImageComponent { ImageNative = 0, ImageView, ImageMemory, ImageExtent, ImageFormatNative, ImageFramebuffer };
+	enum PipelineComponent { PipelineNative = 0, PipelineLayout, PipelineBindPoint, PipelineSetLayout, PipelineStorageBufferCount, PipelineStorageImageMask };
+	enum QueryPoolComponent { QueryPoolNative = 0, QueryPoolTimestampMask };
+
+	HandlePool<QueueTag, int, std::unique_ptr<DeviceQueueVulkan>> m_queuePool;
+	HandlePool<BufferTag, VkBuffer, VkDeviceMemory, VkDeviceSize, void *> m_bufferPool;
+	HandlePool<ImageTag, VkImage, VkImageView, VkDeviceMemory, VkExtent2D, VkFormat, VkFramebuffer> m_imagePool;
+	HandlePool<PipelineTag, VkPipeline, VkPipelineLayout, VkPipelineBindPoint, VkDescriptorSetLayout, uint32_t, uint32_t> m_pipelinePool;
+	HandlePool<QueryPoolTag, VkQueryPool, uint64_t> m_queryPools;
+
+	// Queue types sharing a family share the queue, and its handle
+	QueueHandle m_queues[QueueCount];
+	VkPipelineStageFlags m_queueStages[QueueCount] = {};
+	uint32_t m_queueTimestampBits[QueueCount] = {};	// timestampValidBits of the family, 0 when it cannot time
+
+	// One per color format, a handful at most
+	std::mutex m_renderPassMutex;
+	std::vector<std::pair<VkFormat, VkRenderPass>> m_renderPasses;
+
+	std::mutex m_submitMutex;
+	CommandTranslatorVulkan m_translator{ *this };
+	PipelineCacheVulkan m_pipelineCache;
+	PipelineLayoutCacheVulkan m_layoutCache;
+
+	// Descriptor pools are filled by the submissions, then reset as a whole once the last one using them completes
+	std::vector<VkDescriptorPool> m_descriptorPools;	// every pool, for destruction
+	std::vector<VkDescriptorPool> m_submitDescriptorPools;	// written by the submission being translated
+	std::deque<RetiredDescriptorPool> m_retiredDescriptorPools;
+	uint32_t m_descriptorSetsLeft = 0;	// in the last of m_submitDescriptorPools
+
+	JobSystem * m_jobs;
+	std::vector<InitTask> m_initTasks;
+	std::mutex m_initErrorMutex;
+	std::exception_ptr m_initError;
 };
\ No newline at end of file
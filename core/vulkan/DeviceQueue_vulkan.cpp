@@ -1,14 +1,374 @@
 #include <stdafx.h>
 #include "DeviceQueue_vulkan.h"
 
+#include <limits>
+
+//
+//
+//	SubmitBatchVulkan =============================================================================
+//
+//
+void SubmitBatchVulkan::AddCommandBuffer( VkCommandBuffer commandBuffer )
+{
+	assert( commandBufferCount < MAX_COMMAND_BUFFERS );
+	commandBuffers[commandBufferCount++] = commandBuffer;
+}
+
+void SubmitBatchVulkan::Wait( VkSemaphore semaphore, VkPipelineStageFlags stage )
+{
+	assert( waitCount < MAX_SEMAPHORES );
+	waitSemaphores[waitCount] = semaphore;
+	waitStages[waitCount] = stage;
+	++waitCount;
+}
+
+void SubmitBatchVulkan::Signal( VkSemaphore semaphore )
+{
+	assert( signalCount < MAX_SEMAPHORES );
+	signalSemaphores[signalCount++] = semaphore;
+}
+
+void SubmitBatchVulkan::Present( VkSwapchainKHR swapChain, uint32_t imageIndex )
+{
+	presentSwapChain = swapChain;
+	presentImageIndex = imageIndex;
+}
+
+//
+//
+//	DeviceQueueVulkan =============================================================================
+//
+//
+DeviceQueueVulkan::DeviceQueueVulkan()
+	: m_ring( SUBMIT_RING_SIZE )
+{
+}
+
+DeviceQueueVulkan::~DeviceQueueVulkan()
+{
+	DestroySubmission();
+}
+
 void DeviceQueueVulkan::InitCommandPool( VkDevice & device)
 {
 	VkCommandPoolCreateInfo cpInfo = {};
 	cpInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	cpInfo.queueFamilyIndex = m_familyIdx;
+	cpInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
 	if ( vkCreateCommandPool( device, &cpInfo, nullptr, &m_commandPool ) != VK_SUCCESS )
 	{
 		throw std::runtime_error( "Cannot create command pool" );
 	}
 }
+
+void DeviceQueueVulkan::DestroyCommandPool( VkDevice & device )
+{
+	// Freed along with the pool
+	m_retiredCommandBuffers.clear();
+	m_freeCommandBuffers.clear();
+	vkDestroyCommandPool( device, m_commandPool, nullptr );
+	m_commandPool = VK_NULL_HANDLE;
+}
+
+void DeviceQueueVulkan::InitSubmission( VkDevice device )
+{
+	assert( !m_running );
+
+	m_device = device;
+	m_running = true;
+	m_retireRunning = true;
+	m_submitThread = std::thread( &DeviceQueueVulkan::SubmitThreadMain, this );
+	m_retireThread = std::thread( &DeviceQueueVulkan::RetireThreadMain, this );
+}
+
+void DeviceQueueVulkan::DestroySubmission()
+{
+	if ( !m_running )
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock( m_wakeMutex );
+		m_running = false;
+	}
+	m_wakeUp.notify_one();
+	m_submitThread.join();
+
+	// The submit thread drained the ring before leaving, the retire thread leaves once every fence is retired
+	{
+		std::lock_guard<std::mutex> lock( m_inFlightMutex );
+		m_retireRunning = false;
+	}
+	m_inFlightAdded.notify_one();
+	m_retireThread.join();
+
+	for ( VkFence fence : m_freeFences )
+	{
+		vkDestroyFence( m_device, fence, nullptr );
+	}
+	m_freeFences.clear();
+}
+
+uint64_t DeviceQueueVulkan::Enqueue( const SubmitBatchVulkan & batch )
+{
+	assert( m_running );
+
+	uint64_t position = 0;
+	while ( !m_ring.Push( batch, &position ) )
+	{
+		// Ring full, the submit thread is behind, or gone
+		ThrowIfFailed();
+		std::this_thread::yield();
+	}
+	ThrowIfFailed();
+
+	// Pairs with the fence in SubmitThreadMain: either the submit thread sees the batch or we see it sleeping
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+	if ( m_submitSleeping.load( std::memory_order_relaxed ) )
+	{
+		std::lock_guard<std::mutex> lock( m_wakeMutex );
+		m_wakeUp.notify_one();
+	}
+
+	// Ring positions are handed out in consumption order, so they double as submission serials
+	return position + 1;
+}
+
+void DeviceQueueVulkan::WaitComplete( uint64_t serial )
+{
+	if ( IsComplete( serial ) )
+		return;
+
+	std::unique_lock<std::mutex> lock( m_completeMutex );
+	m_completed.wait( lock, [this, serial]() { return IsComplete( serial ) || m_submitFailed.load( std::memory_order_relaxed ); } );
+	lock.unlock();
+	if ( !IsComplete( serial ) )
+		ThrowIfFailed();
+}
+
+void DeviceQueueVulkan::SetFailed( std::exception_ptr error )
+{
+	{
+		std::lock_guard<std::mutex> lock( m_completeMutex );
+		if ( !m_submitError )
+			m_submitError = error;
+		m_submitFailed.store( true, std::memory_order_release );
+	}
+	m_completed.notify_all();
+}
+
+void DeviceQueueVulkan::ThrowIfFailed() const
+{
+	if ( m_submitFailed.load( std::memory_order_acquire ) )
+	{
+		std::rethrow_exception( m_submitError );
+	}
+}
+
+VkCommandBuffer DeviceQueueVulkan::AcquireCommandBuffer()
+{
+	while ( !m_retiredCommandBuffers.empty() && IsComplete( m_retiredCommandBuffers.front().serial ) )
+	{
+		m_freeCommandBuffers.push_back( m_retiredCommandBuffers.front().commandBuffer );
+		m_retiredCommandBuffers.pop_front();
+	}
+
+	if ( !m_freeCommandBuffers.empty() )
+	{
+		VkCommandBuffer commandBuffer = m_freeCommandBuffers.back();
+		m_freeCommandBuffers.pop_back();
+		vkResetCommandBuffer( commandBuffer, 0 );
+		return commandBuffer;
+	}
+
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = m_commandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer;
+	if ( vkAllocateCommandBuffers( m_device, &allocInfo, &commandBuffer ) != VK_SUCCESS )
+	{
+		throw std::runtime_error( "Cannot allocate command buffer" );
+	}
+	return commandBuffer;
+}
+
+void DeviceQueueVulkan::RetireCommandBuffer( VkCommandBuffer commandBuffer, uint64_t serial )
+{
+	m_retiredCommandBuffers.push_back( { commandBuffer, serial } );
+}
+
+void DeviceQueueVulkan::SubmitThreadMain()
+{
+	std::vector<SubmitBatchVulkan> pending;
+	pending.reserve( SUBMIT_RING_SIZE );
+	uint64_t lastSerial = 0;
+
+	for ( ;; )
+	{
+		// Everything published since the last pass goes out in one vkQueueSubmit
+		SubmitBatchVulkan batch;
+		pending.clear();
+		while ( m_ring.Pop( batch ) )
+		{
+			pending.push_back( batch );
+		}
+
+		// Nothing catches on this thread: keep the error for the threads enqueueing and waiting
+		try
+		{
+			if ( !pending.empty() )
+			{
+				lastSerial += pending.size();
+				SubmitPending( pending, lastSerial );
+			}
+		}
+		catch ( ... )
+		{
+			SetFailed( std::current_exception() );
+			break;
+		}
+
+		if ( !pending.empty() )
+			continue;
+
+		std::unique_lock<std::mutex> lock( m_wakeMutex );
+		m_submitSleeping.store( true, std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		if ( !m_ring.HasPending() )
+		{
+			if ( !m_running )
+				break;
+
+			m_wakeUp.wait( lock );
+		}
+		m_submitSleeping.store( false, std::memory_order_relaxed );
+	}
+}
+
+void DeviceQueueVulkan::SubmitPending( std::vector<SubmitBatchVulkan> & batches, uint64_t lastSerial )
+{
+	m_submitInfos.clear();
+
+	auto flush = [this]( uint64_t serial ) {
+		VkFence fence = AcquireFence();
+		if ( vkQueueSubmit( m_queueNative, (uint32_t)m_submitInfos.size(), m_submitInfos.data(), fence ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "Error while submitting" );
+		}
+		{
+			std::lock_guard<std::mutex> lock( m_inFlightMutex );
+			m_inFlight.push_back( { fence, serial } );
+		}
+		m_inFlightAdded.notify_one();
+		m_submitInfos.clear();
+		m_submitCount.fetch_add( 1, std::memory_order_relaxed );
+	};
+
+	const uint64_t firstSerial = lastSerial - batches.size() + 1;
+	for ( size_t i = 0; i < batches.size(); ++i )
+	{
+		const SubmitBatchVulkan & batch = batches[i];
+		const bool hasWork = batch.commandBufferCount > 0 || batch.signalCount > 0 || batch.presentSwapChain == VK_NULL_HANDLE;
+
+		if ( hasWork )
+		{
+			VkSubmitInfo info = {};
+			info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			info.waitSemaphoreCount = batch.waitCount;
+			info.pWaitSemaphores = batch.waitSemaphores;
+			info.pWaitDstStageMask = batch.waitStages;
+			info.commandBufferCount = batch.commandBufferCount;
+			info.pCommandBuffers = batch.commandBuffers;
+			info.signalSemaphoreCount = batch.signalCount;
+			info.pSignalSemaphores = batch.signalSemaphores;
+			m_submitInfos.push_back( info );
+		}
+
+		if ( batch.presentSwapChain != VK_NULL_HANDLE )
+		{
+			// The present has to follow the submit on the queue, close the current group here
+			if ( !m_submitInfos.empty() )
+				flush( firstSerial + i );
+
+			VkPresentInfoKHR presentInfo = {};
+			presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+			presentInfo.waitSemaphoreCount = hasWork ? batch.signalCount : batch.waitCount;
+			presentInfo.pWaitSemaphores = hasWork ? batch.signalSemaphores : batch.waitSemaphores;
+			presentInfo.swapchainCount = 1;
+			presentInfo.pSwapchains = &batch.presentSwapChain;
+			presentInfo.pImageIndices = &batch.presentImageIndex;
+			m_lastPresentResult.store( vkQueuePresentKHR( m_queueNative, &presentInfo ), std::memory_order_relaxed );
+		}
+	}
+
+	// A fence-only submit still tracks batches that were presents without work
+	flush( lastSerial );
+}
+
+void DeviceQueueVulkan::RetireThreadMain()
+{
+	for ( ;; )
+	{
+		// Fences complete in submission order on a queue, the oldest one is the next to signal
+		VkFence fence = VK_NULL_HANDLE;
+		{
+			std::unique_lock<std::mutex> lock( m_inFlightMutex );
+			m_inFlightAdded.wait( lock, [this]() { return !m_inFlight.empty() || !m_retireRunning; } );
+			if ( m_inFlight.empty() )
+				break;
+			fence = m_inFlight.front().fence;
+		}
+
+		const VkResult result = vkWaitForFences( m_device, 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max() );
+
+		std::lock_guard<std::mutex> lock( m_inFlightMutex );
+		if ( result != VK_SUCCESS )
+		{
+			// Lost device: nothing in flight will ever complete, give the fences back for destruction
+			for ( const InFlightSubmit & submit : m_inFlight )
+			{
+				m_freeFences.push_back( submit.fence );
+			}
+			m_inFlight.clear();
+			SetFailed( std::make_exception_ptr( std::runtime_error( "Error while waiting for a submission" ) ) );
+			continue;
+		}
+
+		vkResetFences( m_device, 1, &fence );
+		m_freeFences.push_back( fence );
+		const uint64_t serial = m_inFlight.front().lastSerial;
+		m_inFlight.pop_front();
+		{
+			// Stored under the waiters' mutex so none of them can miss the notification
+			std::lock_guard<std::mutex> completeLock( m_completeMutex );
+			m_completedSerial.store( serial, std::memory_order_release );
+		}
+		m_completed.notify_all();
+	}
+}
+
+VkFence DeviceQueueVulkan::AcquireFence()
+{
+	{
+		std::lock_guard<std::mutex> lock( m_inFlightMutex );
+		if ( !m_freeFences.empty() )
+		{
+			VkFence fence = m_freeFences.back();
+			m_freeFences.pop_back();
+			return fence;
+		}
+	}
+
+	VkFenceCreateInfo fenceInfo = {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	VkFence fence;
+	if ( vkCreateFence( m_device, &fenceInfo, nullptr, &fence ) != VK_SUCCESS )
+	{
+		throw std::runtime_error( "cannot create fence" );
+	}
+	return fence;
+}
@@ -1,13 +1,128 @@
 #pragma once
 #include <vulkan/vulkan.h>
+#include "../thread/MpscQueue.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// One unit of work for a queue: command buffers with their semaphores, optionally followed by a present.
+// Plain data so it can be copied through the lock-free submission ring.
+struct SubmitBatchVulkan
+{
+	static constexpr uint32_t MAX_COMMAND_BUFFERS = 8;
+	static constexpr uint32_t MAX_SEMAPHORES = 4;
+
+	void AddCommandBuffer( VkCommandBuffer commandBuffer );
+	void Wait( VkSemaphore semaphore, VkPipelineStageFlags stage );
+	void Signal( VkSemaphore semaphore );
+	// Presented once the batch is submitted, waiting on the batch signal semaphores.
+	// A batch without command buffers hands its wait semaphores straight to the present.
+	void Present( VkSwapchainKHR swapChain, uint32_t imageIndex );
+
+	VkCommandBuffer commandBuffers[MAX_COMMAND_BUFFERS];
+	uint32_t commandBufferCount = 0;
+	VkSemaphore waitSemaphores[MAX_SEMAPHORES];
+	VkPipelineStageFlags waitStages[MAX_SEMAPHORES];
+	uint32_t waitCount = 0;
+	VkSemaphore signalSemaphores[MAX_SEMAPHORES];
+	uint32_t signalCount = 0;
+	VkSwapchainKHR presentSwapChain = VK_NULL_HANDLE;
+	uint32_t presentImageIndex = 0;
+};
 
 class DeviceQueueVulkan
 {
 public:
+	DeviceQueueVulkan();
+	~DeviceQueueVulkan();
+
 	void InitCommandPool( VkDevice & device );
+	void DestroyCommandPool( VkDevice & device );
+
+	// Submission front-end. Any thread enqueues batches without locking; the queue's submit thread
+	// drains everything pending into a single vkQueueSubmit and attaches a pooled fence to it.
+	// A retire thread blocks on the oldest fence in flight and wakes the waiters as soon as it signals.
+	// Once started, m_queueNative must not be used directly anymore.
+	void InitSubmission( VkDevice device );
+	void DestroySubmission();
+
+	// Returns the serial of the batch, complete once IsComplete( serial ) is true.
+	// A failure on the submit thread stops it, Enqueue() and WaitComplete() rethrow it to their caller.
+	uint64_t Enqueue( const SubmitBatchVulkan & batch );
+	bool IsComplete( uint64_t serial ) const { return serial <= m_completedSerial.load( std::memory_order_acquire ); }
+	// Blocks without spinning until the batch is complete
+	void WaitComplete( uint64_t serial );
+	// Primary command buffers from m_commandPool, recycled once the batch using them completed.
+	// The pool is not synchronized: acquire and retire from one thread at a time.
+	VkCommandBuffer AcquireCommandBuffer();
+	void RetireCommandBuffer( VkCommandBuffer commandBuffer, uint64_t serial );
+
+	uint64_t GetSubmitCount() const { return m_submitCount.load( std::memory_order_relaxed ); }
+	VkResult GetLastPresentResult() const { return (VkResult)m_lastPresentResult.load( std::memory_order_relaxed ); }
+
+private:
+	static constexpr uint32_t SUBMIT_RING_SIZE = 256;
+
+	struct InFlightSubmit
+	{
+		VkFence fence;
+		uint64_t lastSerial;
+	};
+
+	struct RetiredCommandBuffer
+	{
+		VkCommandBuffer commandBuffer;
+		uint64_t serial;
+	};
+
+	void SubmitThreadMain();
+	void RetireThreadMain();
+	void SetFailed( std::exception_ptr error );
+	void ThrowIfFailed() const;
+	void SubmitPending( std::vector<SubmitBatchVulkan> & batches, uint64_t lastSerial );
+	VkFence AcquireFence();
 
 public:
 	int m_familyIdx;
 	VkQueue m_queueNative;
-	VkCommandPool m_commandPool;
-};
\ No newline at end of file
+	VkCommandPool m_commandPool = VK_NULL_HANDLE;
+
+private:
+	VkDevice m_device = VK_NULL_HANDLE;
+	MpscQueue<SubmitBatchVulkan> m_ring;
+	std::atomic<uint64_t> m_completedSerial{ 0 };
+	std::atomic<uint64_t> m_submitCount{ 0 };
+	std::atomic<int> m_lastPresentResult{ VK_SUCCESS };
+
+	std::deque<RetiredCommandBuffer> m_retiredCommandBuffers;
+	std::vector<VkCommandBuffer> m_freeCommandBuffers;
+
+	// Submit thread only
+	std::vector<VkSubmitInfo> m_submitInfos;
+
+	// Filled by the submit thread, retired by the retire thread
+	std::mutex m_inFlightMutex;
+	std::condition_variable m_inFlightAdded;
+	std::deque<InFlightSubmit> m_inFlight;
+	std::vector<VkFence> m_freeFences;
+	bool m_retireRunning = false;
+	std::thread m_retireThread;
+
+	// WaitComplete() sleeps here, the retire thread notifies after every completed serial
+	std::mutex m_completeMutex;
+	std::condition_variable m_completed;
+
+	std::thread m_submitThread;
+	std::atomic<bool> m_running{ false };
+	std::atomic<bool> m_submitSleeping{ false };
+	// First failure of the submit or retire thread, under m_completeMutex, published by m_submitFailed
+	std::exception_ptr m_submitError;
+	std::atomic<bool> m_submitFailed{ false };
+	std::mutex m_wakeMutex;
+	std::condition_variable m_wakeUp;
+};
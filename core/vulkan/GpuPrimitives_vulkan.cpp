@@ -0,0 +1,50 @@
+#include <stdafx.h>
+#include "GpuPrimitives_vulkan.h"
+#include "Device3D_vulkan.h"
+#include "../shader/ShaderCompiler.h"
+
+namespace
+{
+	// The first subgroup of the workgroup scans the totals of all of them: GROUP_SIZE / 16 at most
+	const uint32_t MIN_SUBGROUP_SIZE = 16;
+	const uint32_t GROUP_SIZE = 256;	// primitives.glsl
+
+	// The subgroup scan needs full subgroups, and one subgroup able to hold the total of every subgroup.
+	// Otherwise the kernels keep the shared-memory scan.
+	bool CanUseSubgroups( uint32_t subgroupSize )
+	{
+		return subgroupSize >= MIN_SUBGROUP_SIZE && GROUP_SIZE % subgroupSize == 0 && GROUP_SIZE / subgroupSize <= subgroupSize;
+	}
+
+	PipelineHandle CreatePipeline( Device3DVulkan & device, ShaderCompiler & compiler, const char * path, bool key64 )
+	{
+		ShaderDesc desc;
+		desc.path = path;
+		desc.stage = ShaderStage::Compute;
+		if ( CanUseSubgroups( device.GetComputeSubgroupSize() ) )
+		{
+			desc.defines.push_back( "USE_SUBGROUPS" );
+			desc.target = ShaderTarget::Vulkan11;
+		}
+		if ( key64 )
+			desc.defines.push_back( "KEY_64" );
+
+		return device.CreateComputePipeline( compiler.Compile( desc ).spirv );
+	}
+}
+
+GpuPrimitivePipelines CreateGpuPrimitivePipelinesVulkan( Device3DVulkan & device, ShaderCompiler & compiler )
+{
+	GpuPrimitivePipelines pipelines;
+	pipelines.scanTiles = CreatePipeline( device, compiler, "Shaders/primitives/scan_tiles.comp", false );
+	pipelines.scanAdd = CreatePipeline( device, compiler, "Shaders/primitives/scan_add.comp", false );
+	pipelines.reduce = CreatePipeline( device, compiler, "Shaders/primitives/reduce.comp", false );
+	pipelines.compactScatter = CreatePipeline( device, compiler, "Shaders/primitives/compact_scatter.comp", false );
+	for ( SortKeyWidth width : { SortKeyWidth::Bits32, SortKeyWidth::Bits64 } )
+	{
+		const bool key64 = width == SortKeyWidth::Bits64;
+		pipelines.radixHistogram[(int)width] = CreatePipeline( device, compiler, "Shaders/primitives/radix_histogram.comp", key64 );
+		pipelines.radixScatter[(int)width] = CreatePipeline( device, compiler, "Shaders/primitives/radix_scatter.comp", key64 );
+	}
+	return pipelines;
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include "../compute/GpuPrimitives.h"
+
+class Device3DVulkan;
+class ShaderCompiler;
+
+// Compiles Shaders/primitives and creates their pipelines, owned by the device's pipeline cache.
+// The scans use subgroup arithmetic when the device reports it (GetComputeSubgroupSize()), shared memory otherwise.
+GpuPrimitivePipelines CreateGpuPrimitivePipelinesVulkan( Device3DVulkan & device, ShaderCompiler & compiler );
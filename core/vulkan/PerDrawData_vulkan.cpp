@@ -0,0 +1,67 @@
+#include <stdafx.h>
+#include "PerDrawData_vulkan.h"
+
+void PerDrawStreamVulkan::Init( VkDevice device, PipelineLayoutCacheVulkan & layoutCache, FrameUniformAllocatorVulkan & allocator, uint32_t elementSize )
+{
+	m_device = device;
+	m_allocator = &allocator;
+	m_elementSize = elementSize;
+
+	VkDescriptorSetLayoutBinding binding = {};
+	binding.binding = 0;
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	binding.descriptorCount = 1;
+	binding.stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
+	layoutCache.SetSharedSetLayout( DESCRIPTOR_SET, { binding } );
+	VkDescriptorSetLayout setLayout = layoutCache.GetSharedSetLayout( DESCRIPTOR_SET );
+
+	VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 };
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	if ( vkCreateDescriptorPool( device, &poolInfo, nullptr, &m_pool ) != VK_SUCCESS )
+	{
+		throw std::runtime_error( "Cannot create descriptor pool" );
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = m_pool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &setLayout;
+	if ( vkAllocateDescriptorSets( device, &allocInfo, &m_set ) != VK_SUCCESS )
+	{
+		throw std::runtime_error( "Cannot allocate descriptor set" );
+	}
+
+	// Written once, draws only move the dynamic offset
+	VkDescriptorBufferInfo bufferInfo = m_allocator->GetDescriptorInfo( m_elementSize );
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = m_set;
+	write.dstBinding = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	write.pBufferInfo = &bufferInfo;
+	vkUpdateDescriptorSets( device, 1, &write, 0, nullptr );
+}
+
+void PerDrawStreamVulkan::Destroy()
+{
+	vkDestroyDescriptorPool( m_device, m_pool, nullptr );
+	m_pool = VK_NULL_HANDLE;
+}
+
+uint32_t PerDrawStreamVulkan::Push( const void * data )
+{
+	uint32_t offset = 0;
+	memcpy( m_allocator->Allocate( m_elementSize, offset ), data, m_elementSize );
+	return offset;
+}
+
+void PerDrawStreamVulkan::Bind( VkCommandBuffer cmd, VkPipelineLayout layout, VkPipelineBindPoint bindPoint, uint32_t dynamicOffset )
+{
+	vkCmdBindDescriptorSets( cmd, bindPoint, layout, DESCRIPTOR_SET, 1, &m_set, 1, &dynamicOffset );
+}
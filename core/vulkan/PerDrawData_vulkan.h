@@ -0,0 +1,89 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <type_traits>
+
+#include "PipelineLayoutCache_vulkan.h"
+#include "UniformAllocator_vulkan.h"
+
+// Compile-time checked slice of the push-constant block shared by every pipeline layout.
+template<typename T, uint32_t OFFSET = 0>
+struct PushConstantBlockVulkan
+{
+	static_assert( std::is_trivially_copyable<T>::value, "push constants are copied as raw bytes" );
+	static_assert( OFFSET % 4 == 0 && sizeof( T ) % 4 == 0, "push constant offset and size must be multiples of 4" );
+
+	static constexpr uint32_t offset = OFFSET;
+	static constexpr uint32_t size = sizeof( T );
+	static constexpr bool fits = OFFSET + sizeof( T ) <= PipelineLayoutCacheVulkan::PUSH_CONSTANT_SIZE;
+};
+
+// Default per-draw parameters, everything else is fetched indirectly from these indices.
+// Matches the push_constant block declared by the shaders.
+struct DrawParamsVulkan
+{
+	uint32_t objectIndex;
+	uint32_t materialIndex;
+	uint32_t transformOffset;
+	uint32_t padding;
+};
+static_assert( PushConstantBlockVulkan<DrawParamsVulkan>::fits, "DrawParamsVulkan must fit the guaranteed push constant space" );
+
+// Fallback for per-draw data larger than the push-constant space: elements are bump-allocated in the
+// frame uniform allocator and read through a dynamic uniform buffer. Each draw only changes the
+// dynamic offset, the descriptor set itself is written once at init.
+class PerDrawStreamVulkan
+{
+public:
+	static constexpr uint32_t DESCRIPTOR_SET = PipelineLayoutVulkan::MAX_SETS - 1;
+
+public:
+	void Init( VkDevice device, PipelineLayoutCacheVulkan & layoutCache, FrameUniformAllocatorVulkan & allocator, uint32_t elementSize );
+	void Destroy();
+
+	uint32_t Push( const void * data );
+	void Bind( VkCommandBuffer cmd, VkPipelineLayout layout, VkPipelineBindPoint bindPoint, uint32_t dynamicOffset );
+
+private:
+	VkDevice m_device = VK_NULL_HANDLE;
+	FrameUniformAllocatorVulkan * m_allocator = nullptr;
+	VkDescriptorPool m_pool = VK_NULL_HANDLE;
+	VkDescriptorSet m_set = VK_NULL_HANDLE;
+	uint32_t m_elementSize = 0;
+};
+
+// Per-draw data writer. The path is chosen at compile time from sizeof( T ):
+// small blocks go through vkCmdPushConstants, larger ones through the dynamic-offset uniform stream.
+template<typename T, VkShaderStageFlags STAGES = VK_SHADER_STAGE_ALL_GRAPHICS>
+class PerDrawDataVulkan
+{
+	typedef PushConstantBlockVulkan<T> Block;
+
+public:
+	static constexpr bool USES_PUSH_CONSTANTS = Block::fits;
+
+	explicit PerDrawDataVulkan( PerDrawStreamVulkan * stream = nullptr )
+		: m_stream( stream )
+	{
+		assert( USES_PUSH_CONSTANTS || m_stream != nullptr );
+	}
+
+	void Write( VkCommandBuffer cmd, VkPipelineLayout layout, const T & data )
+	{
+		Write( cmd, layout, data, std::integral_constant<bool, USES_PUSH_CONSTANTS>() );
+	}
+
+private:
+	void Write( VkCommandBuffer cmd, VkPipelineLayout layout, const T & data, std::true_type )
+	{
+		vkCmdPushConstants( cmd, layout, STAGES, Block::offset, Block::size, &data );
+	}
+
+	void Write( VkCommandBuffer cmd, VkPipelineLayout layout, const T & data, std::false_type )
+	{
+		const VkPipelineBindPoint bindPoint = (STAGES & VK_SHADER_STAGE_COMPUTE_BIT) ? VK_PIPELINE_BIND_POINT_COMPUTE : VK_PIPELINE_BIND_POINT_GRAPHICS;
+		m_stream->Bind( cmd, layout, bindPoint, m_stream->Push( &data ) );
+	}
+
+private:
+	PerDrawStreamVulkan * m_stream;
+};
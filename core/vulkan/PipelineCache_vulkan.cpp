@@ -0,0 +1,147 @@
+#include <stdafx.h>
+#include "PipelineCache_vulkan.h"
+
+namespace
+{
+	// Header written by the driver at the start of vkGetPipelineCacheData blobs (version one)
+	struct PipelineCacheHeader
+	{
+		uint32_t headerSize;
+		uint32_t headerVersion;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint8_t uuid[16];
+	};
+
+	std::vector<char> ReadBlob( const std::string & path, const VkPhysicalDeviceProperties & props )
+	{
+		std::ifstream file( path, std::ios::ate | std::ios::binary );
+		if ( !file.is_open() )
+			return std::vector<char>();
+
+		std::vector<char> blob( (size_t)file.tellg() );
+		file.seekg( 0 );
+		file.read( blob.data(), blob.size() );
+
+		// A blob from another driver or GPU is useless, start from scratch rather than letting the driver reject it
+		PipelineCacheHeader header = {};
+		if ( blob.size() < sizeof( header ) )
+			return std::vector<char>();
+
+		memcpy( &header, blob.data(), sizeof( header ) );
+		if ( header.vendorID != props.vendorID || header.deviceID != props.deviceID || memcmp( header.uuid, props.pipelineCacheUUID, sizeof( header.uuid ) ) != 0 )
+			return std::vector<char>();
+
+		return blob;
+	}
+}
+
+void PipelineCacheVulkan::Init( VkDevice device, VkPhysicalDevice physicalDevice, const std::string & path )
+{
+	m_device = device;
+	m_path = path;
+
+	VkPhysicalDeviceProperties props = {};
+	vkGetPhysicalDeviceProperties( physicalDevice, &props );
+	std::vector<char> blob = ReadBlob( m_path, props );
+
+	VkPipelineCacheCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	createInfo.initialDataSize = blob.size();
+	createInfo.pInitialData = blob.empty() ? nullptr : blob.data();
+
+	if ( vkCreatePipelineCache( m_device, &createInfo, nullptr, &m_native ) != VK_SUCCESS )
+	{
+		throw std::runtime_error( "Cannot create pipeline cache" );
+	}
+}
+
+void PipelineCacheVulkan::Destroy()
+{
+	Save();
+
+	for ( auto & it : m_pipelines )
+	{
+		vkDestroyPipeline( m_device, it.second, nullptr );
+	}
+	m_pipelines.clear();
+
+	vkDestroyPipelineCache( m_device, m_native, nullptr );
+	m_native = VK_NULL_HANDLE;
+}
+
+VkPipeline PipelineCacheVulkan::Find( const PipelineKeyVulkan & key )
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	auto it = m_pipelines.find( key );
+	return it == m_pipelines.end() ? VK_NULL_HANDLE : it->second;
+}
+
+VkPipeline PipelineCacheVulkan::CreateGraphicsPipeline( const PipelineKeyVulkan & key, const VkGraphicsPipelineCreateInfo & createInfo )
+{
+	VkPipeline pipeline = Find( key );
+	if ( pipeline != VK_NULL_HANDLE )
+		return pipeline;
+
+	// Created unlocked: VkPipelineCache is internally synchronized, other threads keep compiling
+	if ( vkCreateGraphicsPipelines( m_device, m_native, 1, &createInfo, nullptr, &pipeline ) != VK_SUCCESS )
+	{
+		throw std::runtime_error( "Cannot create graphics pipeline" );
+	}
+	return Insert( key, pipeline );
+}
+
+VkPipeline PipelineCacheVulkan::CreateComputePipeline( const PipelineKeyVulkan & key, const VkComputePipelineCreateInfo & createInfo )
+{
+	VkPipeline pipeline = Find( key );
+	if ( pipeline != VK_NULL_HANDLE )
+		return pipeline;
+
+	if ( vkCreateComputePipelines( m_device, m_native, 1, &createInfo, nullptr, &pipeline ) != VK_SUCCESS )
+	{
+		throw std::runtime_error( "Cannot create compute pipeline" );
+	}
+	return Insert( key, pipeline );
+}
+
+void PipelineCacheVulkan::Release( const PipelineKeyVulkan & key )
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	auto it = m_pipelines.find( key );
+	if ( it != m_pipelines.end() )
+	{
+		vkDestroyPipeline( m_device, it->second, nullptr );
+		m_pipelines.erase( it );
+	}
+}
+
+VkPipeline PipelineCacheVulkan::Insert( const PipelineKeyVulkan & key, VkPipeline pipeline )
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	auto result = m_pipelines.emplace( key, pipeline );
+	if ( !result.second )
+	{
+		// Another thread won the race for the same key, keep a single instance
+		vkDestroyPipeline( m_device, pipeline, nullptr );
+	}
+	else
+	{
+		++m_createCount;
+	}
+	return result.first->second;
+}
+
+void PipelineCacheVulkan::Save()
+{
+	if ( m_native == VK_NULL_HANDLE || m_path.empty() )
+		return;
+
+	size_t size = 0;
+	vkGetPipelineCacheData( m_device, m_native, &size, nullptr );
+	std::vector<char> blob( size );
+	if ( size == 0 || vkGetPipelineCacheData( m_device, m_native, &size, blob.data() ) != VK_SUCCESS )
+		return;
+
+	std::ofstream file( m_path, std::ios::binary | std::ios::trunc );
+	file.write( blob.data(), size );
+}
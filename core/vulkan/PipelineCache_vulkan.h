@@ -0,0 +1,82 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "../Hash.h"
+
+// Accumulates everything that makes two pipelines different: shader hashes, variants, layout and state.
+// The bytes are kept next to their hash: two keys only match when both are equal, a hash collision
+// is a cache miss rather than the wrong pipeline.
+class PipelineKeyVulkan
+{
+public:
+	template<typename T>
+	PipelineKeyVulkan & Add( const T & value )
+	{
+		static_assert( std::is_trivially_copyable<T>::value, "pipeline key values are compared byte by byte" );
+		m_hash = HashValue( value, m_hash );
+		const uint8_t * bytes = reinterpret_cast<const uint8_t *>( &value );
+		m_bytes.insert( m_bytes.end(), bytes, bytes + sizeof( T ) );
+		return *this;
+	}
+
+	// Contents rather than their hash, for what is compared on a hit: shader code, specialization data
+	PipelineKeyVulkan & AddBytes( const void * data, size_t size )
+	{
+		m_hash = HashBytes( data, size, HashValue( size, m_hash ) );
+		const uint8_t * bytes = static_cast<const uint8_t *>( data );
+		m_bytes.insert( m_bytes.end(), bytes, bytes + size );
+		return *this;
+	}
+	PipelineKeyVulkan & AddSpecialization( const VkSpecializationInfo * info )
+	{
+		if ( !info )
+			return Add( 0u );
+		return Add( info->mapEntryCount ).AddBytes( info->pMapEntries, info->mapEntryCount * sizeof( VkSpecializationMapEntry ) ).AddBytes( info->pData, info->dataSize );
+	}
+
+	uint64_t GetHash() const { return m_hash; }
+
+	bool operator==( const PipelineKeyVulkan & other ) const { return m_hash == other.m_hash && m_bytes == other.m_bytes; }
+
+	struct Hasher
+	{
+		size_t operator()( const PipelineKeyVulkan & key ) const { return (size_t)key.m_hash; }
+	};
+
+private:
+	uint64_t m_hash = HASH_SEED;
+	std::vector<uint8_t> m_bytes;
+};
+
+// Deduplicates pipelines by key and persists the driver's VkPipelineCache across runs.
+class PipelineCacheVulkan
+{
+public:
+	void Init( VkDevice device, VkPhysicalDevice physicalDevice, const std::string & path );
+	void Destroy();
+
+	VkPipeline Find( const PipelineKeyVulkan & key );
+	VkPipeline CreateGraphicsPipeline( const PipelineKeyVulkan & key, const VkGraphicsPipelineCreateInfo & createInfo );
+	VkPipeline CreateComputePipeline( const PipelineKeyVulkan & key, const VkComputePipelineCreateInfo & createInfo );
+	void Release( const PipelineKeyVulkan & key );
+
+	VkPipelineCache GetNative() const { return m_native; }
+	uint32_t GetCreateCount() const { return m_createCount; }
+
+private:
+	VkPipeline Insert( const PipelineKeyVulkan & key, VkPipeline pipeline );
+	void Save();
+
+private:
+	VkDevice m_device = VK_NULL_HANDLE;
+	VkPipelineCache m_native = VK_NULL_HANDLE;
+	std::string m_path;
+	std::mutex m_mutex;
+	std::unordered_map<PipelineKeyVulkan, VkPipeline, PipelineKeyVulkan::Hasher> m_pipelines;
+	uint32_t m_createCount = 0;
+};
@@ -0,0 +1,199 @@
+#include <stdafx.h>
+#include "PipelineLayoutCache_vulkan.h"
+#include "ShaderReflection_vulkan.h"
+
+namespace
+{
+	PipelineKeyVulkan GetBindingsKey( const std::vector<VkDescriptorSetLayoutBinding> & bindings )
+	{
+		PipelineKeyVulkan key;
+		key.Add( bindings.size() );
+		for ( const auto & b : bindings )
+		{
+			key.Add( b.binding ).Add( b.descriptorType ).Add( b.descriptorCount ).Add( b.stageFlags );
+		}
+		return key;
+	}
+
+	// SPIR-V cannot express dynamic offsets, a reflected buffer matches its dynamic counterpart
+	bool IsCompatibleType( VkDescriptorType shared, VkDescriptorType reflected )
+	{
+		if ( shared == reflected )
+			return true;
+		if ( shared == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC )
+			return reflected == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		if ( shared == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC )
+			return reflected == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		return false;
+	}
+
+	void MergeBinding( std::vector<VkDescriptorSetLayoutBinding> & bindings, const VkDescriptorSetLayoutBinding & binding )
+	{
+		for ( auto & existing : bindings )
+		{
+			if ( existing.binding != binding.binding )
+				continue;
+
+			if ( existing.descriptorType != binding.descriptorType )
+			{
+				throw std::runtime_error( "descriptor binding used with different types across stages" );
+			}
+			existing.descriptorCount = std::max( existing.descriptorCount, binding.descriptorCount );
+			existing.stageFlags |= binding.stageFlags;
+			return;
+		}
+		bindings.push_back( binding );
+	}
+}
+
+void PipelineLayoutCacheVulkan::Init( VkDevice device )
+{
+	m_device = device;
+}
+
+void PipelineLayoutCacheVulkan::Destroy()
+{
+	for ( auto & it : m_layouts )
+	{
+		vkDestroyPipelineLayout( m_device, it.second.m_native, nullptr );
+	}
+	for ( auto & it : m_setLayouts )
+	{
+		vkDestroyDescriptorSetLayout( m_device, it.second, nullptr );
+	}
+	m_layouts.clear();
+	m_setLayouts.clear();
+}
+
+void PipelineLayoutCacheVulkan::SetSharedSetLayout( uint32_t set, const std::vector<VkDescriptorSetLayoutBinding> & bindings )
+{
+	assert( set < PipelineLayoutVulkan::MAX_SETS );
+	std::lock_guard<std::mutex> lock( m_mutex );
+	m_sharedSets[set] = bindings;
+}
+
+VkDescriptorSetLayout PipelineLayoutCacheVulkan::GetSharedSetLayout( uint32_t set, VkShaderStageFlags visibility )
+{
+	assert( set < PipelineLayoutVulkan::MAX_SETS && !m_sharedSets[set].empty() );
+	std::lock_guard<std::mutex> lock( m_mutex );
+
+	// Same visibility rule as GetLayout() so the handle is the one pipelines end up with
+	std::vector<VkDescriptorSetLayoutBinding> bindings = m_sharedSets[set];
+	for ( auto & b : bindings )
+	{
+		b.stageFlags = visibility;
+	}
+	return GetSetLayoutLocked( bindings );
+}
+
+const PipelineLayoutVulkan & PipelineLayoutCacheVulkan::GetLayout( const ShaderReflectionVulkan * const * stages, uint32_t stageCount )
+{
+	std::vector<VkDescriptorSetLayoutBinding> sets[PipelineLayoutVulkan::MAX_SETS];
+	VkShaderStageFlags stageFlags = 0;
+	uint32_t pushConstantSize = 0;
+
+	for ( uint32_t s = 0; s < stageCount; ++s )
+	{
+		stageFlags |= stages[s]->stage;
+		pushConstantSize = std::max( pushConstantSize, stages[s]->pushConstantSize );
+		for ( const auto & desc : stages[s]->bindings )
+		{
+			if ( desc.set >= PipelineLayoutVulkan::MAX_SETS )
+			{
+				throw std::runtime_error( "descriptor set index out of range" );
+			}
+			MergeBinding( sets[desc.set], desc.binding );
+		}
+	}
+
+	if ( pushConstantSize > PUSH_CONSTANT_SIZE )
+	{
+		throw std::runtime_error( "push constant block exceeds the 128 bytes guaranteed by Vulkan" );
+	}
+
+	std::lock_guard<std::mutex> lock( m_mutex );
+
+	PipelineLayoutVulkan layout;
+	// Visibility covers the whole bind point, so the stages a pipeline happens to use never leak into the layout
+	const VkShaderStageFlags visibility = (stageFlags & VK_SHADER_STAGE_COMPUTE_BIT) ? VK_SHADER_STAGE_COMPUTE_BIT : VK_SHADER_STAGE_ALL_GRAPHICS;
+	layout.pushConstants.stageFlags = visibility;
+	layout.pushConstants.offset = 0;
+	layout.pushConstants.size = PUSH_CONSTANT_SIZE;
+
+	for ( uint32_t set = 0; set < PipelineLayoutVulkan::MAX_SETS; ++set )
+	{
+		if ( !m_sharedSets[set].empty() )
+		{
+			// Shared sets must cover everything the stages declare for them
+			for ( const auto & b : sets[set] )
+			{
+				auto it = std::find_if( m_sharedSets[set].begin(), m_sharedSets[set].end(), [&b]( const VkDescriptorSetLayoutBinding & s ) { return s.binding == b.binding; } );
+				if ( it == m_sharedSets[set].end() || !IsCompatibleType( it->descriptorType, b.descriptorType ) || it->descriptorCount < b.descriptorCount )
+				{
+					throw std::runtime_error( "shader binding does not match the shared descriptor set layout" );
+				}
+			}
+			sets[set] = m_sharedSets[set];
+		}
+		for ( auto & b : sets[set] )
+		{
+			b.stageFlags = visibility;
+		}
+		if ( !sets[set].empty() )
+		{
+			layout.setCount = set + 1;
+		}
+	}
+
+	// Holes get an empty layout so set indices stay stable across pipelines
+	for ( uint32_t set = 0; set < layout.setCount; ++set )
+	{
+		layout.setLayouts[set] = GetSetLayoutLocked( sets[set] );
+	}
+
+	PipelineKeyVulkan key;
+	key.AddBytes( layout.setLayouts, sizeof( VkDescriptorSetLayout ) * layout.setCount ).Add( layout.pushConstants );
+	layout.hash = key.GetHash();
+
+	auto it = m_layouts.find( key );
+	if ( it != m_layouts.end() )
+		return it->second;
+
+	VkPipelineLayoutCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	createInfo.setLayoutCount = layout.setCount;
+	createInfo.pSetLayouts = layout.setLayouts;
+	createInfo.pushConstantRangeCount = 1;
+	createInfo.pPushConstantRanges = &layout.pushConstants;
+
+	if ( vkCreatePipelineLayout( m_device, &createInfo, nullptr, &layout.m_native ) != VK_SUCCESS )
+	{
+		throw std::runtime_error( "Cannot create pipeline layout" );
+	}
+
+	return m_layouts.emplace( std::move( key ), layout ).first->second;
+}
+
+VkDescriptorSetLayout PipelineLayoutCacheVulkan::GetSetLayoutLocked( std::vector<VkDescriptorSetLayoutBinding> & bindings )
+{
+	std::sort( bindings.begin(), bindings.end(), []( const VkDescriptorSetLayoutBinding & a, const VkDescriptorSetLayoutBinding & b ) { return a.binding < b.binding; } );
+
+	PipelineKeyVulkan key = GetBindingsKey( bindings );
+	auto it = m_setLayouts.find( key );
+	if ( it != m_setLayouts.end() )
+		return it->second;
+
+	VkDescriptorSetLayoutCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	createInfo.bindingCount = (uint32_t)bindings.size();
+	createInfo.pBindings = bindings.data();
+
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	if ( vkCreateDescriptorSetLayout( m_device, &createInfo, nullptr, &setLayout ) != VK_SUCCESS )
+	{
+		throw std::runtime_error( "Cannot create descriptor set layout" );
+	}
+
+	m_setLayouts.emplace( std::move( key ), setLayout );
+	return setLayout;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "PipelineCache_vulkan.h"
+
+class ShaderReflectionVulkan;
+
+struct PipelineLayoutVulkan
+{
+	static constexpr uint32_t MAX_SETS = 4;
+
+	VkPipelineLayout m_native = VK_NULL_HANDLE;
+	uint32_t setCount = 0;
+	VkDescriptorSetLayout setLayouts[MAX_SETS] = {};
+	VkPushConstantRange pushConstants = {};
+	uint64_t hash = 0;
+};
+
+// Builds pipeline layouts from the reflected interface of a pipeline's stages.
+// Compatibility is guaranteed by construction:
+//  - binding visibility is widened to the whole bind point,
+//  - identical set descriptions always resolve to the same VkDescriptorSetLayout,
+//  - sets registered through SetSharedSetLayout() always use the shared layout, so every
+//    pipeline agrees on them whatever subset of their bindings it actually reads,
+//  - every layout of a bind point declares the same push-constant range.
+// Switching between pipelines therefore never invalidates already bound descriptor sets.
+// Layouts are keyed like pipelines, by their description's bytes: a hash collision creates a
+// second layout rather than handing out the wrong one.
+class PipelineLayoutCacheVulkan
+{
+public:
+	static constexpr uint32_t PUSH_CONSTANT_SIZE = 128;	// guaranteed minimum of maxPushConstantsSize
+
+public:
+	void Init( VkDevice device );
+	void Destroy();
+
+	void SetSharedSetLayout( uint32_t set, const std::vector<VkDescriptorSetLayoutBinding> & bindings );
+	VkDescriptorSetLayout GetSharedSetLayout( uint32_t set, VkShaderStageFlags visibility = VK_SHADER_STAGE_ALL_GRAPHICS );
+	const PipelineLayoutVulkan & GetLayout( const ShaderReflectionVulkan * const * stages, uint32_t stageCount );
+
+private:
+	VkDescriptorSetLayout GetSetLayoutLocked( std::vector<VkDescriptorSetLayoutBinding> & bindings );
+
+private:
+	VkDevice m_device = VK_NULL_HANDLE;
+	std::mutex m_mutex;
+	std::vector<VkDescriptorSetLayoutBinding> m_sharedSets[PipelineLayoutVulkan::MAX_SETS];
+	std::unordered_map<PipelineKeyVulkan, VkDescriptorSetLayout, PipelineKeyVulkan::Hasher> m_setLayouts;
+	std::unordered_map<PipelineKeyVulkan, PipelineLayoutVulkan, PipelineKeyVulkan::Hasher> m_layouts;
+};
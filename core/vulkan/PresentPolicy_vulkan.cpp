@@ -0,0 +1,50 @@
+#include <stdafx.h>
+#include "PresentPolicy_vulkan.h"
+
+namespace
+{
+	bool IsSupported( VkPresentModeKHR mode, const VkPresentModeKHR * modes, uint32_t modeCount )
+	{
+		return std::find( modes, modes + modeCount, mode ) != modes + modeCount;
+	}
+}
+
+const char * GetPresentPolicyName( PresentPolicy policy )
+{
+	static const char * names[] = { "throughput", "low-latency", "power-saving" };
+	static_assert( sizeof( names ) / sizeof( *names ) == (size_t)PresentPolicy::Count, "missing present policy name" );
+	return names[(int)policy];
+}
+
+PresentConfigVulkan ChoosePresentConfigVulkan( PresentPolicy policy, const VkSurfaceCapabilitiesKHR & caps, const VkPresentModeKHR * modes, uint32_t modeCount )
+{
+	PresentConfigVulkan config = { VK_PRESENT_MODE_FIFO_KHR, std::max( caps.minImageCount, 2U ) };
+
+	switch ( policy )
+	{
+	case PresentPolicy::Throughput:
+		// One image on screen, one queued, one being rendered
+		config.imageCount = std::max( caps.minImageCount + 1, 3U );
+		break;
+	case PresentPolicy::LowLatency:
+		// Mailbox only replaces queued frames with a spare image to render into
+		if ( IsSupported( VK_PRESENT_MODE_MAILBOX_KHR, modes, modeCount ) )
+		{
+			config.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+			config.imageCount = std::max( caps.minImageCount, 3U );
+		}
+		else if ( IsSupported( VK_PRESENT_MODE_IMMEDIATE_KHR, modes, modeCount ) )
+		{
+			config.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+		}
+		break;
+	case PresentPolicy::PowerSaving:
+	default:
+		break;
+	}
+
+	// maxImageCount 0 means no limit
+	if ( caps.maxImageCount > 0 )
+		config.imageCount = std::min( config.imageCount, caps.maxImageCount );
+	return config;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+
+// What the swap chain is tuned for. Switching policy recreates the swap chain, nothing else.
+enum class PresentPolicy
+{
+	Throughput = 0,	// FIFO with an extra image: rendering never waits on the display, frames queue behind it
+	LowLatency,		// MAILBOX, else IMMEDIATE: the newest frame replaces queued ones, nothing waits behind the display
+	PowerSaving,	// FIFO with the fewest images: the display rate throttles rendering, no frame is made ahead
+	Count,
+};
+
+const char * GetPresentPolicyName( PresentPolicy policy );
+
+struct PresentConfigVulkan
+{
+	VkPresentModeKHR presentMode;
+	uint32_t imageCount;
+};
+
+// FIFO is always supported, every policy falls back to it
+PresentConfigVulkan ChoosePresentConfigVulkan( PresentPolicy policy, const VkSurfaceCapabilitiesKHR & caps, const VkPresentModeKHR * modes, uint32_t modeCount );
@@ -0,0 +1,82 @@
+#include <stdafx.h>
+#include "RenderTarget_vulkan.h"
+#include "Buffer_vulkan.h"
+
+void RenderTargetVulkan::Init( VkDevice device, VkPhysicalDevice physicalDevice, VkRenderPass renderPass, VkFormat format, VkExtent2D extent, VkImageUsageFlags extraUsage )
+{
+	m_device = device;
+	m_format = format;
+	m_extent = extent;
+
+	VkImageCreateInfo imageInfo = {};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = format;
+	imageInfo.extent = { extent.width, extent.height, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | extraUsage;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	if ( vkCreateImage( m_device, &imageInfo, nullptr, &m_image ) != VK_SUCCESS )
+	{
+		throw std::runtime_error( "Cannot create render target" );
+	}
+
+	VkMemoryRequirements memReqs = {};
+	vkGetImageMemoryRequirements( m_device, m_image, &memReqs );
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memReqs.size;
+	allocInfo.memoryTypeIndex = FindMemoryTypeVulkan( physicalDevice, memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
+
+	if ( vkAllocateMemory( m_device, &allocInfo, nullptr, &m_memory ) != VK_SUCCESS )
+	{
+		throw std::runtime_error( "Cannot allocate render target memory" );
+	}
+	vkBindImageMemory( m_device, m_image, m_memory, 0 );
+
+	VkImageViewCreateInfo viewInfo = {};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = m_image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = format;
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.layerCount = 1;
+
+	if ( vkCreateImageView( m_device, &viewInfo, nullptr, &m_view ) != VK_SUCCESS )
+	{
+		throw std::runtime_error( "Cannot create render target view" );
+	}
+
+	VkFramebufferCreateInfo fbInfo = {};
+	fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	fbInfo.renderPass = renderPass;
+	fbInfo.attachmentCount = 1;
+	fbInfo.pAttachments = &m_view;
+	fbInfo.width = extent.width;
+	fbInfo.height = extent.height;
+	fbInfo.layers = 1;
+
+	if ( vkCreateFramebuffer( m_device, &fbInfo, nullptr, &m_framebuffer ) != VK_SUCCESS )
+	{
+		throw std::runtime_error( "Cannot create render target framebuffer" );
+	}
+}
+
+void RenderTargetVulkan::Destroy()
+{
+	vkDestroyFramebuffer( m_device, m_framebuffer, nullptr );
+	vkDestroyImageView( m_device, m_view, nullptr );
+	vkDestroyImage( m_device, m_image, nullptr );
+	vkFreeMemory( m_device, m_memory, nullptr );
+	m_framebuffer = VK_NULL_HANDLE;
+	m_view = VK_NULL_HANDLE;
+	m_image = VK_NULL_HANDLE;
+	m_memory = VK_NULL_HANDLE;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+// Offscreen color target with its own allocation, view and framebuffer for one render pass.
+// Rendered into at any size up to its extent, then copied or blitted out (upscale, readback).
+class RenderTargetVulkan
+{
+public:
+	void Init( VkDevice device, VkPhysicalDevice physicalDevice, VkRenderPass renderPass, VkFormat format, VkExtent2D extent, VkImageUsageFlags extraUsage = 0 );
+	void Destroy();
+
+public:
+	VkDevice m_device = VK_NULL_HANDLE;
+	VkImage m_image = VK_NULL_HANDLE;
+	VkDeviceMemory m_memory = VK_NULL_HANDLE;
+	VkImageView m_view = VK_NULL_HANDLE;
+	VkFramebuffer m_framebuffer = VK_NULL_HANDLE;
+	VkFormat m_format = VK_FORMAT_UNDEFINED;
+	VkExtent2D m_extent = {};
+};
@@ -0,0 +1,505 @@
+#include <stdafx.h>
+#include "ShaderReflection_vulkan.h"
+#include "../shader/SpirvStore.h"
+
+#include <unordered_map>
+
+namespace
+{
+	const uint32_t SPIRV_MAGIC = 0x07230203;
+	const uint32_t SPIRV_HEADER_SIZE = 5;
+
+	// Subset of the SPIR-V grammar needed for interface reflection
+	enum SpvOp
+	{
+		OpName = 5,
+		OpEntryPoint = 15,
+		OpExecutionMode = 16,
+		OpTypeBool = 20,
+		OpTypeInt = 21,
+		OpTypeFloat = 22,
+		OpTypeVector = 23,
+		OpTypeMatrix = 24,
+		OpTypeImage = 25,
+		OpTypeSampler = 26,
+		OpTypeSampledImage = 27,
+		OpTypeArray = 28,
+		OpTypeRuntimeArray = 29,
+		OpTypeStruct = 30,
+		OpTypePointer = 32,
+		OpConstant = 43,
+		OpSpecConstantTrue = 48,
+		OpSpecConstantFalse = 49,
+		OpSpecConstant = 50,
+		OpVariable = 59,
+		OpDecorate = 71,
+		OpMemberDecorate = 72,
+	};
+
+	enum SpvDecoration
+	{
+		DecorationSpecId = 1,
+		DecorationBlock = 2,
+		DecorationBufferBlock = 3,
+		DecorationArrayStride = 6,
+		DecorationMatrixStride = 7,
+		DecorationBuiltIn = 11,
+		DecorationLocation = 30,
+		DecorationBinding = 33,
+		DecorationDescriptorSet = 34,
+		DecorationOffset = 35,
+	};
+
+	enum SpvStorageClass
+	{
+		StorageClassUniformConstant = 0,
+		StorageClassInput = 1,
+		StorageClassUniform = 2,
+		StorageClassPushConstant = 9,
+		StorageClassStorageBuffer = 12,
+	};
+
+	const uint32_t ExecutionModeLocalSize = 17;
+	const uint32_t DimBuffer = 5;
+	const uint32_t DimSubpassData = 6;
+	const uint32_t NONE = ~0U;
+
+	struct SpvId
+	{
+		uint32_t opcode = 0;
+		uint32_t typeId = NONE;			// pointee, element, component or result type
+		uint32_t storageClass = NONE;
+		uint32_t width = 0;				// scalar width, vector/matrix count, image dim
+		uint32_t sampled = 0;			// image sampled operand, int signedness
+		uint64_t value = 0;				// constants
+		std::vector<uint32_t> members;
+
+		uint32_t set = NONE;
+		uint32_t binding = NONE;
+		uint32_t location = NONE;
+		uint32_t specId = NONE;
+		uint32_t arrayStride = 0;
+		bool block = false;
+		bool bufferBlock = false;
+		bool builtIn = false;
+		std::vector<uint32_t> memberOffsets;
+		std::vector<uint32_t> memberMatrixStrides;
+		std::string name;
+	};
+
+	std::string ReadString( const uint32_t * words, uint32_t wordCount )
+	{
+		const char * str = reinterpret_cast<const char *>( words );
+		size_t maxLen = wordCount * sizeof( uint32_t );
+		size_t len = 0;
+		while ( len < maxLen && str[len] != '\0' )
+			++len;
+		return std::string( str, len );
+	}
+
+	void SetMember( std::vector<uint32_t> & values, uint32_t member, uint32_t value )
+	{
+		if ( values.size() <= member )
+			values.resize( member + 1, 0 );
+		values[member] = value;
+	}
+
+	class SpirvParser
+	{
+	public:
+		SpirvParser( const uint32_t * words, size_t wordCount );
+
+		const SpvId & Get( uint32_t id ) const;
+		SpvId & At( uint32_t id );
+		uint32_t SizeOf( uint32_t typeId, uint32_t matrixStride ) const;
+		uint32_t ArrayLength( const SpvId & type ) const;
+		VkFormat FormatOf( uint32_t typeId, uint32_t & size ) const;
+
+	public:
+		std::vector<SpvId> ids;
+		std::vector<uint32_t> variables;
+		std::vector<uint32_t> specConstants;
+		std::vector<uint32_t> entryInterface;
+		uint32_t executionModel = NONE;
+		uint32_t entryId = NONE;
+		std::string entryName;
+		uint32_t localSize[3] = { 1, 1, 1 };
+	};
+
+	SpirvParser::SpirvParser( const uint32_t * words, size_t wordCount )
+	{
+		if ( wordCount < SPIRV_HEADER_SIZE || words[0] != SPIRV_MAGIC )
+		{
+			throw std::runtime_error( "invalid SPIR-V module" );
+		}
+
+		ids.resize( words[3] );
+
+		size_t i = SPIRV_HEADER_SIZE;
+		while ( i < wordCount )
+		{
+			const uint32_t * inst = words + i;
+			const uint32_t count = inst[0] >> 16;
+			const uint32_t opcode = inst[0] & 0xFFFF;
+			if ( count == 0 || i + count > wordCount )
+			{
+				throw std::runtime_error( "truncated SPIR-V instruction" );
+			}
+
+			switch ( opcode )
+			{
+			case OpName:
+				At( inst[1] ).name = ReadString( inst + 2, count - 2 );
+				break;
+			case OpEntryPoint:
+				// Only the first entry point is reflected, glslang emits one per module
+				if ( entryId == NONE )
+				{
+					executionModel = inst[1];
+					entryId = inst[2];
+					entryName = ReadString( inst + 3, count - 3 );
+					const uint32_t nameWords = (uint32_t)entryName.size() / 4 + 1;
+					entryInterface.assign( inst + 3 + nameWords, inst + count );
+				}
+				break;
+			case OpExecutionMode:
+				if ( inst[1] == entryId && inst[2] == ExecutionModeLocalSize && count >= 6 )
+				{
+					localSize[0] = inst[3];
+					localSize[1] = inst[4];
+					localSize[2] = inst[5];
+				}
+				break;
+			case OpDecorate:
+			{
+				SpvId & target = At( inst[1] );
+				const uint32_t literal = count > 3 ? inst[3] : 0;
+				switch ( inst[2] )
+				{
+				case DecorationSpecId: target.specId = literal; break;
+				case DecorationBlock: target.block = true; break;
+				case DecorationBufferBlock: target.bufferBlock = true; break;
+				case DecorationArrayStride: target.arrayStride = literal; break;
+				case DecorationBuiltIn: target.builtIn = true; break;
+				case DecorationLocation: target.location = literal; break;
+				case DecorationBinding: target.binding = literal; break;
+				case DecorationDescriptorSet: target.set = literal; break;
+				}
+				break;
+			}
+			case OpMemberDecorate:
+			{
+				SpvId & target = At( inst[1] );
+				const uint32_t literal = count > 4 ? inst[4] : 0;
+				if ( inst[3] == DecorationOffset )
+					SetMember( target.memberOffsets, inst[2], literal );
+				else if ( inst[3] == DecorationMatrixStride )
+					SetMember( target.memberMatrixStrides, inst[2], literal );
+				else if ( inst[3] == DecorationBuiltIn )
+					target.builtIn = true;
+				break;
+			}
+			case OpTypeBool:
+				At( inst[1] ).opcode = opcode;
+				At( inst[1] ).width = 32;
+				break;
+			case OpTypeInt:
+				At( inst[1] ).opcode = opcode;
+				At( inst[1] ).width = inst[2];
+				At( inst[1] ).sampled = inst[3];
+				break;
+			case OpTypeFloat:
+				At( inst[1] ).opcode = opcode;
+				At( inst[1] ).width = inst[2];
+				break;
+			case OpTypeVector:
+			case OpTypeMatrix:
+				At( inst[1] ).opcode = opcode;
+				At( inst[1] ).typeId = inst[2];
+				At( inst[1] ).width = inst[3];
+				break;
+			case OpTypeImage:
+				At( inst[1] ).opcode = opcode;
+				At( inst[1] ).typeId = inst[2];
+				At( inst[1] ).width = inst[3];
+				At( inst[1] ).sampled = inst[7];
+				break;
+			case OpTypeSampler:
+				At( inst[1] ).opcode = opcode;
+				break;
+			case OpTypeSampledImage:
+			case OpTypeRuntimeArray:
+				At( inst[1] ).opcode = opcode;
+				At( inst[1] ).typeId = inst[2];
+				break;
+			case OpTypeArray:
+				At( inst[1] ).opcode = opcode;
+				At( inst[1] ).typeId = inst[2];
+				At( inst[1] ).members.assign( 1, inst[3] );	// length constant id
+				break;
+			case OpTypeStruct:
+				At( inst[1] ).opcode = opcode;
+				At( inst[1] ).members.assign( inst + 2, inst + count );
+				break;
+			case OpTypePointer:
+				At( inst[1] ).opcode = opcode;
+				At( inst[1] ).storageClass = inst[2];
+				At( inst[1] ).typeId = inst[3];
+				break;
+			case OpConstant:
+			case OpSpecConstant:
+			{
+				SpvId & constant = At( inst[2] );
+				constant.opcode = opcode;
+				constant.typeId = inst[1];
+				constant.value = count > 3 ? inst[3] : 0;
+				if ( count > 4 )
+					constant.value |= (uint64_t)inst[4] << 32;
+				if ( opcode == OpSpecConstant )
+					specConstants.push_back( inst[2] );
+				break;
+			}
+			case OpSpecConstantTrue:
+			case OpSpecConstantFalse:
+				At( inst[2] ).opcode = opcode;
+				At( inst[2] ).typeId = inst[1];
+				At( inst[2] ).value = opcode == OpSpecConstantTrue ? 1 : 0;
+				specConstants.push_back( inst[2] );
+				break;
+			case OpVariable:
+				At( inst[2] ).opcode = opcode;
+				At( inst[2] ).typeId = inst[1];
+				At( inst[2] ).storageClass = inst[3];
+				variables.push_back( inst[2] );
+				break;
+			}
+
+			i += count;
+		}
+	}
+
+	const SpvId & SpirvParser::Get( uint32_t id ) const
+	{
+		if ( id >= ids.size() )
+		{
+			throw std::runtime_error( "SPIR-V id out of bounds" );
+		}
+		return ids[id];
+	}
+
+	SpvId & SpirvParser::At( uint32_t id )
+	{
+		return const_cast<SpvId &>( Get( id ) );
+	}
+
+	uint32_t SpirvParser::ArrayLength( const SpvId & type ) const
+	{
+		if ( type.opcode != OpTypeArray )
+			return 1;
+		return (uint32_t)Get( type.members[0] ).value;
+	}
+
+	// Size in bytes as laid out by the Offset/ArrayStride/MatrixStride decorations
+	uint32_t SpirvParser::SizeOf( uint32_t typeId, uint32_t matrixStride ) const
+	{
+		const SpvId & type = Get( typeId );
+		switch ( type.opcode )
+		{
+		case OpTypeBool:
+		case OpTypeInt:
+		case OpTypeFloat:
+			return type.width / 8;
+		case OpTypeVector:
+			return SizeOf( type.typeId, 0 ) * type.width;
+		case OpTypeMatrix:
+			return ( matrixStride ? matrixStride : SizeOf( type.typeId, 0 ) ) * type.width;
+		case OpTypeArray:
+			return ( type.arrayStride ? type.arrayStride : SizeOf( type.typeId, matrixStride ) ) * ArrayLength( type );
+		case OpTypeStruct:
+		{
+			uint32_t size = 0;
+			for ( uint32_t m = 0; m < type.members.size(); ++m )
+			{
+				const uint32_t offset = m < type.memberOffsets.size() ? type.memberOffsets[m] : size;
+				const uint32_t stride = m < type.memberMatrixStrides.size() ? type.memberMatrixStrides[m] : 0;
+				size = std::max( size, offset + SizeOf( type.members[m], stride ) );
+			}
+			return size;
+		}
+		}
+		return 0;
+	}
+
+	VkFormat SpirvParser::FormatOf( uint32_t typeId, uint32_t & size ) const
+	{
+		const SpvId & type = Get( typeId );
+		const SpvId & scalar = type.opcode == OpTypeVector ? Get( type.typeId ) : type;
+		const uint32_t components = type.opcode == OpTypeVector ? type.width : 1;
+		size = scalar.width / 8 * components;
+
+		static const VkFormat floatFormats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+		static const VkFormat doubleFormats[] = { VK_FORMAT_R64_SFLOAT, VK_FORMAT_R64G64_SFLOAT, VK_FORMAT_R64G64B64_SFLOAT, VK_FORMAT_R64G64B64A64_SFLOAT };
+		static const VkFormat sintFormats[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+		static const VkFormat uintFormats[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+
+		if ( components < 1 || components > 4 )
+			return VK_FORMAT_UNDEFINED;
+		if ( scalar.opcode == OpTypeFloat )
+			return scalar.width == 64 ? doubleFormats[components - 1] : floatFormats[components - 1];
+		if ( scalar.opcode == OpTypeInt && scalar.width == 32 )
+			return scalar.sampled ? sintFormats[components - 1] : uintFormats[components - 1];
+		return VK_FORMAT_UNDEFINED;
+	}
+
+	VkShaderStageFlagBits StageOf( uint32_t executionModel )
+	{
+		switch ( executionModel )
+		{
+		case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+		case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+		case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+		case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+		case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+		case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+		throw std::runtime_error( "unsupported SPIR-V execution model" );
+	}
+
+	VkDescriptorType DescriptorTypeOf( const SpirvParser & parser, const SpvId & type, uint32_t storageClass )
+	{
+		if ( storageClass == StorageClassStorageBuffer )
+			return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		if ( storageClass == StorageClassUniform )
+			return type.bufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+
+		switch ( type.opcode )
+		{
+		case OpTypeSampler:
+			return VK_DESCRIPTOR_TYPE_SAMPLER;
+		case OpTypeSampledImage:
+			return parser.Get( type.typeId ).width == DimBuffer ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		case OpTypeImage:
+			if ( type.width == DimSubpassData )
+				return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+			if ( type.width == DimBuffer )
+				return type.sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+			return type.sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		}
+		throw std::runtime_error( "unsupported SPIR-V resource type" );
+	}
+}
+
+void ShaderReflectionVulkan::Reflect( const SpirvBlob & spirv )
+{
+	Reflect( spirv.words, spirv.wordCount );
+}
+
+void ShaderReflectionVulkan::Reflect( const uint32_t * words, size_t wordCount )
+{
+	SpirvParser parser( words, wordCount );
+
+	stage = StageOf( parser.executionModel );
+	entryPoint = parser.entryName;
+	bindings.clear();
+	vertexInputs.clear();
+	specConstants.clear();
+	pushConstantSize = 0;
+	std::copy( parser.localSize, parser.localSize + 3, localSize );
+
+	for ( uint32_t varId : parser.variables )
+	{
+		const SpvId & var = parser.Get( varId );
+		const SpvId & pointer = parser.Get( var.typeId );
+		uint32_t typeId = pointer.typeId;
+
+		switch ( var.storageClass )
+		{
+		case StorageClassPushConstant:
+			pushConstantSize = std::max( pushConstantSize, parser.SizeOf( typeId, 0 ) );
+			break;
+
+		case StorageClassInput:
+		{
+			if ( stage != VK_SHADER_STAGE_VERTEX_BIT || var.builtIn || var.location == NONE )
+				break;
+			if ( std::find( parser.entryInterface.begin(), parser.entryInterface.end(), varId ) == parser.entryInterface.end() )
+				break;
+
+			VertexInputVulkan input;
+			input.location = var.location;
+			input.format = parser.FormatOf( typeId, input.size );
+			input.name = var.name;
+			vertexInputs.push_back( input );
+			break;
+		}
+
+		case StorageClassUniformConstant:
+		case StorageClassUniform:
+		case StorageClassStorageBuffer:
+		{
+			if ( var.binding == NONE )
+				break;
+
+			DescriptorBindingVulkan desc;
+			desc.set = var.set == NONE ? 0 : var.set;
+			desc.name = var.name;
+			desc.binding.binding = var.binding;
+			desc.binding.descriptorCount = 1;
+			desc.binding.stageFlags = stage;
+
+			const SpvId * type = &parser.Get( typeId );
+			if ( type->opcode == OpTypeArray || type->opcode == OpTypeRuntimeArray )
+			{
+				desc.binding.descriptorCount = parser.ArrayLength( *type );
+				type = &parser.Get( type->typeId );
+			}
+			desc.binding.descriptorType = DescriptorTypeOf( parser, *type, var.storageClass );
+			bindings.push_back( desc );
+			break;
+		}
+		}
+	}
+
+	for ( uint32_t constId : parser.specConstants )
+	{
+		const SpvId & constant = parser.Get( constId );
+		if ( constant.specId == NONE )
+			continue;
+
+		SpecConstantVulkan spec;
+		spec.constantID = constant.specId;
+		spec.size = parser.SizeOf( constant.typeId, 0 );
+		spec.defaultValue = constant.value;
+		spec.name = constant.name;
+		specConstants.push_back( spec );
+	}
+
+	std::sort( vertexInputs.begin(), vertexInputs.end(), []( const VertexInputVulkan & a, const VertexInputVulkan & b ) { return a.location < b.location; } );
+	std::sort( specConstants.begin(), specConstants.end(), []( const SpecConstantVulkan & a, const SpecConstantVulkan & b ) { return a.constantID < b.constantID; } );
+}
+
+void ShaderReflectionVulkan::BuildVertexInput( std::vector<VkVertexInputBindingDescription> & bindingDescs, std::vector<VkVertexInputAttributeDescription> & attributes ) const
+{
+	bindingDescs.clear();
+	attributes.clear();
+	if ( vertexInputs.empty() )
+		return;
+
+	uint32_t offset = 0;
+	for ( const auto & input : vertexInputs )
+	{
+		VkVertexInputAttributeDescription attr = {};
+		attr.location = input.location;
+		attr.binding = 0;
+		attr.format = input.format;
+		attr.offset = offset;
+		attributes.push_back( attr );
+		offset += input.size;
+	}
+
+	VkVertexInputBindingDescription binding = {};
+	binding.binding = 0;
+	binding.stride = offset;
+	binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	bindingDescs.push_back( binding );
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+
+struct SpirvBlob;
+
+struct DescriptorBindingVulkan
+{
+	uint32_t set = 0;
+	VkDescriptorSetLayoutBinding binding = {};
+	std::string name;
+};
+
+struct VertexInputVulkan
+{
+	uint32_t location = 0;
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	uint32_t size = 0;
+	std::string name;
+};
+
+struct SpecConstantVulkan
+{
+	uint32_t constantID = 0;
+	uint32_t size = 0;
+	uint64_t defaultValue = 0;
+	std::string name;
+};
+
+// Interface of a single shader stage, read straight from the SPIR-V words.
+class ShaderReflectionVulkan
+{
+public:
+	void Reflect( const SpirvBlob & spirv );
+	void Reflect( const uint32_t * words, size_t wordCount );
+
+	// Tightly packed, interleaved binding 0 in location order
+	void BuildVertexInput( std::vector<VkVertexInputBindingDescription> & bindings, std::vector<VkVertexInputAttributeDescription> & attributes ) const;
+
+public:
+	VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+	std::string entryPoint;
+	std::vector<DescriptorBindingVulkan> bindings;
+	uint32_t pushConstantSize = 0;
+	std::vector<VertexInputVulkan> vertexInputs;
+	std::vector<SpecConstantVulkan> specConstants;
+	uint32_t localSize[3] = { 1, 1, 1 };
+};
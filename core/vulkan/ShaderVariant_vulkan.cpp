@@ -0,0 +1,72 @@
+#include <stdafx.h>
+#include "ShaderVariant_vulkan.h"
+#include "ShaderReflection_vulkan.h"
+#include "../Hash.h"
+
+void ShaderVariantVulkan::Validate( const ShaderReflectionVulkan & reflection ) const
+{
+	for ( const auto & entry : m_entries )
+	{
+		auto it = std::find_if( reflection.specConstants.begin(), reflection.specConstants.end(),
+			[&entry]( const SpecConstantVulkan & spec ) { return spec.constantID == entry.constantID; } );
+
+		if ( it == reflection.specConstants.end() )
+		{
+			throw std::runtime_error( "specialization constant " + std::to_string( entry.constantID ) + " is not declared by the shader" );
+		}
+		if ( it->size != entry.size )
+		{
+			throw std::runtime_error( "specialization constant " + it->name + " set with a value of the wrong size" );
+		}
+	}
+}
+
+const VkSpecializationInfo * ShaderVariantVulkan::GetInfo()
+{
+	if ( m_entries.empty() )
+		return nullptr;
+
+	m_info.mapEntryCount = (uint32_t)m_entries.size();
+	m_info.pMapEntries = m_entries.data();
+	m_info.dataSize = m_data.size();
+	m_info.pData = m_data.data();
+	return &m_info;
+}
+
+void ShaderVariantVulkan::SetBytes( uint32_t constantID, const void * data, uint32_t size )
+{
+	auto it = std::lower_bound( m_constants.begin(), m_constants.end(), constantID,
+		[]( const Constant & constant, uint32_t id ) { return constant.constantID < id; } );
+
+	if ( it == m_constants.end() || it->constantID != constantID )
+	{
+		it = m_constants.insert( it, Constant() );
+	}
+
+	it->constantID = constantID;
+	it->size = size;
+	memcpy( it->bytes, data, size );
+
+	Rebuild();
+}
+
+void ShaderVariantVulkan::Rebuild()
+{
+	m_entries.clear();
+	m_data.clear();
+
+	uint64_t hash = HASH_SEED;
+	for ( const auto & constant : m_constants )
+	{
+		VkSpecializationMapEntry entry = {};
+		entry.constantID = constant.constantID;
+		entry.offset = (uint32_t)m_data.size();
+		entry.size = constant.size;
+		m_entries.push_back( entry );
+		m_data.insert( m_data.end(), constant.bytes, constant.bytes + constant.size );
+
+		hash = HashValue( constant.constantID, hash );
+		hash = HashBytes( constant.bytes, constant.size, hash );
+	}
+	m_hash = hash;
+}
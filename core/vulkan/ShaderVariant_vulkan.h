@@ -0,0 +1,54 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+class ShaderReflectionVulkan;
+
+// Set of specialization constant values selecting one permutation of a shader.
+// Constants are kept sorted by id so the hash only depends on the values, not on the order they were set.
+class ShaderVariantVulkan
+{
+public:
+	template<typename T>
+	ShaderVariantVulkan & Set( uint32_t constantID, T value )
+	{
+		static_assert( std::is_same<T, bool>::value || std::is_same<T, int32_t>::value || std::is_same<T, uint32_t>::value ||
+			std::is_same<T, float>::value || std::is_same<T, int64_t>::value || std::is_same<T, uint64_t>::value || std::is_same<T, double>::value,
+			"specialization constants must be bool, 32/64-bit integers, float or double" );
+
+		// GLSL booleans are specialized as 32-bit VkBool32
+		typedef typename std::conditional<std::is_same<T, bool>::value, VkBool32, T>::type Stored;
+		const Stored stored = static_cast<Stored>( value );
+		SetBytes( constantID, &stored, sizeof( Stored ) );
+		return *this;
+	}
+
+	bool IsEmpty() const { return m_constants.empty(); }
+	uint64_t GetHash() const { return m_hash; }
+
+	// Throws when a constant does not exist in the shader or has the wrong size
+	void Validate( const ShaderReflectionVulkan & reflection ) const;
+
+	// Pointers stay valid until the variant is modified or destroyed
+	const VkSpecializationInfo * GetInfo();
+
+private:
+	struct Constant
+	{
+		uint32_t constantID;
+		uint32_t size;
+		uint8_t bytes[8];
+	};
+
+	void SetBytes( uint32_t constantID, const void * data, uint32_t size );
+	void Rebuild();
+
+private:
+	std::vector<Constant> m_constants;
+	std::vector<VkSpecializationMapEntry> m_entries;
+	std::vector<uint8_t> m_data;
+	VkSpecializationInfo m_info = {};
+	uint64_t m_hash = 0;
+};
@@ -0,0 +1,108 @@
+#include <stdafx.h>
+#include "UniformAllocator_vulkan.h"
+
+namespace
+{
+	uint32_t AlignUp( uint32_t value, uint32_t alignment )
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	uint32_t AlignDown( uint32_t value, uint32_t alignment )
+	{
+		return value / alignment * alignment;
+	}
+}
+
+void FrameUniformAllocatorVulkan::Init( VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize bytesPerFrame, uint32_t frameCount )
+{
+	VkPhysicalDeviceProperties props = {};
+	vkGetPhysicalDeviceProperties( physicalDevice, &props );
+
+	m_alignment = std::max( 16U, (uint32_t)props.limits.minUniformBufferOffsetAlignment );
+	m_atomSize = std::max( 1U, (uint32_t)props.limits.nonCoherentAtomSize );
+
+	// Regions start on an atom boundary so flushing one frame never touches its neighbours
+	m_frameSize = AlignUp( AlignUp( (uint32_t)bytesPerFrame, m_alignment ), m_atomSize );
+	m_frameCount = frameCount;
+
+	// Coherent memory is preferred, any host-visible type will do
+	m_buffer.Init( device, physicalDevice, (VkDeviceSize)m_frameSize * frameCount, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
+
+	BeginFrame( 0 );
+}
+
+void FrameUniformAllocatorVulkan::Destroy()
+{
+	m_buffer.Destroy();
+}
+
+void FrameUniformAllocatorVulkan::BeginFrame( uint32_t frameIdx )
+{
+	assert( frameIdx < m_frameCount );
+	m_frameBase = m_frameSize * frameIdx;
+	m_frameEnd = m_frameBase + m_frameSize;
+	m_cursor = m_frameBase;
+	m_flushed = m_frameBase;
+}
+
+void * FrameUniformAllocatorVulkan::Allocate( uint32_t size, uint32_t & offset )
+{
+	const uint32_t start = AlignUp( m_cursor, m_alignment );
+	if ( start + size > m_frameEnd )
+	{
+		throw std::runtime_error( "frame uniform allocator exhausted, raise bytesPerFrame" );
+	}
+
+	offset = start;
+	m_cursor = start + size;
+	return static_cast<uint8_t *>( m_buffer.m_mapped ) + start;
+}
+
+void FrameUniformAllocatorVulkan::Flush()
+{
+	FrameUniformAllocatorVulkan * self = this;
+	FlushAll( &self, 1 );
+}
+
+void FrameUniformAllocatorVulkan::FlushAll( FrameUniformAllocatorVulkan * const * allocators, uint32_t count )
+{
+	// One call per MAX_FLUSH_RANGES dirty allocators, a single one in practice
+	const uint32_t MAX_FLUSH_RANGES = 16;
+	VkMappedMemoryRange ranges[MAX_FLUSH_RANGES];
+
+	uint32_t rangeCount = 0;
+	VkDevice device = VK_NULL_HANDLE;
+	for ( uint32_t i = 0; i < count; ++i )
+	{
+		if ( allocators[i]->GetDirtyRange( ranges[rangeCount] ) )
+		{
+			device = allocators[i]->m_buffer.m_device;
+			++rangeCount;
+		}
+		if ( rangeCount == MAX_FLUSH_RANGES || (rangeCount > 0 && i == count - 1) )
+		{
+			vkFlushMappedMemoryRanges( device, rangeCount, ranges );
+			rangeCount = 0;
+		}
+	}
+}
+
+bool FrameUniformAllocatorVulkan::GetDirtyRange( VkMappedMemoryRange & range )
+{
+	if ( IsCoherent() || m_cursor == m_flushed )
+		return false;
+
+	// Writes are linear, what was allocated since the last flush is one contiguous range
+	const uint32_t begin = AlignDown( m_flushed, m_atomSize );
+	const uint32_t end = std::min( AlignUp( m_cursor, m_atomSize ), m_frameEnd );
+	m_flushed = m_cursor;
+
+	range = {};
+	range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	range.memory = m_buffer.m_memory;
+	range.offset = begin;
+	range.size = end - begin;
+	return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstring>
+
+#include "Buffer_vulkan.h"
+
+// Bump allocator for per-frame constants over one persistently mapped buffer, split in one region
+// per frame in flight. An upload is a single memcpy; data is consumed through dynamic descriptor
+// offsets so no Vulkan object is created or written per frame. On non-coherent memory the dirty
+// part of the region is flushed with one vkFlushMappedMemoryRanges call.
+class FrameUniformAllocatorVulkan
+{
+public:
+	void Init( VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize bytesPerFrame, uint32_t frameCount );
+	void Destroy();
+
+	void BeginFrame( uint32_t frameIdx );
+	void * Allocate( uint32_t size, uint32_t & offset );
+
+	template<typename T>
+	uint32_t Upload( const T & data )
+	{
+		uint32_t offset = 0;
+		memcpy( Allocate( sizeof( T ), offset ), &data, sizeof( T ) );
+		return offset;
+	}
+
+	void Flush();
+	static void FlushAll( FrameUniformAllocatorVulkan * const * allocators, uint32_t count );
+
+	VkBuffer GetBuffer() const { return m_buffer.m_native; }
+	VkDescriptorBufferInfo GetDescriptorInfo( uint32_t range ) const { return { m_buffer.m_native, 0, range }; }
+	uint32_t GetAlignment() const { return m_alignment; }
+	uint32_t GetUsedBytes() const { return m_cursor - m_frameBase; }
+	bool IsCoherent() const { return (m_buffer.m_memoryFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0; }
+
+private:
+	bool GetDirtyRange( VkMappedMemoryRange & range );
+
+private:
+	BufferVulkan m_buffer;
+	uint32_t m_alignment = 0;
+	uint32_t m_atomSize = 1;
+	uint32_t m_frameSize = 0;
+	uint32_t m_frameCount = 0;
+	uint32_t m_frameBase = 0;
+	uint32_t m_frameEnd = 0;
+	uint32_t m_cursor = 0;
+	uint32_t m_flushed = 0;
+};
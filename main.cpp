@@ -1,15 +1,267 @@
 #include <stdafx.h>
+#include "core/CommandList.h"
+#include "core/StartupProfile.h"
+#include "core/compute/ComputeBatch.h"
+#include "core/compute/GpuPrimitivesBench.h"
+#include "core/render/BatchRenderer.h"
+#include "core/render/FrameCapture.h"
+#include "core/render/FrameExport.h"
+#include "core/shader/ShaderCompiler.h"
+#include "core/thread/JobSystem.h"
 #include "core/vulkan/Device3D_vulkan.h"
+#include "core/vulkan/GpuPrimitives_vulkan.h"
 
-int main() {
+namespace
+{
+	const uint32_t CAPTURE_WIDTH = 1280;
+	const uint32_t CAPTURE_HEIGHT = 720;
+
+	// Frames are a moving test pattern uploaded into a device image, read back through FrameCapture like
+	// any IDevice3D image. The tutorial renders into its own swap chain and RenderTargetVulkan images,
+	// which are not device images and cannot be captured.
+	void CaptureFrames( IDevice3D & device, JobSystem & jobs, uint32_t frameCount, const FrameCapture::Callback & callback )
+	{
+		ImageDesc imageDesc;
+		imageDesc.width = CAPTURE_WIDTH;
+		imageDesc.height = CAPTURE_HEIGHT;
+		imageDesc.format = ImageFormat::RGBA8;
+		imageDesc.usage = ImageUsageTransferSrc | ImageUsageTransferDst;
+		const ImageHandle image = device.CreateImage( imageDesc );
+
+		BufferDesc uploadDesc;
+		uploadDesc.size = (uint64_t)CAPTURE_WIDTH * CAPTURE_HEIGHT * 4;
+		uploadDesc.usage = BufferUsageTransferSrc;
+		uploadDesc.memory = MemoryUsage::Upload;
+		const BufferHandle upload = device.CreateBuffer( uploadDesc );
+		uint32_t * pixels = static_cast<uint32_t *>( device.GetMappedBuffer( upload ) );
+
+		FrameCapture capture( device, jobs );
+		capture.Init( CAPTURE_WIDTH, CAPTURE_HEIGHT, ImageFormat::RGBA8, callback );
+
+		LinearArena arena( 4 * 1024 );
+		uint64_t serial = 0;
+		for ( uint32_t frame = 0; frame < frameCount; ++frame )
+		{
+			// One image and one upload buffer: the previous frame has to be copied out before they are reused
+			while ( capture.IsCopying( image ) )
+			{
+				capture.Update();
+				std::this_thread::yield();
+			}
+			device.WaitComplete( IDevice3D::GraphicsQueue, serial );
+
+			for ( uint32_t y = 0; y < CAPTURE_HEIGHT; ++y )
+			{
+				for ( uint32_t x = 0; x < CAPTURE_WIDTH; ++x )
+				{
+					pixels[y * CAPTURE_WIDTH + x] = 0xFF000000u | ((y * 255 / CAPTURE_HEIGHT) << 8) | ((x + frame * 8) & 0xFF);
+				}
+			}
+
+			arena.Reset();
+			CommandList list( arena );
+			list.Barrier( image, ResourceState::Undefined, ResourceState::TransferDst );
+			list.CopyBufferToImage( upload, 0, image );
+			list.Barrier( image, ResourceState::TransferDst, ResourceState::TransferSrc );
+			const CommandList * lists[] = { &list };
+			serial = device.Submit( IDevice3D::GraphicsQueue, lists, 1 );
+			capture.Capture( image, serial, frame );
+		}
+
+		capture.Flush();
+		capture.PrintReport( std::cout );
+		capture.Destroy();
+		device.DestroyBuffer( upload );
+		device.DestroyImage( image );
+	}
+
+	// Records the barriers of a ComputeBatch chain and read-back on the compute queue, then checks the translator
+	// only emitted stages its family supports. With --compute-only that is the dedicated compute family, which
+	// rejects the vertex and fragment stages the generic shader states map to.
+	bool CheckComputeBarriers( Device3DVulkan & device )
+	{
+		const uint64_t size = 4096;
+
+		BufferDesc storageDesc;
+		storageDesc.size = size;
+		storageDesc.usage = BufferUsageStorage | BufferUsageTransferSrc | BufferUsageTransferDst;
+		const BufferHandle storage = device.CreateBuffer( storageDesc );
+
+		BufferDesc readbackDesc;
+		readbackDesc.size = size;
+		readbackDesc.usage = BufferUsageTransferDst;
+		readbackDesc.memory = MemoryUsage::Readback;
+		const BufferHandle readback = device.CreateBuffer( readbackDesc );
+
+		device.ResetTranslatorStats();
+		ComputeBatch batch( device );
+		batch.Barrier( storage );
+		batch.Download( storage, 0, readback, 0, size );
+		batch.Wait( batch.Submit() );
+
+		const VkPipelineStageFlags emitted = device.GetTranslatorStats().barrierStages;
+		const VkPipelineStageFlags unsupported = emitted & ~device.GetQueueStages( IDevice3D::ComputeQueue );
+		std::cout << "compute queue barriers: stages 0x" << std::hex << emitted << ", unsupported 0x" << unsupported << std::dec << std::endl;
+
+		device.DestroyBuffer( readback );
+		device.DestroyBuffer( storage );
+		return unsupported == 0;
+	}
+
+	// Even jobs write the compute test pattern, odd ones clear the target in a render pass without drawing.
+	// Every pixel read back is checked against what its job should have produced.
+	bool CheckBatchRender( Device3DVulkan & device, JobSystem & jobs, ShaderCompiler & compiler, uint32_t jobCount )
+	{
+		const PipelineHandle pattern = device.CreateComputePipeline( compiler.Compile( { "Shaders/batch/pattern.comp", ShaderStage::Compute } ).spirv );
+
+		std::vector<OfflineRenderJob> renderJobs( jobCount );
+		for ( uint32_t i = 0; i < jobCount; ++i )
+		{
+			renderJobs[i].id = i;
+			renderJobs[i].variant = i;
+			if ( device.IsComputeOnly() || (i & 1) == 0 )
+				renderJobs[i].computePipeline = pattern;
+		}
+
+		BatchRendererDesc desc;
+		std::atomic<uint32_t> failedImages( 0 );
+		BatchRenderStats stats;
+		{
+			BatchRenderer renderer( device, jobs );
+			renderer.Init( desc );
+			stats = renderer.Render( renderJobs.data(), jobCount, [&]( const OfflineImage & image ) {
+				const OfflineRenderJob & job = renderJobs[image.jobId];
+				for ( uint32_t y = 0; y < image.height; ++y )
+				{
+					for ( uint32_t x = 0; x < image.width; ++x )
+					{
+						const uint8_t * pixel = image.rgba + ((size_t)y * image.width + x) * 4;
+						const bool match = job.computePipeline.IsValid()
+							? pixel[0] == (x & 255) && pixel[1] == (y & 255) && pixel[2] == (job.variant & 255) && pixel[3] == 255
+							: pixel[0] == 0 && pixel[1] == 0 && pixel[2] == 0 && pixel[3] == 255;
+						if ( !match )
+						{
+							++failedImages;
+							return;
+						}
+					}
+				}
+			} );
+		}
+		device.DestroyPipeline( pattern );
+
+		BatchRenderer::PrintReport( std::cout, stats );
+		if ( failedImages )
+			std::cout << "batch render: " << failedImages << " images with unexpected pixels" << std::endl;
+		return failedImages == 0 && stats.imageCount == jobCount;
+	}
+}
+
+// Usage: vulkan_tuto [--compute-only] [--cpu-device] [--check-barriers] [--bench-primitives] [--batch-render N] [--capture N [--export name]]
+// --compute-only brings the device up headless, without window or swap chain, for servers
+// --check-barriers fails when a compute queue barrier names a stage the queue's family does not support
+// --bench-primitives times the GPU scan, reduce, compaction and sort from 1K to 100M elements
+// --batch-render renders N offscreen images through BatchRenderer, compute and graphics jobs, and checks their pixels
+// --capture reads N frames back through FrameCapture and reports its throughput and latency
+// --export publishes the captured frames to the shared-memory frame ring <name>, for tools/frame_ring_cat
+int main( int argc, char ** argv ) {
 	int exitCode = EXIT_SUCCESS;
 
-	Device3DVulkan * device = new Device3DVulkan;
-	device->Init();
+	DeviceDescVulkan deviceDesc;
+	bool checkBarriers = false;
+	bool benchPrimitives = false;
+	uint32_t batchRenderCount = 0;
+	uint32_t captureFrameCount = 0;
+	const char * exportName = nullptr;
+	for ( int i = 1; i < argc; ++i )
+	{
+		if ( strcmp( argv[i], "--compute-only" ) == 0 )
+			deviceDesc.mode = DeviceModeVulkan::ComputeOnly;
+		else if ( strcmp( argv[i], "--cpu-device" ) == 0 )
+			deviceDesc.preferCpuDevice = true;
+		else if ( strcmp( argv[i], "--check-barriers" ) == 0 )
+			checkBarriers = true;
+		else if ( strcmp( argv[i], "--bench-primitives" ) == 0 )
+			benchPrimitives = true;
+		else if ( strcmp( argv[i], "--batch-render" ) == 0 && i + 1 < argc )
+			batchRenderCount = (uint32_t)std::max( 0, atoi( argv[++i] ) );
+		else if ( strcmp( argv[i], "--capture" ) == 0 && i + 1 < argc )
+			captureFrameCount = (uint32_t)std::max( 0, atoi( argv[++i] ) );
+		else if ( strcmp( argv[i], "--export" ) == 0 && i + 1 < argc )
+			exportName = argv[++i];
+	}
+
+	// Started first so this thread becomes worker 0, the one GLFW calls are routed to
+	JobSystem * jobSystem = new JobSystem;
+	{
+		StartupPhase phase( "JobSystem::Init" );
+		jobSystem->Init();
+	}
+
+	Device3DVulkan * device = new Device3DVulkan( jobSystem, deviceDesc );
+	ShaderCompiler * shaderCompiler = new ShaderCompiler( "Shaders/cache" );
+
+	// Shaders do not need the device, they load while it is created
+	device->AddInitTask( []( void * data ) {
+		StartupPhase phase( "LoadShaders" );
+		ShaderCompiler * compiler = static_cast<ShaderCompiler *>( data );
+		compiler->Compile( { "Shaders/shader.vert", ShaderStage::Vertex } );
+		compiler->Compile( { "Shaders/shader.frag", ShaderStage::Fragment } );
+	}, shaderCompiler );
 
 	try
 	{
-		
+		device->Init();
+
+		// Nothing is drawn nor presented here yet, the milestone is the first graphics submission the GPU completed
+		if ( !device->IsComputeOnly() )
+		{
+			StartupPhase phase( "FirstSubmit" );
+			LinearArena arena( 0 );
+			CommandList frame( arena );
+			const CommandList * lists[] = { &frame };
+			device->WaitComplete( IDevice3D::GraphicsQueue, device->Submit( IDevice3D::GraphicsQueue, lists, 1 ) );
+			StartupProfile::Get().MarkFirstSubmit();
+		}
+		StartupProfile::Get().PrintReport( std::cout );
+
+		if ( checkBarriers && !CheckComputeBarriers( *device ) )
+			exitCode = EXIT_FAILURE;
+
+		if ( benchPrimitives )
+		{
+			GpuPrimitivesBenchDesc benchDesc;
+			benchDesc.maxBufferSize = device->GetLimits().maxStorageBufferRange;
+			if ( !RunGpuPrimitivesBench( *device, CreateGpuPrimitivePipelinesVulkan( *device, *shaderCompiler ), benchDesc, std::cout ) )
+				exitCode = EXIT_FAILURE;
+		}
+
+		if ( batchRenderCount > 0 && !CheckBatchRender( *device, *jobSystem, *shaderCompiler, batchRenderCount ) )
+			exitCode = EXIT_FAILURE;
+
+		if ( captureFrameCount > 0 )
+		{
+			if ( device->IsComputeOnly() )
+				throw std::runtime_error( "--capture needs the graphics queue, it cannot run with --compute-only" );
+
+			FrameExport frameExport;
+			FrameCapture::Callback callback;
+			if ( exportName )
+			{
+				FrameExportDesc exportDesc;
+				exportDesc.name = exportName;
+				exportDesc.width = CAPTURE_WIDTH;
+				exportDesc.height = CAPTURE_HEIGHT;
+				frameExport.Open( exportDesc );
+				callback = [&frameExport]( const CapturedFrame & frame ) { frameExport.Write( frame ); };
+			}
+			CaptureFrames( *device, *jobSystem, captureFrameCount, callback );
+			if ( frameExport.IsOpen() )
+			{
+				frameExport.PrintReport( std::cout );
+				frameExport.Close();
+			}
+		}
 	}
 	catch ( const std::runtime_error& e )
 	{
@@ -21,6 +273,10 @@ int main() {
 terminate:
 	device->Destroy();
 	delete device;
+	delete shaderCompiler;
+
+	jobSystem->Shutdown();
+	delete jobSystem;
 
 	return exitCode;
-}
\ No newline at end of file
+}
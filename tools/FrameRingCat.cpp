@@ -0,0 +1,105 @@
+#include <stdafx.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "core/render/FrameExport.h"
+
+// Reference consumer of a frame ring: streams the frames as a Y4M or raw RGB24 file, to stdout by
+// default so it pipes straight into an encoder, e.g.
+//   frame_ring_cat --shm vulkan_tuto | ffmpeg -i - out.mp4                         (Y4M ring)
+//   frame_ring_cat --shm vulkan_tuto | ffmpeg -f rawvideo -pix_fmt rgb24 -s 1920x1080 -i - out.mp4
+// Usage: frame_ring_cat (--shm name | --file path) [--out path] [--wait seconds]
+// Waits for the producer to create the ring, exits once it is closed and drained.
+
+namespace
+{
+	const double DEFAULT_WAIT_SECONDS = 10.0;
+	const auto POLL_INTERVAL = std::chrono::microseconds( 500 );
+
+	const char * GetArgument( int argc, char ** argv, const char * name )
+	{
+		for ( int i = 1; i + 1 < argc; ++i )
+		{
+			if ( strcmp( argv[i], name ) == 0 )
+				return argv[i + 1];
+		}
+		return nullptr;
+	}
+}
+
+int main( int argc, char ** argv )
+{
+	const char * shmName = GetArgument( argc, argv, "--shm" );
+	const char * filePath = GetArgument( argc, argv, "--file" );
+	const char * outPath = GetArgument( argc, argv, "--out" );
+	const char * waitArg = GetArgument( argc, argv, "--wait" );
+	if ( !shmName == !filePath )
+	{
+		fprintf( stderr, "usage: frame_ring_cat (--shm name | --file path) [--out path] [--wait seconds]\n" );
+		return EXIT_FAILURE;
+	}
+
+	const FrameExportTarget target = shmName ? FrameExportTarget::SharedMemory : FrameExportTarget::RingFile;
+	const char * name = shmName ? shmName : filePath;
+	const double waitSeconds = waitArg ? std::atof( waitArg ) : DEFAULT_WAIT_SECONDS;
+
+	FrameRingReader reader;
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>( waitSeconds );
+	while ( !reader.Open( target, name ) )
+	{
+		if ( std::chrono::steady_clock::now() > deadline )
+		{
+			fprintf( stderr, "no frame ring %s\n", name );
+			return EXIT_FAILURE;
+		}
+		std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+	}
+
+	FILE * out = outPath ? fopen( outPath, "wb" ) : stdout;
+	if ( !out )
+	{
+		fprintf( stderr, "cannot write %s\n", outPath );
+		return EXIT_FAILURE;
+	}
+
+	const FrameRingHeader & header = reader.GetHeader();
+	fprintf( stderr, "%ux%u %s, %u:%u fps, %u slots\n", header.width, header.height,
+		header.format == FrameExportFormat::Y4M ? "y4m" : "rgb24", header.fpsNumerator, header.fpsDenominator, header.slotCount );
+	fputs( header.streamHeader, out );
+
+	uint64_t frameCount = 0;
+	uint64_t lastFrameId = 0;
+	uint64_t gapCount = 0;
+	while ( !reader.IsFinished() )
+	{
+		const uint8_t * payload = nullptr;
+		const FrameSlotHeader * slot = reader.Acquire( &payload );
+		if ( !slot )
+		{
+			std::this_thread::sleep_for( POLL_INTERVAL );
+			continue;
+		}
+
+		// Frames the producer dropped because we were behind show up as holes in the ids
+		if ( frameCount && slot->frameId != lastFrameId + 1 )
+			++gapCount;
+		lastFrameId = slot->frameId;
+
+		const bool isWritten = fwrite( payload, 1, slot->payloadSize, out ) == slot->payloadSize;
+		reader.Release();
+		if ( !isWritten )
+		{
+			fprintf( stderr, "write failed after %llu frames\n", (unsigned long long)frameCount );
+			return EXIT_FAILURE;
+		}
+		++frameCount;
+	}
+
+	if ( out != stdout )
+		fclose( out );
+	fprintf( stderr, "%llu frames, %llu gaps\n", (unsigned long long)frameCount, (unsigned long long)gapCount );
+	return EXIT_SUCCESS;
+}
@@ -5,16 +5,37 @@ Vulkan tutorials from https://vulkan-tutorial.com
 //#include <vulkan/vulkan.h>
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
+#include "core/LatencyWindow.h"
+#include "core/memory/AllocationCounter.h"
+#include "core/memory/LinearArena.h"
+#include "core/StartupProfile.h"
+#include "core/render/FramePacing.h"
+#include "core/render/FrameScheduler.h"
+#include "core/render/RenderScaleController.h"
+#include "core/shader/ShaderCompiler.h"
+#include "core/shader/ShaderWatcher.h"
+#include "core/thread/BoundedQueue.h"
+#include "core/vulkan/PerDrawData_vulkan.h"
+#include "core/vulkan/PipelineCache_vulkan.h"
+#include "core/vulkan/PipelineLayoutCache_vulkan.h"
+#include "core/vulkan/PresentPolicy_vulkan.h"
+#include "core/vulkan/RenderTarget_vulkan.h"
+#include "core/vulkan/ShaderReflection_vulkan.h"
+#include "core/vulkan/ShaderVariant_vulkan.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
 #include <stdexcept>
 #include <cassert>
 #include <cstring>
+#include <exception>
 #include <fstream>
 #include <functional>
 #include <vector>
 #include <set>
+#include <thread>
 
 VkResult CreateDebugReportCallbackEXT(VkInstance instance, const VkDebugReportCallbackCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugReportCallbackEXT* pCallback) {
 	auto func = (PFN_vkCreateDebugReportCallbackEXT)vkGetInstanceProcAddr(instance, "vkCreateDebugReportCallbackEXT");
@@ -43,14 +64,49 @@ struct QueueFamilyIndices {
 };
 
 struct SwapChainSupportDetails {
+	explicit SwapChainSupportDetails(LinearArena & arena) : formats(arena), presentModes(arena) {}
+
 	VkSurfaceCapabilitiesKHR capabilities;
-	std::vector<VkSurfaceFormatKHR> formats;
-	std::vector<VkPresentModeKHR> presentModes;
+	ArenaVector<VkSurfaceFormatKHR> formats;
+	ArenaVector<VkPresentModeKHR> presentModes;
+};
+
+// Per-frame shader constants, uploaded once per frame through the frame uniform allocator.
+// Mirrors FrameConstants in Shaders/shader.vert.
+struct FrameConstantsVulkan {
+	float aspectScale;	// height / width of the render extent, keeps the triangle's proportions
+	float time;
+	uint32_t frameNumber;
+	uint32_t padding;
+};
+
+// Everything the render thread needs to record a frame. Built by the simulation on the main
+// thread and never modified once queued, so the two threads share no mutable state.
+// Its containers live in the frame arena of the frame that built it.
+struct FrameSnapshot {
+	FrameSnapshot() = default;
+	explicit FrameSnapshot(LinearArena & arena) : draws(arena) {}
+
+	uint64_t frameNumber = 0;
+	double time = 0.0;
+	std::chrono::steady_clock::time_point inputTime;
+	bool rebuildPipeline = false;
+	bool dynamicResolution = true;
+	bool grayscale = false;
+	PresentPolicy presentPolicy = PresentPolicy::Throughput;
+	ArenaVector<DrawParamsVulkan> draws;
 };
 
 class HelloTriangleApplication {
 	const int WIDTH = 800;
 	const int HEIGHT = 600;
+	static const uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+	// Frames after which the loop is expected to stop allocating
+	static const uint32_t STEADY_STATE_FRAME = 8;
+	// constant_id of GRAYSCALE in Shaders/shader.frag
+	static const uint32_t FRAG_GRAYSCALE_CONSTANT = 0;
+	// Frame constants only, a few hundred frames' worth with the uniform offset alignment
+	static const uint32_t FRAME_UNIFORM_BYTES = 4096;
 
 	const std::vector<const char*> m_validationLayers = {
 		"VK_LAYER_LUNARG_standard_validation"
@@ -74,34 +130,97 @@ class HelloTriangleApplication {
 	VkDebugReportCallbackEXT m_callback;
 	VkSurfaceKHR m_surface = VK_NULL_HANDLE;
 	GLFWwindow * m_window = nullptr;
-	VkSwapchainKHR m_swapChain;
+	VkSwapchainKHR m_swapChain = VK_NULL_HANDLE;
 	std::vector<VkImage> m_swapChainImages;
 	VkFormat m_swapChainImageFormat;
 	VkExtent2D m_swapChainExtent;
-	std::vector<VkImageView> m_swapChainImageViews;
+	PipelineLayoutCacheVulkan m_layoutCache;
 	VkPipelineLayout m_pipelineLayout;
 	VkRenderPass m_renderPass;
+	PipelineCacheVulkan m_pipelineCache;
 	VkPipeline m_gfxPipeline;
-	std::vector<VkFramebuffer> m_swapChainFramebuffers;
+	PipelineKeyVulkan m_gfxPipelineKey;
+	// One region per frame in flight; the stream's dynamic uniform set carries the frame constants,
+	// written once at init, so a frame costs one memcpy and one bind
+	FrameUniformAllocatorVulkan m_frameUniforms;
+	PerDrawStreamVulkan m_frameConstants;
+	// The scene is rendered at the render scale into the target of its frame slot, then blitted to the swap chain image
+	RenderTargetVulkan m_renderTargets[MAX_FRAMES_IN_FLIGHT];
+	RenderScaleController m_renderScale;
+	bool m_isDynamicResolution = true;	// main thread, D toggles it
+	bool m_isGrayscale = false;			// main thread, G toggles it
+	float m_frameScales[MAX_FRAMES_IN_FLIGHT] = {};
+	// Start and end of each frame slot, no pool when the graphics queue cannot time
+	VkQueryPool m_timestampPool = VK_NULL_HANDLE;
+	double m_timestampPeriodNs = 0.0;
+	uint64_t m_timestampMask = 0;
+	bool m_timestampPending[MAX_FRAMES_IN_FLIGHT] = {};
 		
 	// commands objects
 	VkCommandPool m_commandPool;
 	std::vector<VkCommandBuffer> m_commandBuffers;
 
 	// synch mechanisms
-	VkSemaphore m_imageAvailableSemaphore;
-	VkSemaphore m_renderFinishedSemaphore;
+	VkSemaphore m_imageAvailableSemaphores[MAX_FRAMES_IN_FLIGHT];
+	VkSemaphore m_renderFinishedSemaphores[MAX_FRAMES_IN_FLIGHT];
+	VkFence m_inFlightFences[MAX_FRAMES_IN_FLIGHT];
+	uint32_t m_currentFrame = 0;
+
+	// Picked with the 1, 2 and 3 keys on the main thread, applied by the render thread between frames
+	PresentPolicy m_requestedPresentPolicy = PresentPolicy::Throughput;
+	PresentPolicy m_presentPolicy = PresentPolicy::Throughput;
+	// Render thread only, reported and reset whenever the policy changes
+	LatencyWindow m_acquireLatency;
+	// CPU time from acquire until vkQueuePresentKHR returns, not until the image reaches the display
+	LatencyWindow m_acquireToPresentCallLatency;
+
+	// Simulation runs on the main thread, recording and submission on the render thread.
+	// The main thread only starts a frame once the pacer says the render thread holds a free frame slot
+	// and a swap chain image, so input is sampled after the blocking waits, not before them.
+	BoundedQueue<FrameSnapshot> m_frameQueue{ 1 };
+	FramePacer m_framePacer;
+	FrameLatencyTracker m_frameLatency;
+	uint32_t m_imageIndex = 0;
+	std::chrono::steady_clock::time_point m_acquireStart;
+	std::thread m_renderThread;
+	std::exception_ptr m_renderError;
+	uint64_t m_frameNumber = 0;
+
+	// Snapshot N is read by the render thread while N+1 is queued and N+2 is being simulated
+	FrameArenas m_frameArenas{ m_frameQueue.GetCapacity() + 2, 64 * 1024 };
+	// Main thread only. Renders on change and sleeps on the event queue otherwise, C toggles
+	// continuous rendering, L a frame rate cap.
+	FrameScheduler m_scheduler;
+	static const uint32_t CAPPED_FPS = 60;
+	bool m_isFpsCapped = false;
+	// Steady-state frames are expected not to touch the heap at all
+	FrameAllocationBudget m_frameBudget{ 0, 0, STEADY_STATE_FRAME };
+
+	// shaders
+	ShaderCompiler m_shaderCompiler{ "Shaders/cache" };
+	ShaderWatcher m_shaderWatcher{ m_shaderCompiler };
+	bool m_pipelineDirty = false;
+	ShaderVariantVulkan m_vertVariant;
+	ShaderVariantVulkan m_fragVariant;
+	// Render thread only: the value m_fragVariant was last built with
+	bool m_isGrayscalePipeline = false;
 
 public:
 	void run() {
-		initWindow();
-		initVulkan();
+		{
+			AllocationScopeGuard scope(AllocationScope::Init);
+			StartupPhase phase("init");
+			initWindow();
+			initVulkan();
+		}
 		mainLoop();
 		cleanup();
+		StartupProfile::Get().PrintReport(std::cout);
 	}
 
 private:
 	void initWindow() {
+		StartupPhase phase("initWindow");
 		if (glfwInit() == GLFW_FALSE) {
 			throw std::runtime_error("Error initializing GLFW");
 		}
@@ -114,34 +233,150 @@ private:
 		glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 
 		m_window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
+		glfwSetWindowUserPointer(m_window, this);
+		glfwSetKeyCallback(m_window, onKey);
+		// Any input or window damage gets a frame out of the idle wait
+		glfwSetCursorPosCallback(m_window, [](GLFWwindow * window, double, double) { getApp(window)->m_scheduler.MarkDirty(); });
+		glfwSetMouseButtonCallback(m_window, [](GLFWwindow * window, int, int, int) { getApp(window)->m_scheduler.MarkDirty(); });
+		glfwSetScrollCallback(m_window, [](GLFWwindow * window, double, double) { getApp(window)->m_scheduler.MarkDirty(); });
+		glfwSetWindowFocusCallback(m_window, [](GLFWwindow * window, int) { getApp(window)->m_scheduler.MarkDirty(); });
+		glfwSetWindowRefreshCallback(m_window, [](GLFWwindow * window) { getApp(window)->m_scheduler.MarkDirty(); });
+		glfwSetWindowIconifyCallback(m_window, [](GLFWwindow * window, int iconified) {
+			getApp(window)->m_scheduler.SetVisible(iconified == GLFW_FALSE);
+			getApp(window)->m_scheduler.MarkDirty();
+		});
+	}
+
+	static HelloTriangleApplication * getApp(GLFWwindow * window) {
+		return static_cast<HelloTriangleApplication *>(glfwGetWindowUserPointer(window));
+	}
+
+	static void onKey(GLFWwindow * window, int key, int scancode, int action, int mods) {
+		HelloTriangleApplication * app = getApp(window);
+		app->m_scheduler.MarkDirty();
+		if (action != GLFW_PRESS) {
+			return;
+		}
+		if (key >= GLFW_KEY_1 && key < GLFW_KEY_1 + (int)PresentPolicy::Count) {
+			app->m_requestedPresentPolicy = (PresentPolicy)(key - GLFW_KEY_1);
+		}
+		else if (key == GLFW_KEY_C) {
+			const bool continuous = app->m_scheduler.GetMode() == FrameScheduler::Mode::Continuous;
+			app->m_scheduler.SetMode(continuous ? FrameScheduler::Mode::OnDemand : FrameScheduler::Mode::Continuous);
+		}
+		else if (key == GLFW_KEY_D) {
+			app->m_isDynamicResolution = !app->m_isDynamicResolution;
+		}
+		else if (key == GLFW_KEY_G) {
+			app->m_isGrayscale = !app->m_isGrayscale;
+		}
+		else if (key == GLFW_KEY_L) {
+			app->m_isFpsCapped = !app->m_isFpsCapped;
+			app->m_scheduler.SetTargetFps(app->m_isFpsCapped ? (double)CAPPED_FPS : 0.0);
+		}
 	}
 
 	void initVulkan() {
+		StartupPhase phase("initVulkan");
 		createInstance();
 		setupDebugCallback();
 		createSurface();
 		pickPhysicalDevice();
 		createLogicalDevice();
+		m_layoutCache.Init(m_device);
+		// Registers the shared set of the frame constants, pipeline layouts are built with it
+		m_frameUniforms.Init(m_device, m_physicalDevice, FRAME_UNIFORM_BYTES, MAX_FRAMES_IN_FLIGHT);
+		m_frameConstants.Init(m_device, m_layoutCache, m_frameUniforms, sizeof(FrameConstantsVulkan));
+		{
+			StartupPhase cachePhase("pipelineCache");
+			m_pipelineCache.Init(m_device, m_physicalDevice, "Shaders/cache/pipeline.cache");
+		}
 		createSwapChain();
-		createImageViews();
 		createRenderPass();
-		createGraphicsPipeline();
-		createFramebuffers();
+		{
+			StartupPhase pipelinePhase("createGraphicsPipeline");
+			createGraphicsPipeline();
+		}
+		createRenderTargets();
+		createTimestampQueries();
 		createCommandPool();
 		createCommandBuffers();
-		createSemaphores();
+		createSyncObjects();
+		watchShaders();
+	}
+
+	void watchShaders() {
+		// Background recompiles only flag the pipeline, it is rebuilt between frames
+		const ShaderDesc descs[] = {
+			{ "Shaders/shader.vert", ShaderStage::Vertex },
+			{ "Shaders/shader.frag", ShaderStage::Fragment },
+		};
+		for (const auto & desc : descs) {
+			m_shaderWatcher.Watch(desc, m_shaderCompiler.Compile(desc), [this](const ShaderBinary &) {
+				m_pipelineDirty = true;
+				m_scheduler.MarkDirty();
+			});
+		}
+	}
+
+	// Render thread only, the pipeline is not referenced by any other thread
+	void recreateGraphicsPipeline() {
+		// Reload work, not held to the frame budget
+		AllocationScopeGuard scope(AllocationScope::Init);
+		vkDeviceWaitIdle(m_device);
+
+		m_pipelineCache.Release(m_gfxPipelineKey);
+
+		// The grayscale variant is the same fragment shader with its GRAYSCALE constant specialized
+		m_fragVariant.Set(FRAG_GRAYSCALE_CONSTANT, m_isGrayscalePipeline);
+		createGraphicsPipeline();
+	}
+
+	// Render thread only. Render pass and render targets only depend on format and extent, which no policy changes.
+	void recreateSwapChain(PresentPolicy policy) {
+		AllocationScopeGuard scope(AllocationScope::Init);
+		vkDeviceWaitIdle(m_device);
+
+		printPresentLatency();
+		m_acquireLatency.Reset();
+		m_acquireToPresentCallLatency.Reset();
+		m_frameLatency.Reset();
+		m_presentPolicy = policy;
+
+		createSwapChain();
 	}
 
-	void createSemaphores() {
+	void printPresentLatency() {
+		std::cout << "present policy " << GetPresentPolicyName(m_presentPolicy) << std::endl;
+		m_acquireLatency.PrintReport(std::cout, "  acquire");
+		m_acquireToPresentCallLatency.PrintReport(std::cout, "  acquire to present call");
+		m_frameLatency.PrintReport(std::cout);
+		m_renderScale.PrintReport(std::cout);
+	}
+
+	void createSyncObjects() {
 		VkSemaphoreCreateInfo semInfo = {};
 		semInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-		if (vkCreateSemaphore(m_device, &semInfo, nullptr, &m_imageAvailableSemaphore) != VK_SUCCESS ||
-			vkCreateSemaphore(m_device, &semInfo, nullptr, &m_renderFinishedSemaphore) != VK_SUCCESS) {
-			throw std::runtime_error("cannot create semaphore");
+
+		// Fences start signaled so the first wait on each frame slot returns immediately
+		VkFenceCreateInfo fenceInfo = {};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+		for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+			if (vkCreateSemaphore(m_device, &semInfo, nullptr, &m_imageAvailableSemaphores[i]) != VK_SUCCESS ||
+				vkCreateSemaphore(m_device, &semInfo, nullptr, &m_renderFinishedSemaphores[i]) != VK_SUCCESS) {
+				throw std::runtime_error("cannot create semaphore");
+			}
+			if (vkCreateFence(m_device, &fenceInfo, nullptr, &m_inFlightFences[i]) != VK_SUCCESS) {
+				throw std::runtime_error("cannot create fence");
+			}
 		}
 	}
+
+	// One command buffer per frame in flight, re-recorded every frame from the frame snapshot
 	void createCommandBuffers() {
-		m_commandBuffers.resize(m_swapChainFramebuffers.size());
+		m_commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
 
 		VkCommandBufferAllocateInfo cbAllocInfo = {};
 		cbAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -152,74 +387,171 @@ private:
 		if (vkAllocateCommandBuffers(m_device, &cbAllocInfo, m_commandBuffers.data()) != VK_SUCCESS) {
 			throw std::runtime_error("cannot allocate command buffers");
 		}
+	}
 
-		for (size_t i = 0; i < m_commandBuffers.size(); i++) {
-			VkCommandBufferBeginInfo beginInfo = {};
-			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-			beginInfo.pInheritanceInfo = nullptr; // Optional
+	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, const FrameSnapshot & snapshot) {
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		beginInfo.pInheritanceInfo = nullptr; // Optional
 
-			if (vkBeginCommandBuffer(m_commandBuffers[i], &beginInfo) != VK_SUCCESS) {
-				throw std::runtime_error("failed to begin recording command buffer!");
-			}
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording command buffer!");
+		}
 
-			VkRenderPassBeginInfo renderPassInfo = {};
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassInfo.renderPass = m_renderPass;
-			renderPassInfo.framebuffer = m_swapChainFramebuffers[i];
-			renderPassInfo.renderArea.offset = { 0, 0 };
-			renderPassInfo.renderArea.extent = m_swapChainExtent;
-			VkClearValue clearVal = { 0.0f, 0.0f, 1.0f, 1.0f };
-			renderPassInfo.clearValueCount = 1;
-			renderPassInfo.pClearValues = &clearVal;
-			
-			vkCmdBeginRenderPass(m_commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-			vkCmdBindPipeline(m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_gfxPipeline);
-			vkCmdDraw(m_commandBuffers[i], 3, 1, 0, 0);
-			vkCmdEndRenderPass(m_commandBuffers[i]);
-
-			if (vkEndCommandBuffer(m_commandBuffers[i]) != VK_SUCCESS) {
-				throw std::runtime_error("failed to end recording command buffer!");
-			}
+		if (m_timestampPool != VK_NULL_HANDLE) {
+			vkCmdResetQueryPool(commandBuffer, m_timestampPool, 2 * m_currentFrame, 2);
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_timestampPool, 2 * m_currentFrame);
+		}
+
+		const float scale = snapshot.dynamicResolution ? m_renderScale.GetScale() : 1.0f;
+		m_frameScales[m_currentFrame] = scale;
+		const VkExtent2D renderExtent = {
+			RenderScaleController::ScaleSize(m_swapChainExtent.width, scale),
+			RenderScaleController::ScaleSize(m_swapChainExtent.height, scale)
+		};
+		const RenderTargetVulkan & target = m_renderTargets[m_currentFrame];
+
+		VkRenderPassBeginInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = m_renderPass;
+		renderPassInfo.framebuffer = target.m_framebuffer;
+		renderPassInfo.renderArea.offset = { 0, 0 };
+		renderPassInfo.renderArea.extent = renderExtent;
+		VkClearValue clearVal = { 0.0f, 0.0f, 1.0f, 1.0f };
+		renderPassInfo.clearValueCount = 1;
+		renderPassInfo.pClearValues = &clearVal;
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_gfxPipeline);
+
+		// The frame slot's fence was waited, its region of the allocator is free again
+		m_frameUniforms.BeginFrame(m_currentFrame);
+		const FrameConstantsVulkan frameConstants = {
+			(float)renderExtent.height / (float)renderExtent.width, (float)snapshot.time, (uint32_t)snapshot.frameNumber, 0
+		};
+		m_frameConstants.Bind(commandBuffer, m_pipelineLayout, VK_PIPELINE_BIND_POINT_GRAPHICS, m_frameConstants.Push(&frameConstants));
+		m_frameUniforms.Flush();
+
+		const VkViewport viewport = { 0.0f, 0.0f, (float)renderExtent.width, (float)renderExtent.height, 0.0f, 1.0f };
+		const VkRect2D scissor = { { 0, 0 }, renderExtent };
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		// Per-draw indices travel as push constants, no descriptor update per draw
+		PerDrawDataVulkan<DrawParamsVulkan> drawData;
+		for (const auto & params : snapshot.draws) {
+			drawData.Write(commandBuffer, m_pipelineLayout, params);
+			vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+		}
+		vkCmdEndRenderPass(commandBuffer);
+
+		blitToSwapChainImage(commandBuffer, target.m_image, renderExtent, m_swapChainImages[imageIndex]);
+
+		if (m_timestampPool != VK_NULL_HANDLE) {
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_timestampPool, 2 * m_currentFrame + 1);
+			m_timestampPending[m_currentFrame] = true;
+		}
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to end recording command buffer!");
 		}
 	}
 
+	// Upscales the rendered region to the whole swap chain image and leaves it ready to present
+	void blitToSwapChainImage(VkCommandBuffer commandBuffer, VkImage source, VkExtent2D sourceExtent, VkImage swapChainImage) {
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = swapChainImage;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		// The image available semaphore is waited at the transfer stage, the barrier chains to it
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		VkImageBlit blit = {};
+		blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		blit.srcOffsets[1] = { (int32_t)sourceExtent.width, (int32_t)sourceExtent.height, 1 };
+		blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		blit.dstOffsets[1] = { (int32_t)m_swapChainExtent.width, (int32_t)m_swapChainExtent.height, 1 };
+		vkCmdBlitImage(commandBuffer, source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapChainImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
 	void createCommandPool() {
 		QueueFamilyIndices queueFamily = findQueueFamilies(m_physicalDevice);
 
 		VkCommandPoolCreateInfo cpInfo = {};
 		cpInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 		cpInfo.queueFamilyIndex = queueFamily.graphicsFamily;
+		cpInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
 		if (vkCreateCommandPool(m_device, &cpInfo, nullptr, &m_commandPool) != VK_SUCCESS) {
 			throw std::runtime_error("Cannot create command pool");
 		}
 	}
 
-	void createFramebuffers() {
-		m_swapChainFramebuffers.resize(m_swapChainImageViews.size());
+	// One per frame slot: a frame in flight may still be blitting from its target while the next renders
+	void createRenderTargets() {
+		for (auto & target : m_renderTargets) {
+			target.Init(m_device, m_physicalDevice, m_renderPass, m_swapChainImageFormat, m_swapChainExtent);
+		}
 
-		int i = 0;
-		for (auto imageView : m_swapChainImageViews) {
-			VkImageView attachments[] = {
-				imageView
-			};
+		// The GPU gets most of a display refresh, the rest is left for composition and timing noise
+		const GLFWvidmode * mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+		const double refreshRate = mode && mode->refreshRate > 0 ? mode->refreshRate : 60.0;
+		m_renderScale.SetBudgetMs(0.85 * 1000.0 / refreshRate);
+	}
 
-			VkFramebufferCreateInfo fbInfo = {};
-			fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-			fbInfo.renderPass = m_renderPass;
-			fbInfo.attachmentCount = 1;
-			fbInfo.pAttachments = attachments;
-			fbInfo.width = m_swapChainExtent.width;
-			fbInfo.height = m_swapChainExtent.height;
-			fbInfo.layers = 1;
+	void createTimestampQueries() {
+		QueueFamilyIndices indices = findQueueFamilies(m_physicalDevice);
+		uint32_t queueFamCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamCount, nullptr);
+		std::vector<VkQueueFamilyProperties> queueFamProps(queueFamCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(m_physicalDevice, &queueFamCount, queueFamProps.data());
 
-			if (vkCreateFramebuffer(m_device, &fbInfo, nullptr, &m_swapChainFramebuffers[i]) != VK_SUCCESS) {
-				throw std::runtime_error("Cant create framebuffer");
-			}
+		// Without timings the scale stays where it is
+		const uint32_t validBits = queueFamProps[indices.graphicsFamily].timestampValidBits;
+		if (validBits == 0) {
+			return;
+		}
+
+		VkPhysicalDeviceProperties props = {};
+		vkGetPhysicalDeviceProperties(m_physicalDevice, &props);
+		m_timestampPeriodNs = props.limits.timestampPeriod;
+		m_timestampMask = validBits >= 64 ? ~0ULL : (1ULL << validBits) - 1;
+
+		VkQueryPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		poolInfo.queryCount = 2 * MAX_FRAMES_IN_FLIGHT;
+		if (vkCreateQueryPool(m_device, &poolInfo, nullptr, &m_timestampPool) != VK_SUCCESS) {
+			throw std::runtime_error("cannot create timestamp query pool");
+		}
+	}
 
-			++i;
+	// Once the slot's fence signaled, its timestamps are available without waiting
+	void readFrameTimestamps(uint32_t slot) {
+		if (!m_timestampPending[slot]) {
+			return;
+		}
+		m_timestampPending[slot] = false;
+
+		uint64_t timestamps[2] = {};
+		if (vkGetQueryPoolResults(m_device, m_timestampPool, 2 * slot, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+			return;
 		}
+		const double gpuMs = ((timestamps[1] - timestamps[0]) & m_timestampMask) * m_timestampPeriodNs * 1e-6;
+		m_renderScale.Update(gpuMs, m_frameScales[slot]);
 	}
 
 	void createRenderPass() {
@@ -231,7 +563,8 @@ private:
 		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		// Blitted to the swap chain image right after the pass
+		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
 
 		VkAttachmentReference colorAttachmentRef = {};
 		colorAttachmentRef.attachment = 0;
@@ -242,13 +575,20 @@ private:
 		subpassDesc.colorAttachmentCount = 1;
 		subpassDesc.pColorAttachments = &colorAttachmentRef; 
 		
-		VkSubpassDependency dependency = {};
-		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependency.dstSubpass = 0;
-		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.srcAccessMask = 0;
-		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		VkSubpassDependency dependencies[2] = {};
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].srcAccessMask = 0;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		// Rendering is done before the blit reads the target
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
 
 		VkRenderPassCreateInfo renderPassInfo = {};
 		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -256,8 +596,8 @@ private:
 		renderPassInfo.pAttachments = &colorAttachment;
 		renderPassInfo.subpassCount = 1;
 		renderPassInfo.pSubpasses = &subpassDesc; 
-		renderPassInfo.dependencyCount = 1;
-		renderPassInfo.pDependencies = &dependency;
+		renderPassInfo.dependencyCount = 2;
+		renderPassInfo.pDependencies = dependencies;
 		
 		if (vkCreateRenderPass(m_device, &renderPassInfo, nullptr, &m_renderPass) != VK_SUCCESS) {
 			throw std::runtime_error("Cannot create render pass");
@@ -266,62 +606,67 @@ private:
 
 	void createGraphicsPipeline() {
 		// Shader creation and setup
-		auto vertShaderCode = readFile("Shaders/vert.spv");
-		auto fragShaderCode = readFile("Shaders/frag.spv");
+		// Cache hits map the SPIR-V straight from disk, only edited shaders reach glslang
+		ShaderBinary vertShaderCode = m_shaderCompiler.Compile({ "Shaders/shader.vert", ShaderStage::Vertex });
+		ShaderBinary fragShaderCode = m_shaderCompiler.Compile({ "Shaders/shader.frag", ShaderStage::Fragment });
 
 		// shaders
-		VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-		VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+		VkShaderModule vertShaderModule = createShaderModule(vertShaderCode.spirv);
+		VkShaderModule fragShaderModule = createShaderModule(fragShaderCode.spirv);
 
 		VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
 		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
 		vertShaderStageInfo.module = vertShaderModule;
 		vertShaderStageInfo.pName = "main";
-		vertShaderStageInfo.pSpecializationInfo = nullptr;
+		vertShaderStageInfo.pSpecializationInfo = m_vertVariant.GetInfo();
 
 		VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
 		fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
 		fragShaderStageInfo.module = fragShaderModule;
 		fragShaderStageInfo.pName = "main";
-		fragShaderStageInfo.pSpecializationInfo = nullptr;
+		fragShaderStageInfo.pSpecializationInfo = m_fragVariant.GetInfo();
 
 		VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
+		// Interface is reflected from the SPIR-V, layouts come from the shared cache
+		ShaderReflectionVulkan vertReflection;
+		ShaderReflectionVulkan fragReflection;
+		vertReflection.Reflect(vertShaderCode.spirv);
+		fragReflection.Reflect(fragShaderCode.spirv);
+		m_vertVariant.Validate(vertReflection);
+		m_fragVariant.Validate(fragReflection);
+
 		// Vertex input
+		std::vector<VkVertexInputBindingDescription> vertexBindings;
+		std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+		vertReflection.BuildVertexInput(vertexBindings, vertexAttributes);
+
 		VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
 		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		vertexInputInfo.pVertexAttributeDescriptions = nullptr;
-		vertexInputInfo.vertexAttributeDescriptionCount = 0;
-		vertexInputInfo.pVertexBindingDescriptions = nullptr;
-		vertexInputInfo.vertexBindingDescriptionCount = 0;
+		vertexInputInfo.pVertexAttributeDescriptions = vertexAttributes.data();
+		vertexInputInfo.vertexAttributeDescriptionCount = (uint32_t)vertexAttributes.size();
+		vertexInputInfo.pVertexBindingDescriptions = vertexBindings.data();
+		vertexInputInfo.vertexBindingDescriptionCount = (uint32_t)vertexBindings.size();
 
 		VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
 		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
 		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 		inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-		// Viewport and Scissor
-		VkViewport viewport = {};
-		viewport.x = 0;
-		viewport.y = 0;
-		viewport.width = (float)m_swapChainExtent.width;
-		viewport.height = (float)m_swapChainExtent.height;
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-
-		VkRect2D scissor = {};
-		scissor.offset = { 0, 0 };
-		scissor.extent = m_swapChainExtent;
-
+		// Viewport and Scissor, dynamic: they follow the render scale every frame
 		VkPipelineViewportStateCreateInfo viewportState = {};
 		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-		viewportState.pViewports = &viewport;
 		viewportState.viewportCount = 1;
-		viewportState.pScissors = &scissor;
 		viewportState.scissorCount = 1;
 
+		const VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamicState = {};
+		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicState.dynamicStateCount = 2;
+		dynamicState.pDynamicStates = dynamicStates;
+
 		// Rasterizer
 		VkPipelineRasterizationStateCreateInfo rasterizer = {};
 		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -355,16 +700,8 @@ private:
 		colorBlending.blendConstants[2] = 0.0f;
 		colorBlending.blendConstants[3] = 0.0f;
 
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
-		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = 0;
-		pipelineLayoutInfo.pSetLayouts = nullptr;
-		pipelineLayoutInfo.pushConstantRangeCount = 0;
-		pipelineLayoutInfo.pPushConstantRanges = nullptr;
-
-		if (vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
-			throw std::runtime_error("Cannot create pipeline layout");
-		}
+		const ShaderReflectionVulkan * reflections[] = { &vertReflection, &fragReflection };
+		m_pipelineLayout = m_layoutCache.GetLayout(reflections, 2).m_native;
 		
 		VkGraphicsPipelineCreateInfo gfxPipelineInfo = {};
 		gfxPipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -378,25 +715,28 @@ private:
 		gfxPipelineInfo.pMultisampleState = &multisampling;
 		gfxPipelineInfo.pDepthStencilState = nullptr;
 		gfxPipelineInfo.pColorBlendState = &colorBlending;
-		gfxPipelineInfo.pDynamicState = nullptr;
+		gfxPipelineInfo.pDynamicState = &dynamicState;
 		gfxPipelineInfo.renderPass = m_renderPass;
 		gfxPipelineInfo.subpass = 0;
 		gfxPipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 		gfxPipelineInfo.basePipelineIndex = -1;
 
-		if (vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &gfxPipelineInfo, nullptr, &m_gfxPipeline)) {
-			throw std::runtime_error("Cannot create graphics pipeline");
-		}
+		// Same shaders, same variants and same state resolve to the same pipeline
+		m_gfxPipelineKey = PipelineKeyVulkan()
+			.AddBytes(vertShaderCode.spirv.words, vertShaderCode.spirv.SizeInBytes()).AddSpecialization(m_vertVariant.GetInfo())
+			.AddBytes(fragShaderCode.spirv.words, fragShaderCode.spirv.SizeInBytes()).AddSpecialization(m_fragVariant.GetInfo())
+			.Add(m_pipelineLayout).Add(m_renderPass);
+		m_gfxPipeline = m_pipelineCache.CreateGraphicsPipeline(m_gfxPipelineKey, gfxPipelineInfo);
 
 		vkDestroyShaderModule(m_device, vertShaderModule, nullptr);
 		vkDestroyShaderModule(m_device, fragShaderModule, nullptr);
 	}
 
-	VkShaderModule createShaderModule(const std::vector<char> & shader) {
+	VkShaderModule createShaderModule(const SpirvBlob & shader) {
 		VkShaderModuleCreateInfo createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		createInfo.codeSize = shader.size();
-		createInfo.pCode = reinterpret_cast<const uint32_t*>(shader.data());
+		createInfo.codeSize = shader.SizeInBytes();
+		createInfo.pCode = shader.words;
 		VkShaderModule shaderModule;
 		if (VK_SUCCESS != vkCreateShaderModule(m_device, &createInfo, nullptr, &shaderModule)) {
 			throw std::runtime_error("Cannot create shader module");
@@ -415,8 +755,9 @@ private:
 		// Before creating device, setup a graphical queue
 		QueueFamilyIndices indices = findQueueFamilies(m_physicalDevice);
 
-		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-		std::set<int> uniqueQueueFamilyIndices = { indices.graphicsFamily, indices.presentFamily };
+		ArenaScope scratch(LinearArena::ThreadLocal());
+		ArenaVector<VkDeviceQueueCreateInfo> queueCreateInfos(scratch.GetArena());
+		ArenaSet<int> uniqueQueueFamilyIndices({ indices.graphicsFamily, indices.presentFamily }, std::less<int>(), scratch.GetArena());
 		float queuePriority = 1.0f;
 
 		for (int queueFamily : uniqueQueueFamilyIndices) {
@@ -477,16 +818,15 @@ private:
 	}
 
 	void createSwapChain() {
-		SwapChainSupportDetails swapChainDetails = querySwapChainSupport(m_physicalDevice);
+		AllocationScopeGuard scope(AllocationScope::SwapChain);
+		ArenaScope scratch(LinearArena::ThreadLocal());
+		SwapChainSupportDetails swapChainDetails = querySwapChainSupport(m_physicalDevice, scratch.GetArena());
 
 		VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainDetails.formats);
 		VkExtent2D extent = chooseSwapExtent(swapChainDetails.capabilities);
-		VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainDetails.presentModes);
-
-		uint32_t imageCount = swapChainDetails.capabilities.minImageCount + 1;
-		if (swapChainDetails.capabilities.maxImageCount > 0 && swapChainDetails.capabilities.maxImageCount < imageCount) {
-			imageCount = swapChainDetails.capabilities.maxImageCount;
-		}
+		const PresentConfigVulkan presentConfig = ChoosePresentConfigVulkan(m_presentPolicy, swapChainDetails.capabilities,
+			swapChainDetails.presentModes.data(), (uint32_t)swapChainDetails.presentModes.size());
+		uint32_t imageCount = presentConfig.imageCount;
 
 		VkSwapchainCreateInfoKHR createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -495,7 +835,11 @@ private:
 		createInfo.imageColorSpace = surfaceFormat.colorSpace;
 		createInfo.imageExtent = extent;
 		createInfo.imageArrayLayers = 1;
-		createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		// Only ever written by the upscale blit
+		if (!(swapChainDetails.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
+			throw std::runtime_error("swap chain images cannot be blitted to");
+		}
+		createInfo.imageUsage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 		createInfo.minImageCount = imageCount;
 
 		QueueFamilyIndices indices = findQueueFamilies(m_physicalDevice);
@@ -515,13 +859,18 @@ private:
 		createInfo.preTransform = swapChainDetails.capabilities.currentTransform;
 		createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;//VK_COMPOSITE_ALPHA_PRE_MULTIPLIED_BIT_KHR;
 
-		createInfo.presentMode = presentMode;
+		createInfo.presentMode = presentConfig.presentMode;
 		createInfo.clipped = VK_TRUE;
-		createInfo.oldSwapchain = VK_NULL_HANDLE;
+		createInfo.oldSwapchain = m_swapChain;
 
-		if (vkCreateSwapchainKHR(m_device, &createInfo, nullptr, &m_swapChain) != VK_SUCCESS) {
+		VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+		if (vkCreateSwapchainKHR(m_device, &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create swap chain");
 		}
+		if (m_swapChain != VK_NULL_HANDLE) {
+			vkDestroySwapchainKHR(m_device, m_swapChain, nullptr);
+		}
+		m_swapChain = swapChain;
 
 		// Retrieves swap chain images
 		vkGetSwapchainImagesKHR(m_device, m_swapChain, &imageCount, nullptr);
@@ -533,41 +882,18 @@ private:
 		m_swapChainExtent = extent;
 	}
 
-	void createImageViews() {
-		m_swapChainImageViews.resize(m_swapChainImages.size());
-
-		for (size_t i = 0; i < m_swapChainImages.size(); ++i) {
-			VkImageViewCreateInfo createInfo = {};
-			createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-			createInfo.image = m_swapChainImages[i];
-			createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-			createInfo.format = m_swapChainImageFormat;
-			createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-			createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-			createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-			createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-			createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			createInfo.subresourceRange.baseArrayLayer = 0;
-			createInfo.subresourceRange.layerCount = 1;
-			createInfo.subresourceRange.baseMipLevel = 0;
-			createInfo.subresourceRange.levelCount = 1;
-
-			if (vkCreateImageView(m_device, &createInfo, nullptr, &m_swapChainImageViews[i]) != VK_SUCCESS) {
-				throw std::runtime_error("failed to create image views");
-			}
-		}
-	}
-
 	QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device) {
+		ArenaScope scratch(LinearArena::ThreadLocal());
+
 		QueueFamilyIndices indices;
 		uint32_t queueFamCount = 0;
 		vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamCount, nullptr);
 
-		std::vector<VkQueueFamilyProperties> queueFamProp(queueFamCount);
-		vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamCount, queueFamProp.data());
+		VkQueueFamilyProperties * queueFamProp = scratch.GetArena().AllocateArray<VkQueueFamilyProperties>(queueFamCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamCount, queueFamProp);
 
-		int i = 0;
-		for (auto& queueFam : queueFamProp) {
+		for (int i = 0; i < (int)queueFamCount; ++i) {
+			const VkQueueFamilyProperties & queueFam = queueFamProp[i];
 			VkBool32 presentSupport = false;
 			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentSupport);
 			if (queueFam.queueCount > 0 && queueFam.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
@@ -580,8 +906,6 @@ private:
 			if (indices.isComplete()) {
 				break;
 			}
-
-			++i;
 		}
 		return indices;
 	}
@@ -599,10 +923,11 @@ private:
 
 		bool swapChainAdequate = false;
 		if (extensionsSupported) {
-			SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
+			ArenaScope scratch(LinearArena::ThreadLocal());
+			SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device, scratch.GetArena());
 			swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
 		}
-		return findQueueFamilies(device).isComplete() && extensionsSupported && swapChainAdequate;
+		return indices.isComplete() && extensionsSupported && swapChainAdequate;
 	}
 
 	bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
@@ -665,7 +990,7 @@ private:
 		createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
 		createInfo.ppEnabledExtensionNames = extensions.data();
 
-		if (checkInstanceExtensions(extensions)) {
+		if (!checkInstanceExtensions(extensions)) {
 			throw std::runtime_error("missing extension");
 		}
 
@@ -675,35 +1000,162 @@ private:
 	}
 
 	void mainLoop() {
+		// GLFW stays on this thread, Vulkan queues are only touched by the render thread
+		m_renderThread = std::thread(&HelloTriangleApplication::renderLoop, this);
+
+		AllocationScopeGuard scope(AllocationScope::Frame);
 		while (!glfwWindowShouldClose(m_window)) {
+			// Nothing to show: the thread sleeps in the event queue until input or the next scene change
+			const auto now = std::chrono::steady_clock::now();
+			if (!m_scheduler.ShouldRender(now)) {
+				m_scheduler.OnIdleWait();
+				glfwWaitEventsTimeout(m_scheduler.GetIdleWaitSeconds(now));
+				m_shaderWatcher.DispatchReloads();
+				continue;
+			}
+
+			m_scheduler.BeginFrame();
+			m_frameBudget.BeginFrame();
+
+			if (!m_framePacer.WaitForSlot()) {
+				break;
+			}
+
 			glfwPollEvents();
-			drawFrame();
+			m_shaderWatcher.DispatchReloads();
+			m_scheduler.OnInputSampled();
+
+			if (!m_frameQueue.Push(simulate())) {
+				break;
+			}
+
+			m_frameBudget.EndFrame();
 		}
+
+		m_frameQueue.Close();
+		m_framePacer.Close();
+		m_renderThread.join();
 		vkDeviceWaitIdle(m_device);
+		printPresentLatency();
+		m_scheduler.PrintReport(std::cout);
+
+		if (m_frameBudget.IsExceeded()) {
+			m_frameBudget.PrintReport(std::cerr);
+			AllocationCounter::PrintReport(std::cerr);
+		}
+
+		if (m_renderError) {
+			std::rethrow_exception(m_renderError);
+		}
+	}
+
+	FrameSnapshot simulate() {
+		FrameSnapshot snapshot(m_frameArenas.BeginFrame(m_frameNumber));
+		snapshot.frameNumber = m_frameNumber++;
+		snapshot.time = glfwGetTime();
+		snapshot.inputTime = std::chrono::steady_clock::now();
+		snapshot.rebuildPipeline = m_pipelineDirty;
+		m_pipelineDirty = false;
+		snapshot.presentPolicy = m_requestedPresentPolicy;
+		snapshot.dynamicResolution = m_isDynamicResolution;
+		snapshot.grayscale = m_isGrayscale;
+
+		// Cycles the triangle colors once per second
+		DrawParamsVulkan params = {};
+		params.objectIndex = 0;
+		params.materialIndex = (uint32_t)snapshot.time % 3;
+		snapshot.draws.push_back(params);
+
+		// The colors only change on whole seconds, nothing needs rendering before the next one
+		m_scheduler.RequestFrameIn(std::floor(snapshot.time) + 1.0 - snapshot.time);
+		return snapshot;
 	}
 
-	void drawFrame() {
-		uint32_t imageIndex;
-		vkAcquireNextImageKHR(m_device, m_swapChain, std::numeric_limits<uint64_t>::max(), m_imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+	void renderLoop() {
+		try {
+			AllocationScopeGuard scope(AllocationScope::Frame);
+			FrameSnapshot snapshot;
+			beginFrame();
+			while (m_frameQueue.Pop(snapshot)) {
+				if (snapshot.grayscale != m_isGrayscalePipeline) {
+					m_isGrayscalePipeline = snapshot.grayscale;
+					snapshot.rebuildPipeline = true;
+				}
+				if (snapshot.rebuildPipeline) {
+					recreateGraphicsPipeline();
+				}
+				drawFrame(snapshot);
+				// The image acquired for this frame belonged to the old swap chain, the next one will not
+				if (snapshot.presentPolicy != m_presentPolicy) {
+					recreateSwapChain(snapshot.presentPolicy);
+				}
+				beginFrame();
+			}
+		}
+		catch (...) {
+			// Handed to the main thread, which rethrows once the render thread is joined
+			m_renderError = std::current_exception();
+			m_frameQueue.Close();
+			m_framePacer.Close();
+		}
+	}
+
+	// Every blocking wait of a frame, before the main thread is let to sample input for it
+	void beginFrame() {
+		pollCompletedFrames();
+
+		// Back-pressure from the GPU: the slot is free once the frame submitted MAX_FRAMES_IN_FLIGHT ago completed
+		vkWaitForFences(m_device, 1, &m_inFlightFences[m_currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+		m_frameLatency.OnComplete(m_currentFrame, std::chrono::steady_clock::now());
+		readFrameTimestamps(m_currentFrame);
+
+		// Acquire blocks when the policy queues frames behind the display, see printPresentLatency()
+		m_acquireStart = std::chrono::steady_clock::now();
+		vkAcquireNextImageKHR(m_device, m_swapChain, std::numeric_limits<uint64_t>::max(), m_imageAvailableSemaphores[m_currentFrame], VK_NULL_HANDLE, &m_imageIndex);
+		m_acquireLatency.Add(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_acquireStart).count());
+
+		m_framePacer.SignalSlotReady();
+	}
+
+	// Stamps the frames whose fence signaled since the last look, without waiting
+	void pollCompletedFrames() {
+		const auto now = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+			if (m_frameLatency.IsPending(i) && vkGetFenceStatus(m_device, m_inFlightFences[i]) == VK_SUCCESS) {
+				m_frameLatency.OnComplete(i, now);
+			}
+		}
+	}
+
+	void drawFrame(const FrameSnapshot & snapshot) {
+		// Reset only once the frame is sure to be submitted, the fence must not stay unsignaled otherwise
+		vkResetFences(m_device, 1, &m_inFlightFences[m_currentFrame]);
+		const uint32_t imageIndex = m_imageIndex;
+
+		VkCommandBuffer commandBuffer = m_commandBuffers[m_currentFrame];
+		vkResetCommandBuffer(commandBuffer, 0);
+		recordCommandBuffer(commandBuffer, imageIndex, snapshot);
 
 		VkSubmitInfo submitInfo = {};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-		VkSemaphore	waitSemaphores[] = { m_imageAvailableSemaphore };
-		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+		VkSemaphore	waitSemaphores[] = { m_imageAvailableSemaphores[m_currentFrame] };
+		// The swap chain image is first touched by the upscale blit
+		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_TRANSFER_BIT };
 		submitInfo.waitSemaphoreCount = 1;
 		submitInfo.pWaitSemaphores = waitSemaphores;
 		submitInfo.pWaitDstStageMask = waitStages;
 		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &m_commandBuffers[imageIndex];
+		submitInfo.pCommandBuffers = &commandBuffer;
 		
-		VkSemaphore signalSemaphores[] = { m_renderFinishedSemaphore };
+		VkSemaphore signalSemaphores[] = { m_renderFinishedSemaphores[m_currentFrame] };
 		submitInfo.signalSemaphoreCount = 1;
 		submitInfo.pSignalSemaphores = signalSemaphores;
 
-		if (vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+		if (vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_inFlightFences[m_currentFrame]) != VK_SUCCESS) {
 			throw std::runtime_error("Error while sumbitting");
 		}
+		m_frameLatency.OnSubmit(m_currentFrame, snapshot.inputTime, std::chrono::steady_clock::now());
 
 		VkPresentInfoKHR presentInfo = {};
 		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -717,29 +1169,37 @@ private:
 		presentInfo.pImageIndices = &imageIndex;
 
 		vkQueuePresentKHR(m_presentQueue, &presentInfo);
+		m_acquireToPresentCallLatency.Add(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_acquireStart).count());
+		if (snapshot.frameNumber == 0) {
+			StartupProfile::Get().MarkFirstFrame();
+		}
+
+		m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 	}
 
 	void cleanup() {
-		vkDestroySemaphore(m_device, m_imageAvailableSemaphore, nullptr);
-
-		vkDestroySemaphore(m_device, m_renderFinishedSemaphore, nullptr);
+		for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+			vkDestroySemaphore(m_device, m_imageAvailableSemaphores[i], nullptr);
+			vkDestroySemaphore(m_device, m_renderFinishedSemaphores[i], nullptr);
+			vkDestroyFence(m_device, m_inFlightFences[i], nullptr);
+		}
 
 		vkDestroyCommandPool(m_device, m_commandPool, nullptr);
 
-		vkDestroyPipeline(m_device, m_gfxPipeline, nullptr);
+		m_frameConstants.Destroy();
+		m_frameUniforms.Destroy();
+
+		m_pipelineCache.Destroy();
 
-		vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+		m_layoutCache.Destroy();
 
-		for (auto fb : m_swapChainFramebuffers) {
-			vkDestroyFramebuffer(m_device, fb, nullptr);
+		for (auto & target : m_renderTargets) {
+			target.Destroy();
 		}
+		vkDestroyQueryPool(m_device, m_timestampPool, nullptr);
 
 		vkDestroyRenderPass(m_device, m_renderPass, nullptr);
 
-		for (size_t i = 0; i < m_swapChainImageViews.size(); i++) {
-			vkDestroyImageView(m_device, m_swapChainImageViews[i], nullptr);
-		}
-
 		vkDestroySwapchainKHR(m_device, m_swapChain, nullptr);
 
 		vkDestroyDevice(m_device, nullptr);
@@ -787,12 +1247,6 @@ private:
 		std::vector<VkExtensionProperties> extensions(extensionCount);
 		vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
 
-		std::cout << "available extensions:" << std::endl;
-
-		for (const auto & extension : extensions) {
-			std::cout << "\t" << extension.extensionName << std::endl;
-		}
-
 		bool allFound = true;
 		for (const auto & req : requiredExt) {
 			bool found = false;
@@ -802,9 +1256,12 @@ private:
 					break;
 				}
 			}
+			if (!found) {
+				std::cerr << "missing instance extension: " << req << std::endl;
+			}
 			allFound &= found;
 		}
-		return false;
+		return allFound;
 	}
 
 	std::vector<const char*> getRequiredExtensions() {
@@ -824,8 +1281,9 @@ private:
 		return extensions;
 	}
 
-	SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device) {
-		SwapChainSupportDetails details;
+	// The lists are allocated in arena, callers open an ArenaScope around the query
+	SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, LinearArena & arena) {
+		SwapChainSupportDetails details(arena);
 
 		vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, m_surface, &details.capabilities);
 
@@ -846,7 +1304,7 @@ private:
 		return details;
 	}
 
-	VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats) {
+	VkSurfaceFormatKHR chooseSwapSurfaceFormat(const ArenaVector<VkSurfaceFormatKHR>& availableFormats) {
 		if (availableFormats.size() == 1 && availableFormats[0].format == VK_FORMAT_UNDEFINED) {
 			return { VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
 		}
@@ -860,21 +1318,6 @@ private:
 		return availableFormats[0];
 	}
 
-	VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
-		VkPresentModeKHR bestMode = VK_PRESENT_MODE_FIFO_KHR;
-
-		for (auto& availablePresentMode : availablePresentModes) {
-			if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-				return availablePresentMode;
-			}
-			else if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-				bestMode = availablePresentMode;
-			}
-		}
-
-		return bestMode;
-	}
-
 	VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) {
 		if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
 			return capabilities.currentExtent;